@@ -0,0 +1,551 @@
+#include "async_jobs.h"
+#include "simd_optimizations.h"
+#include "sticker_pipeline.h"
+#include "thread_pool.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Dart_CObject_kInt64
+#define DART_COBJECT_INT64 3
+
+// Layout of a Dart_CObject holding an int64, which is all jobs post
+typedef struct {
+    int32_t type;
+    union {
+        int64_t as_int64;
+        double as_double;
+        void* as_pointer;
+    } value;
+} JobMessage;
+
+typedef enum {
+    JOB_FUSED,
+    JOB_SMOOTH,
+    JOB_EXPAND,
+    JOB_SDF,
+    JOB_APPLY_SDF,
+    JOB_RESIZE,
+    JOB_UPSAMPLE,
+    JOB_SESSION,
+    JOB_CACHE_PUT
+} JobKind;
+
+typedef struct Job {
+    struct Job* next;
+    JobKind kind;
+    int64_t port;
+    int64_t id;
+    MaskJobState* state;
+    MaskProcessorContext* context;
+
+    // Arguments; which ones are used depends on the kind
+    const void* src;
+    void* dst;
+    const double* mask;
+    const float* sdf;
+    int width;
+    int height;
+    int dst_width;
+    int dst_height;
+    // Kernel size, border width or output format
+    int size;
+    int flag;
+    RGBColor border_color;
+    float border_width;
+    double threshold;
+    float mean[3];
+    float inv_std[3];
+    StickerSession** session;
+    MaskCache* cache;
+    MaskHash128 key;
+} Job;
+
+// Jobs run in order within a lane; each lane has its own thread
+typedef struct {
+    Job* head;
+    Job* tail;
+    pthread_cond_t ready;
+    int started;
+} JobLane;
+
+enum {
+    // Kernels, on the full thread pool
+    LANE_KERNELS,
+    // Cache puts, which mostly wait on the disk and would otherwise hold
+    // up the kernels queued behind them
+    LANE_DISK,
+    LANE_COUNT
+};
+
+static struct {
+    MaskPostCObjectFn post;
+    JobLane lanes[LANE_COUNT];
+} queue = {
+    .lanes = {
+        [LANE_KERNELS] = { NULL, NULL, PTHREAD_COND_INITIALIZER, 0 },
+        [LANE_DISK] = { NULL, NULL, PTHREAD_COND_INITIALIZER, 0 }
+    }
+};
+
+// Parallel passes each kind makes on its default path, which progress is
+// spread over. An estimate: a few paths, such as a fused job on a single
+// thread, make fewer, and progress then jumps to 1 at the end.
+static const int job_passes[] = {
+    [JOB_FUSED] = 1,
+    [JOB_SMOOTH] = 1,
+    [JOB_EXPAND] = 1,
+    [JOB_SDF] = 4,
+    [JOB_APPLY_SDF] = 1,
+    [JOB_RESIZE] = 1,
+    [JOB_UPSAMPLE] = 1,
+    [JOB_SESSION] = 6,
+    [JOB_CACHE_PUT] = 1
+};
+
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t worker_once[LANE_COUNT] = { PTHREAD_ONCE_INIT, PTHREAD_ONCE_INIT };
+
+static MaskProcessorResult run_job(Job* job) {
+    MaskProcessorContext* context = job->context;
+
+    switch (job->kind) {
+    case JOB_FUSED:
+        return context
+            ? make_sticker_mask_fused_ctx(
+                  context, job->src, job->dst, job->mask, job->width, job->height,
+                  job->size, job->flag, job->border_color, (int)job->border_width)
+            : make_sticker_mask_fused(
+                  job->src, job->dst, job->mask, job->width, job->height,
+                  job->size, job->flag, job->border_color, (int)job->border_width);
+    case JOB_SMOOTH:
+        return context
+            ? smooth_mask_ctx(context, job->mask, job->dst, job->width, job->height, job->size)
+            : smooth_mask_optimized(job->mask, job->dst, job->width, job->height, job->size);
+    case JOB_EXPAND:
+        return context
+            ? expand_mask_ctx(context, job->mask, job->dst, job->width, job->height, job->size)
+            : expand_mask_optimized(job->mask, job->dst, job->width, job->height, job->size);
+    case JOB_SDF:
+        return context
+            ? compute_mask_sdf_ctx(context, job->mask, job->dst, job->width, job->height)
+            : compute_mask_sdf_native(job->mask, job->dst, job->width, job->height);
+    case JOB_APPLY_SDF:
+        if (job->src == job->dst) {
+            return apply_sticker_mask_sdf_native(
+                job->dst, job->mask, job->sdf, job->width, job->height,
+                job->flag, job->border_color, job->border_width);
+        }
+        return apply_sticker_mask_sdf_to_native(
+            job->src, job->dst, job->mask, job->sdf, job->width, job->height,
+            job->flag, job->border_color, job->border_width);
+    case JOB_RESIZE:
+        return context
+            ? resize_rgba_to_nchw_ctx(
+                  context, job->src, job->width, job->height, job->dst,
+                  job->dst_width, job->dst_height, job->mean, job->inv_std)
+            : resize_rgba_to_nchw(
+                  job->src, job->width, job->height, job->dst,
+                  job->dst_width, job->dst_height, job->mean, job->inv_std);
+    case JOB_UPSAMPLE:
+        return context
+            ? upsample_mask_tensor_ctx(
+                  context, job->src, job->width, job->height, job->dst,
+                  (MaskOutputFormat)job->size, job->dst_width, job->dst_height,
+                  job->flag, job->threshold)
+            : upsample_mask_tensor(
+                  job->src, job->width, job->height, job->dst,
+                  (MaskOutputFormat)job->size, job->dst_width, job->dst_height,
+                  job->flag, job->threshold);
+    case JOB_SESSION:
+        return sticker_session_create(
+            job->session, job->src, job->mask, job->width, job->height,
+            job->size, job->flag, job->border_color, job->border_width);
+    case JOB_CACHE_PUT:
+        return mask_cache_put(job->cache, &job->key, job->mask, job->width, job->height);
+    }
+    return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+}
+
+// Run a job with its state attached as the monitor of this thread
+static MaskProcessorResult job_run_monitored(Job* job) {
+    MaskJobState* state = job->state;
+    if (__atomic_load_n(&state->cancelled, __ATOMIC_RELAXED)) {
+        if (job->kind == JOB_SESSION) {
+            *job->session = NULL;
+        }
+        return MASK_PROCESSOR_ERROR_CANCELLED;
+    }
+
+    MaskJobMonitor monitor = { &state->cancelled, &state->progress, job_passes[job->kind], 0 };
+    MaskJobMonitor* previous = mask_job_monitor_attach(&monitor);
+    const MaskProcessorResult result = run_job(job);
+    mask_job_monitor_attach(previous);
+
+    // A cancellation that lands after the last pass leaves the result alone
+    if (result == MASK_PROCESSOR_SUCCESS) {
+        const float done = 1.0f;
+        __atomic_store(&state->progress, &done, __ATOMIC_RELAXED);
+    }
+    return result;
+}
+
+static void* worker_main(void* arg) {
+    JobLane* lane = (JobLane*)arg;
+
+    for (;;) {
+        pthread_mutex_lock(&queue_lock);
+        while (!lane->head) {
+            pthread_cond_wait(&lane->ready, &queue_lock);
+        }
+        Job* job = lane->head;
+        lane->head = job->next;
+        if (!lane->head) {
+            lane->tail = NULL;
+        }
+        const MaskPostCObjectFn post = queue.post;
+        pthread_mutex_unlock(&queue_lock);
+
+        job->state->result = job_run_monitored(job);
+
+        JobMessage message;
+        message.type = DART_COBJECT_INT64;
+        message.value.as_int64 = job->id;
+        post(job->port, &message);
+        free(job);
+    }
+    return NULL;
+}
+
+static void start_lane(JobLane* lane) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, worker_main, lane) == 0) {
+        pthread_detach(thread);
+        lane->started = 1;
+    }
+}
+
+static void start_kernel_lane(void) {
+    start_lane(&queue.lanes[LANE_KERNELS]);
+}
+
+static void start_disk_lane(void) {
+    start_lane(&queue.lanes[LANE_DISK]);
+}
+
+MaskProcessorResult mask_jobs_init(MaskPostCObjectFn post_cobject) {
+    if (!post_cobject) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+    pthread_mutex_lock(&queue_lock);
+    queue.post = post_cobject;
+    pthread_mutex_unlock(&queue_lock);
+    return MASK_PROCESSOR_SUCCESS;
+}
+
+void mask_job_cancel(MaskJobState* state) {
+    if (state) {
+        __atomic_store_n(&state->cancelled, 1, __ATOMIC_RELAXED);
+    }
+}
+
+// Zeroed job for a submission (NULL on allocation failure)
+static Job* job_new(JobKind kind, int64_t port, int64_t job_id, MaskJobState* state) {
+    Job* job = (Job*)calloc(1, sizeof(Job));
+    if (job) {
+        job->kind = kind;
+        job->port = port;
+        job->id = job_id;
+        job->state = state;
+    }
+    return job;
+}
+
+static MaskProcessorResult job_submit(Job* job) {
+    if (!job) {
+        return MASK_PROCESSOR_ERROR_MEMORY;
+    }
+
+    const int index = job->kind == JOB_CACHE_PUT ? LANE_DISK : LANE_KERNELS;
+    JobLane* lane = &queue.lanes[index];
+    pthread_once(&worker_once[index], index == LANE_DISK ? start_disk_lane : start_kernel_lane);
+    pthread_mutex_lock(&queue_lock);
+    if (!queue.post || !lane->started) {
+        pthread_mutex_unlock(&queue_lock);
+        free(job);
+        return MASK_PROCESSOR_ERROR_PROCESSING;
+    }
+    if (lane->tail) {
+        lane->tail->next = job;
+    } else {
+        lane->head = job;
+    }
+    lane->tail = job;
+    pthread_cond_signal(&lane->ready);
+    pthread_mutex_unlock(&queue_lock);
+    return MASK_PROCESSOR_SUCCESS;
+}
+
+MaskProcessorResult make_sticker_mask_fused_async(
+    int64_t port,
+    int64_t job_id,
+    MaskJobState* state,
+    MaskProcessorContext* context,
+    const uint8_t* src,
+    uint8_t* dst,
+    const double* mask,
+    int width,
+    int height,
+    int kernel_size,
+    int add_border,
+    RGBColor border_color,
+    int border_width
+) {
+    if (!state) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+    Job* job = job_new(JOB_FUSED, port, job_id, state);
+    if (job) {
+        job->context = context;
+        job->src = src;
+        job->dst = dst;
+        job->mask = mask;
+        job->width = width;
+        job->height = height;
+        job->size = kernel_size;
+        job->flag = add_border;
+        job->border_color = border_color;
+        job->border_width = (float)border_width;
+    }
+    return job_submit(job);
+}
+
+MaskProcessorResult smooth_mask_async(
+    int64_t port,
+    int64_t job_id,
+    MaskJobState* state,
+    MaskProcessorContext* context,
+    const double* mask,
+    double* output,
+    int width,
+    int height,
+    int kernel_size
+) {
+    if (!state) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+    Job* job = job_new(JOB_SMOOTH, port, job_id, state);
+    if (job) {
+        job->context = context;
+        job->mask = mask;
+        job->dst = output;
+        job->width = width;
+        job->height = height;
+        job->size = kernel_size;
+    }
+    return job_submit(job);
+}
+
+MaskProcessorResult expand_mask_async(
+    int64_t port,
+    int64_t job_id,
+    MaskJobState* state,
+    MaskProcessorContext* context,
+    const double* mask,
+    double* output,
+    int width,
+    int height,
+    int border_width
+) {
+    if (!state) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+    Job* job = job_new(JOB_EXPAND, port, job_id, state);
+    if (job) {
+        job->context = context;
+        job->mask = mask;
+        job->dst = output;
+        job->width = width;
+        job->height = height;
+        job->size = border_width;
+    }
+    return job_submit(job);
+}
+
+MaskProcessorResult compute_mask_sdf_async(
+    int64_t port,
+    int64_t job_id,
+    MaskJobState* state,
+    MaskProcessorContext* context,
+    const double* mask,
+    float* sdf,
+    int width,
+    int height
+) {
+    if (!state) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+    Job* job = job_new(JOB_SDF, port, job_id, state);
+    if (job) {
+        job->context = context;
+        job->mask = mask;
+        job->dst = sdf;
+        job->width = width;
+        job->height = height;
+    }
+    return job_submit(job);
+}
+
+MaskProcessorResult apply_sticker_mask_sdf_async(
+    int64_t port,
+    int64_t job_id,
+    MaskJobState* state,
+    const uint8_t* src,
+    uint8_t* dst,
+    const double* mask,
+    const float* sdf,
+    int width,
+    int height,
+    int add_border,
+    RGBColor border_color,
+    float border_width
+) {
+    if (!state) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+    Job* job = job_new(JOB_APPLY_SDF, port, job_id, state);
+    if (job) {
+        job->src = src;
+        job->dst = dst;
+        job->mask = mask;
+        job->sdf = sdf;
+        job->width = width;
+        job->height = height;
+        job->flag = add_border;
+        job->border_color = border_color;
+        job->border_width = border_width;
+    }
+    return job_submit(job);
+}
+
+MaskProcessorResult resize_rgba_to_nchw_async(
+    int64_t port,
+    int64_t job_id,
+    MaskJobState* state,
+    MaskProcessorContext* context,
+    const uint8_t* src,
+    int src_width,
+    int src_height,
+    float* dst,
+    int dst_width,
+    int dst_height,
+    const float* mean,
+    const float* inv_std
+) {
+    if (!state || !mean || !inv_std) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+    Job* job = job_new(JOB_RESIZE, port, job_id, state);
+    if (job) {
+        job->context = context;
+        job->src = src;
+        job->dst = dst;
+        job->width = src_width;
+        job->height = src_height;
+        job->dst_width = dst_width;
+        job->dst_height = dst_height;
+        memcpy(job->mean, mean, sizeof(job->mean));
+        memcpy(job->inv_std, inv_std, sizeof(job->inv_std));
+    }
+    return job_submit(job);
+}
+
+MaskProcessorResult upsample_mask_tensor_async(
+    int64_t port,
+    int64_t job_id,
+    MaskJobState* state,
+    MaskProcessorContext* context,
+    const float* src,
+    int src_width,
+    int src_height,
+    void* dst,
+    MaskOutputFormat format,
+    int dst_width,
+    int dst_height,
+    int apply_sigmoid,
+    double threshold
+) {
+    if (!state) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+    Job* job = job_new(JOB_UPSAMPLE, port, job_id, state);
+    if (job) {
+        job->context = context;
+        job->src = src;
+        job->dst = dst;
+        job->width = src_width;
+        job->height = src_height;
+        job->size = (int)format;
+        job->dst_width = dst_width;
+        job->dst_height = dst_height;
+        job->flag = apply_sigmoid;
+        job->threshold = threshold;
+    }
+    return job_submit(job);
+}
+
+MaskProcessorResult sticker_session_create_async(
+    int64_t port,
+    int64_t job_id,
+    MaskJobState* state,
+    StickerSession** session,
+    const uint8_t* src,
+    const double* mask,
+    int width,
+    int height,
+    int kernel_size,
+    int add_border,
+    RGBColor border_color,
+    float border_width
+) {
+    if (!state || !session) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+    Job* job = job_new(JOB_SESSION, port, job_id, state);
+    if (job) {
+        job->session = session;
+        job->src = src;
+        job->mask = mask;
+        job->width = width;
+        job->height = height;
+        job->size = kernel_size;
+        job->flag = add_border;
+        job->border_color = border_color;
+        job->border_width = border_width;
+    }
+    return job_submit(job);
+}
+
+MaskProcessorResult mask_cache_put_async(
+    int64_t port,
+    int64_t job_id,
+    MaskJobState* state,
+    MaskCache* cache,
+    const MaskHash128* key,
+    const double* mask,
+    int width,
+    int height
+) {
+    if (!state || !cache || !key) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+    Job* job = job_new(JOB_CACHE_PUT, port, job_id, state);
+    if (job) {
+        job->cache = cache;
+        job->key = *key;
+        job->mask = mask;
+        job->width = width;
+        job->height = height;
+    }
+    return job_submit(job);
+}
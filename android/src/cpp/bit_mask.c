@@ -0,0 +1,563 @@
+#include "bit_mask.h"
+#include "tiling.h"
+#include "scratch_arena.h"
+#include "processor_stats.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Threshold constants matching mask_processor.c
+#define THRESHOLD 0.5
+#define THRESHOLD_HIGH (THRESHOLD + 0.05)
+#define THRESHOLD_LOW (THRESHOLD - 0.05)
+#define THRESHOLD_RANGE 0.1
+#define THRESHOLD_U8 128        // q / 255 > 0.5
+
+// Valid bits of the last word in each row
+static inline uint64_t last_word_bits(int width) {
+    const int tail = width & 63;
+    return tail ? (((uint64_t)1 << tail) - 1) : ~(uint64_t)0;
+}
+
+static inline int same_size(const BitMask* a, const BitMask* b) {
+    return a->width == b->width && a->height == b->height;
+}
+
+static inline int is_valid(const BitMask* mask) {
+    return mask && mask->words && mask->width > 0 && mask->height > 0;
+}
+
+MaskProcessorResult bit_mask_create(BitMask* mask, int width, int height) {
+    if (!mask || width <= 0 || height <= 0) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+
+    mask->width = width;
+    mask->height = height;
+    mask->words_per_row = (width + 63) / 64;
+    mask->words = (uint64_t*)calloc((size_t)mask->words_per_row * height, sizeof(uint64_t));
+    if (!mask->words) {
+        return MASK_PROCESSOR_ERROR_MEMORY;
+    }
+    return MASK_PROCESSOR_SUCCESS;
+}
+
+void bit_mask_destroy(BitMask* mask) {
+    if (!mask) {
+        return;
+    }
+    free(mask->words);
+    mask->words = NULL;
+}
+
+MaskProcessorResult bit_mask_threshold(
+    BitMask* output,
+    const double* values,
+    double threshold
+) {
+    if (!is_valid(output) || !values) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+
+    const int width = output->width;
+    for (int y = 0; y < output->height; y++) {
+        const double* src = values + y * width;
+        uint64_t* dst = output->words + y * output->words_per_row;
+
+        for (int w = 0; w < output->words_per_row; w++) {
+            const int x0 = w * 64;
+            const int n = width - x0 < 64 ? width - x0 : 64;
+            uint64_t word = 0;
+            for (int b = 0; b < n; b++) {
+                word |= (uint64_t)(src[x0 + b] > threshold) << b;
+            }
+            dst[w] = word;
+        }
+    }
+    return MASK_PROCESSOR_SUCCESS;
+}
+
+MaskProcessorResult bit_mask_or(BitMask* output, const BitMask* a, const BitMask* b) {
+    if (!is_valid(output) || !is_valid(a) || !is_valid(b) ||
+        !same_size(output, a) || !same_size(output, b)) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+
+    const size_t count = (size_t)output->words_per_row * output->height;
+    for (size_t i = 0; i < count; i++) {
+        output->words[i] = a->words[i] | b->words[i];
+    }
+    return MASK_PROCESSOR_SUCCESS;
+}
+
+MaskProcessorResult bit_mask_and(BitMask* output, const BitMask* a, const BitMask* b) {
+    if (!is_valid(output) || !is_valid(a) || !is_valid(b) ||
+        !same_size(output, a) || !same_size(output, b)) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+
+    const size_t count = (size_t)output->words_per_row * output->height;
+    for (size_t i = 0; i < count; i++) {
+        output->words[i] = a->words[i] & b->words[i];
+    }
+    return MASK_PROCESSOR_SUCCESS;
+}
+
+// dst |= src shifted toward higher x by shift bits (across word boundaries)
+static void row_or_shift_up(uint64_t* dst, const uint64_t* src, int words, int shift) {
+    const int word_shift = shift >> 6;
+    const int bit_shift = shift & 63;
+
+    for (int i = words - 1; i >= word_shift; i--) {
+        uint64_t v = src[i - word_shift] << bit_shift;
+        if (bit_shift && i - word_shift - 1 >= 0) {
+            v |= src[i - word_shift - 1] >> (64 - bit_shift);
+        }
+        dst[i] |= v;
+    }
+}
+
+// dst |= src shifted toward lower x by shift bits (across word boundaries)
+static void row_or_shift_down(uint64_t* dst, const uint64_t* src, int words, int shift) {
+    const int word_shift = shift >> 6;
+    const int bit_shift = shift & 63;
+
+    for (int i = 0; i + word_shift < words; i++) {
+        uint64_t v = src[i + word_shift] >> bit_shift;
+        if (bit_shift && i + word_shift + 1 < words) {
+            v |= src[i + word_shift + 1] << (64 - bit_shift);
+        }
+        dst[i] |= v;
+    }
+}
+
+void bit_mask_row_dilations(const uint64_t* src, uint64_t* dilated, int width, int max_shift) {
+    const int words = (width + 63) / 64;
+    const size_t row_bytes = sizeof(uint64_t) * words;
+    const uint64_t tail_bits = last_word_bits(width);
+
+    // dilated[k] = dilated[k - 1] plus the source shifted by +/-k
+    memcpy(dilated, src, row_bytes);
+    for (int k = 1; k <= max_shift; k++) {
+        uint64_t* cur = dilated + k * words;
+        memcpy(cur, cur - words, row_bytes);
+        row_or_shift_up(cur, src, words, k);
+        row_or_shift_down(cur, src, words, k);
+        cur[words - 1] &= tail_bits;
+    }
+}
+
+MaskProcessorResult bit_mask_dilate(BitMask* output, const BitMask* input, int radius) {
+    if (!is_valid(output) || !is_valid(input) || !same_size(output, input) ||
+        output->words == input->words || radius < 0) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+
+    const int words = input->words_per_row;
+    const int height = input->height;
+    const size_t row_bytes = sizeof(uint64_t) * words;
+
+    if (radius == 0) {
+        memcpy(output->words, input->words, row_bytes * height);
+        return MASK_PROCESSOR_SUCCESS;
+    }
+
+    // Disc half-width for each row offset, and the source row dilated
+    // horizontally by every half-width 0..radius
+    int* half_width = (int*)mask_scratch_alloc(sizeof(int) * (radius + 1));
+    uint64_t* dilated = (uint64_t*)mask_scratch_alloc(row_bytes * (radius + 1));
+    if (!half_width || !dilated) {
+        mask_scratch_free(half_width);
+        mask_scratch_free(dilated);
+        return MASK_PROCESSOR_ERROR_MEMORY;
+    }
+    for (int dy = 0; dy <= radius; dy++) {
+        half_width[dy] = (int)floor(sqrt((double)radius * radius - (double)dy * dy));
+    }
+
+    memset(output->words, 0, row_bytes * height);
+
+    for (int y = 0; y < height; y++) {
+        const uint64_t* src = input->words + y * words;
+
+        int empty = 1;
+        for (int i = 0; i < words; i++) {
+            if (src[i]) {
+                empty = 0;
+                break;
+            }
+        }
+        if (empty) {
+            continue;
+        }
+
+        bit_mask_row_dilations(src, dilated, input->width, radius);
+
+        // Scatter into every output row the disc reaches
+        const int y0 = y - radius < 0 ? 0 : y - radius;
+        const int y1 = y + radius >= height ? height - 1 : y + radius;
+        for (int ty = y0; ty <= y1; ty++) {
+            const int dy = ty > y ? ty - y : y - ty;
+            const uint64_t* row = dilated + half_width[dy] * words;
+            uint64_t* dst = output->words + ty * words;
+            for (int i = 0; i < words; i++) {
+                dst[i] |= row[i];
+            }
+        }
+    }
+
+    mask_scratch_free(half_width);
+    mask_scratch_free(dilated);
+    return MASK_PROCESSOR_SUCCESS;
+}
+
+MaskProcessorResult expand_mask_packed(
+    const double* mask,
+    BitMask* output,
+    int border_width
+) {
+    // Mask reads and packed writes
+    const uint64_t pixel_count = output ? mask_stage_bytes(output->width, output->height, 1) : 0;
+    const MaskStageTimer timer = mask_stage_enter(
+        MASK_STAGE_EXPAND, pixel_count * sizeof(double) + pixel_count / 8);
+    if (!mask || !is_valid(output) || border_width < 0) {
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_INVALID_PARAMS);
+    }
+
+    BitMask seeds;
+    MaskProcessorResult result = bit_mask_create(&seeds, output->width, output->height);
+    if (result != MASK_PROCESSOR_SUCCESS) {
+        return mask_stage_leave(timer, result);
+    }
+
+    result = bit_mask_threshold(&seeds, mask, THRESHOLD);
+    if (result == MASK_PROCESSOR_SUCCESS) {
+        result = bit_mask_dilate(output, &seeds, border_width);
+    }
+
+    bit_mask_destroy(&seeds);
+    return mask_stage_leave(timer, result);
+}
+
+typedef struct {
+    // Either the double mask and output, or the 8-bit ones
+    const double* mask;
+    double* output;
+    const uint8_t* mask_u8;
+    uint8_t* output_u8;
+    int width;
+    int height;
+    int radius;
+    // Disc half-width per row offset 0..radius
+    const int* half_width;
+    int max_words;
+} ExpandTileJob;
+
+// Pack seeds [c0, c0 + region_width) of row y; returns nonzero if any is set
+static uint64_t threshold_tile_row(
+    const ExpandTileJob* job,
+    int y,
+    int c0,
+    int region_width,
+    uint64_t* seeds
+) {
+    const int words = (region_width + 63) / 64;
+    uint64_t any = 0;
+
+    if (job->mask_u8) {
+        const uint8_t* src = job->mask_u8 + (size_t)y * job->width + c0;
+        for (int w = 0; w < words; w++) {
+            const int x0 = w * 64;
+            const int n = region_width - x0 < 64 ? region_width - x0 : 64;
+            uint64_t word = 0;
+            for (int b = 0; b < n; b++) {
+                word |= (uint64_t)(src[x0 + b] >= THRESHOLD_U8) << b;
+            }
+            seeds[w] = word;
+            any |= word;
+        }
+        return any;
+    }
+
+    const double* src = job->mask + (size_t)y * job->width + c0;
+    for (int w = 0; w < words; w++) {
+        const int x0 = w * 64;
+        const int n = region_width - x0 < 64 ? region_width - x0 : 64;
+        uint64_t word = 0;
+        for (int b = 0; b < n; b++) {
+            word |= (uint64_t)(src[x0 + b] > THRESHOLD) << b;
+        }
+        seeds[w] = word;
+        any |= word;
+    }
+    return any;
+}
+
+// Dilate one tile: threshold the tile plus its clipped radius halo row by
+// row, scatter each row's disc into packed core rows, then unpack the core.
+// Seeds further than radius from the core cannot reach it, so the tile
+// matches the whole-image dilation.
+static void expand_tile(void* context, const MaskTile* tile, void* scratch) {
+    const ExpandTileJob* job = (const ExpandTileJob*)context;
+    const int width = job->width;
+    const int radius = job->radius;
+    const int r0 = tile->y0 - radius < 0 ? 0 : tile->y0 - radius;
+    const int r1 = tile->y1 + radius > job->height ? job->height : tile->y1 + radius;
+    const int c0 = tile->x0 - radius < 0 ? 0 : tile->x0 - radius;
+    const int c1 = tile->x1 + radius > width ? width : tile->x1 + radius;
+    const int region_width = c1 - c0;
+    const int words = (region_width + 63) / 64;
+    const int max_shift = radius < region_width - 1 ? radius : region_width - 1;
+
+    uint64_t* seeds = (uint64_t*)scratch;
+    uint64_t* dilated = seeds + job->max_words;
+    uint64_t* core = dilated + (size_t)(radius + 1) * job->max_words;
+    memset(core, 0, sizeof(uint64_t) * words * (tile->y1 - tile->y0));
+
+    for (int y = r0; y < r1; y++) {
+        if (!threshold_tile_row(job, y, c0, region_width, seeds)) {
+            continue;
+        }
+
+        bit_mask_row_dilations(seeds, dilated, region_width, max_shift);
+
+        const int t0 = y - radius > tile->y0 ? y - radius : tile->y0;
+        const int t1 = y + radius < tile->y1 - 1 ? y + radius : tile->y1 - 1;
+        for (int t = t0; t <= t1; t++) {
+            const int dy = t > y ? t - y : y - t;
+            const int shift = job->half_width[dy] < max_shift ? job->half_width[dy] : max_shift;
+            const uint64_t* row = dilated + shift * words;
+            uint64_t* dst = core + (t - tile->y0) * words;
+            for (int i = 0; i < words; i++) {
+                dst[i] |= row[i];
+            }
+        }
+    }
+
+    for (int y = tile->y0; y < tile->y1; y++) {
+        const uint64_t* bits = core + (y - tile->y0) * words;
+        if (job->output_u8) {
+            uint8_t* dst = job->output_u8 + (size_t)y * width;
+            for (int x = tile->x0; x < tile->x1; x++) {
+                const int bit = x - c0;
+                dst[x] = (bits[bit >> 6] >> (bit & 63)) & 1 ? 255 : 0;
+            }
+            continue;
+        }
+        double* dst = job->output + (size_t)y * width;
+        for (int x = tile->x0; x < tile->x1; x++) {
+            const int bit = x - c0;
+            dst[x] = (bits[bit >> 6] >> (bit & 63)) & 1 ? 1.0 : 0.0;
+        }
+    }
+}
+
+// Run the tiles of a plan over the double mask or, with mask NULL, the
+// 8-bit one
+static MaskProcessorResult expand_tiles(
+    const double* mask,
+    double* output,
+    const uint8_t* mask_u8,
+    uint8_t* output_u8,
+    int width,
+    int height,
+    int border_width,
+    const MaskTilePlan* plan
+) {
+    int* half_width = (int*)mask_scratch_alloc(sizeof(int) * (border_width + 1));
+    if (!half_width) {
+        return MASK_PROCESSOR_ERROR_MEMORY;
+    }
+    for (int dy = 0; dy <= border_width; dy++) {
+        half_width[dy] = (int)floor(sqrt((double)border_width * border_width - (double)dy * dy));
+    }
+
+    const int max_words = (plan->tile_width + 2 * border_width + 63) / 64;
+    ExpandTileJob job = {
+        mask, output, mask_u8, output_u8, width, height, border_width, half_width, max_words
+    };
+    const size_t scratch = sizeof(uint64_t) * max_words *
+        (1 + (size_t)border_width + 1 + plan->tile_height);
+    const MaskProcessorResult result = mask_parallel_tiles(plan, scratch, expand_tile, &job);
+
+    mask_scratch_free(half_width);
+    return result;
+}
+
+int expand_mask_tiles_worthwhile(int width, int height, int border_width) {
+    if (width <= 0 || height <= 0 || border_width <= 0) {
+        return 0;
+    }
+    MaskTilePlan plan;
+    mask_tile_plan(&plan, width, height, border_width, 2 * sizeof(double));
+    return mask_tile_worthwhile(&plan);
+}
+
+MaskProcessorResult expand_mask_tiled(
+    const double* mask,
+    double* output,
+    int width,
+    int height,
+    int border_width
+) {
+    const MaskStageTimer timer = mask_stage_enter(
+        MASK_STAGE_EXPAND, mask_stage_bytes(width, height, 16));
+    if (!mask || !output || width <= 0 || height <= 0 || border_width < 0) {
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_INVALID_PARAMS);
+    }
+    if (border_width == 0) {
+        memcpy(output, mask, sizeof(double) * width * height);
+        return mask_stage_leave(timer, MASK_PROCESSOR_SUCCESS);
+    }
+
+    // Mask reads and output writes
+    MaskTilePlan plan;
+    mask_tile_plan(&plan, width, height, border_width, 2 * sizeof(double));
+    return mask_stage_leave(
+        timer, expand_tiles(mask, output, NULL, NULL, width, height, border_width, &plan));
+}
+
+int expand_mask_u8_tiles_worthwhile(int width, int height, int border_width) {
+    if (width <= 0 || height <= 0 || border_width <= 0) {
+        return 0;
+    }
+    // A single tile has no halo to redo, and the packed dilation beats the
+    // distance transform on its own
+    MaskTilePlan plan;
+    mask_tile_plan(&plan, width, height, border_width, 2);
+    return plan.columns * plan.rows == 1 || mask_tile_worthwhile(&plan);
+}
+
+MaskProcessorResult expand_mask_u8_tiled(
+    const uint8_t* mask,
+    uint8_t* output,
+    int width,
+    int height,
+    int border_width
+) {
+    const MaskStageTimer timer = mask_stage_enter(
+        MASK_STAGE_EXPAND, mask_stage_bytes(width, height, 2));
+    if (!mask || !output || width <= 0 || height <= 0 || border_width < 0) {
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_INVALID_PARAMS);
+    }
+    if (border_width == 0) {
+        memcpy(output, mask, (size_t)width * height);
+        return mask_stage_leave(timer, MASK_PROCESSOR_SUCCESS);
+    }
+
+    // Mask reads and output writes
+    MaskTilePlan plan;
+    mask_tile_plan(&plan, width, height, border_width, 2);
+    return mask_stage_leave(
+        timer, expand_tiles(NULL, NULL, mask, output, width, height, border_width, &plan));
+}
+
+MaskProcessorResult apply_sticker_mask_packed(
+    uint8_t* pixels,
+    const double* mask,
+    int width,
+    int height,
+    int add_border,
+    RGBColor border_color,
+    const BitMask* expanded_mask
+) {
+    const uint64_t pixel_count = mask_stage_bytes(width, height, 1);
+    const MaskStageTimer timer = mask_stage_enter(
+        MASK_STAGE_COMPOSITE, pixel_count * 16 + (expanded_mask ? pixel_count / 8 : 0));
+    if (!pixels || !mask || width <= 0 || height <= 0) {
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_INVALID_PARAMS);
+    }
+    if (expanded_mask && (!is_valid(expanded_mask) ||
+        expanded_mask->width != width || expanded_mask->height != height)) {
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_INVALID_PARAMS);
+    }
+
+    const int border_enabled = add_border && expanded_mask;
+
+    for (int y = 0; y < height; y++) {
+        const double* mask_row = mask + y * width;
+        uint8_t* pixel_row = pixels + y * width * 4;
+        const uint64_t* bits = border_enabled
+            ? expanded_mask->words + y * expanded_mask->words_per_row
+            : NULL;
+
+        for (int x = 0; x < width; x++) {
+            uint8_t* pixel = pixel_row + x * 4;
+            const double mask_value = mask_row[x];
+
+            if (mask_value > THRESHOLD_HIGH) {
+                // Foreground pixel - keep original with full alpha
+                pixel[3] = 255;
+            } else if (mask_value < THRESHOLD_LOW) {
+                if (bits && ((bits[x >> 6] >> (x & 63)) & 1)) {
+                    // Border pixel
+                    pixel[0] = border_color.r;
+                    pixel[1] = border_color.g;
+                    pixel[2] = border_color.b;
+                    pixel[3] = 255;
+                } else {
+                    // Background pixel - transparent
+                    pixel[3] = 0;
+                }
+            } else {
+                // Smooth transition - alpha blending
+                int alpha = (int)round((mask_value - THRESHOLD_LOW) / THRESHOLD_RANGE * 255.0);
+                if (alpha < 0) alpha = 0;
+                if (alpha > 255) alpha = 255;
+                pixel[3] = (uint8_t)alpha;
+            }
+        }
+    }
+
+    return mask_stage_leave(timer, MASK_PROCESSOR_SUCCESS);
+}
+
+MaskProcessorResult apply_sticker_mask_packed_to(
+    const uint8_t* src,
+    uint8_t* dst,
+    const double* mask,
+    int width,
+    int height,
+    int add_border,
+    RGBColor border_color,
+    const BitMask* expanded_mask
+) {
+    const uint64_t pixel_count = mask_stage_bytes(width, height, 1);
+    const MaskStageTimer timer = mask_stage_enter(
+        MASK_STAGE_COMPOSITE, pixel_count * 16 + (expanded_mask ? pixel_count / 8 : 0));
+    if (!src || !dst || !mask || width <= 0 || height <= 0) {
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_INVALID_PARAMS);
+    }
+    if (expanded_mask && (!is_valid(expanded_mask) ||
+        expanded_mask->width != width || expanded_mask->height != height)) {
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_INVALID_PARAMS);
+    }
+
+    const int band_rows = width < MASK_PROCESSOR_COPY_BAND_PIXELS
+        ? MASK_PROCESSOR_COPY_BAND_PIXELS / width : 1;
+
+    for (int y = 0; y < height; y += band_rows) {
+        const int rows = height - y < band_rows ? height - y : band_rows;
+        const size_t offset = (size_t)y * width;
+
+        // Row view of the packed mask covering this band
+        BitMask band;
+        if (expanded_mask) {
+            band = *expanded_mask;
+            band.words += (size_t)y * expanded_mask->words_per_row;
+            band.height = rows;
+        }
+
+        if (dst != src) {
+            memcpy(dst + offset * 4, src + offset * 4, (size_t)rows * width * 4);
+        }
+        const MaskProcessorResult result = apply_sticker_mask_packed(
+            dst + offset * 4, mask + offset, width, rows, add_border, border_color,
+            expanded_mask ? &band : NULL);
+        if (result != MASK_PROCESSOR_SUCCESS) {
+            return mask_stage_leave(timer, result);
+        }
+    }
+
+    return mask_stage_leave(timer, MASK_PROCESSOR_SUCCESS);
+}
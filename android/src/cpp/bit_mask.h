@@ -0,0 +1,209 @@
+#ifndef BIT_MASK_H
+#define BIT_MASK_H
+
+#include "mask_processor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Binary mask with 1 bit per pixel. Each row starts on a 64-bit word and
+// bit (x % 64) of word (x / 64) holds column x; padding bits past width are
+// always zero.
+typedef struct {
+    uint64_t* words;
+    int width;
+    int height;
+    int words_per_row;
+} BitMask;
+
+/**
+ * Allocate a cleared bit mask
+ *
+ * @param mask Mask to initialize
+ * @param width Mask width
+ * @param height Mask height
+ * @return Result code
+ */
+MaskProcessorResult bit_mask_create(BitMask* mask, int width, int height);
+
+/**
+ * Free the words of a bit mask created with bit_mask_create
+ */
+void bit_mask_destroy(BitMask* mask);
+
+/**
+ * Set bits where values[i] > threshold, clear the rest
+ *
+ * @param output Destination mask (sets its dimensions' worth of values)
+ * @param values Mask values, width * height
+ * @param threshold Threshold value
+ * @return Result code
+ */
+MaskProcessorResult bit_mask_threshold(
+    BitMask* output,
+    const double* values,
+    double threshold
+);
+
+/**
+ * Word-parallel OR of two masks of the same size (output may alias inputs)
+ */
+MaskProcessorResult bit_mask_or(BitMask* output, const BitMask* a, const BitMask* b);
+
+/**
+ * Word-parallel AND of two masks of the same size (output may alias inputs)
+ */
+MaskProcessorResult bit_mask_and(BitMask* output, const BitMask* a, const BitMask* b);
+
+/**
+ * Dilate by a disc of the given radius (same disc as expand_mask_native)
+ *
+ * Each source row is dilated horizontally with shifts across words, then
+ * ORed into the output rows it reaches, 64 pixels per operation.
+ *
+ * @param output Destination mask, must not alias input
+ * @param input Source mask of the same size
+ * @param radius Disc radius in pixels
+ * @return Result code
+ */
+MaskProcessorResult bit_mask_dilate(BitMask* output, const BitMask* input, int radius);
+
+/**
+ * Dilate one packed row horizontally by every half-width 0..max_shift
+ *
+ * Building block for banded dilation. Row k of dilated (words_per_row words
+ * each) receives src ORed with itself shifted by up to k bits either way.
+ *
+ * @param src Source row
+ * @param dilated Destination, (max_shift + 1) rows
+ * @param width Row width in pixels
+ * @param max_shift Largest half-width
+ */
+void bit_mask_row_dilations(const uint64_t* src, uint64_t* dilated, int width, int max_shift);
+
+/**
+ * Threshold at 0.5 and dilate, the packed equivalent of expand_mask_native
+ *
+ * @param mask Input mask values
+ * @param output Destination mask, already created with the mask dimensions
+ * @param border_width Border expansion width
+ * @return Result code
+ */
+MaskProcessorResult expand_mask_packed(
+    const double* mask,
+    BitMask* output,
+    int border_width
+);
+
+/**
+ * expand_mask_native in cache-sized 2D tiles
+ *
+ * Each tile thresholds itself plus a border_width halo into packed rows,
+ * dilates them and writes its core as 0.0/1.0, so nothing larger than a
+ * tile is held at once. Same output as expand_mask_native; tiles run in
+ * parallel on the thread pool.
+ *
+ * @param mask Input mask values
+ * @param output Output expanded mask
+ * @param width Mask width
+ * @param height Mask height
+ * @param border_width Border expansion width
+ * @return Result code
+ */
+MaskProcessorResult expand_mask_tiled(
+    const double* mask,
+    double* output,
+    int width,
+    int height,
+    int border_width
+);
+
+/**
+ * Whether expand_mask_tiled beats the whole-image transform for this size
+ *
+ * False when tiling is disabled, the mask fits one tile, or the halo work
+ * exceeds MASK_TILE_MAX_OVERHEAD.
+ */
+int expand_mask_tiles_worthwhile(int width, int height, int border_width);
+
+/**
+ * expand_mask_u8 in cache-sized 2D tiles
+ *
+ * The tiled packed dilation of expand_mask_tiled on an 8-bit mask; seeds
+ * are values of at least 128 and the output is 0 or 255. Same output as
+ * expand_mask_u8 for any border width.
+ *
+ * @param mask Input mask values (0-255)
+ * @param output Output expanded mask (0 or 255)
+ * @param width Mask width
+ * @param height Mask height
+ * @param border_width Border expansion width
+ * @return Result code
+ */
+MaskProcessorResult expand_mask_u8_tiled(
+    const uint8_t* mask,
+    uint8_t* output,
+    int width,
+    int height,
+    int border_width
+);
+
+/**
+ * Whether expand_mask_u8_tiled beats the whole-image transform for this size
+ *
+ * True when the mask fits one tile, otherwise as expand_mask_tiles_worthwhile.
+ */
+int expand_mask_u8_tiles_worthwhile(int width, int height, int border_width);
+
+/**
+ * Apply sticker mask effects with a packed expanded mask
+ *
+ * Same output as apply_sticker_mask_native with expanded_mask holding 1.0
+ * wherever the packed bit is set, while reading 1/64 of the memory.
+ *
+ * @param pixels RGBA pixel data (input/output)
+ * @param mask Mask values (0.0-1.0)
+ * @param width Image width
+ * @param height Image height
+ * @param add_border Whether to add border
+ * @param border_color Border color RGB
+ * @param expanded_mask Packed expanded mask (can be NULL for no border)
+ * @return Result code
+ */
+MaskProcessorResult apply_sticker_mask_packed(
+    uint8_t* pixels,
+    const double* mask,
+    int width,
+    int height,
+    int add_border,
+    RGBColor border_color,
+    const BitMask* expanded_mask
+);
+
+/**
+ * Out-of-place apply_sticker_mask_packed
+ *
+ * Reads src and writes the result to dst, leaving src untouched. dst may
+ * equal src.
+ *
+ * @param src Source RGBA pixel data
+ * @param dst Destination RGBA pixel data
+ * @return Result code
+ */
+MaskProcessorResult apply_sticker_mask_packed_to(
+    const uint8_t* src,
+    uint8_t* dst,
+    const double* mask,
+    int width,
+    int height,
+    int add_border,
+    RGBColor border_color,
+    const BitMask* expanded_mask
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BIT_MASK_H
@@ -0,0 +1,153 @@
+#include "content_hash.h"
+#include "simd_vector.h"
+#include "processor_stats.h"
+#include <string.h>
+
+#define HASH_LANES 8
+#define HASH_STRIPE_BYTES (HASH_LANES * 8)
+// Stripes between scrambles of the accumulators
+#define HASH_BLOCK_STRIPES 16
+
+#define PRIME32_1 0x9E3779B1U
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+
+// Per-lane keys (splitmix64 outputs) for accumulation, scrambling and the
+// two output halves
+static const uint64_t accumulate_keys[HASH_LANES] = {
+    0x6e789e6aa1b965f4ULL, 0x06c45d188009454fULL, 0xf88bb8a8724c81ecULL, 0x1b39896a51a8749bULL,
+    0x53cb9f0c747ea2eaULL, 0x2c829abe1f4532e1ULL, 0xc584133ac916ab3cULL, 0x3ee5789041c98ac3ULL
+};
+static const uint64_t scramble_keys[HASH_LANES] = {
+    0xf3b8488c368cb0a6ULL, 0x657eecdd3cb13d09ULL, 0xc2d326e0055bdef6ULL, 0x8621a03fe0bbdb7bULL,
+    0x8e1f7555983aa92fULL, 0xb54e0f1600cc4d19ULL, 0x84bb3f97971d80abULL, 0x7d29825c75521255ULL
+};
+static const uint64_t merge_keys[HASH_LANES] = {
+    0xc3cf17102b7f7f86ULL, 0x3466e9a083914f64ULL, 0xd81a8d2b5a4485acULL, 0xdb01602b100b9ed7ULL,
+    0xa9038a921825f10dULL, 0xedf5f1d90dca2f6aULL, 0x54496ad67bd2634cULL, 0xdd7c01d4f5407269ULL
+};
+
+// Lanes are loaded in native byte order; the hash is defined on
+// little-endian loads, which every supported target uses
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "mask_content_hash assumes a little-endian target"
+#endif
+
+// 64x64->128 multiply folded to 64 bits
+static inline uint64_t mul_fold64(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+    const __uint128_t product = (__uint128_t)a * b;
+    return (uint64_t)product ^ (uint64_t)(product >> 64);
+#else
+    // 32-bit targets (armeabi-v7a) have no 128-bit type
+    const uint64_t lo_lo = (a & 0xFFFFFFFFULL) * (b & 0xFFFFFFFFULL);
+    const uint64_t hi_lo = (a >> 32) * (b & 0xFFFFFFFFULL);
+    const uint64_t lo_hi = (a & 0xFFFFFFFFULL) * (b >> 32);
+    const uint64_t hi_hi = (a >> 32) * (b >> 32);
+    const uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFFULL) + lo_hi;
+    const uint64_t upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    const uint64_t lower = (cross << 32) | (lo_lo & 0xFFFFFFFFULL);
+    return lower ^ upper;
+#endif
+}
+
+static inline uint64_t avalanche(uint64_t h) {
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+// One pair of lanes over 16 bytes: lane i adds its input to lane i ^ 1
+// and the product of the two halves of its keyed input to itself, which
+// is a swap and one 32x32->64 multiply per pair
+static inline mp_u64x2 accumulate_pair(mp_u64x2 acc, const uint8_t* p, mp_u64x2 key) {
+    const mp_u64x2 value = mp_u64x2_load(p);
+    const mp_u64x2 keyed = value ^ key;
+    return acc + mp_u64x2_swap(value) + mp_u64x2_mul_lo32(keyed, keyed >> 32);
+}
+
+// Stripes of 64 bytes, with the lanes held in registers
+static void accumulate_stripes(mp_u64x2* acc, const uint8_t* p, size_t stripes) {
+    const mp_u64x2 k0 = mp_u64x2_load(accumulate_keys);
+    const mp_u64x2 k1 = mp_u64x2_load(accumulate_keys + 2);
+    const mp_u64x2 k2 = mp_u64x2_load(accumulate_keys + 4);
+    const mp_u64x2 k3 = mp_u64x2_load(accumulate_keys + 6);
+    mp_u64x2 a0 = acc[0], a1 = acc[1], a2 = acc[2], a3 = acc[3];
+
+    for (size_t s = 0; s < stripes; s++, p += HASH_STRIPE_BYTES) {
+        a0 = accumulate_pair(a0, p, k0);
+        a1 = accumulate_pair(a1, p + 16, k1);
+        a2 = accumulate_pair(a2, p + 32, k2);
+        a3 = accumulate_pair(a3, p + 48, k3);
+    }
+
+    acc[0] = a0;
+    acc[1] = a1;
+    acc[2] = a2;
+    acc[3] = a3;
+}
+
+static inline void scramble(mp_u64x2* acc) {
+    for (int i = 0; i < HASH_LANES / 2; i++) {
+        mp_u64x2 a = acc[i];
+        a ^= a >> 47;
+        a ^= mp_u64x2_load(scramble_keys + i * 2);
+        acc[i] = a * PRIME32_1;
+    }
+}
+
+static uint64_t merge(const uint64_t* acc, uint64_t start, uint64_t tweak) {
+    uint64_t result = start;
+    for (int i = 0; i < HASH_LANES; i += 2) {
+        result += mul_fold64(acc[i] ^ (merge_keys[i] + tweak),
+                             acc[i + 1] ^ (merge_keys[i + 1] - tweak));
+    }
+    return avalanche(result);
+}
+
+MaskProcessorResult mask_content_hash(
+    const uint8_t* data,
+    size_t length,
+    uint64_t seed,
+    MaskHash128* hash
+) {
+    const MaskStageTimer timer = mask_stage_enter(MASK_STAGE_HASH, length);
+    if (!hash || (!data && length > 0)) {
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_INVALID_PARAMS);
+    }
+
+    mp_u64x2 acc[HASH_LANES / 2];
+    for (int i = 0; i < HASH_LANES / 2; i++) {
+        acc[i] = mp_u64x2_load(accumulate_keys + i * 2) ^
+                 ((mp_u64x2){0, 1} + seed * PRIME64_1);
+    }
+
+    // Scramble after every full block
+    const size_t stripes = length / HASH_STRIPE_BYTES;
+    for (size_t stripe = 0; stripe < stripes; stripe += HASH_BLOCK_STRIPES) {
+        const size_t count = stripes - stripe < HASH_BLOCK_STRIPES
+            ? stripes - stripe
+            : HASH_BLOCK_STRIPES;
+        accumulate_stripes(acc, data + stripe * HASH_STRIPE_BYTES, count);
+        if (count == HASH_BLOCK_STRIPES) {
+            scramble(acc);
+        }
+    }
+
+    // Zero-padded last stripe; the length below tells paddings apart
+    const size_t tail = length - stripes * HASH_STRIPE_BYTES;
+    if (tail > 0) {
+        uint8_t last[HASH_STRIPE_BYTES] = {0};
+        memcpy(last, data + stripes * HASH_STRIPE_BYTES, tail);
+        accumulate_stripes(acc, last, 1);
+    }
+    scramble(acc);
+
+    uint64_t lanes[HASH_LANES];
+    memcpy(lanes, acc, sizeof(lanes));
+    const uint64_t len = (uint64_t)length;
+    hash->low = merge(lanes, len * PRIME64_1 ^ seed, 0);
+    hash->high = merge(lanes, ~(len * PRIME64_2) ^ seed, PRIME64_2);
+    return mask_stage_leave(timer, MASK_PROCESSOR_SUCCESS);
+}
@@ -0,0 +1,43 @@
+#ifndef CONTENT_HASH_H
+#define CONTENT_HASH_H
+
+#include "mask_processor.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 128-bit content hash
+typedef struct {
+    uint64_t low;
+    uint64_t high;
+} MaskHash128;
+
+/**
+ * Hash a buffer for use as a cache key
+ *
+ * Reads every byte. Eight 64-bit lanes, each a 32x32->64 multiply-accumulate
+ * per 8 bytes, are scrambled every kilobyte and folded into 128 bits at the
+ * end, the same structure as XXH3, so compilers map the inner loop onto
+ * SSE2/NEON. The result depends only on the bytes, length and seed, and is
+ * the same on every platform. Not a cryptographic hash.
+ *
+ * @param data Bytes to hash (may be NULL when length is 0)
+ * @param length Number of bytes
+ * @param seed Seed mixed into the result
+ * @param hash Receives the hash
+ * @return Result code
+ */
+MaskProcessorResult mask_content_hash(
+    const uint8_t* data,
+    size_t length,
+    uint64_t seed,
+    MaskHash128* hash
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CONTENT_HASH_H
@@ -0,0 +1,736 @@
+// fsync(), ftruncate() and mmap() are not declared under strict ISO C modes
+#if !defined(_POSIX_C_SOURCE) && !defined(__APPLE__)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "mask_cache.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Index file header magic ("MSKC") and format version
+#define CACHE_MAGIC 0x434B534DU
+#define CACHE_VERSION 1
+
+#define RECORD_PUT 1
+#define RECORD_TOUCH 2
+#define RECORD_DROP 3
+
+// Compact once the dead bytes in the data file exceed both the live bytes
+// and this floor
+#define COMPACT_MIN_DEAD_BYTES (4ULL << 20)
+
+// Rewrite the index once its records outnumber the live entries this many
+// times and this floor; every hit appends a TOUCH record
+#define COMPACT_INDEX_RECORDS_PER_ENTRY 4
+#define COMPACT_MIN_INDEX_RECORDS 1024
+
+#define CACHE_PATH_MAX 1024
+// Room left for the longest file name, "/masks." plus a 64-bit number
+#define CACHE_NAME_MAX 32
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    // Suffix of the data file the records point into
+    uint64_t generation;
+} IndexHeader;
+
+// One entry of the index log
+typedef struct {
+    uint32_t type;
+    uint32_t bytes;
+    uint64_t key_low;
+    uint64_t key_high;
+    uint64_t offset;
+    int32_t width;
+    int32_t height;
+    // Low 32 bits of the payload hash, checked on every read
+    uint32_t payload_check;
+    // Low 32 bits of the hash of the fields above
+    uint32_t check;
+} IndexRecord;
+
+typedef struct {
+    MaskHash128 key;
+    uint64_t offset;
+    uint32_t bytes;
+    int width;
+    int height;
+    uint32_t payload_check;
+    uint64_t last_used;
+} CacheEntry;
+
+struct MaskCache {
+    pthread_mutex_t lock;
+    char directory[CACHE_PATH_MAX - CACHE_NAME_MAX];
+    uint64_t max_bytes;
+    uint64_t generation;
+    int index_fd;
+    int data_fd;
+    uint64_t data_size;
+    const uint8_t* map;
+    size_t map_size;
+    CacheEntry* entries;
+    int count;
+    int capacity;
+    // Open-addressed table of entry indices by key, -1 for free slots;
+    // twice the entry capacity, so it is at most half full
+    int* slots;
+    int slot_mask;
+    // Records in the index log after the header
+    uint64_t index_records;
+    uint64_t live_bytes;
+    uint64_t clock;
+};
+
+static uint32_t hash32(const void* data, size_t length) {
+    MaskHash128 hash;
+    mask_content_hash((const uint8_t*)data, length, 0, &hash);
+    return (uint32_t)hash.low;
+}
+
+static uint32_t record_check(const IndexRecord* record) {
+    return hash32(record, offsetof(IndexRecord, check));
+}
+
+static int write_all(int fd, const void* data, size_t length) {
+    const uint8_t* p = (const uint8_t*)data;
+    while (length > 0) {
+        const ssize_t written = write(fd, p, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        p += written;
+        length -= (size_t)written;
+    }
+    return 1;
+}
+
+static int read_all(int fd, void* data, size_t length) {
+    uint8_t* p = (uint8_t*)data;
+    while (length > 0) {
+        const ssize_t got = read(fd, p, length);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return 0;
+        p += got;
+        length -= (size_t)got;
+    }
+    return 1;
+}
+
+static void index_path(const MaskCache* cache, const char* name, char* path) {
+    snprintf(path, CACHE_PATH_MAX, "%s/%s", cache->directory, name);
+}
+
+static void data_path(const MaskCache* cache, uint64_t generation, char* path) {
+    snprintf(path, CACHE_PATH_MAX, "%s/masks.%llu", cache->directory,
+             (unsigned long long)generation);
+}
+
+// PackBits-style coding: control c < 128 is followed by c + 1 literal
+// bytes, c >= 128 by one byte repeated c - 126 times (2-129)
+static size_t rle_bound(size_t length) {
+    return length + length / 128 + 1;
+}
+
+static size_t rle_encode(const uint8_t* in, size_t length, uint8_t* out) {
+    size_t i = 0;
+    size_t o = 0;
+    while (i < length) {
+        size_t run = 1;
+        while (i + run < length && run < 129 && in[i + run] == in[i]) run++;
+        if (run >= 3 || (run == 2 && i + run == length)) {
+            out[o++] = (uint8_t)(run + 126);
+            out[o++] = in[i];
+            i += run;
+            continue;
+        }
+
+        // Literal until the next run of three or the 128-byte limit
+        size_t literal = 0;
+        while (i + literal < length && literal < 128) {
+            if (i + literal + 2 < length &&
+                in[i + literal] == in[i + literal + 1] &&
+                in[i + literal] == in[i + literal + 2]) {
+                break;
+            }
+            literal++;
+        }
+        out[o++] = (uint8_t)(literal - 1);
+        memcpy(out + o, in + i, literal);
+        o += literal;
+        i += literal;
+    }
+    return o;
+}
+
+// Decode into mask values; returns 0 unless the payload fills exactly
+// length values
+static int rle_decode(const uint8_t* in, size_t bytes, double* out, size_t length) {
+    double values[256];
+    for (int q = 0; q < 256; q++) {
+        values[q] = q / 255.0;
+    }
+
+    size_t i = 0;
+    size_t o = 0;
+    while (i < bytes) {
+        const uint8_t control = in[i++];
+        if (control < 128) {
+            const size_t literal = (size_t)control + 1;
+            if (i + literal > bytes || o + literal > length) return 0;
+            for (size_t k = 0; k < literal; k++) {
+                out[o++] = values[in[i++]];
+            }
+        } else {
+            const size_t run = (size_t)control - 126;
+            if (i >= bytes || o + run > length) return 0;
+            const double value = values[in[i++]];
+            for (size_t k = 0; k < run; k++) {
+                out[o++] = value;
+            }
+        }
+    }
+    return o == length;
+}
+
+static int home_slot(const MaskCache* cache, const MaskHash128* key) {
+    // Keys are content hashes, so their low bits are already uniform
+    return (int)(key->low & (uint64_t)cache->slot_mask);
+}
+
+static int same_key(const MaskHash128* a, const MaskHash128* b) {
+    return a->low == b->low && a->high == b->high;
+}
+
+// Slot holding entry i, whose key is in the table
+static int slot_of(const MaskCache* cache, int i) {
+    int slot = home_slot(cache, &cache->entries[i].key);
+    while (cache->slots[slot] != i) {
+        slot = (slot + 1) & cache->slot_mask;
+    }
+    return slot;
+}
+
+static int find_entry(const MaskCache* cache, const MaskHash128* key) {
+    if (!cache->slots) {
+        return -1;
+    }
+    for (int slot = home_slot(cache, key); cache->slots[slot] >= 0;
+         slot = (slot + 1) & cache->slot_mask) {
+        if (same_key(&cache->entries[cache->slots[slot]].key, key)) {
+            return cache->slots[slot];
+        }
+    }
+    return -1;
+}
+
+static void insert_slot(MaskCache* cache, int i) {
+    int slot = home_slot(cache, &cache->entries[i].key);
+    while (cache->slots[slot] >= 0) {
+        slot = (slot + 1) & cache->slot_mask;
+    }
+    cache->slots[slot] = i;
+}
+
+// Free a slot and shift later members of its probe run back, so lookups
+// never need tombstones
+static void erase_slot(MaskCache* cache, int slot) {
+    int next = slot;
+    for (;;) {
+        next = (next + 1) & cache->slot_mask;
+        if (cache->slots[next] < 0) {
+            break;
+        }
+        const int home = home_slot(cache, &cache->entries[cache->slots[next]].key);
+        // Move it back unless its home lies cyclically in (slot, next]
+        const int stays = slot <= next ? (home > slot && home <= next)
+                                       : (home > slot || home <= next);
+        if (!stays) {
+            cache->slots[slot] = cache->slots[next];
+            slot = next;
+        }
+    }
+    cache->slots[slot] = -1;
+}
+
+// Index every entry again, after the entries were reordered
+static void rebuild_slots(MaskCache* cache) {
+    if (!cache->slots) {
+        return;
+    }
+    memset(cache->slots, 0xFF, sizeof(int) * ((size_t)cache->slot_mask + 1));
+    for (int i = 0; i < cache->count; i++) {
+        insert_slot(cache, i);
+    }
+}
+
+static void remove_entry(MaskCache* cache, int i) {
+    const int last = cache->count - 1;
+    cache->live_bytes -= cache->entries[i].bytes;
+    erase_slot(cache, slot_of(cache, i));
+    if (i != last) {
+        cache->slots[slot_of(cache, last)] = i;
+        cache->entries[i] = cache->entries[last];
+    }
+    cache->count--;
+}
+
+static int add_entry(MaskCache* cache, const CacheEntry* entry) {
+    if (cache->count == cache->capacity) {
+        const int capacity = cache->capacity ? cache->capacity * 2 : 16;
+        CacheEntry* entries = (CacheEntry*)realloc(cache->entries, sizeof(CacheEntry) * capacity);
+        if (!entries) return 0;
+        cache->entries = entries;
+        int* slots = (int*)malloc(sizeof(int) * 2 * (size_t)capacity);
+        if (!slots) return 0;
+        free(cache->slots);
+        cache->slots = slots;
+        cache->slot_mask = 2 * capacity - 1;
+        cache->capacity = capacity;
+        rebuild_slots(cache);
+    }
+    cache->entries[cache->count] = *entry;
+    insert_slot(cache, cache->count++);
+    cache->live_bytes += entry->bytes;
+    return 1;
+}
+
+static void fill_record(IndexRecord* record, uint32_t type, const CacheEntry* entry) {
+    memset(record, 0, sizeof(*record));
+    record->type = type;
+    record->bytes = entry->bytes;
+    record->key_low = entry->key.low;
+    record->key_high = entry->key.high;
+    record->offset = entry->offset;
+    record->width = entry->width;
+    record->height = entry->height;
+    record->payload_check = entry->payload_check;
+    record->check = record_check(record);
+}
+
+// TOUCH and DROP records only steer recency and eviction, so a lost one
+// costs nothing but LRU order; they are not synced
+static void append_record(MaskCache* cache, uint32_t type, const CacheEntry* entry) {
+    IndexRecord record;
+    fill_record(&record, type, entry);
+    if (write_all(cache->index_fd, &record, sizeof(record))) {
+        cache->index_records++;
+    }
+}
+
+// Map the whole data file once it has grown past the current mapping
+static int map_data(MaskCache* cache) {
+    if (cache->map_size == cache->data_size) {
+        return 1;
+    }
+    if (cache->map) {
+        munmap((void*)cache->map, cache->map_size);
+        cache->map = NULL;
+        cache->map_size = 0;
+    }
+    if (cache->data_size == 0) {
+        return 1;
+    }
+
+    void* map = mmap(NULL, (size_t)cache->data_size, PROT_READ, MAP_SHARED, cache->data_fd, 0);
+    if (map == MAP_FAILED) {
+        return 0;
+    }
+    cache->map = (const uint8_t*)map;
+    cache->map_size = (size_t)cache->data_size;
+    return 1;
+}
+
+static void evict(MaskCache* cache) {
+    while (cache->live_bytes > cache->max_bytes && cache->count > 0) {
+        int oldest = 0;
+        for (int i = 1; i < cache->count; i++) {
+            if (cache->entries[i].last_used < cache->entries[oldest].last_used) {
+                oldest = i;
+            }
+        }
+        append_record(cache, RECORD_DROP, &cache->entries[oldest]);
+        remove_entry(cache, oldest);
+    }
+}
+
+static int compare_last_used(const void* a, const void* b) {
+    const uint64_t x = ((const CacheEntry*)a)->last_used;
+    const uint64_t y = ((const CacheEntry*)b)->last_used;
+    return x < y ? -1 : x > y;
+}
+
+// Copy the live masks into the next data generation and commit it by
+// renaming a fresh index over the old one. Until the rename the old files
+// stay current, so a crash at any point leaves a consistent cache.
+static void compact(MaskCache* cache) {
+    char data_name[CACHE_PATH_MAX];
+    char index_name[CACHE_PATH_MAX];
+    char temp_name[CACHE_PATH_MAX];
+    const uint64_t generation = cache->generation + 1;
+    data_path(cache, generation, data_name);
+    index_path(cache, "index", index_name);
+    index_path(cache, "index.tmp", temp_name);
+
+    if (!map_data(cache)) {
+        return;
+    }
+
+    const int data_fd = open(data_name, O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0600);
+    const int index_fd = open(temp_name, O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0600);
+    int ok = data_fd >= 0 && index_fd >= 0;
+
+    const IndexHeader header = { CACHE_MAGIC, CACHE_VERSION, generation };
+    ok = ok && write_all(index_fd, &header, sizeof(header));
+
+    // Oldest first, so replaying the new index restores the LRU order
+    qsort(cache->entries, (size_t)cache->count, sizeof(CacheEntry), compare_last_used);
+    rebuild_slots(cache);
+    uint64_t offset = 0;
+    for (int i = 0; ok && i < cache->count; i++) {
+        const CacheEntry* entry = &cache->entries[i];
+        ok = write_all(data_fd, cache->map + entry->offset, entry->bytes);
+        CacheEntry moved = *entry;
+        moved.offset = offset;
+        IndexRecord record;
+        fill_record(&record, RECORD_PUT, &moved);
+        ok = ok && write_all(index_fd, &record, sizeof(record));
+        offset += entry->bytes;
+    }
+
+    ok = ok && fsync(data_fd) == 0 && fsync(index_fd) == 0 &&
+         rename(temp_name, index_name) == 0;
+    if (!ok) {
+        if (data_fd >= 0) close(data_fd);
+        if (index_fd >= 0) close(index_fd);
+        unlink(temp_name);
+        unlink(data_name);
+        return;
+    }
+
+    char old_data[CACHE_PATH_MAX];
+    data_path(cache, cache->generation, old_data);
+    munmap((void*)cache->map, cache->map_size);
+    cache->map = NULL;
+    cache->map_size = 0;
+    close(cache->data_fd);
+    close(cache->index_fd);
+    unlink(old_data);
+
+    uint64_t next = 0;
+    for (int i = 0; i < cache->count; i++) {
+        cache->entries[i].offset = next;
+        next += cache->entries[i].bytes;
+    }
+    cache->data_fd = data_fd;
+    cache->index_fd = index_fd;
+    cache->index_records = (uint64_t)cache->count;
+    cache->generation = generation;
+    cache->data_size = offset;
+    map_data(cache);
+}
+
+// Rewrite the index as one PUT per live entry, oldest first, over the same
+// data file. Committed by the same rename as compact(), so a crash keeps
+// either the old log or the new one.
+static void compact_index(MaskCache* cache) {
+    char index_name[CACHE_PATH_MAX];
+    char temp_name[CACHE_PATH_MAX];
+    index_path(cache, "index", index_name);
+    index_path(cache, "index.tmp", temp_name);
+
+    const int index_fd = open(temp_name, O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0600);
+    const IndexHeader header = { CACHE_MAGIC, CACHE_VERSION, cache->generation };
+    int ok = index_fd >= 0 && write_all(index_fd, &header, sizeof(header));
+
+    qsort(cache->entries, (size_t)cache->count, sizeof(CacheEntry), compare_last_used);
+    rebuild_slots(cache);
+    for (int i = 0; ok && i < cache->count; i++) {
+        IndexRecord record;
+        fill_record(&record, RECORD_PUT, &cache->entries[i]);
+        ok = write_all(index_fd, &record, sizeof(record));
+    }
+
+    ok = ok && fsync(index_fd) == 0 && rename(temp_name, index_name) == 0;
+    if (!ok) {
+        if (index_fd >= 0) close(index_fd);
+        unlink(temp_name);
+        return;
+    }
+    close(cache->index_fd);
+    cache->index_fd = index_fd;
+    cache->index_records = (uint64_t)cache->count;
+}
+
+// Compact the data file once most of it is dead, or else just the index
+// once TOUCH and DROP records swamp it
+static void maybe_compact(MaskCache* cache) {
+    const uint64_t dead = cache->data_size - cache->live_bytes;
+    if (dead > cache->live_bytes && dead > COMPACT_MIN_DEAD_BYTES) {
+        compact(cache);
+    } else if (cache->index_records > COMPACT_MIN_INDEX_RECORDS &&
+               cache->index_records >
+                   (uint64_t)COMPACT_INDEX_RECORDS_PER_ENTRY * (uint64_t)cache->count) {
+        compact_index(cache);
+    }
+}
+
+// Replay the index log into the entry table. Stops at the first record
+// that is incomplete or fails its checksum and cuts the log there.
+static int replay_index(MaskCache* cache) {
+    off_t valid = (off_t)sizeof(IndexHeader);
+    IndexRecord record;
+
+    while (read_all(cache->index_fd, &record, sizeof(record))) {
+        if (record.check != record_check(&record)) {
+            break;
+        }
+        valid += (off_t)sizeof(record);
+        cache->index_records++;
+
+        CacheEntry entry;
+        entry.key.low = record.key_low;
+        entry.key.high = record.key_high;
+        entry.offset = record.offset;
+        entry.bytes = record.bytes;
+        entry.width = record.width;
+        entry.height = record.height;
+        entry.payload_check = record.payload_check;
+        entry.last_used = ++cache->clock;
+
+        const int i = find_entry(cache, &entry.key);
+        switch (record.type) {
+        case RECORD_PUT:
+            if (i >= 0) remove_entry(cache, i);
+            if (record.offset + record.bytes <= cache->data_size && !add_entry(cache, &entry)) {
+                return 0;
+            }
+            break;
+        case RECORD_TOUCH:
+            if (i >= 0) cache->entries[i].last_used = entry.last_used;
+            break;
+        case RECORD_DROP:
+            if (i >= 0) remove_entry(cache, i);
+            break;
+        default:
+            break;
+        }
+    }
+
+    return ftruncate(cache->index_fd, valid) == 0 &&
+           lseek(cache->index_fd, 0, SEEK_END) >= 0;
+}
+
+// Open the index and the data file it names, starting a fresh cache when
+// the index is missing or from another format version
+static int open_files(MaskCache* cache) {
+    char path[CACHE_PATH_MAX];
+    index_path(cache, "index", path);
+    cache->index_fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0600);
+    if (cache->index_fd < 0) {
+        return 0;
+    }
+
+    IndexHeader header;
+    if (!read_all(cache->index_fd, &header, sizeof(header)) ||
+        header.magic != CACHE_MAGIC || header.version != CACHE_VERSION) {
+        header.magic = CACHE_MAGIC;
+        header.version = CACHE_VERSION;
+        header.generation = 0;
+        if (ftruncate(cache->index_fd, 0) != 0 ||
+            !write_all(cache->index_fd, &header, sizeof(header)) ||
+            fsync(cache->index_fd) != 0) {
+            return 0;
+        }
+        data_path(cache, 0, path);
+        unlink(path);
+    }
+    cache->generation = header.generation;
+
+    // A crash right after a compaction's rename leaves the old generation
+    if (cache->generation > 0) {
+        data_path(cache, cache->generation - 1, path);
+        unlink(path);
+    }
+
+    data_path(cache, cache->generation, path);
+    cache->data_fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0600);
+    if (cache->data_fd < 0) {
+        return 0;
+    }
+    const off_t size = lseek(cache->data_fd, 0, SEEK_END);
+    if (size < 0) {
+        return 0;
+    }
+    cache->data_size = (uint64_t)size;
+
+    if (lseek(cache->index_fd, (off_t)sizeof(header), SEEK_SET) < 0) {
+        return 0;
+    }
+    return replay_index(cache);
+}
+
+MaskProcessorResult mask_cache_open(MaskCache** cache, const char* directory, uint64_t max_bytes) {
+    if (!cache || !directory || strlen(directory) + CACHE_NAME_MAX >= CACHE_PATH_MAX) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+    *cache = NULL;
+
+    if (mkdir(directory, 0700) != 0 && errno != EEXIST) {
+        return MASK_PROCESSOR_ERROR_PROCESSING;
+    }
+
+    MaskCache* c = (MaskCache*)calloc(1, sizeof(MaskCache));
+    if (!c) {
+        return MASK_PROCESSOR_ERROR_MEMORY;
+    }
+    strcpy(c->directory, directory);
+    c->max_bytes = max_bytes;
+    c->index_fd = -1;
+    c->data_fd = -1;
+    pthread_mutex_init(&c->lock, NULL);
+
+    if (!open_files(c) || !map_data(c)) {
+        mask_cache_close(c);
+        return MASK_PROCESSOR_ERROR_PROCESSING;
+    }
+    evict(c);
+    maybe_compact(c);
+
+    *cache = c;
+    return MASK_PROCESSOR_SUCCESS;
+}
+
+void mask_cache_close(MaskCache* cache) {
+    if (!cache) {
+        return;
+    }
+    if (cache->map) munmap((void*)cache->map, cache->map_size);
+    if (cache->data_fd >= 0) close(cache->data_fd);
+    if (cache->index_fd >= 0) close(cache->index_fd);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->entries);
+    free(cache->slots);
+    free(cache);
+}
+
+MaskProcessorResult mask_cache_get(
+    MaskCache* cache,
+    const MaskHash128* key,
+    double* output,
+    int width,
+    int height,
+    int* found
+) {
+    if (!cache || !key || !output || !found || width <= 0 || height <= 0) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+    *found = 0;
+
+    pthread_mutex_lock(&cache->lock);
+    const int i = find_entry(cache, key);
+    if (i >= 0 && cache->entries[i].width == width && cache->entries[i].height == height &&
+        map_data(cache)) {
+        CacheEntry* entry = &cache->entries[i];
+        const uint8_t* payload = cache->map + entry->offset;
+
+        if (hash32(payload, entry->bytes) == entry->payload_check &&
+            rle_decode(payload, entry->bytes, output, (size_t)width * height)) {
+            entry->last_used = ++cache->clock;
+            append_record(cache, RECORD_TOUCH, entry);
+            *found = 1;
+        } else {
+            // Damaged on disk; forget it
+            append_record(cache, RECORD_DROP, entry);
+            remove_entry(cache, i);
+        }
+        maybe_compact(cache);
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return MASK_PROCESSOR_SUCCESS;
+}
+
+MaskProcessorResult mask_cache_put(
+    MaskCache* cache,
+    const MaskHash128* key,
+    const double* mask,
+    int width,
+    int height
+) {
+    if (!cache || !key || !mask || width <= 0 || height <= 0) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+
+    const size_t length = (size_t)width * height;
+    uint8_t* quantized = (uint8_t*)malloc(length);
+    uint8_t* payload = (uint8_t*)malloc(rle_bound(length));
+    if (!quantized || !payload) {
+        free(quantized);
+        free(payload);
+        return MASK_PROCESSOR_ERROR_MEMORY;
+    }
+    for (size_t i = 0; i < length; i++) {
+        const double value = mask[i];
+        quantized[i] = value <= 0.0 ? 0 : value >= 1.0 ? 255 : (uint8_t)(value * 255.0 + 0.5);
+    }
+    const size_t bytes = rle_encode(quantized, length, payload);
+    free(quantized);
+
+    CacheEntry entry;
+    entry.key = *key;
+    entry.bytes = (uint32_t)bytes;
+    entry.width = width;
+    entry.height = height;
+    entry.payload_check = hash32(payload, bytes);
+
+    pthread_mutex_lock(&cache->lock);
+    entry.offset = cache->data_size;
+    entry.last_used = ++cache->clock;
+
+    // Data first and synced, then the record that points at it
+    MaskProcessorResult result = MASK_PROCESSOR_ERROR_PROCESSING;
+    if (write_all(cache->data_fd, payload, bytes) && fsync(cache->data_fd) == 0) {
+        cache->data_size += bytes;
+
+        IndexRecord record;
+        fill_record(&record, RECORD_PUT, &entry);
+        if (write_all(cache->index_fd, &record, sizeof(record))) {
+            cache->index_records++;
+            const int i = find_entry(cache, key);
+            if (i >= 0) remove_entry(cache, i);
+            result = add_entry(cache, &entry) ? MASK_PROCESSOR_SUCCESS : MASK_PROCESSOR_ERROR_MEMORY;
+        }
+    } else {
+        // Drop a partial write so later offsets stay right
+        if (ftruncate(cache->data_fd, (off_t)cache->data_size) != 0) {
+            cache->data_size = (uint64_t)lseek(cache->data_fd, 0, SEEK_END);
+        }
+    }
+
+    evict(cache);
+    maybe_compact(cache);
+    pthread_mutex_unlock(&cache->lock);
+
+    free(payload);
+    return result;
+}
+
+void mask_cache_usage(MaskCache* cache, uint64_t* bytes, int* entries) {
+    if (!cache) {
+        return;
+    }
+    pthread_mutex_lock(&cache->lock);
+    if (bytes) *bytes = cache->live_bytes;
+    if (entries) *entries = cache->count;
+    pthread_mutex_unlock(&cache->lock);
+}
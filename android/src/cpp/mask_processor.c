@@ -1,4 +1,8 @@
 #include "mask_processor.h"
+#include "bit_mask.h"
+#include "thread_pool.h"
+#include "scratch_arena.h"
+#include "processor_stats.h"
 #include <math.h>
 #include <string.h>
 #include <stdlib.h>
@@ -9,6 +13,21 @@
 #define THRESHOLD_LOW (THRESHOLD - 0.05)
 #define THRESHOLD_RANGE 0.1
 
+// The same thresholds on 8-bit masks, where value q stands for q / 255
+#define THRESHOLD_U8 128        // q / 255 > 0.5
+#define THRESHOLD_HIGH_U8 141   // q / 255 > 0.55
+#define THRESHOLD_LOW_U8 115    // q / 255 < 0.45
+// Alpha ramp round((q / 255 - 0.45) / 0.1 * 255) = 10 * q - 1147 on [115, 140]
+#define RAMP_OFFSET_U8 1147
+
+// Fixed-point reciprocals for averaging 8-bit sums
+#define RECIP_SHIFT 24
+
+// Smallest band handed to another thread, in pixels
+#define PARALLEL_MIN_BAND_PIXELS 16384
+// Column bands are whole blocks of 8 doubles (one cache line)
+#define COLUMN_BLOCK 8
+
 // SIMD optimization detection
 #ifdef __ARM_NEON
 #include <arm_neon.h>
@@ -41,8 +60,10 @@ MaskProcessorResult apply_sticker_mask_native(
     int border_width,
     const double* expanded_mask
 ) {
+    const MaskStageTimer timer = mask_stage_enter(
+        MASK_STAGE_COMPOSITE, mask_stage_bytes(width, height, expanded_mask ? 24 : 16));
     if (!pixels || !mask || width <= 0 || height <= 0) {
-        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_INVALID_PARAMS);
     }
 
     const int total_pixels = width * height;
@@ -76,7 +97,113 @@ MaskProcessorResult apply_sticker_mask_native(
         }
     }
 
-    return MASK_PROCESSOR_SUCCESS;
+    return mask_stage_leave(timer, MASK_PROCESSOR_SUCCESS);
+}
+
+// Row bands covering at least PARALLEL_MIN_BAND_PIXELS
+static int min_band_rows(int width) {
+    return width < PARALLEL_MIN_BAND_PIXELS ? PARALLEL_MIN_BAND_PIXELS / width : 1;
+}
+
+// Column bands of COLUMN_BLOCK columns covering at least PARALLEL_MIN_BAND_PIXELS
+static int min_band_blocks(int height) {
+    const int blocks = PARALLEL_MIN_BAND_PIXELS / (COLUMN_BLOCK * height);
+    return blocks > 1 ? blocks : 1;
+}
+
+typedef struct {
+    const double* mask;
+    double* temp;
+    double* column_sums;
+    double* output;
+    int width;
+    int height;
+    int half_kernel;
+} BoxBlurJob;
+
+// Horizontal pass: sliding window sum, O(1) per pixel for any kernel size.
+// Near the edges the window is clipped and normalized by the valid taps.
+static void box_blur_rows(void* context, int y_begin, int y_end) {
+    const BoxBlurJob* job = (const BoxBlurJob*)context;
+    const int width = job->width;
+    const int half_kernel = job->half_kernel;
+
+    for (int y = y_begin; y < y_end; y++) {
+        const double* src = job->mask + y * width;
+        double* dst = job->temp + y * width;
+
+        double sum = 0.0;
+        int count = 0;
+        for (int nx = 0; nx <= half_kernel && nx < width; nx++) {
+            sum += src[nx];
+            count++;
+        }
+
+        for (int x = 0; x < width; x++) {
+            dst[x] = sum / count;
+
+            const int enter = x + half_kernel + 1;
+            const int leave = x - half_kernel;
+            if (enter < width) {
+                sum += src[enter];
+                count++;
+            }
+            if (leave >= 0) {
+                sum -= src[leave];
+                count--;
+            }
+        }
+    }
+}
+
+// Vertical pass: running sums for a band of columns, updated one row at a
+// time. Column bands keep every running sum in the same order as a single
+// thread would, so the output does not depend on the thread count.
+static void box_blur_columns(void* context, int block_begin, int block_end) {
+    const BoxBlurJob* job = (const BoxBlurJob*)context;
+    const int width = job->width;
+    const int height = job->height;
+    const int half_kernel = job->half_kernel;
+    const int x0 = block_begin * COLUMN_BLOCK;
+    const int x1 = block_end * COLUMN_BLOCK < width ? block_end * COLUMN_BLOCK : width;
+    double* column_sums = job->column_sums;
+
+    for (int x = x0; x < x1; x++) {
+        column_sums[x] = 0.0;
+    }
+    int count = 0;
+    for (int ny = 0; ny <= half_kernel && ny < height; ny++) {
+        const double* row = job->temp + ny * width;
+        for (int x = x0; x < x1; x++) {
+            column_sums[x] += row[x];
+        }
+        count++;
+    }
+
+    for (int y = 0; y < height; y++) {
+        const double inv_count = 1.0 / count;
+        double* dst = job->output + y * width;
+        for (int x = x0; x < x1; x++) {
+            dst[x] = column_sums[x] * inv_count;
+        }
+
+        const int enter = y + half_kernel + 1;
+        const int leave = y - half_kernel;
+        if (enter < height) {
+            const double* row = job->temp + enter * width;
+            for (int x = x0; x < x1; x++) {
+                column_sums[x] += row[x];
+            }
+            count++;
+        }
+        if (leave >= 0) {
+            const double* row = job->temp + leave * width;
+            for (int x = x0; x < x1; x++) {
+                column_sums[x] -= row[x];
+            }
+            count--;
+        }
+    }
 }
 
 MaskProcessorResult smooth_mask_native(
@@ -86,58 +213,189 @@ MaskProcessorResult smooth_mask_native(
     int height,
     int kernel_size
 ) {
+    const MaskStageTimer timer = mask_stage_enter(
+        MASK_STAGE_SMOOTH, mask_stage_bytes(width, height, 16));
     if (!mask || !output || width <= 0 || height <= 0 || kernel_size <= 0) {
-        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_INVALID_PARAMS);
     }
 
     if (kernel_size <= 1) {
         memcpy(output, mask, sizeof(double) * width * height);
-        return MASK_PROCESSOR_SUCCESS;
+        return mask_stage_leave(timer, MASK_PROCESSOR_SUCCESS);
     }
 
-    // Allocate temporary buffer for separable blur
-    double* temp = (double*)malloc(sizeof(double) * width * height);
+    // Temporary buffer for separable blur, plus one row of column sums
+    double* temp = (double*)mask_scratch_alloc(sizeof(double) * width * (height + 1));
     if (!temp) {
-        return MASK_PROCESSOR_ERROR_MEMORY;
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_MEMORY);
     }
 
-    const int half_kernel = kernel_size / 2;
+    BoxBlurJob job = {
+        mask, temp, temp + width * height, output, width, height, kernel_size / 2
+    };
+    MaskProcessorResult result = mask_parallel_for(height, min_band_rows(width), box_blur_rows, &job);
+    if (result == MASK_PROCESSOR_SUCCESS) {
+        result = mask_parallel_for((width + COLUMN_BLOCK - 1) / COLUMN_BLOCK,
+                                   min_band_blocks(height), box_blur_columns, &job);
+    }
 
-    // Horizontal pass
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            double sum = 0.0;
-            int count = 0;
-
-            for (int kx = -half_kernel; kx <= half_kernel; kx++) {
-                const int nx = x + kx;
-                if (nx >= 0 && nx < width) {
-                    sum += mask[y * width + nx];
-                    count++;
-                }
+    mask_scratch_free(temp);
+    return mask_stage_leave(timer, result);
+}
+
+// Squared distance along a row to the nearest foreground pixel, given the
+// squared vertical distances f (Felzenszwalb-Huttenlocher lower envelope of
+// parabolas). v, z and d are scratch/output arrays of length n, n + 1, n.
+static void edt_row(const double* f, double* d, int* v, double* z, int n) {
+    int k = 0;
+    v[0] = 0;
+    z[0] = -HUGE_VAL;
+    z[1] = HUGE_VAL;
+
+    for (int q = 1; q < n; q++) {
+        // Intersection with the last envelope parabola; z[0] = -inf stops the pop
+        double s;
+        for (;;) {
+            const int p = v[k];
+            s = ((f[q] + (double)q * q) - (f[p] + (double)p * p)) / (2.0 * (q - p));
+            if (s > z[k]) {
+                break;
             }
-            temp[y * width + x] = sum / count;
+            k--;
         }
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = HUGE_VAL;
     }
 
-    // Vertical pass
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            double sum = 0.0;
-            int count = 0;
-
-            for (int ky = -half_kernel; ky <= half_kernel; ky++) {
-                const int ny = y + ky;
-                if (ny >= 0 && ny < height) {
-                    sum += temp[ny * width + x];
-                    count++;
-                }
+    k = 0;
+    for (int q = 0; q < n; q++) {
+        while (z[k + 1] < q) {
+            k++;
+        }
+        const double dq = q - v[k];
+        d[q] = dq * dq + f[v[k]];
+    }
+}
+
+typedef struct {
+    const double* mask;
+    double* dist_sq;
+    int foreground;
+    int width;
+    int height;
+    double far;
+    int failed;
+} EdtJob;
+
+// Vertical distance to the nearest seed pixel for a band of columns,
+// top-down then bottom-up
+static void edt_columns(void* context, int block_begin, int block_end) {
+    const EdtJob* job = (const EdtJob*)context;
+    const int width = job->width;
+    const int foreground = job->foreground;
+    const int x0 = block_begin * COLUMN_BLOCK;
+    const int x1 = block_end * COLUMN_BLOCK < width ? block_end * COLUMN_BLOCK : width;
+
+    for (int x = x0; x < x1; x++) {
+        job->dist_sq[x] = (job->mask[x] > THRESHOLD) == foreground ? 0.0 : job->far;
+    }
+    for (int y = 1; y < job->height; y++) {
+        const double* src = job->mask + y * width;
+        const double* above = job->dist_sq + (y - 1) * width;
+        double* dst = job->dist_sq + y * width;
+        for (int x = x0; x < x1; x++) {
+            dst[x] = (src[x] > THRESHOLD) == foreground ? 0.0 : above[x] + 1.0;
+        }
+    }
+    for (int y = job->height - 2; y >= 0; y--) {
+        const double* below = job->dist_sq + (y + 1) * width;
+        double* dst = job->dist_sq + y * width;
+        for (int x = x0; x < x1; x++) {
+            if (below[x] + 1.0 < dst[x]) {
+                dst[x] = below[x] + 1.0;
             }
-            output[y * width + x] = sum / count;
         }
     }
+}
+
+// Horizontal pass for a band of rows, with its own O(width) scratch
+static void edt_rows(void* context, int y_begin, int y_end) {
+    EdtJob* job = (EdtJob*)context;
+    const int width = job->width;
+
+    double* f = (double*)mask_scratch_alloc(sizeof(double) * (3 * width + 1));
+    int* v = (int*)mask_scratch_alloc(sizeof(int) * width);
+    if (!f || !v) {
+        mask_scratch_free(f);
+        mask_scratch_free(v);
+        __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    double* d = f + width;
+    double* z = d + width;
+
+    for (int y = y_begin; y < y_end; y++) {
+        double* row = job->dist_sq + y * width;
+        for (int x = 0; x < width; x++) {
+            f[x] = row[x] * row[x];
+        }
+        edt_row(f, d, v, z, width);
+        memcpy(row, d, sizeof(double) * width);
+    }
+
+    mask_scratch_free(f);
+    mask_scratch_free(v);
+}
 
-    free(temp);
+// Squared Euclidean distance from every pixel to the nearest pixel whose
+// foreground state ((mask > THRESHOLD) == foreground) matches. The vertical
+// distance is found with two linear scans per column stored in dist_sq, then
+// each row is finished in place with edt_row. Scratch is O(width) per band.
+// Pixels with no match in the image get far * far.
+static MaskProcessorResult squared_edt(
+    const double* mask,
+    int foreground,
+    double* dist_sq,
+    int width,
+    int height,
+    double far
+) {
+    EdtJob job = { mask, dist_sq, foreground, width, height, far, 0 };
+
+    // The row pass reads every column, so it must not run on a cancelled one
+    MaskProcessorResult result = mask_parallel_for((width + COLUMN_BLOCK - 1) / COLUMN_BLOCK,
+                                                   min_band_blocks(height), edt_columns, &job);
+    if (result == MASK_PROCESSOR_SUCCESS) {
+        result = mask_parallel_for(height, min_band_rows(width), edt_rows, &job);
+    }
+    if (result == MASK_PROCESSOR_SUCCESS && job.failed) {
+        result = MASK_PROCESSOR_ERROR_MEMORY;
+    }
+    return result;
+}
+
+// Mark every pixel within border_width (Euclidean) of a foreground pixel
+static MaskProcessorResult expand_mask_edt(
+    const double* mask,
+    double* output,
+    int width,
+    int height,
+    int border_width
+) {
+    // Beyond any real distance and the radius; keeps parabola arithmetic finite
+    const double far = (double)width + height + border_width;
+    const double radius_sq = (double)border_width * border_width;
+
+    const MaskProcessorResult result = squared_edt(mask, 1, output, width, height, far);
+    if (result != MASK_PROCESSOR_SUCCESS) {
+        return result;
+    }
+
+    for (int i = 0; i < width * height; i++) {
+        output[i] = output[i] <= radius_sq ? 1.0 : 0.0;
+    }
     return MASK_PROCESSOR_SUCCESS;
 }
 
@@ -148,144 +406,501 @@ MaskProcessorResult expand_mask_native(
     int height,
     int border_width
 ) {
+    const MaskStageTimer timer = mask_stage_enter(
+        MASK_STAGE_EXPAND, mask_stage_bytes(width, height, 16));
     if (!mask || !output || width <= 0 || height <= 0 || border_width < 0) {
-        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_INVALID_PARAMS);
     }
 
     // If border_width is 0, just copy the mask
     if (border_width == 0) {
         memcpy(output, mask, sizeof(double) * width * height);
-        return MASK_PROCESSOR_SUCCESS;
-    }
-
-    // Initialize output to zero
-    memset(output, 0, sizeof(double) * width * height);
-
-    // For small border widths, use optimized direct approach
-    if (border_width <= 3) {
-        // Pre-compute circular kernel offsets for small borders
-        int kernel_offsets[64]; // Maximum for border_width=3: (2*3+1)^2 = 49
-        int kernel_count = 0;
-        
-        for (int dy = -border_width; dy <= border_width; dy++) {
-            for (int dx = -border_width; dx <= border_width; dx++) {
-                if (dx * dx + dy * dy <= border_width * border_width) {
-                    kernel_offsets[kernel_count++] = dy * width + dx;
-                }
+        return mask_stage_leave(timer, MASK_PROCESSOR_SUCCESS);
+    }
+
+    // Threshold an exact Euclidean distance transform: O(W*H) for any border
+    // width, giving the same round border as a circular dilation kernel
+    return mask_stage_leave(timer, expand_mask_edt(mask, output, width, height, border_width));
+}
+
+MaskProcessorResult compute_mask_sdf_native(
+    const double* mask,
+    float* sdf,
+    int width,
+    int height
+) {
+    const MaskStageTimer timer = mask_stage_enter(
+        MASK_STAGE_SDF, mask_stage_bytes(width, height, 12));
+    if (!mask || !sdf || width <= 0 || height <= 0) {
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_INVALID_PARAMS);
+    }
+
+    const int total_pixels = width * height;
+    // Beyond any real distance; pixels with no seed come back at least
+    // far * far and get an infinite distance, so an empty mask has no
+    // border at any width
+    const double far = (double)width + height;
+    const double no_seed = far * far;
+
+    double* dist_sq = (double*)mask_scratch_alloc(sizeof(double) * total_pixels);
+    if (!dist_sq) {
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_MEMORY);
+    }
+
+    // Outside: distance to the nearest foreground pixel center, moved half a
+    // pixel in so the zero crossing sits between foreground and background
+    MaskProcessorResult result = squared_edt(mask, 1, dist_sq, width, height, far);
+    if (result != MASK_PROCESSOR_SUCCESS) {
+        mask_scratch_free(dist_sq);
+        return mask_stage_leave(timer, result);
+    }
+    for (int i = 0; i < total_pixels; i++) {
+        if (dist_sq[i] >= no_seed) {
+            sdf[i] = INFINITY;
+        } else if (dist_sq[i] > 0.0) {
+            sdf[i] = (float)(sqrt(dist_sq[i]) - 0.5);
+        }
+    }
+
+    // Inside: negative distance to the nearest background pixel
+    result = squared_edt(mask, 0, dist_sq, width, height, far);
+    if (result != MASK_PROCESSOR_SUCCESS) {
+        mask_scratch_free(dist_sq);
+        return mask_stage_leave(timer, result);
+    }
+    for (int i = 0; i < total_pixels; i++) {
+        if (dist_sq[i] >= no_seed) {
+            sdf[i] = -INFINITY;
+        } else if (dist_sq[i] > 0.0) {
+            sdf[i] = (float)(0.5 - sqrt(dist_sq[i]));
+        }
+    }
+
+    mask_scratch_free(dist_sq);
+    return mask_stage_leave(timer, MASK_PROCESSOR_SUCCESS);
+}
+
+MaskProcessorResult apply_sticker_mask_sdf_native(
+    uint8_t* pixels,
+    const double* mask,
+    const float* sdf,
+    int width,
+    int height,
+    int add_border,
+    RGBColor border_color,
+    float border_width
+) {
+    const MaskStageTimer timer = mask_stage_enter(
+        MASK_STAGE_COMPOSITE, mask_stage_bytes(width, height, 20));
+    if (!pixels || !mask || !sdf || width <= 0 || height <= 0 || border_width < 0.0f) {
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_INVALID_PARAMS);
+    }
+
+    const int total_pixels = width * height;
+
+    for (int i = 0; i < total_pixels; i++) {
+        const int pixel_index = i * 4;
+        const double mask_value = mask[i];
+
+        if (mask_value > THRESHOLD_HIGH) {
+            // Foreground pixel - keep original with full alpha
+            pixels[pixel_index + 3] = 255;
+        } else if (mask_value < THRESHOLD_LOW) {
+            // Within border_width of a foreground pixel center: the disc
+            // expand_mask_native and the fused pipeline paint
+            if (add_border && sdf[i] <= border_width - 0.5f) {
+                pixels[pixel_index] = border_color.r;
+                pixels[pixel_index + 1] = border_color.g;
+                pixels[pixel_index + 2] = border_color.b;
+                pixels[pixel_index + 3] = 255;
+            } else {
+                // Background pixel - transparent
+                pixels[pixel_index + 3] = 0;
             }
+        } else {
+            // Smooth transition - alpha blending
+            const int alpha = clamp_int(
+                (int)round((mask_value - THRESHOLD_LOW) / THRESHOLD_RANGE * 255.0),
+                0, 255
+            );
+            pixels[pixel_index + 3] = (uint8_t)alpha;
         }
+    }
+
+    return mask_stage_leave(timer, MASK_PROCESSOR_SUCCESS);
+}
+
+typedef struct {
+    const uint8_t* src;
+    uint8_t* dst;
+    const double* mask;
+    const float* sdf;
+    int width;
+    int add_border;
+    RGBColor border_color;
+    float border_width;
+} ApplySdfJob;
+
+// Rows [y_begin, y_end), copied a slice of MASK_PROCESSOR_COPY_BAND_PIXELS at
+// a time when working out of place so the slice is still in cache when the
+// kernel reads it back
+static void apply_sdf_rows(void* context, int y_begin, int y_end) {
+    const ApplySdfJob* job = (const ApplySdfJob*)context;
+    const int width = job->width;
+    const int band_rows = width < MASK_PROCESSOR_COPY_BAND_PIXELS
+        ? MASK_PROCESSOR_COPY_BAND_PIXELS / width : 1;
+
+    for (int y = y_begin; y < y_end; y += band_rows) {
+        const int rows = y_end - y < band_rows ? y_end - y : band_rows;
+        const size_t offset = (size_t)y * width;
+
+        if (job->dst != job->src) {
+            memcpy(job->dst + offset * 4, job->src + offset * 4, (size_t)rows * width * 4);
+        }
+        apply_sticker_mask_sdf_native(
+            job->dst + offset * 4, job->mask + offset, job->sdf + offset, width, rows,
+            job->add_border, job->border_color, job->border_width);
+    }
+}
+
+MaskProcessorResult apply_sticker_mask_sdf_to_native(
+    const uint8_t* src,
+    uint8_t* dst,
+    const double* mask,
+    const float* sdf,
+    int width,
+    int height,
+    int add_border,
+    RGBColor border_color,
+    float border_width
+) {
+    const MaskStageTimer timer = mask_stage_enter(
+        MASK_STAGE_COMPOSITE, mask_stage_bytes(width, height, 20));
+    if (!src || !dst || !mask || !sdf || width <= 0 || height <= 0 || border_width < 0.0f) {
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_INVALID_PARAMS);
+    }
+
+    ApplySdfJob job = { src, dst, mask, sdf, width, add_border, border_color, border_width };
+    return mask_stage_leave(
+        timer, mask_parallel_for(height, min_band_rows(width), apply_sdf_rows, &job));
+}
+
+MaskProcessorResult apply_sticker_mask_u8(
+    uint8_t* pixels,
+    const uint8_t* mask,
+    int width,
+    int height,
+    int add_border,
+    RGBColor border_color,
+    const uint8_t* expanded_mask
+) {
+    const MaskStageTimer timer = mask_stage_enter(
+        MASK_STAGE_COMPOSITE, mask_stage_bytes(width, height, expanded_mask ? 10 : 9));
+    if (!pixels || !mask || width <= 0 || height <= 0) {
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_INVALID_PARAMS);
+    }
+
+    const int total_pixels = width * height;
+
+    for (int i = 0; i < total_pixels; i++) {
+        const int pixel_index = i * 4;
+        const int mask_value = mask[i];
+        const int expanded_mask_value = expanded_mask ? expanded_mask[i] : mask_value;
 
-        // Apply kernel to each foreground pixel
-        for (int y = 0; y < height; y++) {
-            for (int x = 0; x < width; x++) {
-                if (mask[y * width + x] > THRESHOLD) {
-                    const int center_idx = y * width + x;
-                    
-                    for (int k = 0; k < kernel_count; k++) {
-                        const int target_idx = center_idx + kernel_offsets[k];
-                        const int target_y = target_idx / width;
-                        const int target_x = target_idx % width;
-                        
-                        // Bounds check
-                        if (target_y >= 0 && target_y < height && 
-                            target_x >= 0 && target_x < width) {
-                            output[target_idx] = 1.0;
-                        }
-                    }
-                }
+        if (mask_value >= THRESHOLD_HIGH_U8) {
+            // Foreground pixel - keep original with full alpha
+            pixels[pixel_index + 3] = 255;
+        } else if (mask_value < THRESHOLD_LOW_U8) {
+            if (add_border && expanded_mask_value >= THRESHOLD_U8) {
+                // Border pixel
+                pixels[pixel_index] = border_color.r;
+                pixels[pixel_index + 1] = border_color.g;
+                pixels[pixel_index + 2] = border_color.b;
+                pixels[pixel_index + 3] = 255;
+            } else {
+                // Background pixel - transparent
+                pixels[pixel_index + 3] = 0;
             }
+        } else {
+            // Smooth transition - integer alpha ramp
+            pixels[pixel_index + 3] = (uint8_t)(10 * mask_value - RAMP_OFFSET_U8);
+        }
+    }
+
+    return mask_stage_leave(timer, MASK_PROCESSOR_SUCCESS);
+}
+
+// Round sum / count to nearest with a precomputed fixed-point reciprocal
+static inline uint8_t average_u8(uint32_t sum, uint32_t recip) {
+    return (uint8_t)(((uint64_t)sum * recip + (1u << (RECIP_SHIFT - 1))) >> RECIP_SHIFT);
+}
+
+static inline uint32_t reciprocal_u8(int count) {
+    return (uint32_t)(((1u << RECIP_SHIFT) + count / 2) / count);
+}
+
+typedef struct {
+    const uint8_t* mask;
+    uint8_t* temp;
+    uint32_t* column_sums;
+    const uint32_t* recip;
+    uint8_t* output;
+    int width;
+    int height;
+    int half_kernel;
+} SmoothU8Job;
+
+// Horizontal pass: exact integer running sums
+static void smooth_u8_rows(void* context, int y_begin, int y_end) {
+    const SmoothU8Job* job = (const SmoothU8Job*)context;
+    const int width = job->width;
+    const int half_kernel = job->half_kernel;
+    const uint32_t* recip = job->recip;
+    const uint8_t* mask = job->mask;
+    uint8_t* temp = job->temp;
+
+    for (int y = y_begin; y < y_end; y++) {
+        const uint8_t* src = mask + (size_t)y * width;
+        uint8_t* dst = temp + (size_t)y * width;
+
+        uint32_t sum = 0;
+        int count = 0;
+        for (int nx = 0; nx <= half_kernel && nx < width; nx++) {
+            sum += src[nx];
+            count++;
         }
-    } else {
-        // For larger border widths, use distance transform approach
-        // First pass: mark all foreground pixels
-        for (int i = 0; i < width * height; i++) {
-            if (mask[i] > THRESHOLD) {
-                output[i] = 1.0;
+
+        // Window clipped on the left, then sliding with a fixed tap count,
+        // then clipped on the right
+        int x = 0;
+        for (; x < width && x < half_kernel; x++) {
+            dst[x] = average_u8(sum, recip[count]);
+            if (x + half_kernel + 1 < width) {
+                sum += src[x + half_kernel + 1];
+                count++;
             }
         }
+        const uint32_t full_recip = recip[count];
+        for (; x + half_kernel + 1 < width; x++) {
+            dst[x] = average_u8(sum, full_recip);
+            sum += src[x + half_kernel + 1];
+            sum -= src[x - half_kernel];
+        }
+        for (; x < width; x++) {
+            dst[x] = average_u8(sum, recip[count]);
+            sum -= src[x - half_kernel];
+            count--;
+        }
+    }
+}
+
+// Vertical pass: running column sums for a band of columns, one row at a
+// time. The sums are exact, so the output does not depend on the bands.
+static void smooth_u8_columns(void* context, int block_begin, int block_end) {
+    const SmoothU8Job* job = (const SmoothU8Job*)context;
+    const int width = job->width;
+    const int height = job->height;
+    const int half_kernel = job->half_kernel;
+    const int x0 = block_begin * COLUMN_BLOCK;
+    const int x1 = block_end * COLUMN_BLOCK < width ? block_end * COLUMN_BLOCK : width;
+    // Locals, since byte stores could otherwise alias the job fields
+    uint32_t* column_sums = job->column_sums;
+    const uint32_t* recip = job->recip;
+    const uint8_t* temp = job->temp;
+    uint8_t* output = job->output;
 
-        // Multi-pass dilation for better cache performance
-        double* temp_buffer = (double*)malloc(sizeof(double) * width * height);
-        if (!temp_buffer) {
-            return MASK_PROCESSOR_ERROR_MEMORY;
+    for (int x = x0; x < x1; x++) {
+        column_sums[x] = 0;
+    }
+    int count = 0;
+    for (int ny = 0; ny <= half_kernel && ny < height; ny++) {
+        const uint8_t* row = temp + (size_t)ny * width;
+        for (int x = x0; x < x1; x++) {
+            column_sums[x] += row[x];
         }
+        count++;
+    }
 
-        // Use iterative dilation approach - more cache friendly
-        for (int iter = 0; iter < border_width; iter++) {
-            memcpy(temp_buffer, output, sizeof(double) * width * height);
-            
-            for (int y = 1; y < height - 1; y++) {
-                for (int x = 1; x < width - 1; x++) {
-                    const int idx = y * width + x;
-                    if (temp_buffer[idx] == 0.0) {
-                        // Check 8-connected neighbors
-                        if (temp_buffer[idx - width - 1] > 0.0 ||  // Top-left
-                            temp_buffer[idx - width] > 0.0 ||      // Top
-                            temp_buffer[idx - width + 1] > 0.0 ||  // Top-right
-                            temp_buffer[idx - 1] > 0.0 ||          // Left
-                            temp_buffer[idx + 1] > 0.0 ||          // Right
-                            temp_buffer[idx + width - 1] > 0.0 ||  // Bottom-left
-                            temp_buffer[idx + width] > 0.0 ||      // Bottom
-                            temp_buffer[idx + width + 1] > 0.0) {  // Bottom-right
-                            output[idx] = 1.0;
-                        }
-                    }
-                }
+    for (int y = 0; y < height; y++) {
+        const uint32_t row_recip = recip[count];
+        uint8_t* dst = output + (size_t)y * width;
+        for (int x = x0; x < x1; x++) {
+            dst[x] = average_u8(column_sums[x], row_recip);
+        }
+
+        const int enter = y + half_kernel + 1;
+        const int leave = y - half_kernel;
+        if (enter < height) {
+            const uint8_t* row = temp + (size_t)enter * width;
+            for (int x = x0; x < x1; x++) {
+                column_sums[x] += row[x];
             }
-            
-            // Handle border pixels separately to avoid bounds checking in main loop
-            for (int x = 0; x < width; x++) {
-                // Top row (y = 0)
-                if (temp_buffer[x] == 0.0) {
-                    if ((x > 0 && temp_buffer[x - 1] > 0.0) ||
-                        (x < width - 1 && temp_buffer[x + 1] > 0.0) ||
-                        temp_buffer[width + x] > 0.0 ||
-                        (x > 0 && temp_buffer[width + x - 1] > 0.0) ||
-                        (x < width - 1 && temp_buffer[width + x + 1] > 0.0)) {
-                        output[x] = 1.0;
-                    }
-                }
-                // Bottom row
-                const int bottom_idx = (height - 1) * width + x;
-                if (temp_buffer[bottom_idx] == 0.0) {
-                    if ((x > 0 && temp_buffer[bottom_idx - 1] > 0.0) ||
-                        (x < width - 1 && temp_buffer[bottom_idx + 1] > 0.0) ||
-                        temp_buffer[bottom_idx - width] > 0.0 ||
-                        (x > 0 && temp_buffer[bottom_idx - width - 1] > 0.0) ||
-                        (x < width - 1 && temp_buffer[bottom_idx - width + 1] > 0.0)) {
-                        output[bottom_idx] = 1.0;
-                    }
-                }
+            count++;
+        }
+        if (leave >= 0) {
+            const uint8_t* row = temp + (size_t)leave * width;
+            for (int x = x0; x < x1; x++) {
+                column_sums[x] -= row[x];
             }
-            
-            for (int y = 1; y < height - 1; y++) {
-                // Left column
-                const int left_idx = y * width;
-                if (temp_buffer[left_idx] == 0.0) {
-                    if (temp_buffer[left_idx - width] > 0.0 ||
-                        temp_buffer[left_idx - width + 1] > 0.0 ||
-                        temp_buffer[left_idx + 1] > 0.0 ||
-                        temp_buffer[left_idx + width] > 0.0 ||
-                        temp_buffer[left_idx + width + 1] > 0.0) {
-                        output[left_idx] = 1.0;
-                    }
-                }
-                // Right column
-                const int right_idx = y * width + width - 1;
-                if (temp_buffer[right_idx] == 0.0) {
-                    if (temp_buffer[right_idx - width - 1] > 0.0 ||
-                        temp_buffer[right_idx - width] > 0.0 ||
-                        temp_buffer[right_idx - 1] > 0.0 ||
-                        temp_buffer[right_idx + width - 1] > 0.0 ||
-                        temp_buffer[right_idx + width] > 0.0) {
-                        output[right_idx] = 1.0;
-                    }
-                }
+            count--;
+        }
+    }
+}
+
+MaskProcessorResult smooth_mask_u8(
+    const uint8_t* mask,
+    uint8_t* output,
+    int width,
+    int height,
+    int kernel_size
+) {
+    const MaskStageTimer timer = mask_stage_enter(
+        MASK_STAGE_SMOOTH, mask_stage_bytes(width, height, 2));
+    if (!mask || !output || width <= 0 || height <= 0 || kernel_size <= 0) {
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_INVALID_PARAMS);
+    }
+
+    if (kernel_size <= 1) {
+        memcpy(output, mask, (size_t)width * height);
+        return mask_stage_leave(timer, MASK_PROCESSOR_SUCCESS);
+    }
+
+    const int half_kernel = kernel_size / 2;
+    const int taps = 2 * half_kernel + 1;
+
+    // 8-bit temporary for the horizontal pass, one row of column sums and
+    // reciprocals for every possible tap count
+    uint8_t* temp = (uint8_t*)mask_scratch_alloc((size_t)width * height);
+    uint32_t* column_sums = (uint32_t*)mask_scratch_alloc(sizeof(uint32_t) * (width + taps + 1));
+    if (!temp || !column_sums) {
+        mask_scratch_free(temp);
+        mask_scratch_free(column_sums);
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_MEMORY);
+    }
+    uint32_t* recip = column_sums + width;
+    for (int count = 1; count <= taps; count++) {
+        recip[count] = reciprocal_u8(count);
+    }
+
+    SmoothU8Job job = { mask, temp, column_sums, recip, output, width, height, half_kernel };
+    MaskProcessorResult result = mask_parallel_for(height, min_band_rows(width), smooth_u8_rows, &job);
+    if (result == MASK_PROCESSOR_SUCCESS) {
+        result = mask_parallel_for((width + COLUMN_BLOCK - 1) / COLUMN_BLOCK,
+                                   min_band_blocks(height), smooth_u8_columns, &job);
+    }
+
+    mask_scratch_free(temp);
+    mask_scratch_free(column_sums);
+    return mask_stage_leave(timer, result);
+}
+
+typedef struct {
+    const uint8_t* mask;
+    uint8_t* output;
+    int width;
+    int height;
+    int border_width;
+    int failed;
+} ExpandU8Job;
+
+// Vertical distance to the nearest seed for a band of columns, kept in
+// output and saturating at 255, which is beyond any supported radius
+static void expand_u8_columns(void* context, int block_begin, int block_end) {
+    const ExpandU8Job* job = (const ExpandU8Job*)context;
+    const int width = job->width;
+    const int x0 = block_begin * COLUMN_BLOCK;
+    const int x1 = block_end * COLUMN_BLOCK < width ? block_end * COLUMN_BLOCK : width;
+
+    for (int x = x0; x < x1; x++) {
+        job->output[x] = job->mask[x] >= THRESHOLD_U8 ? 0 : 255;
+    }
+    for (int y = 1; y < job->height; y++) {
+        const uint8_t* src = job->mask + y * width;
+        const uint8_t* above = job->output + (y - 1) * width;
+        uint8_t* dst = job->output + y * width;
+        for (int x = x0; x < x1; x++) {
+            dst[x] = src[x] >= THRESHOLD_U8 ? 0 : (above[x] == 255 ? 255 : above[x] + 1);
+        }
+    }
+    for (int y = job->height - 2; y >= 0; y--) {
+        const uint8_t* below = job->output + (y + 1) * width;
+        uint8_t* dst = job->output + y * width;
+        for (int x = x0; x < x1; x++) {
+            if (below[x] + 1 < dst[x]) {
+                dst[x] = (uint8_t)(below[x] + 1);
             }
         }
+    }
+}
+
+// Horizontal pass and threshold for a band of rows, in place
+static void expand_u8_rows(void* context, int y_begin, int y_end) {
+    ExpandU8Job* job = (ExpandU8Job*)context;
+    const int width = job->width;
+    const double far = (double)width + job->height + job->border_width;
+    const double radius_sq = (double)job->border_width * job->border_width;
 
-        free(temp_buffer);
+    double* f = (double*)mask_scratch_alloc(sizeof(double) * (3 * width + 1));
+    int* v = (int*)mask_scratch_alloc(sizeof(int) * width);
+    if (!f || !v) {
+        mask_scratch_free(f);
+        mask_scratch_free(v);
+        __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+        return;
     }
+    double* d = f + width;
+    double* z = d + width;
 
-    return MASK_PROCESSOR_SUCCESS;
-}
\ No newline at end of file
+    for (int y = y_begin; y < y_end; y++) {
+        uint8_t* row = job->output + y * width;
+        for (int x = 0; x < width; x++) {
+            f[x] = row[x] == 255 ? far * far : (double)row[x] * row[x];
+        }
+        edt_row(f, d, v, z, width);
+        for (int x = 0; x < width; x++) {
+            row[x] = d[x] <= radius_sq ? 255 : 0;
+        }
+    }
+
+    mask_scratch_free(f);
+    mask_scratch_free(v);
+}
+
+MaskProcessorResult expand_mask_u8(
+    const uint8_t* mask,
+    uint8_t* output,
+    int width,
+    int height,
+    int border_width
+) {
+    const MaskStageTimer timer = mask_stage_enter(
+        MASK_STAGE_EXPAND, mask_stage_bytes(width, height, 2));
+    if (!mask || !output || width <= 0 || height <= 0 ||
+        border_width < 0 || border_width > MASK_U8_MAX_BORDER_WIDTH) {
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_INVALID_PARAMS);
+    }
+
+    // If border_width is 0, just copy the mask
+    if (border_width == 0) {
+        memcpy(output, mask, (size_t)width * height);
+        return mask_stage_leave(timer, MASK_PROCESSOR_SUCCESS);
+    }
+
+    // Packed dilation in cache-sized tiles reads and writes only the 8-bit
+    // masks; borders too wide for tiles take the parallel distance transform
+    if (expand_mask_u8_tiles_worthwhile(width, height, border_width)) {
+        return mask_stage_leave(
+            timer, expand_mask_u8_tiled(mask, output, width, height, border_width));
+    }
+
+    ExpandU8Job job = { mask, output, width, height, border_width, 0 };
+    MaskProcessorResult result = mask_parallel_for((width + COLUMN_BLOCK - 1) / COLUMN_BLOCK,
+                                                   min_band_blocks(height), expand_u8_columns, &job);
+    if (result == MASK_PROCESSOR_SUCCESS) {
+        result = mask_parallel_for(height, min_band_rows(width), expand_u8_rows, &job);
+    }
+    if (result == MASK_PROCESSOR_SUCCESS && job.failed) {
+        result = MASK_PROCESSOR_ERROR_MEMORY;
+    }
+    return mask_stage_leave(timer, result);
+}
@@ -13,7 +13,9 @@ typedef enum {
     MASK_PROCESSOR_SUCCESS = 0,
     MASK_PROCESSOR_ERROR_INVALID_PARAMS = -1,
     MASK_PROCESSOR_ERROR_MEMORY = -2,
-    MASK_PROCESSOR_ERROR_PROCESSING = -3
+    MASK_PROCESSOR_ERROR_PROCESSING = -3,
+    // The job was cancelled before it finished (see async_jobs.h)
+    MASK_PROCESSOR_ERROR_CANCELLED = -4
 } MaskProcessorResult;
 
 // Structure for RGB color
@@ -23,6 +25,10 @@ typedef struct {
     uint8_t b;
 } RGBColor;
 
+// Out-of-place apply variants copy and process this many pixels at a time,
+// so each band is still in cache when the kernel reads it back
+#define MASK_PROCESSOR_COPY_BAND_PIXELS 16384
+
 /**
  * Apply sticker mask effects to image pixels with native optimization
  * 
@@ -48,13 +54,17 @@ MaskProcessorResult apply_sticker_mask_native(
 );
 
 /**
- * Smooth mask using optimized separable Gaussian blur
+ * Smooth mask using a separable box blur
+ *
+ * Both passes use running sums, so the cost per pixel does not depend on
+ * kernel_size. Windows clipped at the image edges are normalized by the
+ * number of valid taps.
  * 
  * @param mask Input mask values
  * @param output Output smoothed mask values
  * @param width Mask width
  * @param height Mask height
- * @param kernel_size Blur kernel size (must be odd)
+ * @param kernel_size Blur kernel size; an even size blurs like the next odd one
  * @return Result code
  */
 MaskProcessorResult smooth_mask_native(
@@ -67,6 +77,10 @@ MaskProcessorResult smooth_mask_native(
 
 /**
  * Expand mask for border creation using distance transform
+ *
+ * Marks every pixel within border_width (Euclidean distance) of a pixel
+ * whose mask value is above 0.5. Runs in O(width * height) regardless of
+ * border_width.
  * 
  * @param mask Input mask values
  * @param output Output expanded mask values
@@ -83,6 +97,207 @@ MaskProcessorResult expand_mask_native(
     int border_width
 );
 
+/**
+ * Compute a signed distance field to the mask boundary
+ *
+ * The boundary lies between pixels whose mask value is above 0.5 and the
+ * rest. Values are positive outside the mask and negative inside; a
+ * background pixel at distance d from the nearest foreground pixel center
+ * gets d - 0.5. Thresholding the field at border_width - 0.5 reproduces
+ * expand_mask_native(border_width), so one field serves every border width.
+ * With no foreground pixel every value is +INFINITY, and with no
+ * background pixel every value is -INFINITY.
+ *
+ * @param mask Input mask values
+ * @param sdf Output signed distances (float32, width * height)
+ * @param width Mask width
+ * @param height Mask height
+ * @return Result code
+ */
+MaskProcessorResult compute_mask_sdf_native(
+    const double* mask,
+    float* sdf,
+    int width,
+    int height
+);
+
+/**
+ * Apply sticker mask effects using a signed distance field for the border
+ *
+ * Same foreground and transition handling as apply_sticker_mask_native.
+ * Background pixels within border_width of a foreground pixel center get
+ * the border color, so changing border_width is a single O(n) pass. At an
+ * integer width the output equals apply_sticker_mask_native with
+ * expand_mask_native(border_width), and make_sticker_mask_fused.
+ *
+ * @param pixels RGBA pixel data (input/output)
+ * @param mask Mask values (0.0-1.0)
+ * @param sdf Signed distance field from compute_mask_sdf_native
+ * @param width Image width
+ * @param height Image height
+ * @param add_border Whether to add border
+ * @param border_color Border color RGB
+ * @param border_width Border width in pixels (a fractional width is a disc
+ *        of that radius)
+ * @return Result code
+ */
+MaskProcessorResult apply_sticker_mask_sdf_native(
+    uint8_t* pixels,
+    const double* mask,
+    const float* sdf,
+    int width,
+    int height,
+    int add_border,
+    RGBColor border_color,
+    float border_width
+);
+
+/**
+ * Out-of-place apply_sticker_mask_sdf_native
+ *
+ * Reads src and writes the result to dst, leaving src untouched. dst may
+ * equal src.
+ *
+ * @param src Source RGBA pixel data
+ * @param dst Destination RGBA pixel data
+ * @return Result code
+ */
+MaskProcessorResult apply_sticker_mask_sdf_to_native(
+    const uint8_t* src,
+    uint8_t* dst,
+    const double* mask,
+    const float* sdf,
+    int width,
+    int height,
+    int add_border,
+    RGBColor border_color,
+    float border_width
+);
+
+/*
+ * 8-bit mask variants
+ *
+ * Masks hold q = round(m * 255) and are processed with integer and
+ * fixed-point arithmetic, moving 1/8 of the mask bytes of the double path.
+ * Error bounds against the double kernels run on the unquantized mask m:
+ *
+ * - Quantization: |q / 255 - m| <= 1/510.
+ * - smooth_mask_u8: each pass rounds to nearest, so the output is within
+ *   1.5/255 (< 0.006) of smooth_mask_native.
+ * - expand_mask_u8: identical to expand_mask_native (as 0/255) except where
+ *   an input value lies within 1/510 of the 0.5 threshold.
+ * - apply_sticker_mask_u8: RGB is identical and alpha differs by at most
+ *   6/255, except for pixels within 1/510 of the 0.45 / 0.55 thresholds,
+ *   which may fall in the neighbouring class.
+ * - smooth -> expand -> apply chained: smoothed values stay within 1.5/255,
+ *   so transition alpha differs by at most 16/255 and class changes are
+ *   limited to pixels within 1.5/255 of a threshold.
+ */
+
+// Largest border width supported by expand_mask_u8
+#define MASK_U8_MAX_BORDER_WIDTH 254
+
+/**
+ * Apply sticker mask effects using 8-bit masks
+ *
+ * @param pixels RGBA pixel data (input/output)
+ * @param mask Mask values (0-255)
+ * @param width Image width
+ * @param height Image height
+ * @param add_border Whether to add border
+ * @param border_color Border color RGB
+ * @param expanded_mask Optional expanded mask for borders (can be NULL)
+ * @return Result code
+ */
+MaskProcessorResult apply_sticker_mask_u8(
+    uint8_t* pixels,
+    const uint8_t* mask,
+    int width,
+    int height,
+    int add_border,
+    RGBColor border_color,
+    const uint8_t* expanded_mask
+);
+
+/**
+ * Smooth an 8-bit mask with a separable box blur
+ *
+ * Both passes are split across the thread pool. The sums are exact
+ * integers, so the output is the same for every thread count.
+ *
+ * @param mask Input mask values (0-255)
+ * @param output Output smoothed mask values
+ * @param width Mask width
+ * @param height Mask height
+ * @param kernel_size Blur kernel size; an even size blurs like the next odd one
+ * @return Result code
+ */
+MaskProcessorResult smooth_mask_u8(
+    const uint8_t* mask,
+    uint8_t* output,
+    int width,
+    int height,
+    int kernel_size
+);
+
+/**
+ * Expand an 8-bit mask for border creation
+ *
+ * @param mask Input mask values (0-255)
+ * @param output Output expanded mask (0 or 255)
+ * @param width Mask width
+ * @param height Mask height
+ * @param border_width Border expansion width (at most MASK_U8_MAX_BORDER_WIDTH)
+ * @return Result code
+ */
+MaskProcessorResult expand_mask_u8(
+    const uint8_t* mask,
+    uint8_t* output,
+    int width,
+    int height,
+    int border_width
+);
+
+/**
+ * Set the number of threads the kernels split their work across
+ *
+ * The library keeps a persistent pool of thread_count - 1 workers; the
+ * calling thread does the rest. Output is identical for every thread count.
+ *
+ * @param thread_count Thread count, or 0 for one per online CPU
+ * @return Result code (MASK_PROCESSOR_ERROR_PROCESSING if fewer threads started)
+ */
+MaskProcessorResult mask_processor_set_thread_count(int thread_count);
+
+/**
+ * Number of threads the kernels currently use, including the caller
+ */
+int mask_processor_get_thread_count(void);
+
+/**
+ * Enable or disable cache-blocked tiling in the dispatched kernels
+ *
+ * Tiling is on by default and does not change the output. Intended for
+ * benchmarks; must not be called while kernels are running.
+ *
+ * @param enabled Nonzero to tile
+ */
+void mask_processor_set_tiling(int enabled);
+
+/**
+ * Override the cache size tiles are sized for
+ *
+ * Intended for benchmarks; must not be called while kernels are running.
+ *
+ * @param bytes Cache size in bytes, or 0 for the detected L2 size
+ */
+void mask_processor_set_cache_size(size_t bytes);
+
+/**
+ * Cache size tiles are currently sized for, in bytes
+ */
+size_t mask_processor_get_cache_size(void);
+
 #ifdef __cplusplus
 }
 #endif
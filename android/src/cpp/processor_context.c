@@ -0,0 +1,251 @@
+#include "processor_context.h"
+#include "scratch_arena.h"
+#include "simd_optimizations.h"
+#include "sticker_pipeline.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+struct MaskProcessorContext {
+    MaskArena* arena;
+    void* staging;
+    size_t staging_bytes;
+    uint64_t staging_allocations;
+    // Held for the duration of a call that uses the arena
+    pthread_mutex_t lock;
+};
+
+// Binding of a call in progress
+typedef struct {
+    MaskProcessorContext* context;
+    int owns_arena;
+    MaskScratchBinding previous;
+} ContextCall;
+
+// Bind the calling thread to the context arena, or to the heap while
+// another thread is using it
+static ContextCall context_enter(MaskProcessorContext* context) {
+    ContextCall call;
+    call.context = context;
+    call.owns_arena = pthread_mutex_trylock(&context->lock) == 0;
+    call.previous = mask_scratch_bind(call.owns_arena ? context->arena : NULL, 0);
+    return call;
+}
+
+// Restore the previous binding and grow the stacks that overflowed
+static MaskProcessorResult context_leave(ContextCall call, MaskProcessorResult result) {
+    mask_scratch_restore(call.previous);
+    if (call.owns_arena) {
+        mask_arena_prepare(call.context->arena);
+        pthread_mutex_unlock(&call.context->lock);
+    }
+    return result;
+}
+
+MaskProcessorResult mask_processor_context_create(
+    MaskProcessorContext** context,
+    int thread_count
+) {
+    if (!context) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+    *context = NULL;
+    if (thread_count < 0) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+    if (thread_count > 0) {
+        const MaskProcessorResult result = mask_processor_set_thread_count(thread_count);
+        if (result != MASK_PROCESSOR_SUCCESS) {
+            return result;
+        }
+    }
+
+    MaskProcessorContext* c = (MaskProcessorContext*)calloc(1, sizeof(MaskProcessorContext));
+    if (!c) {
+        return MASK_PROCESSOR_ERROR_MEMORY;
+    }
+    c->arena = mask_arena_create();
+    if (!c->arena || pthread_mutex_init(&c->lock, NULL) != 0) {
+        mask_arena_destroy(c->arena);
+        free(c);
+        return MASK_PROCESSOR_ERROR_MEMORY;
+    }
+
+    *context = c;
+    return MASK_PROCESSOR_SUCCESS;
+}
+
+void mask_processor_context_destroy(MaskProcessorContext* context) {
+    if (!context) {
+        return;
+    }
+    pthread_mutex_destroy(&context->lock);
+    mask_arena_destroy(context->arena);
+    free(context->staging);
+    free(context);
+}
+
+void mask_processor_context_trim(MaskProcessorContext* context) {
+    if (!context) {
+        return;
+    }
+    pthread_mutex_lock(&context->lock);
+    mask_arena_trim(context->arena);
+    pthread_mutex_unlock(&context->lock);
+
+    free(context->staging);
+    context->staging = NULL;
+    context->staging_bytes = 0;
+}
+
+uint64_t mask_processor_context_heap_allocations(const MaskProcessorContext* context) {
+    if (!context) {
+        return 0;
+    }
+    return mask_arena_heap_allocations(context->arena) + context->staging_allocations;
+}
+
+size_t mask_processor_context_reserved_bytes(const MaskProcessorContext* context) {
+    if (!context) {
+        return 0;
+    }
+    return mask_arena_reserved_bytes(context->arena) + context->staging_bytes;
+}
+
+void* mask_processor_context_staging(MaskProcessorContext* context, size_t bytes) {
+    if (!context) {
+        return NULL;
+    }
+    if (bytes > context->staging_bytes) {
+        free(context->staging);
+        context->staging_bytes = 0;
+        context->staging = malloc(bytes);
+        if (!context->staging) {
+            return NULL;
+        }
+        context->staging_bytes = bytes;
+        context->staging_allocations++;
+    }
+    return context->staging;
+}
+
+MaskProcessorResult smooth_mask_ctx(
+    MaskProcessorContext* context,
+    const double* mask,
+    double* output,
+    int width,
+    int height,
+    int kernel_size
+) {
+    if (!context) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+    const ContextCall call = context_enter(context);
+    return context_leave(call, smooth_mask_optimized(mask, output, width, height, kernel_size));
+}
+
+MaskProcessorResult expand_mask_ctx(
+    MaskProcessorContext* context,
+    const double* mask,
+    double* output,
+    int width,
+    int height,
+    int border_width
+) {
+    if (!context) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+    const ContextCall call = context_enter(context);
+    return context_leave(call, expand_mask_optimized(mask, output, width, height, border_width));
+}
+
+MaskProcessorResult compute_mask_sdf_ctx(
+    MaskProcessorContext* context,
+    const double* mask,
+    float* sdf,
+    int width,
+    int height
+) {
+    if (!context) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+    const ContextCall call = context_enter(context);
+    return context_leave(call, compute_mask_sdf_native(mask, sdf, width, height));
+}
+
+MaskProcessorResult make_sticker_mask_fused_ctx(
+    MaskProcessorContext* context,
+    const uint8_t* src,
+    uint8_t* dst,
+    const double* mask,
+    int width,
+    int height,
+    int kernel_size,
+    int add_border,
+    RGBColor border_color,
+    int border_width
+) {
+    if (!context) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+    const ContextCall call = context_enter(context);
+    return context_leave(call, make_sticker_mask_fused(
+        src, dst, mask, width, height, kernel_size, add_border, border_color, border_width));
+}
+
+MaskProcessorResult resize_rgba_to_nchw_ctx(
+    MaskProcessorContext* context,
+    const uint8_t* src,
+    int src_width,
+    int src_height,
+    float* dst,
+    int dst_width,
+    int dst_height,
+    const float* mean,
+    const float* inv_std
+) {
+    if (!context) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+    const ContextCall call = context_enter(context);
+    return context_leave(call, resize_rgba_to_nchw(
+        src, src_width, src_height, dst, dst_width, dst_height, mean, inv_std));
+}
+
+MaskProcessorResult upsample_mask_tensor_ctx(
+    MaskProcessorContext* context,
+    const float* src,
+    int src_width,
+    int src_height,
+    void* dst,
+    MaskOutputFormat format,
+    int dst_width,
+    int dst_height,
+    int apply_sigmoid,
+    double threshold
+) {
+    if (!context) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+    const ContextCall call = context_enter(context);
+    return context_leave(call, upsample_mask_tensor(
+        src, src_width, src_height, dst, format, dst_width, dst_height,
+        apply_sigmoid, threshold));
+}
+
+MaskProcessorResult make_stickers_batch_ctx(
+    MaskProcessorContext* context,
+    const StickerBatchItem* items,
+    int count,
+    int32_t* results,
+    int kernel_size,
+    int add_border,
+    RGBColor border_color,
+    int border_width
+) {
+    if (!context) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+    const ContextCall call = context_enter(context);
+    return context_leave(call, make_stickers_batch(
+        items, count, results, kernel_size, add_border, border_color, border_width));
+}
@@ -0,0 +1,133 @@
+#ifndef PROCESSOR_STATS_H
+#define PROCESSOR_STATS_H
+
+#include "mask_processor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Stages of making a sticker. Inference and encoding run outside the
+// native core; the caller records them with mask_processor_record_stage.
+typedef enum {
+    // resize_rgba_to_nchw
+    MASK_STAGE_PREPROCESS = 0,
+    MASK_STAGE_INFERENCE = 1,
+    // upsample_mask_tensor
+    MASK_STAGE_POSTPROCESS = 2,
+    // smooth_mask_* kernels
+    MASK_STAGE_SMOOTH = 3,
+    // expand_mask_* kernels
+    MASK_STAGE_EXPAND = 4,
+    // compute_mask_sdf_native
+    MASK_STAGE_SDF = 5,
+    // apply_sticker_mask_* kernels
+    MASK_STAGE_COMPOSITE = 6,
+    // make_sticker_mask_fused
+    MASK_STAGE_FUSED = 7,
+    // sticker_stream_push
+    MASK_STAGE_STREAM = 8,
+    // sticker_session_create and the session setters
+    MASK_STAGE_SESSION = 9,
+    // mask_content_hash
+    MASK_STAGE_HASH = 10,
+    MASK_STAGE_ENCODE = 11,
+    MASK_STAGE_COUNT = 12
+} MaskStage;
+
+// Bucket i counts calls that took [2^i, 2^(i+1)) microseconds; bucket 0
+// also counts calls under a microsecond and the last bucket everything
+// from 2^31 microseconds up
+#define MASK_STATS_HISTOGRAM_BUCKETS 32
+
+typedef struct {
+    uint64_t calls;
+    // Calls that returned an error (included in calls)
+    uint64_t errors;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    // Bytes read and written by the calls that succeeded, counted as
+    // mask_benchmark counts them
+    uint64_t bytes;
+    uint64_t histogram[MASK_STATS_HISTOGRAM_BUCKETS];
+} MaskStageStats;
+
+typedef struct {
+    MaskStageStats stages[MASK_STAGE_COUNT];
+} MaskProcessorStats;
+
+/**
+ * Read the statistics of every stage since start or the last reset
+ *
+ * Each thread records into its own counters without locks or atomic
+ * read-modify-writes; this sums them. A call is timed at the outermost
+ * instrumented function on its thread, so the fused kernel counts as
+ * MASK_STAGE_FUSED only and stage times never overlap. Calls finishing
+ * while this runs may or may not be included.
+ *
+ * @param stats Output statistics
+ * @return Result code
+ */
+MaskProcessorResult mask_processor_get_stats(MaskProcessorStats* stats);
+
+/**
+ * Clear the statistics of every stage
+ *
+ * Each thread clears its own counters before it next records.
+ */
+void mask_processor_reset_stats(void);
+
+/**
+ * Record a call timed by the caller, for stages that run outside the
+ * native core such as inference and encoding
+ *
+ * @param stage Stage to record into
+ * @param elapsed_ns Duration of the call in nanoseconds
+ * @param bytes Bytes the call read and wrote
+ * @return Result code
+ */
+MaskProcessorResult mask_processor_record_stage(
+    MaskStage stage,
+    uint64_t elapsed_ns,
+    uint64_t bytes
+);
+
+// Used by the kernels: start timing a call with mask_stage_enter() on
+// entry and return its result through mask_stage_leave()
+typedef struct {
+    uint64_t start_ns;
+    uint64_t bytes;
+    MaskStage stage;
+    // Zero when called from inside another timed call
+    int outermost;
+} MaskStageTimer;
+
+MaskStageTimer mask_stage_enter(MaskStage stage, uint64_t bytes);
+
+// Record the call if it is the outermost one; bytes count only on success
+MaskProcessorResult mask_stage_leave(MaskStageTimer timer, MaskProcessorResult result);
+
+/**
+ * Set how many timed calls are in progress on the calling thread
+ *
+ * Calls made while it is above zero count toward the outer call only.
+ * Pool threads raise it while running bands, so kernels called from a
+ * band are not counted a second time on the thread that runs it.
+ *
+ * @return The previous value, to restore afterwards
+ */
+int mask_stage_set_nesting(int nesting);
+
+// width * height * bytes_per_pixel, or 0 for invalid dimensions
+static inline uint64_t mask_stage_bytes(int width, int height, int bytes_per_pixel) {
+    if (width <= 0 || height <= 0) {
+        return 0;
+    }
+    return (uint64_t)width * (uint64_t)height * (uint64_t)bytes_per_pixel;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROCESSOR_STATS_H
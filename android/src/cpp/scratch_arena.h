@@ -0,0 +1,82 @@
+#ifndef SCRATCH_ARENA_H
+#define SCRATCH_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Alignment of every scratch allocation: one cache line, enough for any
+// vector load the kernels issue
+#define MASK_SCRATCH_ALIGN 64
+
+/**
+ * Growable scratch memory reused across calls
+ *
+ * An arena holds one stack per slot: slot 0 for the thread that makes the
+ * call, and one slot per thread running bands of a pool job, the calling
+ * thread included (see mask_parallel_for). Kernels allocate scratch
+ * with mask_scratch_alloc(), which takes it from the stack of the arena
+ * bound to the calling thread, or from malloc when none is bound. A stack
+ * that runs out takes overflow blocks from malloc and remembers its high
+ * water mark; mask_arena_prepare() then grows it once, so repeated calls of
+ * the same size make no heap allocations at all.
+ *
+ * An arena serves one call at a time.
+ */
+typedef struct MaskArena MaskArena;
+
+MaskArena* mask_arena_create(void);
+void mask_arena_destroy(MaskArena* arena);
+
+/**
+ * Grow each stack to its high water mark; call between calls only
+ */
+void mask_arena_prepare(MaskArena* arena);
+
+/**
+ * Free every stack; the next calls grow them again
+ */
+void mask_arena_trim(MaskArena* arena);
+
+// Heap blocks the arena has allocated since creation
+uint64_t mask_arena_heap_allocations(const MaskArena* arena);
+
+// Bytes held in stacks, excluding live overflow blocks
+size_t mask_arena_reserved_bytes(const MaskArena* arena);
+
+// Arena and slot a thread allocates scratch from
+typedef struct {
+    MaskArena* arena;
+    int slot;
+} MaskScratchBinding;
+
+/**
+ * Bind the calling thread to a slot of an arena (NULL for malloc)
+ *
+ * @return The previous binding, for mask_scratch_restore()
+ */
+MaskScratchBinding mask_scratch_bind(MaskArena* arena, int slot);
+void mask_scratch_restore(MaskScratchBinding previous);
+
+// Arena bound to the calling thread, or NULL
+MaskArena* mask_scratch_arena(void);
+
+/**
+ * Scratch for the current call, aligned to MASK_SCRATCH_ALIGN
+ *
+ * Must be released with mask_scratch_free() on the same thread before the
+ * call returns. Blocks may be freed in any order; stack space is reclaimed
+ * once everything above it is freed.
+ */
+void* mask_scratch_alloc(size_t bytes);
+void* mask_scratch_calloc(size_t count, size_t size);
+void mask_scratch_free(void* pointer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCRATCH_ARENA_H
@@ -7,10 +7,63 @@
 extern "C" {
 #endif
 
+// The NEON kernels are written against the portable vector types in
+// simd_vector.h, so host builds can compile and test them by defining
+// MASK_PROCESSOR_EMULATE_NEON.
+#if defined(__ARM_NEON) || defined(MASK_PROCESSOR_EMULATE_NEON)
+#define MASK_PROCESSOR_HAS_NEON 1
+#endif
+
+// AVX2 and AVX-512 kernels are compiled with per-function target attributes
+// and only selected at runtime, so the baseline build flags stay unchanged.
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define MASK_PROCESSOR_HAS_X86_AVX 1
+#endif
+
+// Above this window the O(1) running-sum passes beat the direct-sum vector
+// kernels, whose cost grows with the kernel size
+#define MASK_PROCESSOR_DIRECT_SUM_MAX_KERNEL 11
+
+// The running-sum passes first round mask values to multiples of 1 / scale,
+// with kernel_size * scale <= 2^51, so every window sum of a [0, 1] mask is
+// a whole number a double holds exactly. A window then has the same sum
+// however far it has slid, and banded, tiled and streamed callers match the
+// whole-image blur bit for bit.
+static inline double mask_running_sum_scale(int half_kernel) {
+    double scale = 2251799813685248.0;
+    for (int taps = 2 * half_kernel + 1; taps > 1; taps = (taps + 1) / 2) {
+        scale *= 0.5;
+    }
+    return scale;
+}
+
+// Adding and removing 2^52 rounds to a whole number; no clamp, so the loops
+// that call this vectorize
+static inline double mask_running_sum_quantize(double value, double scale) {
+    return (value * scale + 4503599627370496.0) - 4503599627370496.0;
+}
+
+// Mean of a window of count quantized values summing to sum
+static inline double mask_running_sum_mean(double sum, int count, double scale) {
+    return sum * (1.0 / ((double)count * scale));
+}
+
+// Instruction set of the kernels selected by the dispatch table
+typedef enum {
+    MASK_PROCESSOR_ISA_SCALAR = 0,
+    MASK_PROCESSOR_ISA_SSE2 = 1,
+    MASK_PROCESSOR_ISA_AVX2 = 2,
+    MASK_PROCESSOR_ISA_AVX512 = 3,
+    MASK_PROCESSOR_ISA_NEON = 4
+} MaskProcessorIsa;
+
 // Platform-specific SIMD optimizations
-#ifdef __ARM_NEON
+#ifdef MASK_PROCESSOR_HAS_NEON
 /**
  * ARM NEON optimized mask application
+ *
+ * Two pixels per vector with the blends of the SSE2 kernel; output is
+ * bit-identical to apply_sticker_mask_native.
  */
 MaskProcessorResult apply_sticker_mask_neon(
     uint8_t* pixels,
@@ -62,6 +115,77 @@ MaskProcessorResult smooth_mask_sse2(
 );
 #endif
 
+#ifdef MASK_PROCESSOR_HAS_X86_AVX
+/**
+ * AVX2 optimized mask application
+ */
+MaskProcessorResult apply_sticker_mask_avx2(
+    uint8_t* pixels,
+    const double* mask,
+    int width,
+    int height,
+    int add_border,
+    RGBColor border_color,
+    int border_width,
+    const double* expanded_mask
+);
+
+/**
+ * AVX2 optimized blur
+ */
+MaskProcessorResult smooth_mask_avx2(
+    const double* mask,
+    double* output,
+    int width,
+    int height,
+    int kernel_size
+);
+
+/**
+ * AVX-512F optimized mask application
+ */
+MaskProcessorResult apply_sticker_mask_avx512(
+    uint8_t* pixels,
+    const double* mask,
+    int width,
+    int height,
+    int add_border,
+    RGBColor border_color,
+    int border_width,
+    const double* expanded_mask
+);
+
+/**
+ * AVX-512F optimized blur
+ */
+MaskProcessorResult smooth_mask_avx512(
+    const double* mask,
+    double* output,
+    int width,
+    int height,
+    int kernel_size
+);
+#endif
+
+/**
+ * Instruction set used by the *_optimized entry points
+ *
+ * The dispatch table is filled once at library load from CPU feature
+ * detection (CPUID on x86, getauxval on ARM).
+ */
+MaskProcessorIsa mask_processor_get_active_isa(void);
+
+/**
+ * Override the dispatch table with a specific instruction set
+ *
+ * Intended for benchmarks and tests. Must not be called while kernels are
+ * running on other threads.
+ *
+ * @param isa Instruction set to use
+ * @return MASK_PROCESSOR_ERROR_INVALID_PARAMS if the CPU or build lacks it
+ */
+MaskProcessorResult mask_processor_select_isa(MaskProcessorIsa isa);
+
 // Auto-dispatch function that selects best available implementation
 MaskProcessorResult apply_sticker_mask_optimized(
     uint8_t* pixels,
@@ -74,6 +198,26 @@ MaskProcessorResult apply_sticker_mask_optimized(
     const double* expanded_mask
 );
 
+// Out-of-place apply: reads src, writes dst (dst may equal src)
+MaskProcessorResult apply_sticker_mask_to_optimized(
+    const uint8_t* src,
+    uint8_t* dst,
+    const double* mask,
+    int width,
+    int height,
+    int add_border,
+    RGBColor border_color,
+    int border_width,
+    const double* expanded_mask
+);
+
+/**
+ * Dispatched box blur
+ *
+ * Direct-sum kernels of the active ISA up to
+ * MASK_PROCESSOR_DIRECT_SUM_MAX_KERNEL, in tiles when the mask outgrows the
+ * cache; above it the O(1) running-sum passes, split into row bands.
+ */
 MaskProcessorResult smooth_mask_optimized(
     const double* mask,
     double* output,
@@ -82,6 +226,97 @@ MaskProcessorResult smooth_mask_optimized(
     int kernel_size
 );
 
+// One pass of a box blur over rows [y_begin, y_end), written to dst starting
+// at its first row. The vertical pass reads up to half_kernel rows of halo
+// above and below the band.
+typedef void (*MaskBlurRowsFn)(
+    const double* src,
+    double* dst,
+    int width,
+    int height,
+    int half_kernel,
+    int y_begin,
+    int y_end
+);
+
+/**
+ * Horizontal and vertical passes smooth_mask_optimized uses for a kernel
+ *
+ * The direct-sum kernels of the active ISA up to
+ * MASK_PROCESSOR_DIRECT_SUM_MAX_KERNEL, the running-sum ones above it. For
+ * pipelines that blur rows as they arrive; same arithmetic as
+ * smooth_mask_rows_optimized.
+ *
+ * @param kernel_size Blur kernel size
+ * @param horizontal Receives the horizontal pass
+ * @param vertical Receives the vertical pass
+ * @return 1 for the running-sum passes, whose vertical window a caller may
+ *         keep across rows as mask_running_sum_quantize sums instead
+ */
+int mask_blur_row_kernels(int kernel_size, MaskBlurRowsFn* horizontal, MaskBlurRowsFn* vertical);
+
+/**
+ * Smooth rows [y_begin, y_end) of a mask for banded pipelines
+ *
+ * Runs the passes of mask_blur_row_kernels, so it matches
+ * smooth_mask_optimized at every kernel size and on every ISA, and
+ * smooth_mask_native to rounding. Each call gives the same rows however the
+ * image is split into bands.
+ *
+ * @param mask Full input mask, width * height
+ * @param output Receives the band, row y at output + (y - y_begin) * width
+ * @param scratch (y_end - y_begin + kernel_size) * width doubles
+ * @param width Mask width
+ * @param height Mask height
+ * @param kernel_size Blur kernel size
+ * @param y_begin First row of the band
+ * @param y_end One past the last row of the band
+ * @return Result code
+ */
+MaskProcessorResult smooth_mask_rows_optimized(
+    const double* mask,
+    double* output,
+    double* scratch,
+    int width,
+    int height,
+    int kernel_size,
+    int y_begin,
+    int y_end
+);
+
+/**
+ * Smooth a mask in cache-sized 2D tiles
+ *
+ * Each tile runs both passes of the dispatched direct-sum kernels over the
+ * tile and its half_kernel halo, so the horizontal pass never round-trips
+ * through a full-size buffer. Same output as smooth_mask_rows_optimized;
+ * smooth_mask_optimized picks this path for large masks. Kernels above
+ * MASK_PROCESSOR_DIRECT_SUM_MAX_KERNEL take the running-sum passes in row
+ * bands instead, since a tile would restart the vertical sum on every row.
+ *
+ * @param mask Input mask values
+ * @param output Output smoothed mask
+ * @param width Mask width
+ * @param height Mask height
+ * @param kernel_size Blur kernel size
+ * @return Result code
+ */
+MaskProcessorResult smooth_mask_tiled(
+    const double* mask,
+    double* output,
+    int width,
+    int height,
+    int kernel_size
+);
+
+MaskProcessorResult expand_mask_optimized(
+    const double* mask,
+    double* output,
+    int width,
+    int height,
+    int border_width
+);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,109 @@
+#ifndef SIMD_VECTOR_H
+#define SIMD_VECTOR_H
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Portable 128-bit vector types built on GCC/Clang vector extensions.
+// They lower to NEON on ARM and to SSE2 on x86, which lets the NEON kernels
+// be compiled and tested on a host machine.
+
+typedef double mp_f64x2 __attribute__((vector_size(16)));
+
+static inline mp_f64x2 mp_f64x2_load(const double* ptr) {
+    mp_f64x2 v;
+    memcpy(&v, ptr, sizeof(v));
+    return v;
+}
+
+static inline void mp_f64x2_store(double* ptr, mp_f64x2 v) {
+    memcpy(ptr, &v, sizeof(v));
+}
+
+static inline mp_f64x2 mp_f64x2_splat(double value) {
+    return (mp_f64x2){value, value};
+}
+
+// Lane masks from comparing mp_f64x2 values: all ones where true
+typedef int64_t mp_i64x2 __attribute__((vector_size(16)));
+
+// Lanes of a where mask is set, of b elsewhere
+static inline mp_f64x2 mp_f64x2_select(mp_i64x2 mask, mp_f64x2 a, mp_f64x2 b) {
+    return (mp_f64x2)((mask & (mp_i64x2)a) | (~mask & (mp_i64x2)b));
+}
+
+typedef uint64_t mp_u64x2 __attribute__((vector_size(16)));
+
+static inline mp_u64x2 mp_u64x2_load(const void* ptr) {
+    mp_u64x2 v;
+    memcpy(&v, ptr, sizeof(v));
+    return v;
+}
+
+// Lanes swapped
+static inline mp_u64x2 mp_u64x2_swap(mp_u64x2 v) {
+#if defined(__clang__)
+    return __builtin_shufflevector(v, v, 1, 0);
+#else
+    return __builtin_shuffle(v, (mp_u64x2){1, 0});
+#endif
+}
+
+// Low 32 bits of each lane multiplied to a full 64-bit product, one
+// pmuludq / vmull_u32 (the generic form multiplies all 64 bits)
+static inline mp_u64x2 mp_u64x2_mul_lo32(mp_u64x2 a, mp_u64x2 b) {
+#if defined(__SSE2__)
+    return (mp_u64x2)_mm_mul_epu32((__m128i)a, (__m128i)b);
+#elif defined(__ARM_NEON)
+    return (mp_u64x2)vmull_u32(vmovn_u64((uint64x2_t)a), vmovn_u64((uint64x2_t)b));
+#else
+    return (a & 0xFFFFFFFFULL) * (b & 0xFFFFFFFFULL);
+#endif
+}
+
+typedef uint32_t mp_u32x2 __attribute__((vector_size(8)));
+
+// Two RGBA pixels widened to one 64-bit lane each
+static inline mp_u64x2 mp_u64x2_from_u32x2(const uint8_t* ptr) {
+    mp_u32x2 v;
+    memcpy(&v, ptr, sizeof(v));
+    return __builtin_convertvector(v, mp_u64x2);
+}
+
+// Low 32 bits of each lane, stored as two RGBA pixels
+static inline void mp_u64x2_store_u32x2(uint8_t* ptr, mp_u64x2 v) {
+    const mp_u32x2 narrow = __builtin_convertvector(v, mp_u32x2);
+    memcpy(ptr, &narrow, sizeof(narrow));
+}
+
+typedef float mp_f32x4 __attribute__((vector_size(16)));
+typedef uint8_t mp_u8x4 __attribute__((vector_size(4)));
+
+static inline mp_f32x4 mp_f32x4_load(const float* ptr) {
+    mp_f32x4 v;
+    memcpy(&v, ptr, sizeof(v));
+    return v;
+}
+
+static inline void mp_f32x4_store(float* ptr, mp_f32x4 v) {
+    memcpy(ptr, &v, sizeof(v));
+}
+
+static inline mp_f32x4 mp_f32x4_splat(float value) {
+    return (mp_f32x4){value, value, value, value};
+}
+
+// Four bytes (one RGBA pixel) widened to floats
+static inline mp_f32x4 mp_f32x4_from_u8x4(const uint8_t* ptr) {
+    mp_u8x4 v;
+    memcpy(&v, ptr, sizeof(v));
+    return __builtin_convertvector(v, mp_f32x4);
+}
+
+#endif // SIMD_VECTOR_H
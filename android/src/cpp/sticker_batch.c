@@ -0,0 +1,128 @@
+#include "sticker_batch.h"
+#include "sticker_pipeline.h"
+#include "thread_pool.h"
+#include "scratch_arena.h"
+#include "processor_stats.h"
+#include <stdlib.h>
+
+// Images at least this large are split across the pool. Below it the
+// per-image band handoff costs more than it saves, and whole images per
+// thread share the work out with no halo rows computed twice.
+#define BATCH_SPLIT_PIXELS (1 << 20)
+
+typedef struct {
+    size_t pixels;
+    int index;
+} BatchOrder;
+
+typedef struct {
+    const StickerBatchItem* items;
+    int32_t* results;
+    const BatchOrder* order;
+    int count;
+    // Next entry of order to claim
+    int next;
+    int kernel_size;
+    int add_border;
+    RGBColor border_color;
+    int border_width;
+} BatchJob;
+
+static int compare_largest_first(const void* a, const void* b) {
+    const size_t pa = ((const BatchOrder*)a)->pixels;
+    const size_t pb = ((const BatchOrder*)b)->pixels;
+    return pa < pb ? 1 : (pa > pb ? -1 : 0);
+}
+
+static void process_item(const BatchJob* job, int index) {
+    const StickerBatchItem* item = &job->items[index];
+    if (mask_job_cancelled()) {
+        job->results[index] = MASK_PROCESSOR_ERROR_CANCELLED;
+        return;
+    }
+    job->results[index] = make_sticker_mask_fused(
+        item->src, item->dst, item->mask, item->width, item->height,
+        job->kernel_size, job->add_border, job->border_color, job->border_width);
+}
+
+// Each pool thread runs one band, which claims whole images until none are
+// left; the fused calls inside run on this thread alone
+static void batch_band(void* context, int begin, int end) {
+    BatchJob* job = (BatchJob*)context;
+    (void)begin;
+    (void)end;
+
+    // Each image is a fused call of its own in the stage statistics
+    const int nesting = mask_stage_set_nesting(0);
+    for (;;) {
+        const int next = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+        if (next >= job->count) {
+            break;
+        }
+        process_item(job, job->order[next].index);
+    }
+    mask_stage_set_nesting(nesting);
+}
+
+MaskProcessorResult make_stickers_batch(
+    const StickerBatchItem* items,
+    int count,
+    int32_t* results,
+    int kernel_size,
+    int add_border,
+    RGBColor border_color,
+    int border_width
+) {
+    if (count < 0 || (count > 0 && (!items || !results))) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+    if (count == 0) {
+        return MASK_PROCESSOR_SUCCESS;
+    }
+
+    BatchOrder* order = (BatchOrder*)mask_scratch_alloc(sizeof(BatchOrder) * count);
+    if (!order) {
+        return MASK_PROCESSOR_ERROR_MEMORY;
+    }
+    for (int i = 0; i < count; i++) {
+        const StickerBatchItem* item = &items[i];
+        order[i].pixels = item->width > 0 && item->height > 0
+            ? (size_t)item->width * item->height : 0;
+        order[i].index = i;
+    }
+    qsort(order, (size_t)count, sizeof(BatchOrder), compare_largest_first);
+
+    // With fewer images than threads, whole images would leave threads idle
+    const int threads = mask_parallel_thread_count();
+    int split = 0;
+    if (count < threads) {
+        split = count;
+    } else {
+        while (split < count && order[split].pixels >= BATCH_SPLIT_PIXELS) {
+            split++;
+        }
+    }
+
+    // Small images first, largest first, so the last ones claimed are the
+    // quickest and threads finish close together
+    BatchJob job = {
+        items, results, order + split, count - split, 0,
+        kernel_size, add_border, border_color, border_width
+    };
+    if (job.count > 0 &&
+        mask_parallel_for(threads, 1, batch_band, &job) == MASK_PROCESSOR_ERROR_CANCELLED) {
+        // Bands skipped after a cancel leave their images unclaimed
+        for (int i = job.next; i < job.count; i++) {
+            results[job.order[i].index] = MASK_PROCESSOR_ERROR_CANCELLED;
+        }
+    }
+
+    // Then each large image on the whole pool
+    job.order = order;
+    for (int i = 0; i < split; i++) {
+        process_item(&job, order[i].index);
+    }
+
+    mask_scratch_free(order);
+    return MASK_PROCESSOR_SUCCESS;
+}
@@ -0,0 +1,59 @@
+#ifndef STICKER_BATCH_H
+#define STICKER_BATCH_H
+
+#include "mask_processor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// One image of a batch
+typedef struct {
+    // Source RGBA pixel data
+    const uint8_t* src;
+    // Destination RGBA pixel data (may equal src)
+    uint8_t* dst;
+    // Raw mask values (0.0-1.0)
+    const double* mask;
+    int width;
+    int height;
+} StickerBatchItem;
+
+/**
+ * make_sticker_mask_fused over many images in one call
+ *
+ * Images below a split size are each processed whole by one thread: the
+ * pool threads take them one at a time, largest first, from a shared
+ * queue, so a thread that draws small images takes more of them. Larger
+ * images are then processed one after another, each split across the
+ * pool. Each image gets the same pixels as make_sticker_mask_fused.
+ *
+ * An image that fails does not stop the others.
+ *
+ * @param items Images to process
+ * @param count Number of images
+ * @param results Receives the result code of each image
+ * @param kernel_size Blur kernel size (1 for no smoothing)
+ * @param add_border Whether to add border
+ * @param border_color Border color RGB
+ * @param border_width Border width in pixels
+ * @return MASK_PROCESSOR_ERROR_INVALID_PARAMS if items or results is
+ *         missing, MASK_PROCESSOR_ERROR_MEMORY if the batch could not be
+ *         scheduled, otherwise MASK_PROCESSOR_SUCCESS with the outcome of
+ *         each image in results
+ */
+MaskProcessorResult make_stickers_batch(
+    const StickerBatchItem* items,
+    int count,
+    int32_t* results,
+    int kernel_size,
+    int add_border,
+    RGBColor border_color,
+    int border_width
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STICKER_BATCH_H
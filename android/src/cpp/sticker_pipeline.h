@@ -0,0 +1,120 @@
+#ifndef STICKER_PIPELINE_H
+#define STICKER_PIPELINE_H
+
+#include "mask_processor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Smooth, expand and apply in one pass over the image
+ *
+ * Streams row bands through the blur, a packed dilation and compositing,
+ * so intermediate rows are reused while they are still in cache and the
+ * RGBA output is written once. Scratch memory is a few bands of rows per
+ * thread; no full-size mask is allocated.
+ *
+ * Gives the same pixels as smooth_mask_rows_optimized over the whole mask,
+ * expand_mask_native on the result (when add_border and border_width > 0)
+ * and apply_sticker_mask_to_optimized, for any thread count.
+ *
+ * @param src Source RGBA pixel data
+ * @param dst Destination RGBA pixel data (may equal src)
+ * @param mask Raw mask values (0.0-1.0)
+ * @param width Image width
+ * @param height Image height
+ * @param kernel_size Blur kernel size (1 for no smoothing)
+ * @param add_border Whether to add border
+ * @param border_color Border color RGB
+ * @param border_width Border width in pixels
+ * @return Result code
+ */
+MaskProcessorResult make_sticker_mask_fused(
+    const uint8_t* src,
+    uint8_t* dst,
+    const double* mask,
+    int width,
+    int height,
+    int kernel_size,
+    int add_border,
+    RGBColor border_color,
+    int border_width
+);
+
+/**
+ * Bounded-memory row streaming of the fused pipeline
+ *
+ * For inputs too large to hold as a full mask and image: the caller pushes
+ * source rows and their mask rows in order and receives finished RGBA rows.
+ * Output trails input by sticker_stream_lag() rows, and the push that
+ * completes the image flushes the rest. Memory held is
+ * O(width * (kernel_size + border_width)) whatever the height.
+ *
+ * Gives the same pixels as make_sticker_mask_fused.
+ */
+typedef struct StickerStream StickerStream;
+
+/**
+ * Create a stream for an image of the given size
+ *
+ * @param stream Receives the stream, NULL on failure
+ * @param width Image width
+ * @param height Image height (total rows that will be pushed)
+ * @param kernel_size Blur kernel size (1 for no smoothing)
+ * @param add_border Whether to add border
+ * @param border_color Border color RGB
+ * @param border_width Border width in pixels
+ * @return Result code
+ */
+MaskProcessorResult sticker_stream_create(
+    StickerStream** stream,
+    int width,
+    int height,
+    int kernel_size,
+    int add_border,
+    RGBColor border_color,
+    int border_width
+);
+
+/**
+ * Destroy a stream and free its buffers
+ *
+ * @param stream Stream to destroy (may be NULL)
+ */
+void sticker_stream_destroy(StickerStream* stream);
+
+/**
+ * Rows of input held back before the matching output row is ready
+ *
+ * @param stream Stream
+ * @return Lag in rows (blur radius plus border width)
+ */
+int sticker_stream_lag(const StickerStream* stream);
+
+/**
+ * Push the next rows and collect the rows they complete
+ *
+ * @param stream Stream
+ * @param pixels Source RGBA rows (rows * width * 4 bytes)
+ * @param mask Raw mask rows (rows * width values, 0.0-1.0)
+ * @param rows Number of rows pushed; at most the rows still expected
+ * @param output Receives finished RGBA rows in order; must hold
+ *               (rows + sticker_stream_lag()) * width * 4 bytes
+ * @param output_rows Receives the number of rows written to output
+ * @return Result code
+ */
+MaskProcessorResult sticker_stream_push(
+    StickerStream* stream,
+    const uint8_t* pixels,
+    const double* mask,
+    int rows,
+    uint8_t* output,
+    int* output_rows
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STICKER_PIPELINE_H
@@ -0,0 +1,243 @@
+#include "sticker_session.h"
+#include "simd_optimizations.h"
+#include "processor_stats.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Threshold constants matching mask_processor.c
+#define THRESHOLD 0.5
+#define THRESHOLD_LOW (THRESHOLD - 0.05)
+
+// Background pixels closer than this to the mask are indexed, so border
+// widths up to it are restyled from the index alone. Wider borders fall
+// back to a full composite.
+#define SESSION_BAND_DISTANCE 64
+
+struct StickerSession {
+    int width;
+    int height;
+    uint8_t* source;
+    uint8_t* output;
+    double* smoothed;
+    float* sdf;
+    // Indexed background pixels grouped by whole-pixel distance: bucket d
+    // holds the pixels with d <= sdf < d + 1 at band[bucket[d]..bucket[d + 1])
+    int* band;
+    int bucket[SESSION_BAND_DISTANCE + 1];
+    int add_border;
+    RGBColor border_color;
+    float border_width;
+};
+
+static float border_extent(int add_border, float border_width) {
+    return add_border ? border_width : 0.0f;
+}
+
+// Index the background pixels within SESSION_BAND_DISTANCE of the mask
+static int build_band(StickerSession* session) {
+    const int total_pixels = session->width * session->height;
+    int counts[SESSION_BAND_DISTANCE] = { 0 };
+
+    for (int i = 0; i < total_pixels; i++) {
+        if (session->smoothed[i] < THRESHOLD_LOW && session->sdf[i] < SESSION_BAND_DISTANCE) {
+            counts[session->sdf[i] > 0.0f ? (int)session->sdf[i] : 0]++;
+        }
+    }
+
+    session->bucket[0] = 0;
+    for (int d = 0; d < SESSION_BAND_DISTANCE; d++) {
+        session->bucket[d + 1] = session->bucket[d] + counts[d];
+        counts[d] = session->bucket[d];
+    }
+
+    session->band = (int*)malloc(sizeof(int) * (session->bucket[SESSION_BAND_DISTANCE] + 1));
+    if (!session->band) {
+        return 0;
+    }
+    for (int i = 0; i < total_pixels; i++) {
+        if (session->smoothed[i] < THRESHOLD_LOW && session->sdf[i] < SESSION_BAND_DISTANCE) {
+            session->band[counts[session->sdf[i] > 0.0f ? (int)session->sdf[i] : 0]++] = i;
+        }
+    }
+    return 1;
+}
+
+// Background pixel under the current style, as apply_sticker_mask_sdf_native
+// writes it over a copy of the source
+static void shade_background(StickerSession* session, int i) {
+    uint8_t* pixel = session->output + (size_t)i * 4;
+
+    if (session->add_border && session->sdf[i] <= session->border_width - 0.5f) {
+        pixel[0] = session->border_color.r;
+        pixel[1] = session->border_color.g;
+        pixel[2] = session->border_color.b;
+        pixel[3] = 255;
+    } else {
+        memcpy(pixel, session->source + (size_t)i * 4, 3);
+        pixel[3] = 0;
+    }
+}
+
+// Apply a new style, rewriting the pixels at distances [low, high) from
+// the mask: those whose coverage or color can differ between the styles
+static MaskProcessorResult restyle(
+    StickerSession* session,
+    int add_border,
+    RGBColor border_color,
+    float border_width
+) {
+    const float old_extent = border_extent(session->add_border, session->border_width);
+    const float new_extent = border_extent(add_border, border_width);
+    const int recolor = border_color.r != session->border_color.r ||
+                        border_color.g != session->border_color.g ||
+                        border_color.b != session->border_color.b;
+
+    session->add_border = add_border;
+    session->border_color = border_color;
+    session->border_width = border_width;
+
+    const float high = old_extent > new_extent ? old_extent : new_extent;
+    if (high > SESSION_BAND_DISTANCE) {
+        return apply_sticker_mask_sdf_to_native(
+            session->source, session->output, session->smoothed, session->sdf,
+            session->width, session->height, add_border, border_color, border_width);
+    }
+
+    // A pixel is border where sdf <= extent - 0.5, so at or below
+    // min(extent) - 0.5 it stays border and only a color change matters
+    float low = 0.0f;
+    if (!recolor) {
+        low = (old_extent < new_extent ? old_extent : new_extent) - 0.5f;
+        if (low < 0.0f) low = 0.0f;
+    }
+
+    const int first = (int)low;
+    int last = (int)high;
+    if (last < high) last++;
+    if (last > SESSION_BAND_DISTANCE) last = SESSION_BAND_DISTANCE;
+
+    for (int k = session->bucket[first]; k < session->bucket[last]; k++) {
+        shade_background(session, session->band[k]);
+    }
+    return MASK_PROCESSOR_SUCCESS;
+}
+
+MaskProcessorResult sticker_session_create(
+    StickerSession** session,
+    const uint8_t* src,
+    const double* mask,
+    int width,
+    int height,
+    int kernel_size,
+    int add_border,
+    RGBColor border_color,
+    float border_width
+) {
+    const MaskStageTimer timer = mask_stage_enter(
+        MASK_STAGE_SESSION, mask_stage_bytes(width, height, 16));
+    if (!session) {
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_INVALID_PARAMS);
+    }
+    *session = NULL;
+    if (!src || !mask || width <= 0 || height <= 0 || kernel_size <= 0 ||
+        !(border_width >= 0.0f)) {
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_INVALID_PARAMS);
+    }
+
+    const size_t total_pixels = (size_t)width * height;
+    StickerSession* s = (StickerSession*)calloc(1, sizeof(StickerSession));
+    if (!s) {
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_MEMORY);
+    }
+    s->width = width;
+    s->height = height;
+    s->add_border = add_border != 0;
+    s->border_color = border_color;
+    s->border_width = border_width;
+    s->source = (uint8_t*)malloc(total_pixels * 4);
+    s->output = (uint8_t*)malloc(total_pixels * 4);
+    s->smoothed = (double*)malloc(sizeof(double) * total_pixels);
+    s->sdf = (float*)malloc(sizeof(float) * total_pixels);
+    if (!s->source || !s->output || !s->smoothed || !s->sdf) {
+        sticker_session_destroy(s);
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_MEMORY);
+    }
+    memcpy(s->source, src, total_pixels * 4);
+
+    MaskProcessorResult result = MASK_PROCESSOR_SUCCESS;
+    if (kernel_size > 1) {
+        result = smooth_mask_optimized(mask, s->smoothed, width, height, kernel_size);
+    } else {
+        memcpy(s->smoothed, mask, sizeof(double) * total_pixels);
+    }
+    if (result == MASK_PROCESSOR_SUCCESS) {
+        result = compute_mask_sdf_native(s->smoothed, s->sdf, width, height);
+    }
+    if (result == MASK_PROCESSOR_SUCCESS && !build_band(s)) {
+        result = MASK_PROCESSOR_ERROR_MEMORY;
+    }
+    if (result == MASK_PROCESSOR_SUCCESS) {
+        result = apply_sticker_mask_sdf_to_native(
+            s->source, s->output, s->smoothed, s->sdf, width, height,
+            add_border, border_color, border_width);
+    }
+    if (result != MASK_PROCESSOR_SUCCESS) {
+        sticker_session_destroy(s);
+        return mask_stage_leave(timer, result);
+    }
+
+    *session = s;
+    return mask_stage_leave(timer, MASK_PROCESSOR_SUCCESS);
+}
+
+void sticker_session_destroy(StickerSession* session) {
+    if (!session) {
+        return;
+    }
+    free(session->source);
+    free(session->output);
+    free(session->smoothed);
+    free(session->sdf);
+    free(session->band);
+    free(session);
+}
+
+const uint8_t* sticker_session_pixels(const StickerSession* session) {
+    return session ? session->output : NULL;
+}
+
+MaskProcessorResult sticker_session_set_border_color(
+    StickerSession* session,
+    RGBColor border_color
+) {
+    const MaskStageTimer timer = mask_stage_enter(MASK_STAGE_SESSION, 0);
+    if (!session) {
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_INVALID_PARAMS);
+    }
+    return mask_stage_leave(
+        timer, restyle(session, session->add_border, border_color, session->border_width));
+}
+
+MaskProcessorResult sticker_session_set_border_width(
+    StickerSession* session,
+    float border_width
+) {
+    const MaskStageTimer timer = mask_stage_enter(MASK_STAGE_SESSION, 0);
+    if (!session || !(border_width >= 0.0f)) {
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_INVALID_PARAMS);
+    }
+    return mask_stage_leave(
+        timer, restyle(session, session->add_border, session->border_color, border_width));
+}
+
+MaskProcessorResult sticker_session_set_add_border(
+    StickerSession* session,
+    int add_border
+) {
+    const MaskStageTimer timer = mask_stage_enter(MASK_STAGE_SESSION, 0);
+    if (!session) {
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_INVALID_PARAMS);
+    }
+    return mask_stage_leave(
+        timer, restyle(session, add_border != 0, session->border_color, session->border_width));
+}
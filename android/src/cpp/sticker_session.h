@@ -0,0 +1,114 @@
+#ifndef STICKER_SESSION_H
+#define STICKER_SESSION_H
+
+#include "mask_processor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Sticker with a border style that can be changed in place
+ *
+ * Created from the source pixels and raw mask, a session keeps a copy of
+ * the source, the smoothed mask, its signed distance field and the
+ * composited RGBA output. Changing the border color, width or visibility
+ * then rewrites only the background pixels whose border coverage can
+ * change, found from an index of background pixels by distance to the
+ * mask. Foreground and edge pixels are never touched again.
+ *
+ * The output always equals apply_sticker_mask_sdf_to_native on the
+ * smoothed mask with the current style.
+ */
+typedef struct StickerSession StickerSession;
+
+/**
+ * Smooth the mask, compute its distance field and composite the sticker
+ *
+ * @param session Receives the session, NULL on failure
+ * @param src Source RGBA pixel data (copied)
+ * @param mask Raw mask values (0.0-1.0)
+ * @param width Image width
+ * @param height Image height
+ * @param kernel_size Blur kernel size (1 for no smoothing)
+ * @param add_border Whether to add border
+ * @param border_color Border color RGB
+ * @param border_width Border width in pixels (fractional widths allowed)
+ * @return Result code
+ */
+MaskProcessorResult sticker_session_create(
+    StickerSession** session,
+    const uint8_t* src,
+    const double* mask,
+    int width,
+    int height,
+    int kernel_size,
+    int add_border,
+    RGBColor border_color,
+    float border_width
+);
+
+/**
+ * Destroy a session and free its buffers
+ *
+ * @param session Session to destroy (may be NULL)
+ */
+void sticker_session_destroy(StickerSession* session);
+
+/**
+ * Composited RGBA output, width * height * 4 bytes
+ *
+ * Updated in place by the setters; valid until the session is destroyed.
+ *
+ * @param session Session
+ * @return Output pixels
+ */
+const uint8_t* sticker_session_pixels(const StickerSession* session);
+
+/**
+ * Change the border color
+ *
+ * Rewrites only the pixels currently covered by the border.
+ *
+ * @param session Session
+ * @param border_color Border color RGB
+ * @return Result code
+ */
+MaskProcessorResult sticker_session_set_border_color(
+    StickerSession* session,
+    RGBColor border_color
+);
+
+/**
+ * Change the border width
+ *
+ * Rewrites only the pixels between the old and new border contours.
+ *
+ * @param session Session
+ * @param border_width Border width in pixels (fractional widths allowed)
+ * @return Result code
+ */
+MaskProcessorResult sticker_session_set_border_width(
+    StickerSession* session,
+    float border_width
+);
+
+/**
+ * Show or hide the border
+ *
+ * Rewrites only the pixels covered by the border.
+ *
+ * @param session Session
+ * @param add_border Whether to add border
+ * @return Result code
+ */
+MaskProcessorResult sticker_session_set_add_border(
+    StickerSession* session,
+    int add_border
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STICKER_SESSION_H
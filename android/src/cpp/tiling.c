@@ -0,0 +1,119 @@
+#include "tiling.h"
+#include "cpu_features.h"
+#include "thread_pool.h"
+#include "scratch_arena.h"
+#include <math.h>
+#include <stdlib.h>
+
+// Tiles shorter than this spend more time on halo rows than on their core
+#define MIN_TILE_ROWS 16
+
+static int tiling_enabled = 1;
+// Explicit override, or 0 to use the detected size
+static size_t cache_size_override = 0;
+static size_t detected_cache_size = 0;
+
+void mask_processor_set_tiling(int enabled) {
+    tiling_enabled = enabled != 0;
+}
+
+void mask_processor_set_cache_size(size_t bytes) {
+    cache_size_override = bytes;
+}
+
+size_t mask_processor_get_cache_size(void) {
+    if (cache_size_override) {
+        return cache_size_override;
+    }
+    if (!detected_cache_size) {
+        detected_cache_size = cpu_l2_cache_bytes();
+    }
+    return detected_cache_size;
+}
+
+void mask_tile_plan(MaskTilePlan* plan, int width, int height, int halo, size_t bytes_per_pixel) {
+    // Half the cache for the tile, the rest for the output stream and
+    // whatever else the core is running
+    const double budget = (double)mask_processor_get_cache_size() / 2 / bytes_per_pixel;
+
+    // Square-ish core with (side + 2 * halo)^2 pixels within budget
+    int tile_width = (int)sqrt(budget) - 2 * halo;
+    tile_width -= tile_width % MASK_TILE_ALIGN;
+    if (tile_width < MASK_TILE_ALIGN) tile_width = MASK_TILE_ALIGN;
+    if (tile_width > width) tile_width = width;
+
+    int tile_height = (int)(budget / (tile_width + 2 * halo)) - 2 * halo;
+    if (tile_height < MIN_TILE_ROWS) tile_height = MIN_TILE_ROWS;
+    if (tile_height > height) tile_height = height;
+
+    plan->width = width;
+    plan->height = height;
+    plan->halo = halo;
+    plan->tile_width = tile_width;
+    plan->tile_height = tile_height;
+    plan->columns = (width + tile_width - 1) / tile_width;
+    plan->rows = (height + tile_height - 1) / tile_height;
+}
+
+double mask_tile_overhead(const MaskTilePlan* plan) {
+    const double with_halo = (double)(plan->tile_width + 2 * plan->halo) *
+                             (plan->tile_height + 2 * plan->halo);
+    return with_halo / ((double)plan->tile_width * plan->tile_height);
+}
+
+int mask_tile_worthwhile(const MaskTilePlan* plan) {
+    return tiling_enabled &&
+           plan->columns * plan->rows > 1 &&
+           mask_tile_overhead(plan) <= MASK_TILE_MAX_OVERHEAD;
+}
+
+typedef struct {
+    const MaskTilePlan* plan;
+    size_t scratch_bytes;
+    MaskTileFn fn;
+    void* context;
+    int result;
+} TileJob;
+
+static void tile_band(void* context, int begin, int end) {
+    TileJob* job = (TileJob*)context;
+    const MaskTilePlan* plan = job->plan;
+
+    void* scratch = NULL;
+    if (job->scratch_bytes) {
+        scratch = mask_scratch_alloc(job->scratch_bytes);
+        if (!scratch) {
+            __atomic_store_n(&job->result, MASK_PROCESSOR_ERROR_MEMORY, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+
+    for (int index = begin; index < end; index++) {
+        const int row = index / plan->columns;
+        const int column = index % plan->columns;
+
+        MaskTile tile;
+        tile.x0 = column * plan->tile_width;
+        tile.y0 = row * plan->tile_height;
+        tile.x1 = tile.x0 + plan->tile_width < plan->width ? tile.x0 + plan->tile_width : plan->width;
+        tile.y1 = tile.y0 + plan->tile_height < plan->height ? tile.y0 + plan->tile_height : plan->height;
+        job->fn(job->context, &tile, scratch);
+    }
+
+    mask_scratch_free(scratch);
+}
+
+MaskProcessorResult mask_parallel_tiles(
+    const MaskTilePlan* plan,
+    size_t scratch_bytes,
+    MaskTileFn fn,
+    void* context
+) {
+    if (!plan || !fn) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+
+    TileJob job = { plan, scratch_bytes, fn, context, MASK_PROCESSOR_SUCCESS };
+    const MaskProcessorResult result = mask_parallel_for(plan->columns * plan->rows, 1, tile_band, &job);
+    return result != MASK_PROCESSOR_SUCCESS ? result : (MaskProcessorResult)job.result;
+}
@@ -1,6 +1,9 @@
+import 'dart:async';
+import 'dart:io';
 import 'dart:math' as math;
 
 import 'package:flutter/foundation.dart';
+import 'package:flutter_sticker_maker/flutter_sticker_maker.dart';
 import 'package:flutter_sticker_maker/src/native_mask_processor.dart';
 import 'package:flutter_test/flutter_test.dart';
 import 'package:integration_test/integration_test.dart';
@@ -19,6 +22,10 @@ void main() {
 
   setUpAll(() {
     NativeMaskProcessor.initialize();
+    debugPrint(
+      'Native kernels: ${MaskProcessorIsa.name(NativeMaskProcessor.activeIsa)}, '
+      '${NativeMaskProcessor.threadCount} threads',
+    );
   });
 
   group('Native mask processor benchmarks (integration)', () {
@@ -168,6 +175,1337 @@ void main() {
       });
     }
 
+    for (final size in const [1024, 2048, StickerDefaults.maxImageSize]) {
+      testWidgets('SIMD vs scalar mask application (${size}x$size)', (
+        tester,
+      ) async {
+        if (!NativeMaskProcessor.isAvailable) {
+          debugPrint(
+            'Native processor not available, skipping performance test',
+          );
+          return;
+        }
+
+        final pixelCount = size * size;
+        final mask = Float64List(pixelCount);
+        final expandedMask = Float64List(pixelCount);
+        final radius = size / 3;
+        for (var i = 0; i < pixelCount; i++) {
+          final dx = i % size - size / 2;
+          final dy = i ~/ size - size / 2;
+          final distance = math.sqrt(dx * dx + dy * dy);
+          mask[i] = math.max(0.0, 1.0 - distance / radius);
+          expandedMask[i] = distance < radius * 1.1 ? 1.0 : 0.0;
+        }
+
+        final scalarPixels = Uint8List(pixelCount * 4);
+        for (var i = 0; i < scalarPixels.length; i++) {
+          scalarPixels[i] = i % 256;
+        }
+        final simdPixels = Uint8List.fromList(scalarPixels);
+
+        final scalarStopwatch = Stopwatch()..start();
+        final scalarResult = NativeMaskProcessor.applyStickerMaskScalar(
+          scalarPixels,
+          mask,
+          size,
+          size,
+          true,
+          const [255, 255, 255],
+          8,
+          expandedMask,
+        );
+        scalarStopwatch.stop();
+
+        final simdStopwatch = Stopwatch()..start();
+        final simdResult = NativeMaskProcessor.applyStickerMask(
+          simdPixels,
+          mask,
+          size,
+          size,
+          true,
+          const [255, 255, 255],
+          8,
+          expandedMask,
+        );
+        simdStopwatch.stop();
+
+        expect(scalarResult, equals(MaskProcessorResult.success));
+        expect(simdResult, equals(MaskProcessorResult.success));
+        expect(listEquals(simdPixels, scalarPixels), isTrue);
+
+        debugPrint(
+          'Scalar apply mask (${size}x$size): ${scalarStopwatch.elapsedMicroseconds}μs',
+        );
+        debugPrint(
+          'SIMD apply mask (${size}x$size): ${simdStopwatch.elapsedMicroseconds}μs',
+        );
+        debugPrint(
+          'Measured speedup: ${(scalarStopwatch.elapsedMicroseconds / simdStopwatch.elapsedMicroseconds).toStringAsFixed(2)}x',
+        );
+      });
+    }
+
+    testWidgets('Mask smoothing kernel size sweep (1024x1024)', (
+      tester,
+    ) async {
+      if (!NativeMaskProcessor.isAvailable) {
+        debugPrint('Native processor not available, skipping performance test');
+        return;
+      }
+
+      const size = 1024;
+      const pixelCount = size * size;
+      final random = math.Random(42);
+      final mask = Float64List.fromList(
+        List<double>.generate(pixelCount, (_) => random.nextDouble()),
+      );
+      final output = Float64List(pixelCount);
+
+      for (final kernelSize in const [3, 7, 15, 31, 63]) {
+        final stopwatch = Stopwatch()..start();
+        final result = NativeMaskProcessor.smoothMask(
+          mask,
+          output,
+          size,
+          size,
+          kernelSize,
+        );
+        stopwatch.stop();
+
+        expect(result, equals(MaskProcessorResult.success));
+        debugPrint(
+          'Native smooth mask (${size}x$size, kernel $kernelSize): ${stopwatch.elapsedMicroseconds}μs',
+        );
+      }
+    });
+
+    testWidgets('Mask expansion border width sweep (1024x1024)', (
+      tester,
+    ) async {
+      if (!NativeMaskProcessor.isAvailable) {
+        debugPrint('Native processor not available, skipping performance test');
+        return;
+      }
+
+      const size = 1024;
+      const pixelCount = size * size;
+      final mask = Float64List(pixelCount);
+      for (var i = 0; i < pixelCount; i++) {
+        final dx = i % size - size / 2;
+        final dy = i ~/ size - size / 2;
+        mask[i] = dx * dx + dy * dy < size * size / 9 ? 1.0 : 0.0;
+      }
+      final output = Float64List(pixelCount);
+
+      for (final borderWidth in const [1, 4, 12, 25, 50]) {
+        final stopwatch = Stopwatch()..start();
+        final result = NativeMaskProcessor.expandMask(
+          mask,
+          output,
+          size,
+          size,
+          borderWidth,
+        );
+        stopwatch.stop();
+
+        expect(result, equals(MaskProcessorResult.success));
+        debugPrint(
+          'Native expand mask (${size}x$size, border $borderWidth): ${stopwatch.elapsedMicroseconds}μs',
+        );
+      }
+    });
+
+    testWidgets('Staged vs zero-copy marshaling (${StickerDefaults.maxImageSize}x${StickerDefaults.maxImageSize})', (
+      tester,
+    ) async {
+      if (!NativeMaskProcessor.isAvailable) {
+        debugPrint('Native processor not available, skipping performance test');
+        return;
+      }
+
+      const size = StickerDefaults.maxImageSize;
+      const pixelCount = size * size;
+      final source = Uint8List(pixelCount * 4);
+      for (var i = 0; i < source.length; i++) {
+        source[i] = i % 256;
+      }
+      final mask = Float64List(pixelCount);
+      for (var i = 0; i < pixelCount; i++) {
+        mask[i] = (i % size) < size / 2 ? 1.0 : 0.0;
+      }
+
+      // Dart heap buffers are staged through temporary native memory
+      final stagedPixels = Uint8List.fromList(source);
+      final stagedStopwatch = Stopwatch()..start();
+      final stagedResult = NativeMaskProcessor.applyStickerMask(
+        stagedPixels,
+        mask,
+        size,
+        size,
+        false,
+        const [255, 255, 255],
+        0,
+        null,
+      );
+      stagedStopwatch.stop();
+
+      // Native-owned buffers are passed straight through, out of place
+      final nativeSource = NativeMaskProcessor.allocateUint8(source.length)
+        ..setAll(0, source);
+      final nativeMask = NativeMaskProcessor.allocateFloat64(pixelCount)
+        ..setAll(0, mask);
+      final nativePixels = NativeMaskProcessor.allocateUint8(source.length);
+      final zeroCopyStopwatch = Stopwatch()..start();
+      final zeroCopyResult = NativeMaskProcessor.applyStickerMask(
+        nativePixels,
+        nativeMask,
+        size,
+        size,
+        false,
+        const [255, 255, 255],
+        0,
+        null,
+        source: nativeSource,
+      );
+      zeroCopyStopwatch.stop();
+
+      expect(stagedResult, equals(MaskProcessorResult.success));
+      expect(zeroCopyResult, equals(MaskProcessorResult.success));
+      expect(listEquals(nativePixels, stagedPixels), isTrue);
+
+      debugPrint(
+        'Staged apply mask (${size}x$size): ${stagedStopwatch.elapsedMicroseconds}μs',
+      );
+      debugPrint(
+        'Zero-copy apply mask (${size}x$size): ${zeroCopyStopwatch.elapsedMicroseconds}μs',
+      );
+    });
+
+    testWidgets('Thread scaling (${StickerDefaults.maxImageSize}x${StickerDefaults.maxImageSize})', (
+      tester,
+    ) async {
+      if (!NativeMaskProcessor.isAvailable) {
+        debugPrint('Native processor not available, skipping performance test');
+        return;
+      }
+
+      const size = StickerDefaults.maxImageSize;
+      const pixelCount = size * size;
+      final mask = NativeMaskProcessor.allocateFloat64(pixelCount);
+      final radius = size / 3;
+      for (var i = 0; i < pixelCount; i++) {
+        final dx = i % size - size / 2;
+        final dy = i ~/ size - size / 2;
+        mask[i] = math.max(0.0, 1.0 - math.sqrt(dx * dx + dy * dy) / radius);
+      }
+      final source = NativeMaskProcessor.allocateUint8(pixelCount * 4);
+      for (var i = 0; i < source.length; i++) {
+        source[i] = i % 256;
+      }
+      final smoothed = NativeMaskProcessor.allocateFloat64(pixelCount);
+      final expanded = NativeMaskProcessor.allocateFloat64(pixelCount);
+      final pixels = NativeMaskProcessor.allocateUint8(pixelCount * 4);
+
+      // 1, 2, 4, ... up to the default (one per CPU)
+      final maxThreads = NativeMaskProcessor.threadCount;
+      final threadCounts = {
+        for (var t = 1; t < maxThreads; t *= 2) t,
+        maxThreads,
+      };
+      Uint8List? reference;
+
+      try {
+        for (final threads in threadCounts) {
+          expect(
+            NativeMaskProcessor.setThreadCount(threads),
+            equals(MaskProcessorResult.success),
+          );
+
+          final stopwatch = Stopwatch()..start();
+          NativeMaskProcessor.smoothMask(mask, smoothed, size, size, 3);
+          final smoothUs = stopwatch.elapsedMicroseconds;
+          NativeMaskProcessor.expandMask(smoothed, expanded, size, size, 12);
+          final expandUs = stopwatch.elapsedMicroseconds - smoothUs;
+          NativeMaskProcessor.applyStickerMask(
+            pixels,
+            smoothed,
+            size,
+            size,
+            true,
+            const [255, 255, 255],
+            12,
+            expanded,
+            source: source,
+          );
+          stopwatch.stop();
+          final applyUs = stopwatch.elapsedMicroseconds - smoothUs - expandUs;
+
+          // Every thread count must produce the same image
+          reference ??= Uint8List.fromList(pixels);
+          expect(listEquals(pixels, reference), isTrue);
+
+          debugPrint(
+            '$threads threads: smooth ${smoothUs}μs, expand ${expandUs}μs, '
+            'apply ${applyUs}μs',
+          );
+        }
+      } finally {
+        NativeMaskProcessor.setThreadCount(0);
+      }
+    });
+
+    testWidgets('Fused vs separate pipeline (${StickerDefaults.maxImageSize}x${StickerDefaults.maxImageSize})', (
+      tester,
+    ) async {
+      if (!NativeMaskProcessor.isAvailable) {
+        debugPrint('Native processor not available, skipping performance test');
+        return;
+      }
+
+      const size = StickerDefaults.maxImageSize;
+      const pixelCount = size * size;
+      final mask = NativeMaskProcessor.allocateFloat64(pixelCount);
+      final radius = size / 3;
+      for (var i = 0; i < pixelCount; i++) {
+        final dx = i % size - size / 2;
+        final dy = i ~/ size - size / 2;
+        mask[i] = math.max(0.0, 1.0 - math.sqrt(dx * dx + dy * dy) / radius);
+      }
+      final source = NativeMaskProcessor.allocateUint8(pixelCount * 4);
+      for (var i = 0; i < source.length; i++) {
+        source[i] = i % 256;
+      }
+      final smoothed = NativeMaskProcessor.allocateFloat64(pixelCount);
+      final expanded = NativeMaskProcessor.allocateFloat64(pixelCount);
+      final separatePixels = NativeMaskProcessor.allocateUint8(pixelCount * 4);
+      final fusedPixels = NativeMaskProcessor.allocateUint8(pixelCount * 4);
+
+      final separateStopwatch = Stopwatch()..start();
+      NativeMaskProcessor.smoothMask(mask, smoothed, size, size, 3);
+      NativeMaskProcessor.expandMask(smoothed, expanded, size, size, 12);
+      NativeMaskProcessor.applyStickerMask(
+        separatePixels,
+        smoothed,
+        size,
+        size,
+        true,
+        const [255, 255, 255],
+        12,
+        expanded,
+        source: source,
+      );
+      separateStopwatch.stop();
+
+      final fusedStopwatch = Stopwatch()..start();
+      final fusedResult = NativeMaskProcessor.makeStickerMaskFused(
+        fusedPixels,
+        mask,
+        size,
+        size,
+        3,
+        true,
+        const [255, 255, 255],
+        12,
+        source: source,
+      );
+      fusedStopwatch.stop();
+
+      expect(fusedResult, equals(MaskProcessorResult.success));
+      // The scalar smoothMask uses running sums, which round differently
+      if (NativeMaskProcessor.activeIsa != MaskProcessorIsa.scalar) {
+        expect(listEquals(fusedPixels, separatePixels), isTrue);
+      }
+
+      debugPrint(
+        'Separate smooth/expand/apply (${size}x$size): ${separateStopwatch.elapsedMicroseconds}μs',
+      );
+      debugPrint(
+        'Fused pipeline (${size}x$size): ${fusedStopwatch.elapsedMicroseconds}μs',
+      );
+    });
+
+    testWidgets('Tiled vs untiled kernels (${StickerDefaults.maxImageSize}x${StickerDefaults.maxImageSize})', (
+      tester,
+    ) async {
+      if (!NativeMaskProcessor.isAvailable) {
+        debugPrint('Native processor not available, skipping performance test');
+        return;
+      }
+
+      const size = StickerDefaults.maxImageSize;
+      const pixelCount = size * size;
+      final mask = NativeMaskProcessor.allocateFloat64(pixelCount);
+      final radius = size / 3;
+      for (var i = 0; i < pixelCount; i++) {
+        final dx = i % size - size / 2;
+        final dy = i ~/ size - size / 2;
+        mask[i] = math.max(0.0, 1.0 - math.sqrt(dx * dx + dy * dy) / radius);
+      }
+      final untiled = NativeMaskProcessor.allocateFloat64(pixelCount);
+      final tiled = NativeMaskProcessor.allocateFloat64(pixelCount);
+
+      // Perf counters only see the calling thread
+      NativeMaskProcessor.setThreadCount(1);
+      debugPrint('Tile cache size: ${NativeMaskProcessor.cacheSize} bytes');
+
+      String measure(String label, void Function() run) {
+        final counting = NativeMaskProcessor.startPerfCounters();
+        final stopwatch = Stopwatch()..start();
+        run();
+        stopwatch.stop();
+        final counters = counting ? NativeMaskProcessor.stopPerfCounters() : null;
+        final misses = counters == null
+            ? 'no perf counters'
+            : 'cache misses ${counters['cacheMisses']}, '
+                'L1D read misses ${counters['l1dReadMisses']}';
+        return '$label: ${stopwatch.elapsedMicroseconds}μs, $misses';
+      }
+
+      try {
+        for (final tiling in [false, true]) {
+          NativeMaskProcessor.setTiling(tiling);
+          final output = tiling ? tiled : untiled;
+          final name = tiling ? 'tiled' : 'untiled';
+          debugPrint(
+            measure(
+              'Smooth k=3 $name',
+              () => NativeMaskProcessor.smoothMask(mask, output, size, size, 3),
+            ),
+          );
+        }
+        expect(listEquals(tiled, untiled), isTrue);
+
+        for (final tiling in [false, true]) {
+          NativeMaskProcessor.setTiling(tiling);
+          final output = tiling ? tiled : untiled;
+          final name = tiling ? 'tiled' : 'untiled';
+          debugPrint(
+            measure(
+              'Expand border 12 $name',
+              () => NativeMaskProcessor.expandMask(mask, output, size, size, 12),
+            ),
+          );
+        }
+        expect(listEquals(tiled, untiled), isTrue);
+      } finally {
+        NativeMaskProcessor.setTiling(true);
+        NativeMaskProcessor.setThreadCount(0);
+      }
+    });
+
+    testWidgets('Streamed vs fused pipeline (${StickerDefaults.maxImageSize}x${StickerDefaults.maxImageSize})', (
+      tester,
+    ) async {
+      if (!NativeMaskProcessor.isAvailable) {
+        debugPrint('Native processor not available, skipping performance test');
+        return;
+      }
+
+      const size = StickerDefaults.maxImageSize;
+      const pixelCount = size * size;
+      const bandRows = 64;
+      final mask = NativeMaskProcessor.allocateFloat64(pixelCount);
+      final radius = size / 3;
+      for (var i = 0; i < pixelCount; i++) {
+        final dx = i % size - size / 2;
+        final dy = i ~/ size - size / 2;
+        mask[i] = math.max(0.0, 1.0 - math.sqrt(dx * dx + dy * dy) / radius);
+      }
+      final source = NativeMaskProcessor.allocateUint8(pixelCount * 4);
+      for (var i = 0; i < source.length; i++) {
+        source[i] = i % 256;
+      }
+      final fusedPixels = NativeMaskProcessor.allocateUint8(pixelCount * 4);
+      final streamedPixels = Uint8List(pixelCount * 4);
+
+      final fusedStopwatch = Stopwatch()..start();
+      final fusedResult = NativeMaskProcessor.makeStickerMaskFused(
+        fusedPixels,
+        mask,
+        size,
+        size,
+        3,
+        true,
+        const [255, 255, 255],
+        12,
+        source: source,
+      );
+      fusedStopwatch.stop();
+      expect(fusedResult, equals(MaskProcessorResult.success));
+
+      final streamStopwatch = Stopwatch()..start();
+      final stream = NativeStickerStream.create(
+        size,
+        size,
+        3,
+        true,
+        const [255, 255, 255],
+        12,
+      )!;
+      var written = 0;
+      for (var y = 0; y < size; y += bandRows) {
+        final rows = math.min(bandRows, size - y);
+        final finished = stream.push(
+          Uint8List.sublistView(source, y * size * 4, (y + rows) * size * 4),
+          Float64List.sublistView(mask, y * size, (y + rows) * size),
+        )!;
+        streamedPixels.setAll(written, finished);
+        written += finished.length;
+      }
+      stream.dispose();
+      streamStopwatch.stop();
+
+      expect(written, equals(streamedPixels.length));
+      expect(listEquals(streamedPixels, fusedPixels), isTrue);
+
+      debugPrint(
+        'Fused pipeline (${size}x$size): ${fusedStopwatch.elapsedMicroseconds}μs',
+      );
+      debugPrint(
+        'Streamed pipeline, $bandRows-row pushes (lag ${stream.lag}): ${streamStopwatch.elapsedMicroseconds}μs',
+      );
+    });
+
+    testWidgets('Native RGBA to NCHW preprocessing', (tester) async {
+      if (!NativeMaskProcessor.isAvailable) {
+        debugPrint('Native processor not available, skipping performance test');
+        return;
+      }
+
+      const modelInputSize = 320;
+      const mean = [0.485, 0.456, 0.406];
+      const invStd = [1.0 / 0.229, 1.0 / 0.224, 1.0 / 0.225];
+      final tensor = NativeMaskProcessor.allocateFloat32(
+        3 * modelInputSize * modelInputSize,
+      );
+
+      for (final size in const [
+        [1024, 1024],
+        [4032, 3024],
+      ]) {
+        final width = size[0];
+        final height = size[1];
+        final pixels = NativeMaskProcessor.allocateUint8(width * height * 4);
+        for (var i = 0; i < pixels.length; i += 4) {
+          pixels[i] = 200;
+          pixels[i + 1] = 100;
+          pixels[i + 2] = 50;
+          pixels[i + 3] = 255;
+        }
+
+        final stopwatch = Stopwatch()..start();
+        final result = NativeMaskProcessor.resizeRgbaToNchw(
+          pixels,
+          width,
+          height,
+          tensor,
+          modelInputSize,
+          modelInputSize,
+          mean,
+          invStd,
+        );
+        stopwatch.stop();
+
+        expect(result, equals(MaskProcessorResult.success));
+        // A flat image stays flat after area resampling
+        const plane = modelInputSize * modelInputSize;
+        const channels = [200, 100, 50];
+        for (var c = 0; c < 3; c++) {
+          final expected = (channels[c] / 255.0 - mean[c]) * invStd[c];
+          expect(tensor[c * plane], closeTo(expected, 1e-4));
+          expect(tensor[c * plane + plane - 1], closeTo(expected, 1e-4));
+        }
+
+        debugPrint(
+          'RGBA ${width}x$height -> NCHW ${modelInputSize}x$modelInputSize: ${stopwatch.elapsedMicroseconds}μs',
+        );
+      }
+    });
+
+    testWidgets('Native mask upsampling', (tester) async {
+      if (!NativeMaskProcessor.isAvailable) {
+        debugPrint('Native processor not available, skipping performance test');
+        return;
+      }
+
+      const tensorSize = 320;
+      final tensor = NativeMaskProcessor.allocateFloat32(
+        tensorSize * tensorSize,
+      );
+      for (var i = 0; i < tensor.length; i++) {
+        tensor[i] = (i % tensorSize) / (tensorSize - 1);
+      }
+
+      for (final size in const [
+        [1024, 1024],
+        [4032, 3024],
+      ]) {
+        final width = size[0];
+        final height = size[1];
+        final mask = NativeMaskProcessor.allocateFloat64(width * height);
+
+        final stopwatch = Stopwatch()..start();
+        final result = NativeMaskProcessor.upsampleMask(
+          tensor,
+          tensorSize,
+          tensorSize,
+          mask,
+          width,
+          height,
+        );
+        stopwatch.stop();
+
+        expect(result, equals(MaskProcessorResult.success));
+        // Bilinear sampling at x * 320 / width of a horizontal ramp
+        final x = width ~/ 3;
+        final srcX = x * tensorSize / width;
+        final x1 = srcX.floor();
+        final expected =
+            (x1 + (srcX - x1) * (math.min(x1 + 1, tensorSize - 1) - x1)) /
+            (tensorSize - 1);
+        expect(mask[(height ~/ 2) * width + x], closeTo(expected, 1e-6));
+
+        debugPrint(
+          'Upsample ${tensorSize}x$tensorSize -> ${width}x$height: ${stopwatch.elapsedMicroseconds}μs',
+        );
+      }
+    });
+
+    testWidgets('Native content hash', (tester) async {
+      if (!NativeMaskProcessor.isAvailable) {
+        debugPrint('Native processor not available, skipping performance test');
+        return;
+      }
+
+      const width = 4032;
+      const height = 3024;
+      final pixels = NativeMaskProcessor.allocateUint8(width * height * 4);
+      for (var i = 0; i < pixels.length; i++) {
+        pixels[i] = (i * 31) & 0xFF;
+      }
+
+      final stopwatch = Stopwatch()..start();
+      final hash = NativeMaskProcessor.contentHash(pixels);
+      stopwatch.stop();
+
+      expect(hash, isNotNull);
+      expect(hash!.length, equals(32));
+      expect(NativeMaskProcessor.contentHash(pixels), equals(hash));
+      expect(NativeMaskProcessor.contentHash(pixels, seed: 1), isNot(hash));
+
+      // A single changed byte anywhere changes the hash
+      pixels[pixels.length ~/ 2] ^= 1;
+      expect(NativeMaskProcessor.contentHash(pixels), isNot(hash));
+      pixels[pixels.length ~/ 2] ^= 1;
+
+      final megabytes = pixels.length / (1024 * 1024);
+      debugPrint(
+        'Content hash ${width}x$height (${megabytes.toStringAsFixed(1)} MB): ${stopwatch.elapsedMicroseconds}μs',
+      );
+    });
+
+    testWidgets('Persistent mask cache', (tester) async {
+      if (!NativeMaskProcessor.isAvailable) {
+        debugPrint('Native processor not available, skipping performance test');
+        return;
+      }
+
+      const width = 2048;
+      const height = 1536;
+      final mask = NativeMaskProcessor.allocateFloat64(width * height);
+      for (var y = 0; y < height; y++) {
+        for (var x = 0; x < width; x++) {
+          final dx = x - width / 2;
+          final dy = y - height / 2;
+          final d = math.sqrt(dx * dx + dy * dy);
+          mask[y * width + x] = (1.0 - (d - 600) / 8).clamp(0.0, 1.0);
+        }
+      }
+      final key = NativeMaskProcessor.contentHash128(
+        Uint8List.fromList([1, 2, 3]),
+      )!;
+
+      final directory = Directory.systemTemp.createTempSync('mask_cache');
+      try {
+        var cache = NativeMaskCache.open(directory.path, maxBytes: 16 << 20)!;
+        final putWatch = Stopwatch()..start();
+        expect(
+          cache.put(key, mask, width, height),
+          equals(MaskProcessorResult.success),
+        );
+        putWatch.stop();
+        final stored = cache.usage.bytes;
+        cache.close();
+
+        // Reopening finds the mask without recomputing it
+        cache = NativeMaskCache.open(directory.path, maxBytes: 16 << 20)!;
+        final getWatch = Stopwatch()..start();
+        final cached = cache.get(key, width, height);
+        getWatch.stop();
+        cache.close();
+
+        expect(cached, isNotNull);
+        var maxError = 0.0;
+        for (var i = 0; i < mask.length; i++) {
+          maxError = math.max(maxError, (cached![i] - mask[i]).abs());
+        }
+        expect(maxError, lessThanOrEqualTo(0.5 / 255 + 1e-12));
+
+        // An async put only queues the work; closing with it in flight
+        // waits for it instead of pulling the files out from under it
+        final asyncKey = (low: key.low ^ 1, high: key.high);
+        cache = NativeMaskCache.open(directory.path, maxBytes: 16 << 20)!;
+        final submitWatch = Stopwatch()..start();
+        final pending = cache.putAsync(asyncKey, mask, width, height);
+        submitWatch.stop();
+        cache.close();
+        expect(await pending, equals(MaskProcessorResult.success));
+        cache = NativeMaskCache.open(directory.path, maxBytes: 16 << 20)!;
+        expect(cache.get(asyncKey, width, height), isNotNull);
+        cache.close();
+
+        debugPrint(
+          'Mask cache ${width}x$height: put ${putWatch.elapsedMicroseconds}μs '
+          '(${submitWatch.elapsedMicroseconds}μs on the caller when async), '
+          'get ${getWatch.elapsedMicroseconds}μs, '
+          '$stored bytes stored (${(mask.length * 8 / stored).toStringAsFixed(0)}x smaller)',
+        );
+      } finally {
+        directory.deleteSync(recursive: true);
+      }
+    });
+
+    testWidgets('Sticker session restyle vs SDF recomposite', (tester) async {
+      if (!NativeMaskProcessor.isAvailable) {
+        debugPrint('Native processor not available, skipping performance test');
+        return;
+      }
+
+      const width = 2048;
+      const height = 1536;
+      final pixels = NativeMaskProcessor.allocateUint8(width * height * 4);
+      final mask = NativeMaskProcessor.allocateFloat64(width * height);
+      final random = math.Random(42);
+      for (var i = 0; i < pixels.length; i++) {
+        pixels[i] = random.nextInt(256);
+      }
+      for (var y = 0; y < height; y++) {
+        for (var x = 0; x < width; x++) {
+          final dx = x - width / 2;
+          final dy = y - height / 2;
+          mask[y * width + x] = math.sqrt(dx * dx + dy * dy) < 500 ? 1.0 : 0.0;
+        }
+      }
+
+      final session = NativeStickerSession.create(
+        pixels,
+        mask,
+        width,
+        height,
+        3,
+        true,
+        [255, 255, 255],
+        12.0,
+      )!;
+
+      // Reference: smooth once, then a full SDF composite per style
+      final smoothed = NativeMaskProcessor.allocateFloat64(width * height);
+      final sdf = NativeMaskProcessor.allocateFloat32(width * height);
+      NativeMaskProcessor.smoothMask(mask, smoothed, width, height, 3);
+      NativeMaskProcessor.computeMaskSdf(smoothed, sdf, width, height);
+      final reference = NativeMaskProcessor.allocateUint8(width * height * 4);
+
+      const styles = 20;
+      final sessionWatch = Stopwatch();
+      final fullWatch = Stopwatch();
+      for (var i = 0; i < styles; i++) {
+        final color = [i * 12, 255 - i * 12, 128];
+        final borderWidth = 4.0 + i * 1.5;
+        final addBorder = i % 5 != 4;
+
+        sessionWatch.start();
+        session.setAddBorder(addBorder);
+        session.setBorderColor(color);
+        session.setBorderWidth(borderWidth);
+        sessionWatch.stop();
+
+        fullWatch.start();
+        NativeMaskProcessor.applyStickerMaskSdf(
+          reference,
+          smoothed,
+          sdf,
+          width,
+          height,
+          addBorder,
+          color,
+          borderWidth,
+          source: pixels,
+        );
+        fullWatch.stop();
+
+        expect(session.pixels, equals(reference));
+      }
+      session.dispose();
+
+      debugPrint(
+        'Restyle ${width}x$height x$styles: session ${sessionWatch.elapsedMicroseconds}μs, '
+        'full SDF composite ${fullWatch.elapsedMicroseconds}μs',
+      );
+    });
+
+    testWidgets('Processor context steady state allocations', (tester) async {
+      if (!NativeMaskProcessor.isAvailable) {
+        debugPrint('Native processor not available, skipping performance test');
+        return;
+      }
+
+      const width = 1024;
+      const height = 768;
+      const tensorSize = 320;
+      // Plain Dart lists, so every call also stages its arguments
+      final pixels = Uint8List(width * height * 4);
+      final mask = List<double>.filled(width * height, 0.0);
+      final tensor = Float32List(tensorSize * tensorSize);
+      final random = math.Random(42);
+      for (var i = 0; i < pixels.length; i++) {
+        pixels[i] = random.nextInt(256);
+      }
+      for (var y = 0; y < height; y++) {
+        for (var x = 0; x < width; x++) {
+          final dx = x - width / 2;
+          final dy = y - height / 2;
+          mask[y * width + x] = math.sqrt(dx * dx + dy * dy) < 300 ? 1.0 : 0.0;
+        }
+      }
+      for (var i = 0; i < tensor.length; i++) {
+        tensor[i] = random.nextDouble() * 8 - 4;
+      }
+
+      final context = NativeMaskProcessorContext.create()!;
+      final output = Uint8List(width * height * 4);
+      final reference = Uint8List(width * height * 4);
+      final smoothed = Float64List(width * height);
+      final sdf = Float32List(width * height);
+      final upsampled = Float64List(width * height);
+      final normalized = Float32List(3 * tensorSize * tensorSize);
+      const mean = [0.485, 0.456, 0.406];
+      const invStd = [1.0 / 0.229, 1.0 / 0.224, 1.0 / 0.225];
+
+      void sticker(NativeMaskProcessorContext? context, Uint8List output) {
+        NativeMaskProcessor.resizeRgbaToNchw(
+          pixels,
+          width,
+          height,
+          normalized,
+          tensorSize,
+          tensorSize,
+          mean,
+          invStd,
+          context: context,
+        );
+        NativeMaskProcessor.upsampleMask(
+          tensor,
+          tensorSize,
+          tensorSize,
+          upsampled,
+          width,
+          height,
+          applySigmoid: true,
+          context: context,
+        );
+        NativeMaskProcessor.smoothMask(
+          mask,
+          smoothed,
+          width,
+          height,
+          5,
+          context: context,
+        );
+        NativeMaskProcessor.computeMaskSdf(
+          smoothed,
+          sdf,
+          width,
+          height,
+          context: context,
+        );
+        expect(
+          NativeMaskProcessor.makeStickerMaskFused(
+            output,
+            mask,
+            width,
+            height,
+            5,
+            true,
+            [255, 255, 255],
+            12,
+            source: pixels,
+            context: context,
+          ),
+          equals(MaskProcessorResult.success),
+        );
+      }
+
+      // Warm up: the first calls size the scratch and staging memory
+      for (var i = 0; i < 2; i++) {
+        sticker(context, output);
+      }
+      final warmAllocations = context.heapAllocations;
+
+      const runs = 10;
+      final contextWatch = Stopwatch()..start();
+      for (var i = 0; i < runs; i++) {
+        sticker(context, output);
+      }
+      contextWatch.stop();
+      final plainWatch = Stopwatch()..start();
+      for (var i = 0; i < runs; i++) {
+        sticker(null, reference);
+      }
+      plainWatch.stop();
+
+      expect(context.heapAllocations, equals(warmAllocations));
+      expect(output, equals(reference));
+
+      debugPrint(
+        'Sticker ${width}x$height x$runs: context ${contextWatch.elapsedMilliseconds}ms '
+        '(${context.heapAllocations} heap allocations, '
+        '${context.reservedBytes ~/ 1024} KB reserved), '
+        'plain ${plainWatch.elapsedMilliseconds}ms',
+      );
+
+      context.trim();
+      expect(context.reservedBytes, equals(0));
+      context.dispose();
+    });
+
+    testWidgets('Async jobs keep the event loop running (${StickerDefaults.maxImageSize}x${StickerDefaults.maxImageSize})', (
+      tester,
+    ) async {
+      if (!NativeMaskProcessor.isAvailable) {
+        debugPrint('Native processor not available, skipping performance test');
+        return;
+      }
+
+      const size = StickerDefaults.maxImageSize;
+      final pixels = NativeMaskProcessor.allocateUint8(size * size * 4);
+      final mask = NativeMaskProcessor.allocateFloat64(size * size);
+      final random = math.Random(7);
+      for (var i = 0; i < pixels.length; i++) {
+        pixels[i] = random.nextInt(256);
+      }
+      for (var y = 0; y < size; y++) {
+        for (var x = 0; x < size; x++) {
+          final dx = x - size / 2;
+          final dy = y - size / 2;
+          mask[y * size + x] =
+              math.sqrt(dx * dx + dy * dy) < size / 3 ? 1.0 : 0.0;
+        }
+      }
+
+      final reference = NativeMaskProcessor.allocateUint8(size * size * 4);
+      final syncWatch = Stopwatch()..start();
+      NativeMaskProcessor.makeStickerMaskFused(
+        reference,
+        mask,
+        size,
+        size,
+        5,
+        true,
+        [255, 255, 255],
+        12,
+        source: pixels,
+      );
+      syncWatch.stop();
+
+      await tester.runAsync(() async {
+        // Count event loop turns, and the longest stall between them, while
+        // the job runs on the native job thread
+        var ticks = 0;
+        var longestGap = 0;
+        final gapWatch = Stopwatch()..start();
+        final timer = Timer.periodic(const Duration(milliseconds: 1), (_) {
+          ticks++;
+          longestGap = math.max(longestGap, gapWatch.elapsedMilliseconds);
+          gapWatch.reset();
+        });
+
+        final output = NativeMaskProcessor.allocateUint8(size * size * 4);
+        final asyncWatch = Stopwatch()..start();
+        final result = await NativeMaskProcessor.makeStickerMaskFusedAsync(
+          output,
+          mask,
+          size,
+          size,
+          5,
+          true,
+          [255, 255, 255],
+          12,
+          source: pixels,
+        );
+        asyncWatch.stop();
+        timer.cancel();
+
+        expect(result, equals(MaskProcessorResult.success));
+        expect(output, equals(reference));
+        expect(ticks, greaterThan(0));
+
+        debugPrint(
+          'Fused ${size}x$size: sync ${syncWatch.elapsedMilliseconds}ms '
+          'blocking, async ${asyncWatch.elapsedMilliseconds}ms with $ticks '
+          'event loop ticks (longest gap ${longestGap}ms)',
+        );
+
+        // Queued jobs complete in order, with results matching the sync calls
+        final smoothed = Float64List(size * size);
+        final expected = Float64List(size * size);
+        final sdf = Float32List(size * size);
+        final expectedSdf = Float32List(size * size);
+        final results = await Future.wait([
+          NativeMaskProcessor.smoothMaskAsync(mask, smoothed, size, size, 5),
+          NativeMaskProcessor.computeMaskSdfAsync(mask, sdf, size, size),
+          NativeMaskProcessor.smoothMaskAsync(mask, smoothed, 0, size, 5),
+        ]);
+        expect(
+          results,
+          equals([
+            MaskProcessorResult.success,
+            MaskProcessorResult.success,
+            MaskProcessorResult.errorInvalidParams,
+          ]),
+        );
+        NativeMaskProcessor.smoothMask(mask, expected, size, size, 5);
+        NativeMaskProcessor.computeMaskSdf(mask, expectedSdf, size, size);
+        expect(smoothed, equals(expected));
+        expect(sdf, equals(expectedSdf));
+      });
+    });
+
+    testWidgets('Cancelling an async job frees the pool (${StickerDefaults.maxImageSize}x${StickerDefaults.maxImageSize})', (
+      tester,
+    ) async {
+      if (!NativeMaskProcessor.isAvailable) {
+        debugPrint('Native processor not available, skipping performance test');
+        return;
+      }
+
+      const size = StickerDefaults.maxImageSize;
+      final pixels = NativeMaskProcessor.allocateUint8(size * size * 4);
+      final mask = NativeMaskProcessor.allocateFloat64(size * size);
+      final random = math.Random(11);
+      for (var i = 0; i < pixels.length; i++) {
+        pixels[i] = random.nextInt(256);
+      }
+      for (var y = 0; y < size; y++) {
+        for (var x = 0; x < size; x++) {
+          final dx = x - size / 2;
+          final dy = y - size / 2;
+          mask[y * size + x] =
+              math.sqrt(dx * dx + dy * dy) < size / 3 ? 1.0 : 0.0;
+        }
+      }
+
+      await tester.runAsync(() async {
+        // Cancel once the job has made some progress
+        final output = NativeMaskProcessor.allocateUint8(size * size * 4);
+        final control = NativeJobControl();
+        final job = NativeMaskProcessor.makeStickerMaskFusedAsync(
+          output,
+          mask,
+          size,
+          size,
+          5,
+          true,
+          [255, 255, 255],
+          12,
+          source: pixels,
+          control: control,
+        );
+        final waitWatch = Stopwatch()..start();
+        while (control.progress == 0 && waitWatch.elapsedMilliseconds < 5000) {
+          await Future<void>.delayed(const Duration(milliseconds: 1));
+        }
+        final progressAtCancel = control.progress;
+        final cancelWatch = Stopwatch()..start();
+        control.cancel();
+        final result = await job;
+        cancelWatch.stop();
+
+        expect(result, equals(MaskProcessorResult.errorCancelled));
+        expect(control.progress, lessThan(1.0));
+
+        // A cancelled control refuses new jobs
+        final refused = await NativeMaskProcessor.computeMaskSdfAsync(
+          mask,
+          Float32List(size * size),
+          size,
+          size,
+          control: control,
+        );
+        expect(refused, equals(MaskProcessorResult.errorCancelled));
+
+        // The next job starts right away; progress only goes up, to 1
+        final sdf = NativeMaskProcessor.allocateFloat32(size * size);
+        final next = NativeJobControl();
+        final samples = <double>[];
+        final sampler = Timer.periodic(const Duration(milliseconds: 1), (_) {
+          samples.add(next.progress);
+        });
+        final nextWatch = Stopwatch()..start();
+        final nextResult = await NativeMaskProcessor.computeMaskSdfAsync(
+          mask,
+          sdf,
+          size,
+          size,
+          control: next,
+        );
+        nextWatch.stop();
+        sampler.cancel();
+
+        expect(nextResult, equals(MaskProcessorResult.success));
+        expect(next.progress, equals(1.0));
+        for (var i = 1; i < samples.length; i++) {
+          expect(samples[i], greaterThanOrEqualTo(samples[i - 1]));
+        }
+
+        final expected = Float32List(size * size);
+        NativeMaskProcessor.computeMaskSdf(mask, expected, size, size);
+        expect(sdf, equals(expected));
+
+        debugPrint(
+          'Fused ${size}x$size cancelled at '
+          '${(progressAtCancel * 100).toStringAsFixed(1)}% in '
+          '${cancelWatch.elapsedMicroseconds / 1000}ms; next SDF job '
+          '${nextWatch.elapsedMilliseconds}ms with ${samples.length} '
+          'progress samples',
+        );
+      });
+    });
+
+    testWidgets('Batch matches per-image fused', (tester) async {
+      if (!NativeMaskProcessor.isAvailable) {
+        debugPrint('Native processor not available, skipping performance test');
+        return;
+      }
+
+      // Catalogue-sized images, plus one large enough to be split
+      final random = math.Random(42);
+      final sizes = [
+        for (var i = 0; i < 64; i++)
+          (64 + random.nextInt(448), 64 + random.nextInt(448)),
+        (1280, 960),
+      ];
+      final sources = <Uint8List>[];
+      final masks = <Float64List>[];
+      for (final (width, height) in sizes) {
+        final source = Uint8List(width * height * 4);
+        for (var i = 0; i < source.length; i++) {
+          source[i] = random.nextInt(256);
+        }
+        final mask = Float64List(width * height);
+        final radius = math.min(width, height) * 0.4;
+        for (var y = 0; y < height; y++) {
+          for (var x = 0; x < width; x++) {
+            final dx = x - width / 2;
+            final dy = y - height / 2;
+            mask[y * width + x] =
+                math.sqrt(dx * dx + dy * dy) < radius ? 1.0 : 0.0;
+          }
+        }
+        sources.add(source);
+        masks.add(mask);
+      }
+
+      List<NativeStickerBatchItem> batchItems() => [
+        for (var i = 0; i < sizes.length; i++)
+          NativeStickerBatchItem(
+            pixels: Uint8List(sources[i].length),
+            mask: masks[i],
+            width: sizes[i].$1,
+            height: sizes[i].$2,
+            source: sources[i],
+          ),
+      ];
+      const color = [255, 255, 255];
+
+      final loopWatch = Stopwatch()..start();
+      final expected = <Uint8List>[];
+      for (var i = 0; i < sizes.length; i++) {
+        final pixels = Uint8List(sources[i].length);
+        expect(
+          NativeMaskProcessor.makeStickerMaskFused(
+            pixels,
+            masks[i],
+            sizes[i].$1,
+            sizes[i].$2,
+            5,
+            true,
+            color,
+            8,
+            source: sources[i],
+          ),
+          equals(MaskProcessorResult.success),
+        );
+        expected.add(pixels);
+      }
+      loopWatch.stop();
+
+      final items = batchItems();
+      final batchWatch = Stopwatch()..start();
+      final results = NativeMaskProcessor.makeStickersBatch(
+        items,
+        5,
+        true,
+        color,
+        8,
+      );
+      batchWatch.stop();
+
+      final context = NativeMaskProcessorContext.create()!;
+      final contextItems = batchItems();
+      NativeMaskProcessor.makeStickersBatch(
+        contextItems,
+        5,
+        true,
+        color,
+        8,
+        context: context,
+      );
+      final contextWatch = Stopwatch()..start();
+      final contextResults = NativeMaskProcessor.makeStickersBatch(
+        contextItems,
+        5,
+        true,
+        color,
+        8,
+        context: context,
+      );
+      contextWatch.stop();
+      context.dispose();
+
+      for (var i = 0; i < sizes.length; i++) {
+        expect(results[i], equals(MaskProcessorResult.success));
+        expect(contextResults[i], equals(MaskProcessorResult.success));
+        expect(items[i].pixels, equals(expected[i]));
+        expect(contextItems[i].pixels, equals(expected[i]));
+      }
+
+      // An invalid image is reported without failing the rest
+      final mixed = NativeMaskProcessor.makeStickersBatch(
+        [
+          items.first,
+          NativeStickerBatchItem(
+            pixels: Uint8List(16),
+            mask: masks.first,
+            width: 2,
+            height: 2,
+          ),
+        ],
+        5,
+        true,
+        color,
+        8,
+      );
+      expect(
+        mixed,
+        equals([
+          MaskProcessorResult.success,
+          MaskProcessorResult.errorInvalidParams,
+        ]),
+      );
+
+      debugPrint(
+        'Batch of ${sizes.length}: per-image ${loopWatch.elapsedMilliseconds}ms, '
+        'batch ${batchWatch.elapsedMilliseconds}ms, '
+        'batch with context ${contextWatch.elapsedMilliseconds}ms',
+      );
+    });
+
+    testWidgets('Stage statistics', (tester) async {
+      if (!NativeMaskProcessor.isAvailable) {
+        debugPrint('Native processor not available, skipping performance test');
+        return;
+      }
+
+      const size = 256;
+      final mask = Float64List(size * size);
+      for (var y = size ~/ 4; y < size * 3 ~/ 4; y++) {
+        for (var x = size ~/ 4; x < size * 3 ~/ 4; x++) {
+          mask[y * size + x] = 1.0;
+        }
+      }
+      final smoothed = Float64List(size * size);
+      const color = [255, 255, 255];
+
+      NativeMaskProcessor.resetStats();
+      for (final stats in NativeMaskProcessor.getStats()!) {
+        expect(stats.calls, equals(0));
+      }
+
+      for (var i = 0; i < 5; i++) {
+        NativeMaskProcessor.smoothMask(mask, smoothed, size, size, 3);
+      }
+      NativeMaskProcessor.makeStickerMaskFused(
+        Uint8List(size * size * 4),
+        mask,
+        size,
+        size,
+        3,
+        true,
+        color,
+        8,
+      );
+      NativeMaskProcessor.makeStickersBatch(
+        [
+          for (var i = 0; i < 3; i++)
+            NativeStickerBatchItem(
+              pixels: Uint8List(size * size * 4),
+              mask: mask,
+              width: size,
+              height: size,
+            ),
+        ],
+        3,
+        true,
+        color,
+        8,
+      );
+      NativeMaskProcessor.recordStage(
+        MaskStage.inference,
+        const Duration(milliseconds: 3),
+      );
+
+      final stats = NativeMaskProcessor.getStats()!;
+      final smooth = stats[MaskStage.smooth];
+      expect(smooth.calls, equals(5));
+      expect(smooth.errors, equals(0));
+      expect(smooth.bytes, equals(5 * size * size * 16));
+      expect(smooth.histogram.reduce((a, b) => a + b), equals(5));
+      expect(smooth.maxTime, lessThanOrEqualTo(smooth.totalTime));
+      // The fused kernel's own smoothing and compositing are not counted
+      // again, and each image of a batch is a fused call
+      expect(stats[MaskStage.fused].calls, equals(4));
+      expect(stats[MaskStage.composite].calls, equals(0));
+      final inference = stats[MaskStage.inference];
+      expect(inference.calls, equals(1));
+      expect(inference.totalTime, equals(const Duration(milliseconds: 3)));
+      // 3000us falls in [2048us, 4096us)
+      expect(inference.histogram[11], equals(1));
+
+      for (final stage in stats.where((stage) => stage.calls > 0)) {
+        debugPrint(
+          'Stage ${stage.name}: ${stage.calls} calls, '
+          'mean ${stage.meanTime.inMicroseconds}us, '
+          'p99 <= ${stage.percentile(0.99).inMicroseconds}us, '
+          '${stage.bytes} bytes',
+        );
+      }
+
+      NativeMaskProcessor.resetStats();
+      final cleared = NativeMaskProcessor.getStats()!;
+      expect(cleared[MaskStage.smooth].calls, equals(0));
+    });
+
     testWidgets('Memory usage sanity check', (tester) async {
       if (!NativeMaskProcessor.isAvailable) {
         debugPrint('Native processor not available, skipping memory test');
@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+"""Compare two mask_benchmark --json outputs.
+
+Usage: compare_benchmarks.py BASELINE.json CANDIDATE.json [--threshold PCT]
+
+Cases are matched on kernel, size, kernel size, border width and threads.
+Prints the median ns/pixel of both runs and the change, and exits with 1
+when any case got slower by more than the threshold (default 5%).
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as file:
+        data = json.load(file)
+    cases = {}
+    for result in data["results"]:
+        key = (
+            result["kernel"],
+            result["width"],
+            result["height"],
+            result["kernel_size"],
+            result["border_width"],
+            result["threads"],
+        )
+        cases[key] = result
+    return data, cases
+
+
+def describe(key):
+    kernel, width, height, kernel_size, border_width, threads = key
+    params = []
+    if kernel_size is not None:
+        params.append(f"k={kernel_size}")
+    if border_width is not None:
+        params.append(f"b={border_width}")
+    return f"{kernel:<16} {width:>5}x{height:<5} {' '.join(params):<10} t={threads:<2}"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("baseline")
+    parser.add_argument("candidate")
+    parser.add_argument(
+        "--threshold",
+        type=float,
+        default=5.0,
+        help="slowdown in percent reported as a regression",
+    )
+    args = parser.parse_args()
+
+    baseline_data, baseline = load(args.baseline)
+    candidate_data, candidate = load(args.candidate)
+    for name, data in (("baseline", baseline_data), ("candidate", candidate_data)):
+        print(f"{name}: {data.get('label') or '-'} ({data['isa']}, {data['timestamp']})")
+    if baseline_data["isa"] != candidate_data["isa"]:
+        print("warning: the runs used different instruction sets")
+
+    regressions = 0
+    for key in sorted(baseline.keys() & candidate.keys()):
+        before = baseline[key]["ns_per_pixel"]
+        after = candidate[key]["ns_per_pixel"]
+        change = (after - before) / before * 100.0
+        flag = ""
+        if change > args.threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        elif change < -args.threshold:
+            flag = "  faster"
+        print(f"{describe(key)} {before:9.3f} -> {after:9.3f} ns/px {change:+7.1f}%{flag}")
+
+    for label, keys in (
+        ("only in baseline", baseline.keys() - candidate.keys()),
+        ("only in candidate", candidate.keys() - baseline.keys()),
+    ):
+        if keys:
+            print(f"{len(keys)} cases {label}")
+
+    if regressions:
+        print(f"{regressions} cases slower by more than {args.threshold:g}%")
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
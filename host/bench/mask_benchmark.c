@@ -0,0 +1,942 @@
+// mask_benchmark: every native kernel across image sizes, kernel sizes and
+// border widths
+//
+// Each case runs once to warm up, then repeatedly until it has run for
+// --min-time seconds and at least three times. The median run is reported
+// as ns/pixel and as GB/s over the bytes the kernel must read and write
+// (its inputs and outputs once each; scratch traffic is not counted). With
+// --json the results are also written as JSON, which compare_benchmarks.py
+// diffs between two runs.
+
+#include "bit_mask.h"
+#include "content_hash.h"
+#include "mask_processor.h"
+#include "perf_counters.h"
+#include "processor_context.h"
+#include "simd_optimizations.h"
+#include "sticker_batch.h"
+#include "sticker_pipeline.h"
+#include "sticker_session.h"
+#include "tensor_ops.h"
+#include <getopt.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Model input and output side, as in OnnxStickerProcessor
+#define MODEL_SIZE 320
+// Border width of kernels that take an expanded mask but no width
+#define FIXED_BORDER_WIDTH 12
+// Kernel size of kernels that take one but are swept over border widths
+#define FIXED_KERNEL_SIZE 3
+// Rows pushed per sticker_stream_push call
+#define STREAM_CHUNK_ROWS 64
+// Images per make_stickers_batch call: the case image cut into strips
+#define BATCH_IMAGES 4
+#define MAX_VALUES 16
+
+// Buffers of one case; common inputs are shared by every case of a size,
+// the rest belong to the case and are freed by case_release
+typedef struct {
+    int width;
+    int height;
+    int kernel_size;
+    int border_width;
+
+    const uint8_t* pixels;
+    const double* mask;
+
+    uint8_t* out_pixels;
+    double* out_mask;
+    double* expanded;
+    float* sdf;
+    uint8_t* mask_u8;
+    uint8_t* expanded_u8;
+    uint8_t* out_u8;
+    float* tensor;
+    float* logits;
+    BitMask packed;
+    StickerSession* session;
+    StickerBatchItem batch[BATCH_IMAGES];
+    int32_t batch_results[BATCH_IMAGES];
+    int batch_count;
+    MaskProcessorContext* context;
+    int toggle;
+} BenchCase;
+
+typedef MaskProcessorResult (*BenchFn)(BenchCase* bench);
+
+typedef struct {
+    const char* name;
+    // Which parameters the kernel is swept over
+    int sweeps_kernel_size;
+    int sweeps_border_width;
+    // Bytes read and written per pixel, plus per call for the model tensor;
+    // 0 for kernels that touch an unpredictable part of the image
+    double bytes_per_pixel;
+    double bytes_per_call;
+    BenchFn setup;
+    BenchFn run;
+} BenchKernel;
+
+typedef struct {
+    int sizes[MAX_VALUES];
+    int size_count;
+    int kernel_sizes[MAX_VALUES];
+    int kernel_size_count;
+    int border_widths[MAX_VALUES];
+    int border_width_count;
+    int threads[MAX_VALUES];
+    int thread_count;
+    double min_time;
+    const char* filter;
+    const char* json_path;
+    const char* label;
+    int perf;
+} BenchOptions;
+
+typedef struct {
+    const char* kernel;
+    int width;
+    int height;
+    int kernel_size;
+    int border_width;
+    int threads;
+    int runs;
+    double median_ns;
+    double min_ns;
+    double ns_per_pixel;
+    // -1 when the kernel has no byte count
+    double gb_per_s;
+    // -1 without --perf or when the counters are unavailable
+    double cycles_per_pixel;
+    double instructions_per_cycle;
+} BenchResult;
+
+static const RGBColor border_color = { 255, 255, 255 };
+
+// Where the table goes: stderr when the JSON takes stdout
+static FILE* table;
+static const float model_mean[3] = { 0.485f, 0.456f, 0.406f };
+static const float model_inv_std[3] = { 1.0f / 0.229f, 1.0f / 0.224f, 1.0f / 0.225f };
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static size_t case_pixels(const BenchCase* bench) {
+    return (size_t)bench->width * bench->height;
+}
+
+static int case_border(const BenchCase* bench) {
+    return bench->border_width > 0;
+}
+
+static void* alloc_or_null(size_t bytes) {
+    return malloc(bytes > 0 ? bytes : 1);
+}
+
+static void case_release(BenchCase* bench) {
+    free(bench->out_pixels);
+    free(bench->out_mask);
+    free(bench->expanded);
+    free(bench->sdf);
+    free(bench->mask_u8);
+    free(bench->expanded_u8);
+    free(bench->out_u8);
+    free(bench->tensor);
+    free(bench->logits);
+    bit_mask_destroy(&bench->packed);
+    sticker_session_destroy(bench->session);
+    mask_processor_context_destroy(bench->context);
+
+    bench->out_pixels = NULL;
+    bench->out_mask = NULL;
+    bench->expanded = NULL;
+    bench->sdf = NULL;
+    bench->mask_u8 = NULL;
+    bench->expanded_u8 = NULL;
+    bench->out_u8 = NULL;
+    bench->tensor = NULL;
+    bench->logits = NULL;
+    memset(&bench->packed, 0, sizeof(bench->packed));
+    bench->session = NULL;
+    bench->batch_count = 0;
+    bench->context = NULL;
+    bench->toggle = 0;
+}
+
+static MaskProcessorResult need_out_pixels(BenchCase* bench) {
+    bench->out_pixels = (uint8_t*)alloc_or_null(case_pixels(bench) * 4);
+    return bench->out_pixels ? MASK_PROCESSOR_SUCCESS : MASK_PROCESSOR_ERROR_MEMORY;
+}
+
+static MaskProcessorResult need_out_mask(BenchCase* bench) {
+    bench->out_mask = (double*)alloc_or_null(case_pixels(bench) * sizeof(double));
+    return bench->out_mask ? MASK_PROCESSOR_SUCCESS : MASK_PROCESSOR_ERROR_MEMORY;
+}
+
+// Kept across runs, so its scratch is sized by the warm-up run
+static MaskProcessorResult need_context(BenchCase* bench) {
+    return mask_processor_context_create(&bench->context, 0);
+}
+
+// mask rounded to 0-255 and, with expanded, its 8-bit expansion
+static MaskProcessorResult need_mask_u8(BenchCase* bench, int expanded) {
+    const size_t n = case_pixels(bench);
+    bench->mask_u8 = (uint8_t*)alloc_or_null(n);
+    bench->out_u8 = (uint8_t*)alloc_or_null(n);
+    if (!bench->mask_u8 || !bench->out_u8) {
+        return MASK_PROCESSOR_ERROR_MEMORY;
+    }
+    for (size_t i = 0; i < n; i++) {
+        bench->mask_u8[i] = (uint8_t)lrint(bench->mask[i] * 255.0);
+    }
+    if (!expanded) {
+        return MASK_PROCESSOR_SUCCESS;
+    }
+    bench->expanded_u8 = (uint8_t*)alloc_or_null(n);
+    if (!bench->expanded_u8) {
+        return MASK_PROCESSOR_ERROR_MEMORY;
+    }
+    return expand_mask_u8(bench->mask_u8, bench->expanded_u8, bench->width, bench->height,
+                          FIXED_BORDER_WIDTH);
+}
+
+// Setup
+
+static MaskProcessorResult setup_out_mask(BenchCase* bench) {
+    return need_out_mask(bench);
+}
+
+static MaskProcessorResult setup_out_pixels(BenchCase* bench) {
+    return need_out_pixels(bench);
+}
+
+static MaskProcessorResult setup_out_mask_ctx(BenchCase* bench) {
+    const MaskProcessorResult result = need_context(bench);
+    return result == MASK_PROCESSOR_SUCCESS ? need_out_mask(bench) : result;
+}
+
+static MaskProcessorResult setup_out_pixels_ctx(BenchCase* bench) {
+    const MaskProcessorResult result = need_context(bench);
+    return result == MASK_PROCESSOR_SUCCESS ? need_out_pixels(bench) : result;
+}
+
+// Horizontal strips of the image, so the batch covers the same pixels as
+// one fused call: small sizes take the per-image queue, large sizes the
+// split path
+static MaskProcessorResult setup_batch(BenchCase* bench) {
+    const MaskProcessorResult result = need_out_pixels(bench);
+    if (result != MASK_PROCESSOR_SUCCESS) {
+        return result;
+    }
+    bench->batch_count = bench->height < BATCH_IMAGES ? bench->height : BATCH_IMAGES;
+    int y = 0;
+    for (int i = 0; i < bench->batch_count; i++) {
+        const int rows = (bench->height - y) / (bench->batch_count - i);
+        const size_t offset = (size_t)y * bench->width;
+        bench->batch[i].src = bench->pixels + offset * 4;
+        bench->batch[i].dst = bench->out_pixels + offset * 4;
+        bench->batch[i].mask = bench->mask + offset;
+        bench->batch[i].width = bench->width;
+        bench->batch[i].height = rows;
+        y += rows;
+    }
+    return MASK_PROCESSOR_SUCCESS;
+}
+
+static MaskProcessorResult setup_batch_ctx(BenchCase* bench) {
+    const MaskProcessorResult result = need_context(bench);
+    return result == MASK_PROCESSOR_SUCCESS ? setup_batch(bench) : result;
+}
+
+static MaskProcessorResult setup_u8(BenchCase* bench) {
+    return need_mask_u8(bench, 0);
+}
+
+static MaskProcessorResult setup_apply_u8(BenchCase* bench) {
+    const MaskProcessorResult result = need_out_pixels(bench);
+    if (result != MASK_PROCESSOR_SUCCESS) {
+        return result;
+    }
+    memcpy(bench->out_pixels, bench->pixels, case_pixels(bench) * 4);
+    return need_mask_u8(bench, 1);
+}
+
+static MaskProcessorResult setup_packed(BenchCase* bench) {
+    return bit_mask_create(&bench->packed, bench->width, bench->height);
+}
+
+static MaskProcessorResult setup_apply(BenchCase* bench) {
+    bench->expanded = (double*)alloc_or_null(case_pixels(bench) * sizeof(double));
+    if (!bench->expanded || need_out_pixels(bench) != MASK_PROCESSOR_SUCCESS) {
+        return MASK_PROCESSOR_ERROR_MEMORY;
+    }
+    return expand_mask_optimized(bench->mask, bench->expanded, bench->width, bench->height,
+                                 FIXED_BORDER_WIDTH);
+}
+
+static MaskProcessorResult setup_apply_packed(BenchCase* bench) {
+    MaskProcessorResult result = setup_packed(bench);
+    if (result == MASK_PROCESSOR_SUCCESS) {
+        result = need_out_pixels(bench);
+    }
+    if (result == MASK_PROCESSOR_SUCCESS) {
+        result = expand_mask_packed(bench->mask, &bench->packed, FIXED_BORDER_WIDTH);
+    }
+    return result;
+}
+
+static MaskProcessorResult setup_sdf(BenchCase* bench) {
+    bench->sdf = (float*)alloc_or_null(case_pixels(bench) * sizeof(float));
+    return bench->sdf ? MASK_PROCESSOR_SUCCESS : MASK_PROCESSOR_ERROR_MEMORY;
+}
+
+static MaskProcessorResult setup_apply_sdf(BenchCase* bench) {
+    MaskProcessorResult result = setup_sdf(bench);
+    if (result == MASK_PROCESSOR_SUCCESS) {
+        result = need_out_pixels(bench);
+    }
+    if (result == MASK_PROCESSOR_SUCCESS) {
+        result = compute_mask_sdf_native(bench->mask, bench->sdf, bench->width, bench->height);
+    }
+    return result;
+}
+
+static MaskProcessorResult setup_sdf_ctx(BenchCase* bench) {
+    const MaskProcessorResult result = need_context(bench);
+    return result == MASK_PROCESSOR_SUCCESS ? setup_sdf(bench) : result;
+}
+
+static MaskProcessorResult setup_stream(BenchCase* bench) {
+    // Room for one chunk plus the rows held back
+    const size_t rows = STREAM_CHUNK_ROWS + FIXED_KERNEL_SIZE + (size_t)bench->border_width + 1;
+    bench->out_pixels = (uint8_t*)alloc_or_null(rows * bench->width * 4);
+    return bench->out_pixels ? MASK_PROCESSOR_SUCCESS : MASK_PROCESSOR_ERROR_MEMORY;
+}
+
+// The border is shown even at width 0, where restyling then grows it
+static MaskProcessorResult setup_session(BenchCase* bench) {
+    return sticker_session_create(&bench->session, bench->pixels, bench->mask,
+                                  bench->width, bench->height, FIXED_KERNEL_SIZE,
+                                  1, border_color, (float)bench->border_width);
+}
+
+static MaskProcessorResult setup_resize(BenchCase* bench) {
+    bench->tensor = (float*)alloc_or_null(sizeof(float) * 3 * MODEL_SIZE * MODEL_SIZE);
+    return bench->tensor ? MASK_PROCESSOR_SUCCESS : MASK_PROCESSOR_ERROR_MEMORY;
+}
+
+static MaskProcessorResult setup_upsample(BenchCase* bench) {
+    bench->logits = (float*)alloc_or_null(sizeof(float) * MODEL_SIZE * MODEL_SIZE);
+    if (!bench->logits || need_out_mask(bench) != MASK_PROCESSOR_SUCCESS) {
+        return MASK_PROCESSOR_ERROR_MEMORY;
+    }
+    // A disc of logits, like a model output
+    for (int y = 0; y < MODEL_SIZE; y++) {
+        for (int x = 0; x < MODEL_SIZE; x++) {
+            const double dx = x - MODEL_SIZE / 2.0;
+            const double dy = y - MODEL_SIZE / 2.0;
+            bench->logits[y * MODEL_SIZE + x] = (float)(MODEL_SIZE * 0.35 - sqrt(dx * dx + dy * dy));
+        }
+    }
+    return MASK_PROCESSOR_SUCCESS;
+}
+
+static MaskProcessorResult setup_resize_ctx(BenchCase* bench) {
+    const MaskProcessorResult result = need_context(bench);
+    return result == MASK_PROCESSOR_SUCCESS ? setup_resize(bench) : result;
+}
+
+static MaskProcessorResult setup_upsample_ctx(BenchCase* bench) {
+    const MaskProcessorResult result = need_context(bench);
+    return result == MASK_PROCESSOR_SUCCESS ? setup_upsample(bench) : result;
+}
+
+// Runs
+
+static MaskProcessorResult run_smooth(BenchCase* bench) {
+    return smooth_mask_optimized(bench->mask, bench->out_mask, bench->width, bench->height,
+                                 bench->kernel_size);
+}
+
+static MaskProcessorResult run_smooth_native(BenchCase* bench) {
+    return smooth_mask_native(bench->mask, bench->out_mask, bench->width, bench->height,
+                              bench->kernel_size);
+}
+
+static MaskProcessorResult run_smooth_u8(BenchCase* bench) {
+    return smooth_mask_u8(bench->mask_u8, bench->out_u8, bench->width, bench->height,
+                          bench->kernel_size);
+}
+
+static MaskProcessorResult run_expand(BenchCase* bench) {
+    return expand_mask_optimized(bench->mask, bench->out_mask, bench->width, bench->height,
+                                 bench->border_width);
+}
+
+static MaskProcessorResult run_expand_u8(BenchCase* bench) {
+    return expand_mask_u8(bench->mask_u8, bench->out_u8, bench->width, bench->height,
+                          bench->border_width);
+}
+
+static MaskProcessorResult run_expand_packed(BenchCase* bench) {
+    return expand_mask_packed(bench->mask, &bench->packed, bench->border_width);
+}
+
+static MaskProcessorResult run_apply(BenchCase* bench) {
+    return apply_sticker_mask_to_optimized(bench->pixels, bench->out_pixels, bench->mask,
+                                           bench->width, bench->height, 1, border_color,
+                                           FIXED_BORDER_WIDTH, bench->expanded);
+}
+
+static MaskProcessorResult run_apply_packed(BenchCase* bench) {
+    return apply_sticker_mask_packed_to(bench->pixels, bench->out_pixels, bench->mask,
+                                        bench->width, bench->height, 1, border_color,
+                                        &bench->packed);
+}
+
+// In place: later runs recomposite the output, at the same cost
+static MaskProcessorResult run_apply_u8(BenchCase* bench) {
+    return apply_sticker_mask_u8(bench->out_pixels, bench->mask_u8, bench->width, bench->height,
+                                 1, border_color, bench->expanded_u8);
+}
+
+static MaskProcessorResult run_sdf(BenchCase* bench) {
+    return compute_mask_sdf_native(bench->mask, bench->sdf, bench->width, bench->height);
+}
+
+static MaskProcessorResult run_apply_sdf(BenchCase* bench) {
+    return apply_sticker_mask_sdf_to_native(bench->pixels, bench->out_pixels, bench->mask,
+                                            bench->sdf, bench->width, bench->height,
+                                            case_border(bench), border_color,
+                                            (float)bench->border_width);
+}
+
+static MaskProcessorResult run_fused(BenchCase* bench) {
+    return make_sticker_mask_fused(bench->pixels, bench->out_pixels, bench->mask,
+                                   bench->width, bench->height, bench->kernel_size,
+                                   case_border(bench), border_color, bench->border_width);
+}
+
+// One image failing fails the case
+static MaskProcessorResult batch_result(BenchCase* bench, MaskProcessorResult result) {
+    for (int i = 0; result == MASK_PROCESSOR_SUCCESS && i < bench->batch_count; i++) {
+        result = (MaskProcessorResult)bench->batch_results[i];
+    }
+    return result;
+}
+
+static MaskProcessorResult run_batch(BenchCase* bench) {
+    return batch_result(bench, make_stickers_batch(bench->batch, bench->batch_count,
+                                                   bench->batch_results, FIXED_KERNEL_SIZE,
+                                                   case_border(bench), border_color,
+                                                   bench->border_width));
+}
+
+static MaskProcessorResult run_stream(BenchCase* bench) {
+    StickerStream* stream = NULL;
+    MaskProcessorResult result = sticker_stream_create(
+        &stream, bench->width, bench->height, FIXED_KERNEL_SIZE, case_border(bench),
+        border_color, bench->border_width);
+    for (int y = 0; result == MASK_PROCESSOR_SUCCESS && y < bench->height; y += STREAM_CHUNK_ROWS) {
+        const int rows = bench->height - y < STREAM_CHUNK_ROWS ? bench->height - y : STREAM_CHUNK_ROWS;
+        int output_rows = 0;
+        result = sticker_stream_push(stream, bench->pixels + (size_t)y * bench->width * 4,
+                                     bench->mask + (size_t)y * bench->width, rows,
+                                     bench->out_pixels, &output_rows);
+    }
+    sticker_stream_destroy(stream);
+    return result;
+}
+
+static MaskProcessorResult run_session_create(BenchCase* bench) {
+    StickerSession* session = NULL;
+    const MaskProcessorResult result = sticker_session_create(
+        &session, bench->pixels, bench->mask, bench->width, bench->height, FIXED_KERNEL_SIZE,
+        case_border(bench), border_color, (float)bench->border_width);
+    sticker_session_destroy(session);
+    return result;
+}
+
+// Alternates between the swept width and one 4 pixels wider
+static MaskProcessorResult run_session_restyle(BenchCase* bench) {
+    bench->toggle = !bench->toggle;
+    const float width = (float)bench->border_width;
+    return sticker_session_set_border_width(bench->session, bench->toggle ? width + 4.0f : width);
+}
+
+static MaskProcessorResult run_resize(BenchCase* bench) {
+    return resize_rgba_to_nchw(bench->pixels, bench->width, bench->height, bench->tensor,
+                               MODEL_SIZE, MODEL_SIZE, model_mean, model_inv_std);
+}
+
+static MaskProcessorResult run_upsample(BenchCase* bench) {
+    return upsample_mask_tensor(bench->logits, MODEL_SIZE, MODEL_SIZE, bench->out_mask,
+                                MASK_OUTPUT_FLOAT64, bench->width, bench->height, 1, -1.0);
+}
+
+static MaskProcessorResult run_content_hash(BenchCase* bench) {
+    MaskHash128 hash;
+    return mask_content_hash(bench->pixels, case_pixels(bench) * 4, 0, &hash);
+}
+
+// Context variants, on the same buffers as the plain runs above
+
+static MaskProcessorResult run_smooth_ctx(BenchCase* bench) {
+    return smooth_mask_ctx(bench->context, bench->mask, bench->out_mask, bench->width,
+                           bench->height, bench->kernel_size);
+}
+
+static MaskProcessorResult run_expand_ctx(BenchCase* bench) {
+    return expand_mask_ctx(bench->context, bench->mask, bench->out_mask, bench->width,
+                           bench->height, bench->border_width);
+}
+
+static MaskProcessorResult run_sdf_ctx(BenchCase* bench) {
+    return compute_mask_sdf_ctx(bench->context, bench->mask, bench->sdf, bench->width,
+                                bench->height);
+}
+
+static MaskProcessorResult run_fused_ctx(BenchCase* bench) {
+    return make_sticker_mask_fused_ctx(bench->context, bench->pixels, bench->out_pixels,
+                                       bench->mask, bench->width, bench->height,
+                                       bench->kernel_size, case_border(bench), border_color,
+                                       bench->border_width);
+}
+
+static MaskProcessorResult run_batch_ctx(BenchCase* bench) {
+    return batch_result(bench, make_stickers_batch_ctx(bench->context, bench->batch,
+                                                       bench->batch_count, bench->batch_results,
+                                                       FIXED_KERNEL_SIZE, case_border(bench),
+                                                       border_color, bench->border_width));
+}
+
+static MaskProcessorResult run_resize_ctx(BenchCase* bench) {
+    return resize_rgba_to_nchw_ctx(bench->context, bench->pixels, bench->width, bench->height,
+                                   bench->tensor, MODEL_SIZE, MODEL_SIZE, model_mean,
+                                   model_inv_std);
+}
+
+static MaskProcessorResult run_upsample_ctx(BenchCase* bench) {
+    return upsample_mask_tensor_ctx(bench->context, bench->logits, MODEL_SIZE, MODEL_SIZE,
+                                    bench->out_mask, MASK_OUTPUT_FLOAT64, bench->width,
+                                    bench->height, 1, -1.0);
+}
+
+static const BenchKernel kernels[] = {
+    { "smooth", 1, 0, 16, 0, setup_out_mask, run_smooth },
+    { "smooth_native", 1, 0, 16, 0, setup_out_mask, run_smooth_native },
+    { "smooth_u8", 1, 0, 2, 0, setup_u8, run_smooth_u8 },
+    { "expand", 0, 1, 16, 0, setup_out_mask, run_expand },
+    { "expand_u8", 0, 1, 2, 0, setup_u8, run_expand_u8 },
+    { "expand_packed", 0, 1, 8.125, 0, setup_packed, run_expand_packed },
+    { "apply", 0, 0, 24, 0, setup_apply, run_apply },
+    { "apply_packed", 0, 0, 16.125, 0, setup_apply_packed, run_apply_packed },
+    { "apply_u8", 0, 0, 10, 0, setup_apply_u8, run_apply_u8 },
+    { "sdf", 0, 0, 12, 0, setup_sdf, run_sdf },
+    { "apply_sdf", 0, 1, 20, 0, setup_apply_sdf, run_apply_sdf },
+    { "fused", 1, 1, 16, 0, setup_out_pixels, run_fused },
+    { "batch", 0, 1, 16, 0, setup_batch, run_batch },
+    { "stream", 0, 1, 16, 0, setup_stream, run_stream },
+    { "session_create", 0, 1, 16, 0, NULL, run_session_create },
+    { "session_restyle", 0, 1, 0, 0, setup_session, run_session_restyle },
+    { "resize_nchw", 0, 0, 4, 12.0 * MODEL_SIZE * MODEL_SIZE, setup_resize, run_resize },
+    { "upsample", 0, 0, 8, 4.0 * MODEL_SIZE * MODEL_SIZE, setup_upsample, run_upsample },
+    { "content_hash", 0, 0, 4, 0, NULL, run_content_hash },
+    { "smooth_ctx", 1, 0, 16, 0, setup_out_mask_ctx, run_smooth_ctx },
+    { "expand_ctx", 0, 1, 16, 0, setup_out_mask_ctx, run_expand_ctx },
+    { "sdf_ctx", 0, 0, 12, 0, setup_sdf_ctx, run_sdf_ctx },
+    { "fused_ctx", 1, 1, 16, 0, setup_out_pixels_ctx, run_fused_ctx },
+    { "batch_ctx", 0, 1, 16, 0, setup_batch_ctx, run_batch_ctx },
+    { "resize_nchw_ctx", 0, 0, 4, 12.0 * MODEL_SIZE * MODEL_SIZE, setup_resize_ctx, run_resize_ctx },
+    { "upsample_ctx", 0, 0, 8, 4.0 * MODEL_SIZE * MODEL_SIZE, setup_upsample_ctx, run_upsample_ctx },
+};
+
+#define KERNEL_COUNT ((int)(sizeof(kernels) / sizeof(kernels[0])))
+
+static int compare_doubles(const void* a, const void* b) {
+    const double da = *(const double*)a;
+    const double db = *(const double*)b;
+    return da < db ? -1 : (da > db ? 1 : 0);
+}
+
+// Time one case; returns the first failing result code, if any
+static MaskProcessorResult measure(
+    const BenchKernel* kernel,
+    BenchCase* bench,
+    const BenchOptions* options,
+    BenchResult* out
+) {
+    enum { MIN_RUNS = 3, MAX_RUNS = 1000 };
+    static double samples[MAX_RUNS];
+
+    MaskProcessorResult result = kernel->setup ? kernel->setup(bench) : MASK_PROCESSOR_SUCCESS;
+    if (result == MASK_PROCESSOR_SUCCESS) {
+        result = kernel->run(bench);
+    }
+
+    int runs = 0;
+    double total = 0.0;
+    while (result == MASK_PROCESSOR_SUCCESS && runs < MAX_RUNS &&
+           (runs < MIN_RUNS || total < options->min_time * 1e9)) {
+        const double start = now_ns();
+        result = kernel->run(bench);
+        samples[runs] = now_ns() - start;
+        total += samples[runs++];
+    }
+
+    // Counted over separate runs so the timings stay free of the overhead
+    double cycles = -1.0;
+    double instructions = -1.0;
+    if (result == MASK_PROCESSOR_SUCCESS && options->perf &&
+        mask_perf_counters_start() == MASK_PROCESSOR_SUCCESS) {
+        MaskPerfCounters counters;
+        for (int i = 0; i < MIN_RUNS && result == MASK_PROCESSOR_SUCCESS; i++) {
+            result = kernel->run(bench);
+        }
+        if (mask_perf_counters_stop(&counters) == MASK_PROCESSOR_SUCCESS &&
+            counters.cycles > 0 && counters.instructions > 0) {
+            cycles = (double)counters.cycles / MIN_RUNS;
+            instructions = (double)counters.instructions / MIN_RUNS;
+        }
+    }
+    case_release(bench);
+    if (result != MASK_PROCESSOR_SUCCESS) {
+        return result;
+    }
+
+    qsort(samples, (size_t)runs, sizeof(double), compare_doubles);
+    const double pixels = (double)bench->width * bench->height;
+    const double bytes = kernel->bytes_per_pixel * pixels + kernel->bytes_per_call;
+
+    out->kernel = kernel->name;
+    out->width = bench->width;
+    out->height = bench->height;
+    out->kernel_size = kernel->sweeps_kernel_size ? bench->kernel_size : 0;
+    out->border_width = kernel->sweeps_border_width ? bench->border_width : -1;
+    out->threads = mask_processor_get_thread_count();
+    out->runs = runs;
+    out->median_ns = samples[runs / 2];
+    out->min_ns = samples[0];
+    out->ns_per_pixel = out->median_ns / pixels;
+    out->gb_per_s = bytes > 0.0 ? bytes / out->median_ns : -1.0;
+    out->cycles_per_pixel = cycles >= 0.0 ? cycles / pixels : -1.0;
+    out->instructions_per_cycle = cycles > 0.0 ? instructions / cycles : -1.0;
+    return MASK_PROCESSOR_SUCCESS;
+}
+
+// Random RGBA pixels and a disc mask with a soft edge, like a subject
+static int make_inputs(int size, uint8_t** pixels, double** mask) {
+    const size_t n = (size_t)size * size;
+    *pixels = (uint8_t*)malloc(n * 4);
+    *mask = (double*)malloc(n * sizeof(double));
+    if (!*pixels || !*mask) {
+        return -1;
+    }
+
+    uint32_t state = 0x12345678u;
+    for (size_t i = 0; i < n * 4; i++) {
+        state = state * 1664525u + 1013904223u;
+        (*pixels)[i] = (uint8_t)(state >> 24);
+    }
+    const double radius = size * 0.35;
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            const double dx = x - size / 2.0;
+            const double dy = y - size / 2.0;
+            const double inside = (radius - sqrt(dx * dx + dy * dy)) / 2.0 + 0.5;
+            (*mask)[(size_t)y * size + x] = inside < 0.0 ? 0.0 : (inside > 1.0 ? 1.0 : inside);
+        }
+    }
+    return 0;
+}
+
+static void print_result(const BenchResult* result) {
+    char params[32] = "";
+    if (result->kernel_size > 0 && result->border_width >= 0) {
+        snprintf(params, sizeof(params), "k=%d b=%d", result->kernel_size, result->border_width);
+    } else if (result->kernel_size > 0) {
+        snprintf(params, sizeof(params), "k=%d", result->kernel_size);
+    } else if (result->border_width >= 0) {
+        snprintf(params, sizeof(params), "b=%d", result->border_width);
+    }
+
+    fprintf(table, "%-16s %5dx%-5d %-10s t=%-2d %10.3f ms %8.3f ns/px",
+           result->kernel, result->width, result->height, params, result->threads,
+           result->median_ns / 1e6, result->ns_per_pixel);
+    if (result->gb_per_s >= 0.0) {
+        fprintf(table, " %7.2f GB/s", result->gb_per_s);
+    } else {
+        fprintf(table, "       - GB/s");
+    }
+    if (result->cycles_per_pixel >= 0.0) {
+        fprintf(table, " %7.2f cyc/px %5.2f IPC", result->cycles_per_pixel,
+                result->instructions_per_cycle);
+    }
+    fprintf(table, "\n");
+    fflush(table);
+}
+
+static const char* isa_name(MaskProcessorIsa isa) {
+    switch (isa) {
+        case MASK_PROCESSOR_ISA_SSE2: return "sse2";
+        case MASK_PROCESSOR_ISA_AVX2: return "avx2";
+        case MASK_PROCESSOR_ISA_AVX512: return "avx512";
+        case MASK_PROCESSOR_ISA_NEON: return "neon";
+        default: return "scalar";
+    }
+}
+
+static void json_number(FILE* file, const char* name, double value, const char* suffix) {
+    if (value < 0.0) {
+        fprintf(file, "\"%s\": null%s", name, suffix);
+    } else {
+        fprintf(file, "\"%s\": %.6g%s", name, value, suffix);
+    }
+}
+
+static int write_json(const char* path, const BenchOptions* options, const BenchResult* results, int count) {
+    FILE* file = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (!file) {
+        perror(path);
+        return -1;
+    }
+
+    char timestamp[32];
+    const time_t now = time(NULL);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    fprintf(file, "{\n  \"schema\": 1,\n  \"label\": \"");
+    for (const char* c = options->label ? options->label : ""; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', file);
+        }
+        if ((unsigned char)*c >= 0x20) {
+            fputc(*c, file);
+        }
+    }
+    fprintf(file, "\",\n  \"timestamp\": \"%s\",\n  \"isa\": \"%s\",\n  \"cache_bytes\": %zu,\n"
+                  "  \"min_time_s\": %g,\n  \"results\": [\n",
+            timestamp, isa_name(mask_processor_get_active_isa()), mask_processor_get_cache_size(),
+            options->min_time);
+
+    for (int i = 0; i < count; i++) {
+        const BenchResult* result = &results[i];
+        fprintf(file, "    {\"kernel\": \"%s\", \"width\": %d, \"height\": %d, ",
+                result->kernel, result->width, result->height);
+        if (result->kernel_size > 0) {
+            fprintf(file, "\"kernel_size\": %d, ", result->kernel_size);
+        } else {
+            fprintf(file, "\"kernel_size\": null, ");
+        }
+        if (result->border_width >= 0) {
+            fprintf(file, "\"border_width\": %d, ", result->border_width);
+        } else {
+            fprintf(file, "\"border_width\": null, ");
+        }
+        fprintf(file, "\"threads\": %d, \"runs\": %d, ", result->threads, result->runs);
+        json_number(file, "median_ns", result->median_ns, ", ");
+        json_number(file, "min_ns", result->min_ns, ", ");
+        json_number(file, "ns_per_pixel", result->ns_per_pixel, ", ");
+        json_number(file, "gb_per_s", result->gb_per_s, ", ");
+        json_number(file, "cycles_per_pixel", result->cycles_per_pixel, ", ");
+        json_number(file, "instructions_per_cycle", result->instructions_per_cycle, "");
+        fprintf(file, "}%s\n", i + 1 < count ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+
+    if (file != stdout && fclose(file) != 0) {
+        perror(path);
+        return -1;
+    }
+    return 0;
+}
+
+// Comma-separated positive integers
+static int parse_list(const char* text, int min, int* values, int* count) {
+    *count = 0;
+    while (*text) {
+        char* end = NULL;
+        const long value = strtol(text, &end, 10);
+        if (end == text || value < min || value > 1 << 16 || *count == MAX_VALUES ||
+            (*end != ',' && *end != '\0')) {
+            return -1;
+        }
+        values[(*count)++] = (int)value;
+        text = *end == ',' ? end + 1 : end;
+    }
+    return *count > 0 ? 0 : -1;
+}
+
+static int parse_isa(const char* text) {
+    static const char* const names[] = { "scalar", "sse2", "avx2", "avx512", "neon" };
+    for (int isa = MASK_PROCESSOR_ISA_SCALAR; isa <= MASK_PROCESSOR_ISA_NEON; isa++) {
+        if (strcmp(text, names[isa]) == 0) {
+            return mask_processor_select_isa((MaskProcessorIsa)isa) == MASK_PROCESSOR_SUCCESS ? 0 : -1;
+        }
+    }
+    return -1;
+}
+
+static void usage(FILE* out, const char* program) {
+    fprintf(out,
+            "Usage: %s [options]\n"
+            "\n"
+            "  -s, --sizes LIST         Square image sizes (default 256,512,1024,2048,4096)\n"
+            "  -k, --kernel-sizes LIST  Smoothing kernel sizes (default 3,5,9,15)\n"
+            "  -b, --border-widths LIST Border widths (default 0,4,12,32)\n"
+            "  -t, --threads LIST       Pool thread counts (default 1)\n"
+            "  -f, --filter TEXT        Only kernels whose name contains TEXT\n"
+            "  -m, --min-time SECONDS   Minimum measured time per case (default 0.2)\n"
+            "  -i, --isa NAME           Force scalar, sse2, avx2, avx512 or neon kernels\n"
+            "  -j, --json FILE          Also write results as JSON (- for stdout)\n"
+            "  -l, --label TEXT         Label stored in the JSON, e.g. a commit\n"
+            "  -p, --perf               Add cycles/pixel and IPC from perf counters\n"
+            "  -q, --quick              Small sizes and short runs, for smoke tests\n"
+            "  -h, --help               Show this help\n"
+            "\n"
+            "Kernels:",
+            program);
+    for (int i = 0; i < KERNEL_COUNT; i++) {
+        fprintf(out, " %s", kernels[i].name);
+    }
+    fprintf(out, "\n");
+}
+
+int main(int argc, char** argv) {
+    static const struct option long_options[] = {
+        { "sizes", required_argument, NULL, 's' },
+        { "kernel-sizes", required_argument, NULL, 'k' },
+        { "border-widths", required_argument, NULL, 'b' },
+        { "threads", required_argument, NULL, 't' },
+        { "filter", required_argument, NULL, 'f' },
+        { "min-time", required_argument, NULL, 'm' },
+        { "isa", required_argument, NULL, 'i' },
+        { "json", required_argument, NULL, 'j' },
+        { "label", required_argument, NULL, 'l' },
+        { "perf", no_argument, NULL, 'p' },
+        { "quick", no_argument, NULL, 'q' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    BenchOptions options = {
+        { 256, 512, 1024, 2048, 4096 }, 5,
+        { 3, 5, 9, 15 }, 4,
+        { 0, 4, 12, 32 }, 4,
+        { 1 }, 1,
+        0.2, NULL, NULL, NULL, 0
+    };
+
+    int option;
+    int bad = 0;
+    while (!bad && (option = getopt_long(argc, argv, "s:k:b:t:f:m:i:j:l:pqh", long_options, NULL)) != -1) {
+        switch (option) {
+            case 's': bad = parse_list(optarg, 1, options.sizes, &options.size_count); break;
+            case 'k': bad = parse_list(optarg, 1, options.kernel_sizes, &options.kernel_size_count); break;
+            case 'b': bad = parse_list(optarg, 0, options.border_widths, &options.border_width_count); break;
+            case 't': bad = parse_list(optarg, 1, options.threads, &options.thread_count); break;
+            case 'f': options.filter = optarg; break;
+            case 'm': options.min_time = atof(optarg); bad = options.min_time < 0.0; break;
+            case 'i': bad = parse_isa(optarg); break;
+            case 'j': options.json_path = optarg; break;
+            case 'l': options.label = optarg; break;
+            case 'p': options.perf = 1; break;
+            case 'q':
+                options.sizes[0] = 256;
+                options.sizes[1] = 512;
+                options.size_count = 2;
+                options.kernel_sizes[0] = 3;
+                options.kernel_sizes[1] = 15;
+                options.kernel_size_count = 2;
+                options.border_widths[0] = 0;
+                options.border_widths[1] = 12;
+                options.border_width_count = 2;
+                options.min_time = 0.0;
+                break;
+            case 'h': usage(stdout, argv[0]); return 0;
+            default: bad = 1; break;
+        }
+    }
+    if (bad || optind != argc) {
+        usage(stderr, argv[0]);
+        return 2;
+    }
+
+    const int max_results = options.thread_count * options.size_count * KERNEL_COUNT *
+                            options.kernel_size_count * options.border_width_count;
+    BenchResult* results = (BenchResult*)malloc(sizeof(BenchResult) * (size_t)max_results);
+    if (!results) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    table = options.json_path && strcmp(options.json_path, "-") == 0 ? stderr : stdout;
+    fprintf(table, "isa %s, cache %zu KB\n", isa_name(mask_processor_get_active_isa()),
+           mask_processor_get_cache_size() / 1024);
+
+    int count = 0;
+    int failures = 0;
+    for (int s = 0; s < options.size_count; s++) {
+        uint8_t* pixels = NULL;
+        double* mask = NULL;
+        const int size = options.sizes[s];
+        if (make_inputs(size, &pixels, &mask) != 0) {
+            fprintf(stderr, "%dx%d: out of memory\n", size, size);
+            free(pixels);
+            free(mask);
+            failures++;
+            continue;
+        }
+
+        for (int t = 0; t < options.thread_count; t++) {
+            mask_processor_set_thread_count(options.threads[t]);
+
+            for (int k = 0; k < KERNEL_COUNT; k++) {
+                const BenchKernel* kernel = &kernels[k];
+                if (options.filter && !strstr(kernel->name, options.filter)) {
+                    continue;
+                }
+                const int kernel_sizes = kernel->sweeps_kernel_size ? options.kernel_size_count : 1;
+                const int border_widths = kernel->sweeps_border_width ? options.border_width_count : 1;
+
+                for (int ki = 0; ki < kernel_sizes; ki++) {
+                    for (int bi = 0; bi < border_widths; bi++) {
+                        BenchCase bench;
+                        memset(&bench, 0, sizeof(bench));
+                        bench.width = size;
+                        bench.height = size;
+                        bench.kernel_size = kernel->sweeps_kernel_size ? options.kernel_sizes[ki] : FIXED_KERNEL_SIZE;
+                        bench.border_width = kernel->sweeps_border_width ? options.border_widths[bi] : FIXED_BORDER_WIDTH;
+                        bench.pixels = pixels;
+                        bench.mask = mask;
+
+                        const MaskProcessorResult result = measure(kernel, &bench, &options, &results[count]);
+                        if (result != MASK_PROCESSOR_SUCCESS) {
+                            fprintf(stderr, "%s %dx%d k=%d b=%d: failed (%d)\n", kernel->name, size, size,
+                                    bench.kernel_size, bench.border_width, result);
+                            failures++;
+                            continue;
+                        }
+                        print_result(&results[count++]);
+                    }
+                }
+            }
+        }
+        free(pixels);
+        free(mask);
+    }
+
+    if (options.json_path && write_json(options.json_path, &options, results, count) != 0) {
+        failures++;
+    }
+    free(results);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,136 @@
+#include "image_io.h"
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+// jpeglib.h relies on the stdio.h and stddef.h types being declared first
+#include <jpeglib.h>
+#include <png.h>
+
+typedef struct {
+    struct jpeg_error_mgr base;
+    jmp_buf escape;
+} JpegError;
+
+static void jpeg_error_exit(j_common_ptr info) {
+    longjmp(((JpegError*)info->err)->escape, 1);
+}
+
+static int load_png(const char* path, uint8_t** pixels, int* width, int* height) {
+    png_image image;
+    memset(&image, 0, sizeof(image));
+    image.version = PNG_IMAGE_VERSION;
+    if (!png_image_begin_read_from_file(&image, path)) {
+        return -1;
+    }
+
+    image.format = PNG_FORMAT_RGBA;
+    uint8_t* buffer = (uint8_t*)malloc(PNG_IMAGE_SIZE(image));
+    if (!buffer) {
+        png_image_free(&image);
+        return -1;
+    }
+    if (!png_image_finish_read(&image, NULL, buffer, 0, NULL)) {
+        free(buffer);
+        return -1;
+    }
+
+    *pixels = buffer;
+    *width = (int)image.width;
+    *height = (int)image.height;
+    return 0;
+}
+
+static int load_jpeg(FILE* file, uint8_t** pixels, int* width, int* height) {
+    struct jpeg_decompress_struct info;
+    JpegError error;
+    // volatile: assigned between setjmp and a possible longjmp
+    uint8_t* volatile buffer = NULL;
+
+    info.err = jpeg_std_error(&error.base);
+    error.base.error_exit = jpeg_error_exit;
+    if (setjmp(error.escape)) {
+        jpeg_destroy_decompress(&info);
+        free(buffer);
+        return -1;
+    }
+
+    jpeg_create_decompress(&info);
+    jpeg_stdio_src(&info, file);
+    jpeg_read_header(&info, TRUE);
+    info.out_color_space = JCS_RGB;
+    jpeg_start_decompress(&info);
+
+    const size_t row_pixels = info.output_width;
+    buffer = (uint8_t*)malloc(row_pixels * info.output_height * 4);
+    if (!buffer) {
+        jpeg_destroy_decompress(&info);
+        return -1;
+    }
+
+    // Each RGB row is decoded into the end of its RGBA row, then spread out
+    // front to back so no pixel is overwritten before it is read
+    while (info.output_scanline < info.output_height) {
+        uint8_t* row = buffer + row_pixels * 4 * info.output_scanline;
+        JSAMPROW rgb = row + row_pixels;
+        jpeg_read_scanlines(&info, &rgb, 1);
+        for (size_t x = 0; x < row_pixels; x++) {
+            row[x * 4] = rgb[x * 3];
+            row[x * 4 + 1] = rgb[x * 3 + 1];
+            row[x * 4 + 2] = rgb[x * 3 + 2];
+            row[x * 4 + 3] = 255;
+        }
+    }
+
+    jpeg_finish_decompress(&info);
+    *pixels = buffer;
+    *width = (int)info.output_width;
+    *height = (int)info.output_height;
+    jpeg_destroy_decompress(&info);
+    return 0;
+}
+
+int image_load_rgba(const char* path, uint8_t** pixels, int* width, int* height) {
+    static const uint8_t png_header[4] = { 0x89, 0x50, 0x4E, 0x47 };
+    static const uint8_t jpeg_header[3] = { 0xFF, 0xD8, 0xFF };
+
+    if (!path || !pixels || !width || !height) {
+        return -1;
+    }
+
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return -1;
+    }
+    uint8_t header[4] = { 0 };
+    const size_t header_size = fread(header, 1, sizeof(header), file);
+
+    int result = -1;
+    if (header_size >= sizeof(jpeg_header) &&
+        memcmp(header, jpeg_header, sizeof(jpeg_header)) == 0) {
+        rewind(file);
+        result = load_jpeg(file, pixels, width, height);
+        fclose(file);
+    } else {
+        fclose(file);
+        if (header_size == sizeof(png_header) &&
+            memcmp(header, png_header, sizeof(png_header)) == 0) {
+            result = load_png(path, pixels, width, height);
+        }
+    }
+    return result;
+}
+
+int image_save_png(const char* path, const uint8_t* pixels, int width, int height) {
+    if (!path || !pixels || width <= 0 || height <= 0) {
+        return -1;
+    }
+
+    png_image image;
+    memset(&image, 0, sizeof(image));
+    image.version = PNG_IMAGE_VERSION;
+    image.width = (png_uint_32)width;
+    image.height = (png_uint_32)height;
+    image.format = PNG_FORMAT_RGBA;
+    return png_image_write_to_file(&image, path, 0, pixels, 0, NULL) ? 0 : -1;
+}
@@ -0,0 +1,39 @@
+#ifndef IMAGE_IO_H
+#define IMAGE_IO_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Decode a PNG or JPEG file to RGBA
+ *
+ * The format is taken from the file header, not the extension. JPEG
+ * images get an opaque alpha channel.
+ *
+ * @param path File to read
+ * @param pixels Receives the RGBA pixels, to be released with free()
+ * @param width Receives the image width
+ * @param height Receives the image height
+ * @return 0 on success, -1 if the file could not be read or decoded
+ */
+int image_load_rgba(const char* path, uint8_t** pixels, int* width, int* height);
+
+/**
+ * Encode RGBA pixels as a PNG file
+ *
+ * @param path File to write, replaced if it exists
+ * @param pixels RGBA pixel data
+ * @param width Image width
+ * @param height Image height
+ * @return 0 on success, -1 on failure
+ */
+int image_save_png(const char* path, const uint8_t* pixels, int width, int height);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IMAGE_IO_H
@@ -0,0 +1,268 @@
+#include "segmenter.h"
+#include <onnxruntime_c_api.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct Segmenter {
+    const OrtApi* ort;
+    OrtEnv* env;
+    OrtSession* session;
+    OrtMemoryInfo* memory_info;
+    char* input_name;
+    // The mask is the last output; the others are side outputs of the
+    // model that the plugin ignores as well
+    char* output_name;
+};
+
+// Consume status, copying its message to error; 0 when there was none
+static int take_status(const OrtApi* ort, OrtStatus* status, char* error, size_t error_size) {
+    if (!status) {
+        return 0;
+    }
+    if (error && error_size > 0) {
+        snprintf(error, error_size, "%s", ort->GetErrorMessage(status));
+    }
+    ort->ReleaseStatus(status);
+    return -1;
+}
+
+static void set_error(char* error, size_t error_size, const char* message) {
+    if (error && error_size > 0) {
+        snprintf(error, error_size, "%s", message);
+    }
+}
+
+// Copy of a name allocated by ONNX Runtime, which is then freed
+static char* take_name(const OrtApi* ort, OrtAllocator* allocator, char* name) {
+    char* copy = (char*)malloc(strlen(name) + 1);
+    if (copy) {
+        strcpy(copy, name);
+    }
+    ort->AllocatorFree(allocator, name);
+    return copy;
+}
+
+static int read_io_names(Segmenter* segmenter, char* error, size_t error_size) {
+    const OrtApi* ort = segmenter->ort;
+    OrtAllocator* allocator = NULL;
+    size_t input_count = 0;
+    size_t output_count = 0;
+    char* name = NULL;
+
+    if (take_status(ort, ort->GetAllocatorWithDefaultOptions(&allocator), error, error_size) ||
+        take_status(ort, ort->SessionGetInputCount(segmenter->session, &input_count), error, error_size) ||
+        take_status(ort, ort->SessionGetOutputCount(segmenter->session, &output_count), error, error_size)) {
+        return -1;
+    }
+    if (input_count != 1 || output_count == 0) {
+        set_error(error, error_size, "model must have one input and at least one output");
+        return -1;
+    }
+
+    if (take_status(ort, ort->SessionGetInputName(segmenter->session, 0, allocator, &name), error, error_size)) {
+        return -1;
+    }
+    segmenter->input_name = take_name(ort, allocator, name);
+
+    if (take_status(ort, ort->SessionGetOutputName(segmenter->session, output_count - 1, allocator, &name),
+                    error, error_size)) {
+        return -1;
+    }
+    segmenter->output_name = take_name(ort, allocator, name);
+
+    if (!segmenter->input_name || !segmenter->output_name) {
+        set_error(error, error_size, "out of memory");
+        return -1;
+    }
+    return 0;
+}
+
+int segmenter_create(
+    Segmenter** segmenter,
+    const char* model_path,
+    int intra_op_threads,
+    char* error,
+    size_t error_size
+) {
+    if (!segmenter || !model_path || intra_op_threads < 0) {
+        set_error(error, error_size, "invalid arguments");
+        return -1;
+    }
+    *segmenter = NULL;
+
+    Segmenter* created = (Segmenter*)calloc(1, sizeof(Segmenter));
+    if (!created) {
+        set_error(error, error_size, "out of memory");
+        return -1;
+    }
+    const OrtApi* ort = OrtGetApiBase()->GetApi(ORT_API_VERSION);
+    if (!ort) {
+        free(created);
+        set_error(error, error_size, "ONNX Runtime does not support the API version built against");
+        return -1;
+    }
+    created->ort = ort;
+
+    OrtSessionOptions* options = NULL;
+    int result = take_status(ort, ort->CreateEnv(ORT_LOGGING_LEVEL_WARNING, "sticker_maker_cli", &created->env),
+                             error, error_size);
+    if (!result) {
+        result = take_status(ort, ort->CreateSessionOptions(&options), error, error_size);
+    }
+    if (!result) {
+        result = take_status(ort, ort->SetIntraOpNumThreads(options, intra_op_threads), error, error_size);
+    }
+    if (!result) {
+        result = take_status(ort, ort->SetSessionGraphOptimizationLevel(options, ORT_ENABLE_ALL),
+                             error, error_size);
+    }
+    if (!result) {
+        result = take_status(ort, ort->CreateSession(created->env, model_path, options, &created->session),
+                             error, error_size);
+    }
+    if (!result) {
+        result = take_status(ort, ort->CreateCpuMemoryInfo(OrtArenaAllocator, OrtMemTypeDefault,
+                                                          &created->memory_info),
+                             error, error_size);
+    }
+    if (!result) {
+        result = read_io_names(created, error, error_size);
+    }
+    if (options) {
+        ort->ReleaseSessionOptions(options);
+    }
+
+    if (result) {
+        segmenter_destroy(created);
+        return -1;
+    }
+    *segmenter = created;
+    return 0;
+}
+
+void segmenter_destroy(Segmenter* segmenter) {
+    if (!segmenter) {
+        return;
+    }
+    const OrtApi* ort = segmenter->ort;
+    free(segmenter->input_name);
+    free(segmenter->output_name);
+    if (segmenter->memory_info) {
+        ort->ReleaseMemoryInfo(segmenter->memory_info);
+    }
+    if (segmenter->session) {
+        ort->ReleaseSession(segmenter->session);
+    }
+    if (segmenter->env) {
+        ort->ReleaseEnv(segmenter->env);
+    }
+    free(segmenter);
+}
+
+// Copy a float tensor shaped [..., H, W] into mask
+static int copy_mask(
+    const OrtApi* ort,
+    OrtValue* output,
+    float* mask,
+    size_t mask_capacity,
+    int* mask_width,
+    int* mask_height,
+    char* error,
+    size_t error_size
+) {
+    OrtTensorTypeAndShapeInfo* info = NULL;
+    ONNXTensorElementDataType type = ONNX_TENSOR_ELEMENT_DATA_TYPE_UNDEFINED;
+    int64_t dims[8];
+    size_t dim_count = 0;
+    float* data = NULL;
+
+    if (take_status(ort, ort->GetTensorTypeAndShape(output, &info), error, error_size)) {
+        return -1;
+    }
+    int result = take_status(ort, ort->GetTensorElementType(info, &type), error, error_size);
+    if (!result) {
+        result = take_status(ort, ort->GetDimensionsCount(info, &dim_count), error, error_size);
+    }
+    if (!result && (dim_count < 2 || dim_count > 8)) {
+        set_error(error, error_size, "unexpected output rank");
+        result = -1;
+    }
+    if (!result) {
+        result = take_status(ort, ort->GetDimensions(info, dims, dim_count), error, error_size);
+    }
+    ort->ReleaseTensorTypeAndShapeInfo(info);
+    if (result) {
+        return -1;
+    }
+
+    const int64_t height = dims[dim_count - 2];
+    const int64_t width = dims[dim_count - 1];
+    for (size_t i = 0; i + 2 < dim_count; i++) {
+        if (dims[i] != 1) {
+            set_error(error, error_size, "output holds more than one mask");
+            return -1;
+        }
+    }
+    if (type != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT || width <= 0 || height <= 0 ||
+        (uint64_t)width * (uint64_t)height > mask_capacity) {
+        set_error(error, error_size, "unexpected output type or size");
+        return -1;
+    }
+
+    if (take_status(ort, ort->GetTensorMutableData(output, (void**)&data), error, error_size)) {
+        return -1;
+    }
+    memcpy(mask, data, sizeof(float) * (size_t)(width * height));
+    *mask_width = (int)width;
+    *mask_height = (int)height;
+    return 0;
+}
+
+int segmenter_run(
+    Segmenter* segmenter,
+    const float* input,
+    float* mask,
+    size_t mask_capacity,
+    int* mask_width,
+    int* mask_height,
+    char* error,
+    size_t error_size
+) {
+    if (!segmenter || !input || !mask || !mask_width || !mask_height) {
+        set_error(error, error_size, "invalid arguments");
+        return -1;
+    }
+    const OrtApi* ort = segmenter->ort;
+    static const int64_t shape[4] = { 1, 3, SEGMENTER_INPUT_SIZE, SEGMENTER_INPUT_SIZE };
+    const size_t input_bytes = sizeof(float) * 3 * SEGMENTER_INPUT_SIZE * SEGMENTER_INPUT_SIZE;
+
+    // The tensor wraps input without copying; ONNX Runtime only reads it
+    OrtValue* input_value = NULL;
+    OrtValue* output_value = NULL;
+    if (take_status(ort, ort->CreateTensorWithDataAsOrtValue(segmenter->memory_info, (void*)input,
+                                                             input_bytes, shape, 4,
+                                                             ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT,
+                                                             &input_value),
+                    error, error_size)) {
+        return -1;
+    }
+
+    const char* input_names[1] = { segmenter->input_name };
+    const char* output_names[1] = { segmenter->output_name };
+    int result = take_status(ort, ort->Run(segmenter->session, NULL, input_names,
+                                           (const OrtValue* const*)&input_value, 1,
+                                           output_names, 1, &output_value),
+                             error, error_size);
+    if (!result) {
+        result = copy_mask(ort, output_value, mask, mask_capacity, mask_width, mask_height,
+                           error, error_size);
+    }
+
+    if (output_value) {
+        ort->ReleaseValue(output_value);
+    }
+    ort->ReleaseValue(input_value);
+    return result;
+}
@@ -0,0 +1,73 @@
+#ifndef SEGMENTER_H
+#define SEGMENTER_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Side of the square model input, as in OnnxStickerProcessor
+#define SEGMENTER_INPUT_SIZE 320
+
+/**
+ * Background segmentation model run with ONNX Runtime on the CPU
+ *
+ * One segmenter can be run from several threads at once.
+ */
+typedef struct Segmenter Segmenter;
+
+/**
+ * Load a model
+ *
+ * @param segmenter Receives the segmenter, NULL on failure
+ * @param model_path Path of the .onnx file
+ * @param intra_op_threads Threads ONNX Runtime uses within one run
+ * @param error Receives a message on failure (may be NULL)
+ * @param error_size Size of error
+ * @return 0 on success, -1 on failure
+ */
+int segmenter_create(
+    Segmenter** segmenter,
+    const char* model_path,
+    int intra_op_threads,
+    char* error,
+    size_t error_size
+);
+
+/**
+ * Destroy a segmenter
+ *
+ * @param segmenter Segmenter to destroy (may be NULL)
+ */
+void segmenter_destroy(Segmenter* segmenter);
+
+/**
+ * Run the model on one image
+ *
+ * @param segmenter Segmenter
+ * @param input Normalized 1x3xSxS tensor, S = SEGMENTER_INPUT_SIZE
+ * @param mask Receives the last model output, a mask of probabilities
+ * @param mask_capacity Floats mask can hold
+ * @param mask_width Receives the mask width
+ * @param mask_height Receives the mask height
+ * @param error Receives a message on failure (may be NULL)
+ * @param error_size Size of error
+ * @return 0 on success, -1 on failure
+ */
+int segmenter_run(
+    Segmenter* segmenter,
+    const float* input,
+    float* mask,
+    size_t mask_capacity,
+    int* mask_width,
+    int* mask_height,
+    char* error,
+    size_t error_size
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SEGMENTER_H
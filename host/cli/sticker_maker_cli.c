@@ -0,0 +1,563 @@
+// sticker_maker_cli: the plugin's ONNX sticker pipeline, headless
+//
+// Each image is decoded, resampled into the model input, segmented with
+// ONNX Runtime on the CPU, upsampled back to full size and passed through
+// the fused smooth/expand/composite kernel, then written out as PNG. This
+// is the path OnnxStickerProcessor.makeSticker() takes with native support.
+//
+// Images are processed whole, one per thread: every thread claims the next
+// unprocessed image until none are left. Each thread keeps its own
+// processor context, and ONNX Runtime runs one thread per inference, so
+// the threads do not compete for cores within an image.
+
+#include "image_io.h"
+#include "segmenter.h"
+#include "processor_context.h"
+#include "tensor_ops.h"
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef STICKER_MAKER_DEFAULT_MODEL
+#define STICKER_MAKER_DEFAULT_MODEL "assets/model.onnx"
+#endif
+
+// StickerDefaults in lib/src/constants.dart
+#define DEFAULT_BORDER_WIDTH 12
+#define DEFAULT_KERNEL_SIZE 3
+
+typedef enum {
+    STAGE_DECODE = 0,
+    STAGE_PREPROCESS,
+    STAGE_INFERENCE,
+    STAGE_UPSAMPLE,
+    STAGE_STICKER,
+    STAGE_ENCODE,
+    STAGE_COUNT
+} Stage;
+
+static const char* const stage_names[STAGE_COUNT] = {
+    "decode", "preprocess", "inference", "upsample", "sticker", "encode"
+};
+
+typedef struct {
+    char** items;
+    int count;
+    int capacity;
+} PathList;
+
+typedef struct {
+    const char* output_dir;
+    const char* model_path;
+    int threads;
+    int kernel_size;
+    int add_border;
+    int border_width;
+    RGBColor border_color;
+} CliOptions;
+
+typedef struct {
+    const CliOptions* options;
+    Segmenter* segmenter;
+    const PathList* inputs;
+    // Next input to claim
+    int next;
+    // Milliseconds per image, negative for images that failed
+    double* latencies;
+} CliRun;
+
+typedef struct {
+    CliRun* run;
+    pthread_t thread;
+    // Seconds spent in each stage over the images this thread completed
+    double stage_seconds[STAGE_COUNT];
+} CliWorker;
+
+// Same as processing an image in OnnxStickerProcessor
+static const float model_mean[3] = { 0.485f, 0.456f, 0.406f };
+static const float model_inv_std[3] = { 1.0f / 0.229f, 1.0f / 0.224f, 1.0f / 0.225f };
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static int path_list_add(PathList* list, const char* path) {
+    if (list->count == list->capacity) {
+        const int capacity = list->capacity ? list->capacity * 2 : 64;
+        char** items = (char**)realloc(list->items, sizeof(char*) * (size_t)capacity);
+        if (!items) {
+            return -1;
+        }
+        list->items = items;
+        list->capacity = capacity;
+    }
+    char* copy = (char*)malloc(strlen(path) + 1);
+    if (!copy) {
+        return -1;
+    }
+    strcpy(copy, path);
+    list->items[list->count++] = copy;
+    return 0;
+}
+
+static void path_list_free(PathList* list) {
+    for (int i = 0; i < list->count; i++) {
+        free(list->items[i]);
+    }
+    free(list->items);
+}
+
+static int compare_paths(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+static int has_image_extension(const char* name) {
+    const char* dot = strrchr(name, '.');
+    return dot && (strcasecmp(dot, ".png") == 0 || strcasecmp(dot, ".jpg") == 0 ||
+                   strcasecmp(dot, ".jpeg") == 0);
+}
+
+// Add the PNG and JPEG files directly in dir, in name order
+static int add_directory(PathList* list, const char* dir) {
+    DIR* handle = opendir(dir);
+    if (!handle) {
+        fprintf(stderr, "%s: %s\n", dir, strerror(errno));
+        return -1;
+    }
+
+    const int first = list->count;
+    int result = 0;
+    struct dirent* entry;
+    while (result == 0 && (entry = readdir(handle)) != NULL) {
+        if (entry->d_name[0] == '.' || !has_image_extension(entry->d_name)) {
+            continue;
+        }
+        const size_t length = strlen(dir) + strlen(entry->d_name) + 2;
+        char* path = (char*)malloc(length);
+        if (!path) {
+            result = -1;
+            break;
+        }
+        snprintf(path, length, "%s/%s", dir, entry->d_name);
+        struct stat info;
+        if (stat(path, &info) == 0 && S_ISREG(info.st_mode)) {
+            result = path_list_add(list, path);
+        }
+        free(path);
+    }
+    closedir(handle);
+
+    qsort(list->items + first, (size_t)(list->count - first), sizeof(char*), compare_paths);
+    return result;
+}
+
+static int add_input(PathList* list, const char* path) {
+    struct stat info;
+    if (stat(path, &info) != 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    return S_ISDIR(info.st_mode) ? add_directory(list, path) : path_list_add(list, path);
+}
+
+// Add each non-empty line of a list file ("-" for stdin)
+static int add_list_file(PathList* list, const char* list_path) {
+    FILE* file = strcmp(list_path, "-") == 0 ? stdin : fopen(list_path, "r");
+    if (!file) {
+        fprintf(stderr, "%s: %s\n", list_path, strerror(errno));
+        return -1;
+    }
+
+    int result = 0;
+    char line[4096];
+    while (result == 0 && fgets(line, sizeof(line), file)) {
+        size_t length = strlen(line);
+        while (length > 0 && isspace((unsigned char)line[length - 1])) {
+            line[--length] = '\0';
+        }
+        if (length > 0) {
+            result = add_input(list, line);
+        }
+    }
+    if (file != stdin) {
+        fclose(file);
+    }
+    return result;
+}
+
+// <output_dir>/<input name without extension>.png
+static char* output_path(const char* output_dir, const char* input) {
+    const char* slash = strrchr(input, '/');
+    const char* name = slash ? slash + 1 : input;
+    const char* dot = strrchr(name, '.');
+    const size_t stem = dot && dot != name ? (size_t)(dot - name) : strlen(name);
+
+    const size_t length = strlen(output_dir) + stem + 6;
+    char* path = (char*)malloc(length);
+    if (path) {
+        snprintf(path, length, "%s/%.*s.png", output_dir, (int)stem, name);
+    }
+    return path;
+}
+
+typedef struct {
+    MaskProcessorContext* context;
+    float tensor[3 * SEGMENTER_INPUT_SIZE * SEGMENTER_INPUT_SIZE];
+    float model_mask[SEGMENTER_INPUT_SIZE * SEGMENTER_INPUT_SIZE];
+    double* mask;
+    size_t mask_capacity;
+} WorkerBuffers;
+
+// Run the pipeline on one image; 0 on success
+static int make_sticker(
+    CliWorker* worker,
+    WorkerBuffers* buffers,
+    const char* input,
+    double stage_seconds[STAGE_COUNT]
+) {
+    const CliOptions* options = worker->run->options;
+    char error[256] = "";
+    uint8_t* pixels = NULL;
+    int width = 0;
+    int height = 0;
+    int mask_width = 0;
+    int mask_height = 0;
+    MaskProcessorResult result;
+
+    double start = now_seconds();
+    if (image_load_rgba(input, &pixels, &width, &height) != 0) {
+        fprintf(stderr, "%s: not a readable PNG or JPEG image\n", input);
+        return -1;
+    }
+    double end = now_seconds();
+    stage_seconds[STAGE_DECODE] = end - start;
+
+    const size_t pixel_count = (size_t)width * height;
+    if (pixel_count > buffers->mask_capacity) {
+        double* mask = (double*)realloc(buffers->mask, sizeof(double) * pixel_count);
+        if (!mask) {
+            fprintf(stderr, "%s: out of memory\n", input);
+            free(pixels);
+            return -1;
+        }
+        buffers->mask = mask;
+        buffers->mask_capacity = pixel_count;
+    }
+
+    start = end;
+    result = resize_rgba_to_nchw_ctx(
+        buffers->context, pixels, width, height, buffers->tensor,
+        SEGMENTER_INPUT_SIZE, SEGMENTER_INPUT_SIZE, model_mean, model_inv_std);
+    end = now_seconds();
+    stage_seconds[STAGE_PREPROCESS] = end - start;
+    if (result != MASK_PROCESSOR_SUCCESS) {
+        fprintf(stderr, "%s: preprocessing failed (%d)\n", input, result);
+        free(pixels);
+        return -1;
+    }
+
+    start = end;
+    if (segmenter_run(worker->run->segmenter, buffers->tensor, buffers->model_mask,
+                      SEGMENTER_INPUT_SIZE * SEGMENTER_INPUT_SIZE, &mask_width, &mask_height,
+                      error, sizeof(error)) != 0) {
+        fprintf(stderr, "%s: inference failed: %s\n", input, error);
+        free(pixels);
+        return -1;
+    }
+    end = now_seconds();
+    stage_seconds[STAGE_INFERENCE] = end - start;
+
+    start = end;
+    result = upsample_mask_tensor_ctx(
+        buffers->context, buffers->model_mask, mask_width, mask_height, buffers->mask,
+        MASK_OUTPUT_FLOAT64, width, height, 0, -1.0);
+    end = now_seconds();
+    stage_seconds[STAGE_UPSAMPLE] = end - start;
+    if (result != MASK_PROCESSOR_SUCCESS) {
+        fprintf(stderr, "%s: mask upsampling failed (%d)\n", input, result);
+        free(pixels);
+        return -1;
+    }
+
+    start = end;
+    result = make_sticker_mask_fused_ctx(
+        buffers->context, pixels, pixels, buffers->mask, width, height,
+        options->kernel_size, options->add_border, options->border_color, options->border_width);
+    end = now_seconds();
+    stage_seconds[STAGE_STICKER] = end - start;
+    if (result != MASK_PROCESSOR_SUCCESS) {
+        fprintf(stderr, "%s: sticker processing failed (%d)\n", input, result);
+        free(pixels);
+        return -1;
+    }
+
+    start = end;
+    char* output = output_path(options->output_dir, input);
+    const int saved = output ? image_save_png(output, pixels, width, height) : -1;
+    end = now_seconds();
+    stage_seconds[STAGE_ENCODE] = end - start;
+    if (saved != 0) {
+        fprintf(stderr, "%s: could not write %s\n", input, output ? output : "output");
+    }
+
+    free(output);
+    free(pixels);
+    return saved;
+}
+
+static void* worker_main(void* arg) {
+    CliWorker* worker = (CliWorker*)arg;
+    CliRun* run = worker->run;
+
+    // Large: keep it off the thread stack
+    WorkerBuffers* buffers = (WorkerBuffers*)calloc(1, sizeof(WorkerBuffers));
+    if (!buffers || mask_processor_context_create(&buffers->context, 0) != MASK_PROCESSOR_SUCCESS) {
+        fprintf(stderr, "out of memory\n");
+        free(buffers);
+        return NULL;
+    }
+
+    for (;;) {
+        const int index = __atomic_fetch_add(&run->next, 1, __ATOMIC_RELAXED);
+        if (index >= run->inputs->count) {
+            break;
+        }
+
+        double stage_seconds[STAGE_COUNT] = { 0 };
+        const double start = now_seconds();
+        const int result = make_sticker(worker, buffers, run->inputs->items[index], stage_seconds);
+        const double elapsed = now_seconds() - start;
+
+        run->latencies[index] = result == 0 ? elapsed * 1000.0 : -1.0;
+        if (result == 0) {
+            for (int stage = 0; stage < STAGE_COUNT; stage++) {
+                worker->stage_seconds[stage] += stage_seconds[stage];
+            }
+        }
+    }
+
+    mask_processor_context_destroy(buffers->context);
+    free(buffers->mask);
+    free(buffers);
+    return NULL;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    const double da = *(const double*)a;
+    const double db = *(const double*)b;
+    return da < db ? -1 : (da > db ? 1 : 0);
+}
+
+// Nearest-rank percentile of count sorted values
+static double percentile(const double* sorted, int count, double fraction) {
+    int rank = (int)(fraction * count + 0.999999);
+    if (rank < 1) {
+        rank = 1;
+    }
+    return sorted[(rank > count ? count : rank) - 1];
+}
+
+static void report(const CliRun* run, const CliWorker* workers, int thread_count, double seconds) {
+    const int total = run->inputs->count;
+    double* sorted = (double*)malloc(sizeof(double) * (size_t)(total > 0 ? total : 1));
+    int done = 0;
+    for (int i = 0; i < total; i++) {
+        if (run->latencies[i] >= 0.0 && sorted) {
+            sorted[done++] = run->latencies[i];
+        }
+    }
+
+    printf("Processed %d of %d images in %.2f s with %d threads\n", done, total, seconds, thread_count);
+    if (done > 0 && sorted) {
+        qsort(sorted, (size_t)done, sizeof(double), compare_doubles);
+        printf("Throughput: %.2f images/s\n", done / seconds);
+        printf("Latency: p50 %.1f ms, p99 %.1f ms, max %.1f ms\n",
+               percentile(sorted, done, 0.50), percentile(sorted, done, 0.99), sorted[done - 1]);
+
+        printf("Mean per image:");
+        for (int stage = 0; stage < STAGE_COUNT; stage++) {
+            double stage_total = 0.0;
+            for (int t = 0; t < thread_count; t++) {
+                stage_total += workers[t].stage_seconds[stage];
+            }
+            printf("%s %s %.1f ms", stage ? "," : "", stage_names[stage], stage_total * 1000.0 / done);
+        }
+        printf("\n");
+    }
+    free(sorted);
+}
+
+static int parse_color(const char* text, RGBColor* color) {
+    if (text[0] == '#') {
+        text++;
+    }
+    if (strlen(text) != 6) {
+        return -1;
+    }
+    char* end = NULL;
+    const unsigned long value = strtoul(text, &end, 16);
+    if (*end != '\0') {
+        return -1;
+    }
+    color->r = (uint8_t)(value >> 16);
+    color->g = (uint8_t)(value >> 8);
+    color->b = (uint8_t)value;
+    return 0;
+}
+
+static int parse_int(const char* text, int min, int* value) {
+    char* end = NULL;
+    const long parsed = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || parsed < min || parsed > 1 << 16) {
+        return -1;
+    }
+    *value = (int)parsed;
+    return 0;
+}
+
+static void usage(FILE* out, const char* program) {
+    fprintf(out,
+            "Usage: %s [options] -o DIR [FILE|DIR]...\n"
+            "\n"
+            "Make a sticker from each PNG or JPEG image given, directly or as a\n"
+            "directory of them, and write it to DIR as <name>.png.\n"
+            "\n"
+            "  -o, --output DIR         Directory to write stickers to (created if missing)\n"
+            "  -l, --list FILE          Also read input paths from FILE, one per line (- for stdin)\n"
+            "  -m, --model FILE         Segmentation model (default %s)\n"
+            "  -t, --threads N          Images processed at once (default: online CPUs)\n"
+            "  -b, --border-width N     Border width in pixels (default %d)\n"
+            "  -c, --border-color RGB   Border color as RRGGBB hex (default FFFFFF)\n"
+            "      --no-border          Cut out the subject without a border\n"
+            "  -k, --kernel-size N      Mask smoothing kernel size (default %d)\n"
+            "  -h, --help               Show this help\n",
+            program, STICKER_MAKER_DEFAULT_MODEL, DEFAULT_BORDER_WIDTH, DEFAULT_KERNEL_SIZE);
+}
+
+int main(int argc, char** argv) {
+    static const struct option long_options[] = {
+        { "output", required_argument, NULL, 'o' },
+        { "list", required_argument, NULL, 'l' },
+        { "model", required_argument, NULL, 'm' },
+        { "threads", required_argument, NULL, 't' },
+        { "border-width", required_argument, NULL, 'b' },
+        { "border-color", required_argument, NULL, 'c' },
+        { "no-border", no_argument, NULL, 'n' },
+        { "kernel-size", required_argument, NULL, 'k' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    const long online = sysconf(_SC_NPROCESSORS_ONLN);
+    CliOptions options = {
+        NULL, STICKER_MAKER_DEFAULT_MODEL, online > 0 ? (int)online : 1,
+        DEFAULT_KERNEL_SIZE, 1, DEFAULT_BORDER_WIDTH, { 255, 255, 255 }
+    };
+    PathList inputs = { NULL, 0, 0 };
+    int status = 0;
+
+    int option;
+    while (status == 0 &&
+           (option = getopt_long(argc, argv, "o:l:m:t:b:c:k:h", long_options, NULL)) != -1) {
+        switch (option) {
+            case 'o': options.output_dir = optarg; break;
+            case 'l': status = add_list_file(&inputs, optarg) ? 2 : 0; break;
+            case 'm': options.model_path = optarg; break;
+            case 't': status = parse_int(optarg, 1, &options.threads) ? 2 : 0; break;
+            case 'b': status = parse_int(optarg, 0, &options.border_width) ? 2 : 0; break;
+            case 'c': status = parse_color(optarg, &options.border_color) ? 2 : 0; break;
+            case 'n': options.add_border = 0; break;
+            case 'k': status = parse_int(optarg, 1, &options.kernel_size) ? 2 : 0; break;
+            case 'h': usage(stdout, argv[0]); path_list_free(&inputs); return 0;
+            default: status = 2; break;
+        }
+    }
+    for (int i = optind; status == 0 && i < argc; i++) {
+        status = add_input(&inputs, argv[i]) ? 2 : 0;
+    }
+    if (status == 0 && (!options.output_dir || inputs.count == 0)) {
+        status = 2;
+    }
+    if (status != 0) {
+        usage(stderr, argv[0]);
+        path_list_free(&inputs);
+        return status;
+    }
+    if (mkdir(options.output_dir, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "%s: %s\n", options.output_dir, strerror(errno));
+        path_list_free(&inputs);
+        return 1;
+    }
+
+    char error[256] = "";
+    Segmenter* segmenter = NULL;
+    if (segmenter_create(&segmenter, options.model_path, 1, error, sizeof(error)) != 0) {
+        fprintf(stderr, "%s: %s\n", options.model_path, error);
+        path_list_free(&inputs);
+        return 1;
+    }
+
+    // No more threads than images; the pool serves whichever kernel call
+    // finds it free, and the others run on their calling thread
+    const int thread_count = options.threads < inputs.count ? options.threads : inputs.count;
+    mask_processor_set_thread_count(thread_count);
+
+    CliRun run = { &options, segmenter, &inputs, 0, NULL };
+    run.latencies = (double*)malloc(sizeof(double) * (size_t)inputs.count);
+    CliWorker* workers = (CliWorker*)calloc((size_t)thread_count, sizeof(CliWorker));
+    if (!run.latencies || !workers) {
+        fprintf(stderr, "out of memory\n");
+        status = 1;
+    }
+
+    if (status == 0) {
+        for (int i = 0; i < inputs.count; i++) {
+            run.latencies[i] = -1.0;
+        }
+
+        const double start = now_seconds();
+        int started = 0;
+        for (; started < thread_count; started++) {
+            workers[started].run = &run;
+            if (pthread_create(&workers[started].thread, NULL, worker_main, &workers[started]) != 0) {
+                break;
+            }
+        }
+        if (started == 0) {
+            // Run on this thread instead
+            workers[0].run = &run;
+            worker_main(&workers[0]);
+            started = 1;
+        } else {
+            for (int i = 0; i < started; i++) {
+                pthread_join(workers[i].thread, NULL);
+            }
+        }
+        const double seconds = now_seconds() - start;
+
+        report(&run, workers, started, seconds);
+        for (int i = 0; i < inputs.count; i++) {
+            if (run.latencies[i] < 0.0) {
+                status = 1;
+            }
+        }
+    }
+
+    free(workers);
+    free(run.latencies);
+    segmenter_destroy(segmenter);
+    path_list_free(&inputs);
+    return status;
+}
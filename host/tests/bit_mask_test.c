@@ -0,0 +1,204 @@
+// Packed bit masks against the double kernels: threshold, OR/AND, dilation
+// and the packed composite
+
+#include "bit_mask.h"
+#include "test_support.h"
+#include <string.h>
+
+static const int widths[] = { 1, 5, 63, 64, 65, 127, 130, 200 };
+static const int heights[] = { 1, 6, 70 };
+
+static int get_bit(const BitMask* mask, int x, int y) {
+    return (int)((mask->words[(size_t)y * mask->words_per_row + (x >> 6)] >> (x & 63)) & 1);
+}
+
+// Bits past the width must stay clear
+static int padding_clear(const BitMask* mask) {
+    const int tail = mask->width & 63;
+    if (!tail) {
+        return 1;
+    }
+    for (int y = 0; y < mask->height; y++) {
+        if (mask->words[(size_t)y * mask->words_per_row + mask->words_per_row - 1] >> tail) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void check_logic(const double* mask, int width, int height, TestMaskKind kind) {
+    BitMask a, b, out;
+    memset(&a, 0, sizeof(a));
+    memset(&b, 0, sizeof(b));
+    memset(&out, 0, sizeof(out));
+    if (bit_mask_create(&a, width, height) != MASK_PROCESSOR_SUCCESS ||
+        bit_mask_create(&b, width, height) != MASK_PROCESSOR_SUCCESS ||
+        bit_mask_create(&out, width, height) != MASK_PROCESSOR_SUCCESS) {
+        CHECK(0, "bit_mask_create %dx%d failed", width, height);
+        goto done;
+    }
+
+    static const double levels[] = { 0.0, 0.25, 0.5, 0.75, 1.0 };
+    for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++) {
+        CHECK(bit_mask_threshold(&a, mask, levels[l]) == MASK_PROCESSOR_SUCCESS,
+              "bit_mask_threshold failed");
+        int wrong = 0;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                wrong += get_bit(&a, x, y) != (mask[(size_t)y * width + x] > levels[l]);
+            }
+        }
+        CHECK(wrong == 0 && padding_clear(&a), "bit_mask_threshold %s %dx%d t=%g: %d wrong bits",
+              test_mask_names[kind], width, height, levels[l], wrong);
+    }
+
+    bit_mask_threshold(&a, mask, 0.3);
+    bit_mask_threshold(&b, mask, 0.6);
+    for (int op = 0; op < 2; op++) {
+        // Into a separate mask, then in place over the first input
+        for (int in_place = 0; in_place <= 1; in_place++) {
+            BitMask* target = in_place ? &a : &out;
+            BitMask copy = a;
+            uint64_t* saved = (uint64_t*)malloc(sizeof(uint64_t) * a.words_per_row * height);
+            if (!saved) {
+                CHECK(0, "out of memory");
+                continue;
+            }
+            memcpy(saved, a.words, sizeof(uint64_t) * a.words_per_row * height);
+            copy.words = saved;
+
+            const MaskProcessorResult result = op ? bit_mask_and(target, &a, &b) : bit_mask_or(target, &a, &b);
+            CHECK(result == MASK_PROCESSOR_SUCCESS, "bit_mask_%s failed", op ? "and" : "or");
+            int wrong = 0;
+            for (int y = 0; y < height; y++) {
+                for (int x = 0; x < width; x++) {
+                    const int expected = op ? get_bit(&copy, x, y) & get_bit(&b, x, y)
+                                            : get_bit(&copy, x, y) | get_bit(&b, x, y);
+                    wrong += get_bit(target, x, y) != expected;
+                }
+            }
+            CHECK(wrong == 0 && padding_clear(target), "bit_mask_%s %s %dx%d in_place=%d: %d wrong bits",
+                  op ? "and" : "or", test_mask_names[kind], width, height, in_place, wrong);
+
+            memcpy(a.words, saved, sizeof(uint64_t) * a.words_per_row * height);
+            free(saved);
+        }
+    }
+
+    // Mismatched sizes are rejected
+    BitMask other;
+    if (bit_mask_create(&other, width + 1, height) == MASK_PROCESSOR_SUCCESS) {
+        CHECK(bit_mask_or(&out, &a, &other) == MASK_PROCESSOR_ERROR_INVALID_PARAMS,
+              "bit_mask_or accepted masks of different sizes");
+        CHECK(bit_mask_and(&out, &other, &b) == MASK_PROCESSOR_ERROR_INVALID_PARAMS,
+              "bit_mask_and accepted masks of different sizes");
+        bit_mask_destroy(&other);
+    }
+
+done:
+    bit_mask_destroy(&a);
+    bit_mask_destroy(&b);
+    bit_mask_destroy(&out);
+}
+
+static void check_expand_apply(const double* mask, int width, int height, int radius,
+                               TestMaskKind kind) {
+    const size_t n = (size_t)width * height;
+    const RGBColor color = { 9, 180, 33 };
+    double* expanded = (double*)malloc(sizeof(double) * n);
+    uint8_t* source = (uint8_t*)malloc(n * 4);
+    uint8_t* expected = (uint8_t*)malloc(n * 4);
+    uint8_t* actual = (uint8_t*)malloc(n * 4);
+    BitMask packed, seeds, dilated;
+    memset(&packed, 0, sizeof(packed));
+    memset(&seeds, 0, sizeof(seeds));
+    memset(&dilated, 0, sizeof(dilated));
+    if (!expanded || !source || !expected || !actual ||
+        bit_mask_create(&packed, width, height) != MASK_PROCESSOR_SUCCESS ||
+        bit_mask_create(&seeds, width, height) != MASK_PROCESSOR_SUCCESS ||
+        bit_mask_create(&dilated, width, height) != MASK_PROCESSOR_SUCCESS) {
+        CHECK(0, "out of memory");
+        goto done;
+    }
+
+    CHECK(expand_mask_native(mask, expanded, width, height, radius) == MASK_PROCESSOR_SUCCESS,
+          "expand_mask_native %dx%d r=%d failed", width, height, radius);
+    CHECK(expand_mask_packed(mask, &packed, radius) == MASK_PROCESSOR_SUCCESS,
+          "expand_mask_packed %dx%d r=%d failed", width, height, radius);
+    bit_mask_threshold(&seeds, mask, 0.5);
+    CHECK(bit_mask_dilate(&dilated, &seeds, radius) == MASK_PROCESSOR_SUCCESS,
+          "bit_mask_dilate %dx%d r=%d failed", width, height, radius);
+
+    int wrong = 0;
+    int wrong_dilate = 0;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            const int bit = expanded[(size_t)y * width + x] > 0.5;
+            wrong += get_bit(&packed, x, y) != bit;
+            wrong_dilate += get_bit(&dilated, x, y) != bit;
+        }
+    }
+    CHECK(wrong == 0 && padding_clear(&packed), "expand_mask_packed %s %dx%d r=%d: %d wrong bits",
+          test_mask_names[kind], width, height, radius, wrong);
+    CHECK(wrong_dilate == 0 && padding_clear(&dilated), "bit_mask_dilate %s %dx%d r=%d: %d wrong bits",
+          test_mask_names[kind], width, height, radius, wrong_dilate);
+
+    test_fill_pixels(source, n * 4);
+    for (int add_border = 0; add_border <= 1; add_border++) {
+        memcpy(expected, source, n * 4);
+        apply_sticker_mask_native(expected, mask, width, height, add_border, color, radius, expanded);
+
+        memcpy(actual, source, n * 4);
+        CHECK(apply_sticker_mask_packed(actual, mask, width, height, add_border, color,
+                                        &packed) == MASK_PROCESSOR_SUCCESS,
+              "apply_sticker_mask_packed %dx%d failed", width, height);
+        CHECK(memcmp(expected, actual, n * 4) == 0,
+              "apply_sticker_mask_packed %s %dx%d r=%d border=%d differs", test_mask_names[kind],
+              width, height, radius, add_border);
+
+        memset(actual, 0, n * 4);
+        CHECK(apply_sticker_mask_packed_to(source, actual, mask, width, height, add_border, color,
+                                           &packed) == MASK_PROCESSOR_SUCCESS,
+              "apply_sticker_mask_packed_to %dx%d failed", width, height);
+        CHECK(memcmp(expected, actual, n * 4) == 0,
+              "apply_sticker_mask_packed_to %s %dx%d r=%d border=%d differs", test_mask_names[kind],
+              width, height, radius, add_border);
+    }
+
+done:
+    free(expanded);
+    free(source);
+    free(expected);
+    free(actual);
+    bit_mask_destroy(&packed);
+    bit_mask_destroy(&seeds);
+    bit_mask_destroy(&dilated);
+}
+
+int main(void) {
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+        for (size_t h = 0; h < sizeof(heights) / sizeof(heights[0]); h++) {
+            const int width = widths[w];
+            const int height = heights[h];
+            double* mask = (double*)malloc(sizeof(double) * width * height);
+            if (!mask) {
+                CHECK(0, "out of memory");
+                continue;
+            }
+
+            // Radius 0 and 1, a few in between, and radii reaching past the
+            // image in one or both directions
+            const int radii[] = { 0, 1, 2, 5, 17, width, width + 3, width + height + 1 };
+            for (int kind = 0; kind < TEST_MASK_KIND_COUNT; kind++) {
+                test_fill_mask(mask, width, height, (TestMaskKind)kind);
+                check_logic(mask, width, height, (TestMaskKind)kind);
+                for (size_t r = 0; r < sizeof(radii) / sizeof(radii[0]); r++) {
+                    check_expand_apply(mask, width, height, radii[r], (TestMaskKind)kind);
+                }
+            }
+            free(mask);
+        }
+    }
+
+    return TEST_RESULT();
+}
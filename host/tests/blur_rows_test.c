@@ -0,0 +1,181 @@
+// The banded, tiled and streamed blurs against smooth_mask_optimized at
+// every kernel size, on both sides of MASK_PROCESSOR_DIRECT_SUM_MAX_KERNEL,
+// and the fused and streamed stickers against the separate stages
+
+#include "simd_optimizations.h"
+#include "sticker_pipeline.h"
+#include "test_support.h"
+#include <math.h>
+#include <string.h>
+
+// Quantized running sums against the unquantized ones of smooth_mask_native
+#define RUNNING_SUM_TOLERANCE 1e-13
+
+static const int sizes[][2] = { { 1, 1 }, { 9, 1 }, { 1, 9 }, { 7, 5 }, { 65, 33 }, { 300, 70 } };
+static const int kernel_sizes[] = { 1, 3, 9, 11, 13, 15, 31, 61 };
+static const int band_rows[] = { 1, 7, 64 };
+
+static const MaskProcessorIsa isas[] = {
+    MASK_PROCESSOR_ISA_SCALAR, MASK_PROCESSOR_ISA_SSE2, MASK_PROCESSOR_ISA_AVX2,
+    MASK_PROCESSOR_ISA_AVX512, MASK_PROCESSOR_ISA_NEON
+};
+static const char* const isa_names[] = { "scalar", "sse2", "avx2", "avx512", "neon" };
+
+static double max_difference(const double* a, const double* b, size_t n) {
+    double worst = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        const double difference = fabs(a[i] - b[i]);
+        if (difference > worst || isnan(difference)) {
+            worst = isnan(difference) ? INFINITY : difference;
+        }
+    }
+    return worst;
+}
+
+static void check_smooth(const double* mask, int width, int height, int kernel_size,
+                         const char* label) {
+    const size_t n = (size_t)width * height;
+    double* expected = (double*)malloc(sizeof(double) * n);
+    double* actual = (double*)malloc(sizeof(double) * n);
+    double* scratch = (double*)malloc(sizeof(double) * (n + (size_t)kernel_size * width));
+    if (!expected || !actual || !scratch) {
+        CHECK(0, "out of memory");
+        goto done;
+    }
+
+    CHECK(smooth_mask_optimized(mask, expected, width, height, kernel_size) ==
+          MASK_PROCESSOR_SUCCESS, "smooth_mask_optimized %dx%d k=%d failed", width, height,
+          kernel_size);
+
+    for (size_t b = 0; b < sizeof(band_rows) / sizeof(band_rows[0]); b++) {
+        for (int y = 0; y < height; y += band_rows[b]) {
+            const int y_end = y + band_rows[b] > height ? height : y + band_rows[b];
+            CHECK(smooth_mask_rows_optimized(mask, actual + (size_t)y * width, scratch, width,
+                                             height, kernel_size, y, y_end) ==
+                  MASK_PROCESSOR_SUCCESS,
+                  "smooth_mask_rows_optimized %dx%d k=%d failed", width, height, kernel_size);
+        }
+        CHECK(memcmp(actual, expected, sizeof(double) * n) == 0,
+              "%s %dx%d k=%d: %d-row bands differ from smooth_mask_optimized by %g", label, width,
+              height, kernel_size, band_rows[b], max_difference(actual, expected, n));
+    }
+
+    CHECK(smooth_mask_tiled(mask, actual, width, height, kernel_size) == MASK_PROCESSOR_SUCCESS,
+          "smooth_mask_tiled %dx%d k=%d failed", width, height, kernel_size);
+    CHECK(memcmp(actual, expected, sizeof(double) * n) == 0,
+          "%s %dx%d k=%d: tiles differ from smooth_mask_optimized by %g", label, width, height,
+          kernel_size, max_difference(actual, expected, n));
+
+    if (kernel_size > MASK_PROCESSOR_DIRECT_SUM_MAX_KERNEL) {
+        CHECK(smooth_mask_native(mask, actual, width, height, kernel_size) ==
+              MASK_PROCESSOR_SUCCESS, "smooth_mask_native %dx%d k=%d failed", width, height,
+              kernel_size);
+        CHECK(max_difference(actual, expected, n) <= RUNNING_SUM_TOLERANCE,
+              "%s %dx%d k=%d: running sums differ from smooth_mask_native by %g", label, width,
+              height, kernel_size, max_difference(actual, expected, n));
+    }
+
+done:
+    free(expected);
+    free(actual);
+    free(scratch);
+}
+
+// Separate stages, fused call and stream, pushed in uneven chunks
+static void check_sticker(const uint8_t* source, const double* mask, int width, int height,
+                          int kernel_size, const char* label) {
+    const size_t n = (size_t)width * height;
+    const RGBColor color = { 30, 200, 90 };
+    const int border_width = 3;
+    double* smoothed = (double*)malloc(sizeof(double) * n);
+    double* expanded = (double*)malloc(sizeof(double) * n);
+    uint8_t* expected = (uint8_t*)malloc(n * 4);
+    uint8_t* actual = (uint8_t*)malloc(n * 4);
+    StickerStream* stream = NULL;
+    if (!smoothed || !expanded || !expected || !actual) {
+        CHECK(0, "out of memory");
+        goto done;
+    }
+
+    CHECK(smooth_mask_optimized(mask, smoothed, width, height, kernel_size) ==
+          MASK_PROCESSOR_SUCCESS &&
+          expand_mask_native(smoothed, expanded, width, height, border_width) ==
+          MASK_PROCESSOR_SUCCESS &&
+          apply_sticker_mask_to_optimized(source, expected, smoothed, width, height, 1, color,
+                                          border_width, expanded) == MASK_PROCESSOR_SUCCESS,
+          "separate stages %dx%d k=%d failed", width, height, kernel_size);
+
+    CHECK(make_sticker_mask_fused(source, actual, mask, width, height, kernel_size, 1, color,
+                                  border_width) == MASK_PROCESSOR_SUCCESS,
+          "make_sticker_mask_fused %dx%d k=%d failed", width, height, kernel_size);
+    CHECK(memcmp(actual, expected, n * 4) == 0,
+          "%s %dx%d k=%d: fused sticker differs from the separate stages", label, width, height,
+          kernel_size);
+
+    memset(actual, 0, n * 4);
+    CHECK(sticker_stream_create(&stream, width, height, kernel_size, 1, color, border_width) ==
+          MASK_PROCESSOR_SUCCESS, "sticker_stream_create %dx%d k=%d failed", width, height,
+          kernel_size);
+    if (stream) {
+        int written = 0;
+        for (int y = 0, chunk = 1; y < height; y += chunk, chunk = chunk % 5 + 1) {
+            const int rows = y + chunk > height ? height - y : chunk;
+            int output_rows = 0;
+            CHECK(sticker_stream_push(stream, source + (size_t)y * width * 4,
+                                      mask + (size_t)y * width, rows,
+                                      actual + (size_t)written * width * 4, &output_rows) ==
+                  MASK_PROCESSOR_SUCCESS, "sticker_stream_push %dx%d k=%d failed", width, height,
+                  kernel_size);
+            written += output_rows;
+        }
+        CHECK(written == height, "%s %dx%d k=%d: stream wrote %d rows", label, width, height,
+              kernel_size, written);
+        CHECK(memcmp(actual, expected, n * 4) == 0,
+              "%s %dx%d k=%d: streamed sticker differs from the separate stages", label, width,
+              height, kernel_size);
+        sticker_stream_destroy(stream);
+    }
+
+done:
+    free(smoothed);
+    free(expanded);
+    free(expected);
+    free(actual);
+}
+
+int main(void) {
+    for (size_t i = 0; i < sizeof(isas) / sizeof(isas[0]); i++) {
+        if (mask_processor_select_isa(isas[i]) != MASK_PROCESSOR_SUCCESS) {
+            continue;
+        }
+
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            const int width = sizes[s][0];
+            const int height = sizes[s][1];
+            const size_t n = (size_t)width * height;
+            uint8_t* source = (uint8_t*)malloc(n * 4);
+            double* mask = (double*)malloc(sizeof(double) * n);
+            if (!source || !mask) {
+                CHECK(0, "out of memory");
+                free(source);
+                free(mask);
+                continue;
+            }
+            test_fill_pixels(source, n * 4);
+
+            for (int kind = 0; kind < TEST_MASK_KIND_COUNT; kind++) {
+                char label[64];
+                snprintf(label, sizeof(label), "%s %s", isa_names[i], test_mask_names[kind]);
+                test_fill_mask(mask, width, height, (TestMaskKind)kind);
+                for (size_t k = 0; k < sizeof(kernel_sizes) / sizeof(kernel_sizes[0]); k++) {
+                    check_smooth(mask, width, height, kernel_sizes[k], label);
+                    check_sticker(source, mask, width, height, kernel_sizes[k], label);
+                }
+            }
+            free(source);
+            free(mask);
+        }
+    }
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,216 @@
+// Heap allocations of the *_ctx pipeline: after warm-up a sticker must not
+// reach malloc, calloc or realloc on any thread. Linked with
+// -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc so every call the library
+// makes lands in the counters below.
+
+#include "processor_context.h"
+#include "sticker_pipeline.h"
+#include "test_support.h"
+#include <string.h>
+
+void* __real_malloc(size_t bytes);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* pointer, size_t bytes);
+
+static int counting = 0;
+static uint64_t allocations = 0;
+
+static void count_allocation(void) {
+    if (__atomic_load_n(&counting, __ATOMIC_RELAXED)) {
+        __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+    }
+}
+
+void* __wrap_malloc(size_t bytes) {
+    count_allocation();
+    return __real_malloc(bytes);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    count_allocation();
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* pointer, size_t bytes) {
+    count_allocation();
+    return __real_realloc(pointer, bytes);
+}
+
+enum { TENSOR_SIZE = 160, BATCH_COUNT = 3, WARM_UP = 2, RUNS = 4 };
+
+static const float mean[3] = { 0.485f, 0.456f, 0.406f };
+static const float inv_std[3] = { 1.0f / 0.229f, 1.0f / 0.224f, 1.0f / 0.225f };
+static const RGBColor white = { 255, 255, 255 };
+
+typedef struct {
+    int width;
+    int height;
+    uint8_t* pixels;
+    uint8_t* output;
+    uint8_t* batch_output[BATCH_COUNT];
+    double* mask;
+    double* upsampled;
+    double* smoothed;
+    double* expanded;
+    float* sdf;
+    float* tensor;
+    float* normalized;
+} Frame;
+
+static int frame_create(Frame* frame, int width, int height) {
+    const size_t n = (size_t)width * height;
+    memset(frame, 0, sizeof(*frame));
+    frame->width = width;
+    frame->height = height;
+    frame->pixels = (uint8_t*)malloc(n * 4);
+    frame->output = (uint8_t*)malloc(n * 4);
+    for (int i = 0; i < BATCH_COUNT; i++) {
+        frame->batch_output[i] = (uint8_t*)malloc(n * 4);
+        if (!frame->batch_output[i]) {
+            return 0;
+        }
+    }
+    frame->mask = (double*)malloc(sizeof(double) * n);
+    frame->upsampled = (double*)malloc(sizeof(double) * n);
+    frame->smoothed = (double*)malloc(sizeof(double) * n);
+    frame->expanded = (double*)malloc(sizeof(double) * n);
+    frame->sdf = (float*)malloc(sizeof(float) * n);
+    frame->tensor = (float*)malloc(sizeof(float) * TENSOR_SIZE * TENSOR_SIZE);
+    frame->normalized = (float*)malloc(sizeof(float) * 3 * TENSOR_SIZE * TENSOR_SIZE);
+    if (!frame->pixels || !frame->output || !frame->mask || !frame->upsampled ||
+        !frame->smoothed || !frame->expanded || !frame->sdf || !frame->tensor ||
+        !frame->normalized) {
+        return 0;
+    }
+
+    test_fill_pixels(frame->pixels, n * 4);
+    test_fill_mask(frame->mask, width, height, TEST_MASK_BLOBS);
+    for (int i = 0; i < TENSOR_SIZE * TENSOR_SIZE; i++) {
+        frame->tensor[i] = (float)(test_random_unit() * 8.0 - 4.0);
+    }
+    return 1;
+}
+
+static void frame_destroy(Frame* frame) {
+    free(frame->pixels);
+    free(frame->output);
+    for (int i = 0; i < BATCH_COUNT; i++) {
+        free(frame->batch_output[i]);
+    }
+    free(frame->mask);
+    free(frame->upsampled);
+    free(frame->smoothed);
+    free(frame->expanded);
+    free(frame->sdf);
+    free(frame->tensor);
+    free(frame->normalized);
+}
+
+// Every stage of a sticker through the context, as the Dart pipeline runs it
+static int sticker(MaskProcessorContext* context, Frame* frame) {
+    const int width = frame->width;
+    const int height = frame->height;
+    int ok = 1;
+
+    ok &= resize_rgba_to_nchw_ctx(context, frame->pixels, width, height, frame->normalized,
+                                  TENSOR_SIZE, TENSOR_SIZE, mean, inv_std) == MASK_PROCESSOR_SUCCESS;
+    ok &= upsample_mask_tensor_ctx(context, frame->tensor, TENSOR_SIZE, TENSOR_SIZE,
+                                   frame->upsampled, MASK_OUTPUT_FLOAT64, width, height, 1,
+                                   0.0) == MASK_PROCESSOR_SUCCESS;
+    ok &= smooth_mask_ctx(context, frame->mask, frame->smoothed, width, height, 5) ==
+          MASK_PROCESSOR_SUCCESS;
+    ok &= expand_mask_ctx(context, frame->mask, frame->expanded, width, height, 12) ==
+          MASK_PROCESSOR_SUCCESS;
+    ok &= compute_mask_sdf_ctx(context, frame->smoothed, frame->sdf, width, height) ==
+          MASK_PROCESSOR_SUCCESS;
+    ok &= make_sticker_mask_fused_ctx(context, frame->pixels, frame->output, frame->mask, width,
+                                      height, 5, 1, white, 12) == MASK_PROCESSOR_SUCCESS;
+
+    StickerBatchItem items[BATCH_COUNT];
+    int32_t results[BATCH_COUNT];
+    for (int i = 0; i < BATCH_COUNT; i++) {
+        items[i].src = frame->pixels;
+        items[i].dst = frame->batch_output[i];
+        items[i].mask = frame->mask;
+        items[i].width = width;
+        items[i].height = height;
+    }
+    ok &= make_stickers_batch_ctx(context, items, BATCH_COUNT, results, 5, 1, white, 12) ==
+          MASK_PROCESSOR_SUCCESS;
+    for (int i = 0; i < BATCH_COUNT; i++) {
+        ok &= results[i] == MASK_PROCESSOR_SUCCESS;
+    }
+    return ok;
+}
+
+static void check_config(int threads, int width, int height, const char* label) {
+    Frame frame;
+    MaskProcessorContext* context = NULL;
+    memset(&frame, 0, sizeof(frame));
+    uint8_t* reference = (uint8_t*)malloc((size_t)width * height * 4);
+    if (!reference || !frame_create(&frame, width, height) ||
+        mask_processor_context_create(&context, threads) != MASK_PROCESSOR_SUCCESS) {
+        CHECK(0, "setup failed for %dx%d at %d threads", width, height, threads);
+        free(reference);
+        frame_destroy(&frame);
+        return;
+    }
+
+    for (int i = 0; i < WARM_UP; i++) {
+        CHECK(sticker(context, &frame), "warm-up sticker failed");
+    }
+    const uint64_t context_before = mask_processor_context_heap_allocations(context);
+
+    __atomic_store_n(&allocations, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&counting, 1, __ATOMIC_RELAXED);
+    for (int i = 0; i < RUNS; i++) {
+        CHECK(sticker(context, &frame), "sticker failed");
+    }
+    __atomic_store_n(&counting, 0, __ATOMIC_RELAXED);
+
+    const uint64_t counted = __atomic_load_n(&allocations, __ATOMIC_RELAXED);
+    CHECK(counted == 0, "%s %dx%d at %d threads: %llu heap allocations in %d stickers after warm-up",
+          label, width, height, threads, (unsigned long long)counted, RUNS);
+    CHECK(mask_processor_context_heap_allocations(context) == context_before,
+          "%s %dx%d at %d threads: context counter grew after warm-up", label, width, height,
+          threads);
+
+    // The context path must not trade correctness for its scratch
+    make_sticker_mask_fused(frame.pixels, reference, frame.mask, width, height, 5, 1, white, 12);
+    CHECK(memcmp(reference, frame.output, (size_t)width * height * 4) == 0,
+          "%s %dx%d at %d threads: fused output differs from the plain kernel", label, width,
+          height, threads);
+    for (int i = 0; i < BATCH_COUNT; i++) {
+        CHECK(memcmp(reference, frame.batch_output[i], (size_t)width * height * 4) == 0,
+              "%s %dx%d at %d threads: batch image %d differs from the plain kernel", label, width,
+              height, threads, i);
+    }
+
+    mask_processor_context_destroy(context);
+    free(reference);
+    frame_destroy(&frame);
+}
+
+int main(void) {
+    static const int thread_counts[] = { 1, 2, 4 };
+    static const int sizes[][2] = { { 97, 61 }, { 640, 480 } };
+
+    for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            mask_processor_set_tiling(1);
+            mask_processor_set_cache_size(0);
+            check_config(thread_counts[t], sizes[s][0], sizes[s][1], "default");
+
+            // Small tiles take the tiled kernels and their per-tile scratch
+            mask_processor_set_cache_size(16 * 1024);
+            check_config(thread_counts[t], sizes[s][0], sizes[s][1], "small tiles");
+
+            mask_processor_set_tiling(0);
+            mask_processor_set_cache_size(0);
+            check_config(thread_counts[t], sizes[s][0], sizes[s][1], "untiled");
+        }
+    }
+    mask_processor_set_tiling(1);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,177 @@
+// Every ISA the CPU supports against the scalar table, through
+// mask_processor_select_isa and the dispatched entry points: apply with and
+// without a border, smooth and expand must be bit-identical
+
+#include "simd_optimizations.h"
+#include "test_support.h"
+#include <math.h>
+#include <string.h>
+
+static const int sizes[][2] = { { 1, 1 }, { 7, 5 }, { 65, 3 }, { 1023, 517 } };
+static const int kernel_sizes[] = { 1, 3, 5, 11, 15 };
+static const int border_widths[] = { 0, 1, 4, 12 };
+
+static const MaskProcessorIsa isas[] = {
+    MASK_PROCESSOR_ISA_SSE2, MASK_PROCESSOR_ISA_AVX2, MASK_PROCESSOR_ISA_AVX512,
+    MASK_PROCESSOR_ISA_NEON
+};
+static const char* const isa_names[] = { "sse2", "avx2", "avx512", "neon" };
+
+// Mask values exactly on the class thresholds and one ulp either side
+static const double threshold_values[] = { 0.45, 0.5, 0.55 };
+
+enum {
+    KERNEL_COUNT = sizeof(kernel_sizes) / sizeof(kernel_sizes[0]),
+    BORDER_COUNT = sizeof(border_widths) / sizeof(border_widths[0]),
+    // With a border and the caller's expanded mask, with a border and
+    // none, and without a border
+    APPLY_COUNT = 3,
+    MASK_COUNT = TEST_MASK_KIND_COUNT + 1
+};
+
+static const char* const apply_names[APPLY_COUNT] = {
+    "border, expanded mask", "border, no expanded mask", "no border"
+};
+
+typedef struct {
+    uint8_t* apply[APPLY_COUNT];
+    double* smooth[KERNEL_COUNT];
+    double* expand[BORDER_COUNT];
+} Outputs;
+
+static int outputs_create(Outputs* outputs, size_t n) {
+    int ok = 1;
+    memset(outputs, 0, sizeof(*outputs));
+    for (int i = 0; i < APPLY_COUNT; i++) {
+        ok &= (outputs->apply[i] = (uint8_t*)malloc(n * 4)) != NULL;
+    }
+    for (int i = 0; i < KERNEL_COUNT; i++) {
+        ok &= (outputs->smooth[i] = (double*)malloc(sizeof(double) * n)) != NULL;
+    }
+    for (int i = 0; i < BORDER_COUNT; i++) {
+        ok &= (outputs->expand[i] = (double*)malloc(sizeof(double) * n)) != NULL;
+    }
+    return ok;
+}
+
+static void outputs_destroy(Outputs* outputs) {
+    for (int i = 0; i < APPLY_COUNT; i++) {
+        free(outputs->apply[i]);
+    }
+    for (int i = 0; i < KERNEL_COUNT; i++) {
+        free(outputs->smooth[i]);
+    }
+    for (int i = 0; i < BORDER_COUNT; i++) {
+        free(outputs->expand[i]);
+    }
+}
+
+static void fill_threshold_mask(double* mask, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        const double value = threshold_values[test_random() % 3];
+        switch (test_random() % 4) {
+        case 0: mask[i] = nextafter(value, 0.0); break;
+        case 1: mask[i] = nextafter(value, 1.0); break;
+        default: mask[i] = value; break;
+        }
+    }
+}
+
+// Every dispatched kernel with the active table
+static void run_kernels(Outputs* outputs, const uint8_t* source, const double* mask,
+                        int width, int height) {
+    const RGBColor color = { 12, 200, 77 };
+    const int border_width = 4;
+
+    CHECK(expand_mask_optimized(mask, outputs->expand[2], width, height, border_width) ==
+          MASK_PROCESSOR_SUCCESS, "expand_mask_optimized %dx%d failed", width, height);
+    CHECK(apply_sticker_mask_to_optimized(source, outputs->apply[0], mask, width, height, 1,
+                                          color, border_width, outputs->expand[2]) ==
+          MASK_PROCESSOR_SUCCESS, "apply with expanded mask %dx%d failed", width, height);
+    CHECK(apply_sticker_mask_to_optimized(source, outputs->apply[1], mask, width, height, 1,
+                                          color, border_width, NULL) == MASK_PROCESSOR_SUCCESS,
+          "apply without expanded mask %dx%d failed", width, height);
+    memcpy(outputs->apply[2], source, (size_t)width * height * 4);
+    CHECK(apply_sticker_mask_optimized(outputs->apply[2], mask, width, height, 0, color,
+                                       border_width, NULL) == MASK_PROCESSOR_SUCCESS,
+          "apply without border %dx%d failed", width, height);
+
+    for (int k = 0; k < KERNEL_COUNT; k++) {
+        CHECK(smooth_mask_optimized(mask, outputs->smooth[k], width, height, kernel_sizes[k]) ==
+              MASK_PROCESSOR_SUCCESS, "smooth_mask_optimized %dx%d k=%d failed", width, height,
+              kernel_sizes[k]);
+    }
+    for (int b = 0; b < BORDER_COUNT; b++) {
+        CHECK(expand_mask_optimized(mask, outputs->expand[b], width, height, border_widths[b]) ==
+              MASK_PROCESSOR_SUCCESS, "expand_mask_optimized %dx%d b=%d failed", width, height,
+              border_widths[b]);
+    }
+}
+
+static void compare_outputs(const Outputs* expected, const Outputs* actual, size_t n,
+                            const char* label) {
+    for (int i = 0; i < APPLY_COUNT; i++) {
+        CHECK(memcmp(expected->apply[i], actual->apply[i], n * 4) == 0,
+              "%s: apply (%s) differs from scalar", label, apply_names[i]);
+    }
+    for (int k = 0; k < KERNEL_COUNT; k++) {
+        CHECK(memcmp(expected->smooth[k], actual->smooth[k], sizeof(double) * n) == 0,
+              "%s: smooth k=%d differs from scalar", label, kernel_sizes[k]);
+    }
+    for (int b = 0; b < BORDER_COUNT; b++) {
+        CHECK(memcmp(expected->expand[b], actual->expand[b], sizeof(double) * n) == 0,
+              "%s: expand b=%d differs from scalar", label, border_widths[b]);
+    }
+}
+
+int main(void) {
+    const MaskProcessorIsa active = mask_processor_get_active_isa();
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        const int width = sizes[s][0];
+        const int height = sizes[s][1];
+        const size_t n = (size_t)width * height;
+        uint8_t* source = (uint8_t*)malloc(n * 4);
+        double* mask = (double*)malloc(sizeof(double) * n);
+        Outputs expected;
+        Outputs actual;
+        if (!source || !mask || !outputs_create(&expected, n) || !outputs_create(&actual, n)) {
+            CHECK(0, "out of memory");
+            return TEST_RESULT();
+        }
+        test_fill_pixels(source, n * 4);
+
+        for (int kind = 0; kind < MASK_COUNT; kind++) {
+            const char* mask_name = kind < TEST_MASK_KIND_COUNT ? test_mask_names[kind]
+                                                                : "thresholds";
+            if (kind < TEST_MASK_KIND_COUNT) {
+                test_fill_mask(mask, width, height, (TestMaskKind)kind);
+            } else {
+                fill_threshold_mask(mask, n);
+            }
+
+            CHECK(mask_processor_select_isa(MASK_PROCESSOR_ISA_SCALAR) == MASK_PROCESSOR_SUCCESS,
+                  "the scalar table must always be available");
+            run_kernels(&expected, source, mask, width, height);
+
+            for (size_t i = 0; i < sizeof(isas) / sizeof(isas[0]); i++) {
+                if (mask_processor_select_isa(isas[i]) != MASK_PROCESSOR_SUCCESS) {
+                    continue;
+                }
+                char label[96];
+                snprintf(label, sizeof(label), "%s %s %dx%d", isa_names[i], mask_name, width,
+                         height);
+                run_kernels(&actual, source, mask, width, height);
+                compare_outputs(&expected, &actual, n, label);
+            }
+        }
+
+        outputs_destroy(&expected);
+        outputs_destroy(&actual);
+        free(source);
+        free(mask);
+    }
+
+    mask_processor_select_isa(active);
+    return TEST_RESULT();
+}
@@ -0,0 +1,240 @@
+// The on-disk mask cache: hits keep the index log bounded, the rewritten
+// log keeps every mask and the LRU order across a reopen, lookups stay
+// right when many keys share a hash slot and entries are evicted under
+// them, and puts queued with mask_cache_put_async land and post
+
+#include "async_jobs.h"
+#include "mask_cache.h"
+#include "test_support.h"
+#include <dirent.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+enum { SIZE = 32, MASKS = 50, HITS_PER_MASK = 400 };
+
+static char directory[] = "/tmp/mask_cache_test.XXXXXX";
+
+static void fill_mask(double* mask, int seed) {
+    for (int i = 0; i < SIZE * SIZE; i++) {
+        mask[i] = (double)((seed * 131 + i * 7) % 256) / 255.0;
+    }
+}
+
+static MaskHash128 key_for(int seed) {
+    // Equal low bits, so every key starts probing at the same slot
+    MaskHash128 key = { (uint64_t)seed << 40, 0x9E3779B97F4A7C15ULL * (uint64_t)(seed + 1) };
+    return key;
+}
+
+static long file_size(const char* name) {
+    char path[256];
+    struct stat info;
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+    return stat(path, &info) == 0 ? (long)info.st_size : -1;
+}
+
+static int lookup(MaskCache* cache, int seed, int check_values) {
+    double expected[SIZE * SIZE];
+    double actual[SIZE * SIZE];
+    const MaskHash128 key = key_for(seed);
+    int found = 0;
+    CHECK(mask_cache_get(cache, &key, actual, SIZE, SIZE, &found) == MASK_PROCESSOR_SUCCESS,
+          "mask_cache_get %d failed", seed);
+    if (found && check_values) {
+        fill_mask(expected, seed);
+        CHECK(memcmp(expected, actual, sizeof(expected)) == 0, "mask %d decoded wrong", seed);
+    }
+    return found;
+}
+
+static void remove_directory(void) {
+    DIR* dir = opendir(directory);
+    if (!dir) {
+        return;
+    }
+    struct dirent* item;
+    while ((item = readdir(dir)) != NULL) {
+        if (strcmp(item->d_name, ".") != 0 && strcmp(item->d_name, "..") != 0) {
+            char path[512];
+            snprintf(path, sizeof(path), "%s/%s", directory, item->d_name);
+            unlink(path);
+        }
+    }
+    closedir(dir);
+    rmdir(directory);
+}
+
+// Hits on a working set: the log must stay near one record per mask, and
+// a reopen must find every mask and evict in LRU order
+static void check_hits(void) {
+    MaskCache* cache = NULL;
+    double mask[SIZE * SIZE];
+    CHECK(mask_cache_open(&cache, directory, 1ULL << 30) == MASK_PROCESSOR_SUCCESS,
+          "mask_cache_open failed");
+    if (!cache) {
+        return;
+    }
+    for (int seed = 0; seed < MASKS; seed++) {
+        const MaskHash128 key = key_for(seed);
+        fill_mask(mask, seed);
+        CHECK(mask_cache_put(cache, &key, mask, SIZE, SIZE) == MASK_PROCESSOR_SUCCESS,
+              "mask_cache_put %d failed", seed);
+    }
+
+    long largest = 0;
+    for (int round = 0; round < HITS_PER_MASK; round++) {
+        for (int seed = 0; seed < MASKS; seed++) {
+            CHECK(lookup(cache, seed, round == 0), "mask %d missing in round %d", seed, round);
+        }
+        const long size = file_size("index");
+        largest = size > largest ? size : largest;
+    }
+    // 20000 hits would append ~1 MB of records without the rewrite
+    CHECK(largest < 128 * 1024, "index grew to %ld bytes over %d hits", largest,
+          MASKS * HITS_PER_MASK);
+
+    uint64_t bytes = 0;
+    int entries = 0;
+    mask_cache_usage(cache, &bytes, &entries);
+    CHECK(entries == MASKS, "%d entries after the hits", entries);
+    mask_cache_close(cache);
+
+    // Half the budget keeps the most recently used half, seeds MASKS / 2 on
+    CHECK(mask_cache_open(&cache, directory, bytes / 2) == MASK_PROCESSOR_SUCCESS,
+          "mask_cache_open with half the budget failed");
+    if (!cache) {
+        return;
+    }
+    for (int seed = MASKS - 1; seed >= 0; seed--) {
+        const int found = lookup(cache, seed, 1);
+        CHECK(found == (seed >= MASKS / 2), "mask %d %s after reopening", seed,
+              found ? "kept" : "evicted");
+    }
+    mask_cache_close(cache);
+}
+
+// Evictions delete keys from the middle of one long probe run
+static void check_collisions(void) {
+    MaskCache* cache = NULL;
+    double mask[SIZE * SIZE];
+    enum { PUTS = 300, KEPT = 8 };
+
+    remove_directory();
+    CHECK(mkdir(directory, 0700) == 0, "mkdir failed");
+    // Measure one mask, then budget for KEPT of them
+    const MaskHash128 probe = key_for(PUTS);
+    fill_mask(mask, PUTS);
+    CHECK(mask_cache_open(&cache, directory, 1ULL << 30) == MASK_PROCESSOR_SUCCESS,
+          "mask_cache_open failed");
+    if (!cache) {
+        return;
+    }
+    CHECK(mask_cache_put(cache, &probe, mask, SIZE, SIZE) == MASK_PROCESSOR_SUCCESS,
+          "mask_cache_put failed");
+    uint64_t one = 0;
+    mask_cache_usage(cache, &one, NULL);
+    mask_cache_close(cache);
+
+    CHECK(mask_cache_open(&cache, directory, one * KEPT + one / 2) == MASK_PROCESSOR_SUCCESS,
+          "mask_cache_open failed");
+    if (!cache) {
+        return;
+    }
+    for (int seed = 0; seed < PUTS; seed++) {
+        const MaskHash128 key = key_for(seed);
+        fill_mask(mask, seed);
+        CHECK(mask_cache_put(cache, &key, mask, SIZE, SIZE) == MASK_PROCESSOR_SUCCESS,
+              "mask_cache_put %d failed", seed);
+
+        // Every few puts, hit the survivors so they move around the table
+        if (seed % 5 == 0) {
+            for (int back = seed - KEPT + 2 < 0 ? 0 : seed - KEPT + 2; back <= seed; back++) {
+                CHECK(lookup(cache, back, 1), "mask %d missing after put %d", back, seed);
+            }
+        }
+        if (seed >= 2 * KEPT) {
+            CHECK(!lookup(cache, seed - 2 * KEPT, 0), "mask %d not evicted by put %d",
+                  seed - 2 * KEPT, seed);
+        }
+    }
+    int entries = 0;
+    mask_cache_usage(cache, NULL, &entries);
+    CHECK(entries <= KEPT, "%d entries over a budget of %d", entries, KEPT);
+    mask_cache_close(cache);
+}
+
+static pthread_mutex_t posted_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t posted_ready = PTHREAD_COND_INITIALIZER;
+static int64_t posted_ids[8];
+static int posted_count = 0;
+
+// Stands in for Dart_PostCObject: the message is a Dart_CObject whose
+// int64 value, after the type field, is the job id
+static bool record_post(int64_t port, void* message) {
+    (void)port;
+    int64_t id;
+    memcpy(&id, (const char*)message + 8, sizeof(id));
+    pthread_mutex_lock(&posted_lock);
+    if (posted_count < 8) {
+        posted_ids[posted_count] = id;
+    }
+    posted_count++;
+    pthread_cond_broadcast(&posted_ready);
+    pthread_mutex_unlock(&posted_lock);
+    return true;
+}
+
+// Puts queued as jobs are stored in order and each posts its id once
+static void check_async(void) {
+    enum { JOBS = 3 };
+    MaskCache* cache = NULL;
+    MaskJobState states[JOBS];
+    static double masks[JOBS][SIZE * SIZE];
+
+    remove_directory();
+    CHECK(mkdir(directory, 0700) == 0, "mkdir failed");
+    CHECK(mask_jobs_init(record_post) == MASK_PROCESSOR_SUCCESS, "mask_jobs_init failed");
+    CHECK(mask_cache_open(&cache, directory, 1ULL << 30) == MASK_PROCESSOR_SUCCESS,
+          "mask_cache_open failed");
+    if (!cache) {
+        return;
+    }
+    memset(states, 0, sizeof(states));
+    for (int job = 0; job < JOBS; job++) {
+        const MaskHash128 key = key_for(job);
+        fill_mask(masks[job], job);
+        CHECK(mask_cache_put_async(7, 100 + job, &states[job], cache, &key, masks[job], SIZE,
+                                   SIZE) == MASK_PROCESSOR_SUCCESS,
+              "mask_cache_put_async %d was not queued", job);
+    }
+
+    pthread_mutex_lock(&posted_lock);
+    while (posted_count < JOBS) {
+        pthread_cond_wait(&posted_ready, &posted_lock);
+    }
+    pthread_mutex_unlock(&posted_lock);
+
+    CHECK(posted_count == JOBS, "%d completions for %d jobs", posted_count, JOBS);
+    for (int job = 0; job < JOBS; job++) {
+        CHECK(posted_ids[job] == 100 + job, "completion %d posted id %lld", job,
+              (long long)posted_ids[job]);
+        CHECK(states[job].result == MASK_PROCESSOR_SUCCESS, "put %d failed with %d", job,
+              states[job].result);
+        CHECK(lookup(cache, job, 1), "mask %d missing after its put completed", job);
+    }
+    mask_cache_close(cache);
+}
+
+int main(void) {
+    if (!mkdtemp(directory)) {
+        CHECK(0, "mkdtemp failed");
+        return TEST_RESULT();
+    }
+    check_hits();
+    check_collisions();
+    check_async();
+    remove_directory();
+    return TEST_RESULT();
+}
@@ -0,0 +1,170 @@
+// NEON kernels against the scalar ones, built with
+// MASK_PROCESSOR_EMULATE_NEON so they run on any host
+
+#include "simd_optimizations.h"
+#include "test_support.h"
+#include <math.h>
+#include <string.h>
+
+// Direct sums and running sums round differently
+#define SMOOTH_TOLERANCE 1e-12
+
+static const int widths[] = { 1, 2, 3, 5, 8, 17, 63, 64, 65, 131 };
+static const int heights[] = { 1, 2, 7, 33 };
+
+static double max_difference(const double* a, const double* b, size_t n) {
+    double worst = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        const double difference = fabs(a[i] - b[i]);
+        if (difference > worst || isnan(difference)) {
+            worst = isnan(difference) ? INFINITY : difference;
+        }
+    }
+    return worst;
+}
+
+static void check_smooth(const double* mask, int width, int height, int kernel_size,
+                         TestMaskKind kind) {
+    const size_t n = (size_t)width * height;
+    double* expected = (double*)malloc(sizeof(double) * n);
+    double* actual = (double*)malloc(sizeof(double) * n);
+    double* rows = (double*)malloc(sizeof(double) * n);
+    double* scratch = (double*)malloc(sizeof(double) * (n + (size_t)kernel_size * width));
+    if (!expected || !actual || !rows || !scratch) {
+        CHECK(0, "out of memory");
+        goto done;
+    }
+
+    CHECK(smooth_mask_native(mask, expected, width, height, kernel_size) == MASK_PROCESSOR_SUCCESS,
+          "smooth_mask_native %dx%d k=%d failed", width, height, kernel_size);
+
+    // The whole-image kernel, the row kernels it shares with the banded
+    // pipelines, and the tiled path built on them
+    CHECK(smooth_mask_neon(mask, actual, width, height, kernel_size) == MASK_PROCESSOR_SUCCESS,
+          "smooth_mask_neon %dx%d k=%d failed", width, height, kernel_size);
+    CHECK(max_difference(expected, actual, n) <= SMOOTH_TOLERANCE,
+          "smooth_mask_neon %s %dx%d k=%d differs by %g", test_mask_names[kind],
+          width, height, kernel_size, max_difference(expected, actual, n));
+
+    CHECK(smooth_mask_rows_optimized(mask, rows, scratch, width, height, kernel_size,
+                                     0, height) == MASK_PROCESSOR_SUCCESS,
+          "smooth_mask_rows_optimized %dx%d k=%d failed", width, height, kernel_size);
+    CHECK(memcmp(rows, actual, sizeof(double) * n) == 0,
+          "NEON row kernels %s %dx%d k=%d differ from smooth_mask_neon", test_mask_names[kind],
+          width, height, kernel_size);
+
+    CHECK(smooth_mask_tiled(mask, rows, width, height, kernel_size) == MASK_PROCESSOR_SUCCESS,
+          "smooth_mask_tiled %dx%d k=%d failed", width, height, kernel_size);
+    CHECK(memcmp(rows, actual, sizeof(double) * n) == 0,
+          "NEON tiles %s %dx%d k=%d differ from smooth_mask_neon", test_mask_names[kind],
+          width, height, kernel_size);
+
+done:
+    free(expected);
+    free(actual);
+    free(rows);
+    free(scratch);
+}
+
+// Mask values on and around the class thresholds and ramp rounding ties
+static const double edge_values[] = {
+    0.0, 0.45, 0.45 + 1e-12, 0.45 - 1e-12, 0.5, 0.5 + 1e-12, 0.55, 0.55 + 1e-12,
+    0.55 - 1e-12, 0.45 + 0.05 / 255.0, 0.45 + 0.1 / 255.0 * 10.5, 1.0, -0.25, 1.5
+};
+
+static void check_apply(const double* mask, const double* expanded, int width, int height,
+                        int add_border, TestMaskKind kind) {
+    const size_t n = (size_t)width * height;
+    const RGBColor color = { 12, 200, 77 };
+    uint8_t* source = (uint8_t*)malloc(n * 4);
+    uint8_t* expected = (uint8_t*)malloc(n * 4);
+    uint8_t* actual = (uint8_t*)malloc(n * 4);
+    if (!source || !expected || !actual) {
+        CHECK(0, "out of memory");
+        goto done;
+    }
+    test_fill_pixels(source, n * 4);
+
+    memcpy(expected, source, n * 4);
+    apply_sticker_mask_native(expected, mask, width, height, add_border, color, 4, expanded);
+
+    memcpy(actual, source, n * 4);
+    CHECK(apply_sticker_mask_neon(actual, mask, width, height, add_border, color, 4,
+                                  expanded) == MASK_PROCESSOR_SUCCESS,
+          "apply_sticker_mask_neon %dx%d failed", width, height);
+    CHECK(memcmp(expected, actual, n * 4) == 0,
+          "apply_sticker_mask_neon %s %dx%d border=%d expanded=%d differs",
+          test_mask_names[kind], width, height, add_border, expanded != NULL);
+
+    // Dispatched, banded and out of place
+    CHECK(apply_sticker_mask_to_optimized(source, actual, mask, width, height, add_border,
+                                          color, 4, expanded) == MASK_PROCESSOR_SUCCESS,
+          "apply_sticker_mask_to_optimized %dx%d failed", width, height);
+    CHECK(memcmp(expected, actual, n * 4) == 0,
+          "dispatched NEON apply %s %dx%d border=%d differs", test_mask_names[kind],
+          width, height, add_border);
+
+done:
+    free(source);
+    free(expected);
+    free(actual);
+}
+
+static void check_apply_cases(const double* mask, int width, int height, TestMaskKind kind) {
+    const size_t n = (size_t)width * height;
+    double* expanded = (double*)malloc(sizeof(double) * n);
+    double* edges = (double*)malloc(sizeof(double) * n);
+    if (!expanded || !edges) {
+        CHECK(0, "out of memory");
+        free(expanded);
+        free(edges);
+        return;
+    }
+
+    CHECK(expand_mask_native(mask, expanded, width, height, 4) == MASK_PROCESSOR_SUCCESS,
+          "expand_mask_native %dx%d failed", width, height);
+    for (size_t i = 0; i < n; i++) {
+        edges[i] = edge_values[test_random() % (sizeof(edge_values) / sizeof(edge_values[0]))];
+    }
+
+    for (int add_border = 0; add_border <= 1; add_border++) {
+        check_apply(mask, NULL, width, height, add_border, kind);
+        check_apply(mask, expanded, width, height, add_border, kind);
+        check_apply(edges, mask, width, height, add_border, kind);
+    }
+    free(expanded);
+    free(edges);
+}
+
+int main(void) {
+    CHECK(mask_processor_select_isa(MASK_PROCESSOR_ISA_NEON) == MASK_PROCESSOR_SUCCESS,
+          "NEON kernels cannot be selected");
+    CHECK(mask_processor_get_active_isa() == MASK_PROCESSOR_ISA_NEON, "NEON kernels not active");
+    if (test_failures) {
+        return TEST_RESULT();
+    }
+
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+        for (size_t h = 0; h < sizeof(heights) / sizeof(heights[0]); h++) {
+            const int width = widths[w];
+            const int height = heights[h];
+            double* mask = (double*)malloc(sizeof(double) * width * height);
+            if (!mask) {
+                CHECK(0, "out of memory");
+                continue;
+            }
+
+            for (int kind = 0; kind < TEST_MASK_KIND_COUNT; kind++) {
+                test_fill_mask(mask, width, height, (TestMaskKind)kind);
+                check_apply_cases(mask, width, height, (TestMaskKind)kind);
+                for (int kernel_size = 1; kernel_size <= MASK_PROCESSOR_DIRECT_SUM_MAX_KERNEL;
+                     kernel_size += 2) {
+                    check_smooth(mask, width, height, kernel_size, (TestMaskKind)kind);
+                }
+            }
+            free(mask);
+        }
+    }
+
+    return TEST_RESULT();
+}
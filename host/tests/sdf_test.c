@@ -0,0 +1,110 @@
+// compute_mask_sdf_native thresholded at border_width - 0.5 against
+// expand_mask_native, and the SDF composites on masks with no boundary
+
+#include "mask_processor.h"
+#include "sticker_session.h"
+#include "test_support.h"
+#include <string.h>
+
+static const int sizes[][2] = { { 1, 1 }, { 1, 9 }, { 9, 1 }, { 7, 5 }, { 32, 32 }, { 65, 33 } };
+
+static void check_threshold(const double* mask, const float* sdf, int width, int height,
+                            int border_width, TestMaskKind kind) {
+    const size_t n = (size_t)width * height;
+    double* expanded = (double*)malloc(sizeof(double) * n);
+    if (!expanded) {
+        CHECK(0, "out of memory");
+        return;
+    }
+
+    CHECK(expand_mask_native(mask, expanded, width, height, border_width) == MASK_PROCESSOR_SUCCESS,
+          "expand_mask_native %dx%d b=%d failed", width, height, border_width);
+    int mismatches = 0;
+    for (size_t i = 0; i < n; i++) {
+        const int inside_sdf = sdf[i] <= (float)border_width - 0.5f;
+        mismatches += inside_sdf != (expanded[i] > 0.5);
+    }
+    CHECK(mismatches == 0, "%s %dx%d b=%d: %d pixels differ from expand_mask_native",
+          test_mask_names[kind], width, height, border_width, mismatches);
+    free(expanded);
+}
+
+// With no boundary neither composite may draw a border, however wide
+static void check_no_border(const double* mask, const float* sdf, int width, int height,
+                            TestMaskKind kind) {
+    const size_t n = (size_t)width * height;
+    const RGBColor color = { 255, 0, 0 };
+    const float border_width = (float)(width + height) * 2.0f;
+    uint8_t* source = (uint8_t*)malloc(n * 4);
+    uint8_t* pixels = (uint8_t*)malloc(n * 4);
+    if (!source || !pixels) {
+        CHECK(0, "out of memory");
+        goto done;
+    }
+    test_fill_pixels(source, n * 4);
+    const uint8_t alpha = kind == TEST_MASK_FULL ? 255 : 0;
+
+    memcpy(pixels, source, n * 4);
+    CHECK(apply_sticker_mask_sdf_native(pixels, mask, sdf, width, height, 1, color,
+                                        border_width) == MASK_PROCESSOR_SUCCESS,
+          "apply_sticker_mask_sdf_native %dx%d failed", width, height);
+    int wrong = 0;
+    for (size_t i = 0; i < n; i++) {
+        wrong += memcmp(pixels + i * 4, source + i * 4, 3) != 0 || pixels[i * 4 + 3] != alpha;
+    }
+    CHECK(wrong == 0, "apply_sticker_mask_sdf_native %s %dx%d: %d border pixels",
+          test_mask_names[kind], width, height, wrong);
+
+    StickerSession* session = NULL;
+    CHECK(sticker_session_create(&session, source, mask, width, height, 1, 1, color,
+                                 border_width) == MASK_PROCESSOR_SUCCESS,
+          "sticker_session_create %dx%d failed", width, height);
+    if (session) {
+        CHECK(sticker_session_set_border_width(session, border_width * 2.0f) == MASK_PROCESSOR_SUCCESS,
+              "sticker_session_set_border_width failed");
+        CHECK(memcmp(sticker_session_pixels(session), pixels, n * 4) == 0,
+              "sticker session %s %dx%d differs from apply_sticker_mask_sdf_native",
+              test_mask_names[kind], width, height);
+        sticker_session_destroy(session);
+    }
+
+done:
+    free(source);
+    free(pixels);
+}
+
+int main(void) {
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        const int width = sizes[s][0];
+        const int height = sizes[s][1];
+        const size_t n = (size_t)width * height;
+        double* mask = (double*)malloc(sizeof(double) * n);
+        float* sdf = (float*)malloc(sizeof(float) * n);
+        if (!mask || !sdf) {
+            CHECK(0, "out of memory");
+            free(mask);
+            free(sdf);
+            continue;
+        }
+
+        for (int kind = 0; kind < TEST_MASK_KIND_COUNT; kind++) {
+            test_fill_mask(mask, width, height, (TestMaskKind)kind);
+            CHECK(compute_mask_sdf_native(mask, sdf, width, height) == MASK_PROCESSOR_SUCCESS,
+                  "compute_mask_sdf_native %dx%d failed", width, height);
+
+            // Every width up to past the image, where only the no-seed
+            // distance decides
+            const int widest = width + height + 4;
+            for (int border_width = 0; border_width <= widest; border_width++) {
+                check_threshold(mask, sdf, width, height, border_width, (TestMaskKind)kind);
+            }
+            if (kind == TEST_MASK_EMPTY || kind == TEST_MASK_FULL) {
+                check_no_border(mask, sdf, width, height, (TestMaskKind)kind);
+            }
+        }
+        free(mask);
+        free(sdf);
+    }
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,125 @@
+// The sticker session against the fused pipeline: at an integer border
+// width both must paint the same sticker, whether the session was created
+// with that width or restyled to it
+
+#include "sticker_pipeline.h"
+#include "sticker_session.h"
+#include "test_support.h"
+#include <math.h>
+#include <string.h>
+
+static const int sizes[][2] = { { 1, 1 }, { 9, 1 }, { 7, 5 }, { 65, 33 }, { 130, 97 } };
+static const int kernel_sizes[] = { 1, 3, 5, 9 };
+// 70 is past the session's band index, where restyling recomposites
+static const int border_widths[] = { 0, 1, 2, 5, 12, 70 };
+
+static int count_differences(const uint8_t* a, const uint8_t* b, size_t bytes, int* max_delta) {
+    int count = 0;
+    *max_delta = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        const int delta = abs((int)a[i] - (int)b[i]);
+        count += delta != 0;
+        if (delta > *max_delta) {
+            *max_delta = delta;
+        }
+    }
+    return count;
+}
+
+static void check_case(const uint8_t* source, const double* mask, int width, int height,
+                       int kernel_size, int add_border, int border_width, const char* label) {
+    const size_t bytes = (size_t)width * height * 4;
+    const RGBColor color = { 250, 20, 120 };
+    uint8_t* fused = (uint8_t*)malloc(bytes);
+    if (!fused) {
+        CHECK(0, "out of memory");
+        return;
+    }
+
+    CHECK(make_sticker_mask_fused(source, fused, mask, width, height, kernel_size, add_border,
+                                  color, border_width) == MASK_PROCESSOR_SUCCESS,
+          "make_sticker_mask_fused %dx%d failed", width, height);
+
+    int max_delta = 0;
+    StickerSession* session = NULL;
+    CHECK(sticker_session_create(&session, source, mask, width, height, kernel_size, add_border,
+                                 color, (float)border_width) == MASK_PROCESSOR_SUCCESS,
+          "sticker_session_create %dx%d failed", width, height);
+    if (session) {
+        const int differences = count_differences(sticker_session_pixels(session), fused, bytes,
+                                                  &max_delta);
+        CHECK(differences == 0,
+              "%s %dx%d k=%d border=%d b=%d: session differs from fused in %d bytes (max %d)",
+              label, width, height, kernel_size, add_border, border_width, differences, max_delta);
+
+        // Restyled away and back, through a fractional width
+        sticker_session_set_border_width(session, (float)border_width + 7.5f);
+        sticker_session_set_border_width(session, (float)border_width);
+        const int restyled = count_differences(sticker_session_pixels(session), fused, bytes,
+                                               &max_delta);
+        CHECK(restyled == 0,
+              "%s %dx%d k=%d border=%d b=%d: restyled session differs from fused in %d bytes (max %d)",
+              label, width, height, kernel_size, add_border, border_width, restyled, max_delta);
+        sticker_session_destroy(session);
+    }
+    free(fused);
+}
+
+// The disc of the original report: 512², kernel 3, border 12
+static void check_disc(void) {
+    const int size = 512;
+    const size_t n = (size_t)size * size;
+    uint8_t* source = (uint8_t*)malloc(n * 4);
+    double* mask = (double*)malloc(sizeof(double) * n);
+    if (!source || !mask) {
+        CHECK(0, "out of memory");
+        free(source);
+        free(mask);
+        return;
+    }
+    test_fill_pixels(source, n * 4);
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            const double d = sqrt((x - size / 2.0) * (x - size / 2.0) + (y - size / 2.0) * (y - size / 2.0));
+            const double value = (size * 0.3 - d) / 4.0 + 0.5;
+            mask[(size_t)y * size + x] = value < 0.0 ? 0.0 : (value > 1.0 ? 1.0 : value);
+        }
+    }
+    check_case(source, mask, size, size, 3, 1, 12, "disc");
+    free(source);
+    free(mask);
+}
+
+int main(void) {
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        const int width = sizes[s][0];
+        const int height = sizes[s][1];
+        const size_t n = (size_t)width * height;
+        uint8_t* source = (uint8_t*)malloc(n * 4);
+        double* mask = (double*)malloc(sizeof(double) * n);
+        if (!source || !mask) {
+            CHECK(0, "out of memory");
+            free(source);
+            free(mask);
+            continue;
+        }
+        test_fill_pixels(source, n * 4);
+
+        for (int kind = 0; kind < TEST_MASK_KIND_COUNT; kind++) {
+            test_fill_mask(mask, width, height, (TestMaskKind)kind);
+            for (size_t k = 0; k < sizeof(kernel_sizes) / sizeof(kernel_sizes[0]); k++) {
+                for (size_t b = 0; b < sizeof(border_widths) / sizeof(border_widths[0]); b++) {
+                    for (int add_border = 0; add_border <= 1; add_border++) {
+                        check_case(source, mask, width, height, kernel_sizes[k], add_border,
+                                   border_widths[b], test_mask_names[kind]);
+                    }
+                }
+            }
+        }
+        free(source);
+        free(mask);
+    }
+    check_disc();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,92 @@
+// Shared helpers of the host tests: a failure counter, a seeded generator
+// and random masks
+
+#ifndef TEST_SUPPORT_H
+#define TEST_SUPPORT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static int test_failures = 0;
+
+// Report a failed check and carry on, so one run lists every failure
+#define CHECK(condition, ...)                                              \
+    do {                                                                   \
+        if (!(condition)) {                                                \
+            fprintf(stderr, "%s:%d: ", __FILE__, __LINE__);                \
+            fprintf(stderr, __VA_ARGS__);                                  \
+            fprintf(stderr, "\n");                                         \
+            test_failures++;                                               \
+        }                                                                  \
+    } while (0)
+
+// Exit status of main
+#define TEST_RESULT() (test_failures ? (fprintf(stderr, "%d failures\n", test_failures), 1) : 0)
+
+static uint32_t test_random_state = 0x2545F491u;
+
+static uint32_t test_random(void) {
+    test_random_state = test_random_state * 1664525u + 1013904223u;
+    return test_random_state >> 8;
+}
+
+// Uniform in [0, 1)
+static double test_random_unit(void) {
+    return test_random() / (double)(1u << 24);
+}
+
+// Mask contents used across the tests
+typedef enum {
+    TEST_MASK_RANDOM,
+    // Blobs of 0 and 1 with soft values in between, like a model output
+    TEST_MASK_BLOBS,
+    TEST_MASK_EMPTY,
+    TEST_MASK_FULL,
+    TEST_MASK_KIND_COUNT
+} TestMaskKind;
+
+static const char* const test_mask_names[] = { "random", "blobs", "empty", "full" };
+
+static void test_fill_mask(double* mask, int width, int height, TestMaskKind kind) {
+    const size_t n = (size_t)width * height;
+    switch (kind) {
+    case TEST_MASK_RANDOM:
+        for (size_t i = 0; i < n; i++) {
+            mask[i] = test_random_unit();
+        }
+        break;
+    case TEST_MASK_BLOBS: {
+        const double cx = width * test_random_unit();
+        const double cy = height * test_random_unit();
+        const double radius = 1.0 + (width < height ? width : height) * 0.4 * test_random_unit();
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                const double d2 = (x - cx) * (x - cx) + (y - cy) * (y - cy);
+                const double value = (radius * radius - d2) / (2.0 * radius) + 0.5;
+                const double noise = (test_random() & 15) == 0 ? test_random_unit() : value;
+                mask[(size_t)y * width + x] = noise < 0.0 ? 0.0 : (noise > 1.0 ? 1.0 : noise);
+            }
+        }
+        break;
+    }
+    case TEST_MASK_EMPTY:
+        for (size_t i = 0; i < n; i++) {
+            mask[i] = 0.0;
+        }
+        break;
+    default:
+        for (size_t i = 0; i < n; i++) {
+            mask[i] = 1.0;
+        }
+        break;
+    }
+}
+
+static void test_fill_pixels(uint8_t* pixels, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        pixels[i] = (uint8_t)test_random();
+    }
+}
+
+#endif // TEST_SUPPORT_H
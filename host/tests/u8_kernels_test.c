@@ -0,0 +1,199 @@
+// The 8-bit mask kernels against the double ones, within the error bounds
+// documented in mask_processor.h, and smooth_mask_u8 on one thread against
+// several
+
+#include "mask_processor.h"
+#include "test_support.h"
+#include <math.h>
+#include <string.h>
+
+// Quantization error of q = round(m * 255)
+#define QUANTUM (1.0 / 510.0)
+
+static const int sizes[][2] = { { 1, 1 }, { 3, 17 }, { 17, 3 }, { 63, 65 }, { 130, 97 }, { 300, 257 } };
+static const int border_widths[] = { 0, 1, 2, 3, 5, 12, 32, 100, MASK_U8_MAX_BORDER_WIDTH };
+static const double thresholds[] = { 0.45, 0.5, 0.55 };
+
+// Move values off the thresholds by more than the quantization error, where
+// the bounds allow a class change
+static void avoid_thresholds(double* mask, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        for (size_t t = 0; t < sizeof(thresholds) / sizeof(thresholds[0]); t++) {
+            if (fabs(mask[i] - thresholds[t]) <= QUANTUM * 1.5) {
+                mask[i] = thresholds[t] + (mask[i] < thresholds[t] ? -3.0 : 3.0) * QUANTUM;
+            }
+        }
+    }
+}
+
+static void quantize(const double* mask, uint8_t* q, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        q[i] = (uint8_t)floor(mask[i] * 255.0 + 0.5);
+    }
+}
+
+static void check_smooth(const double* mask, const uint8_t* q, int width, int height,
+                         const char* kind) {
+    const size_t n = (size_t)width * height;
+    double* expected = (double*)malloc(sizeof(double) * n);
+    uint8_t* actual = (uint8_t*)malloc(n);
+    if (!expected || !actual) {
+        CHECK(0, "out of memory");
+        goto done;
+    }
+
+    for (int kernel_size = 1; kernel_size <= 31; kernel_size++) {
+        CHECK(smooth_mask_native(mask, expected, width, height, kernel_size) == MASK_PROCESSOR_SUCCESS &&
+              smooth_mask_u8(q, actual, width, height, kernel_size) == MASK_PROCESSOR_SUCCESS,
+              "smooth %dx%d k=%d failed", width, height, kernel_size);
+        double worst = 0.0;
+        for (size_t i = 0; i < n; i++) {
+            const double error = fabs(actual[i] / 255.0 - expected[i]);
+            worst = error > worst ? error : worst;
+        }
+        CHECK(worst <= 1.5 / 255.0 + 1e-12, "smooth_mask_u8 %s %dx%d k=%d off by %g/255",
+              kind, width, height, kernel_size, worst * 255.0);
+    }
+
+done:
+    free(expected);
+    free(actual);
+}
+
+static void check_expand_apply(const double* mask, const uint8_t* q, int width, int height,
+                               int border_width, const char* kind) {
+    const size_t n = (size_t)width * height;
+    const RGBColor color = { 40, 90, 250 };
+    double* expanded = (double*)malloc(sizeof(double) * n);
+    uint8_t* expanded_u8 = (uint8_t*)malloc(n);
+    uint8_t* source = (uint8_t*)malloc(n * 4);
+    uint8_t* expected = (uint8_t*)malloc(n * 4);
+    uint8_t* actual = (uint8_t*)malloc(n * 4);
+    if (!expanded || !expanded_u8 || !source || !expected || !actual) {
+        CHECK(0, "out of memory");
+        goto done;
+    }
+
+    CHECK(expand_mask_native(mask, expanded, width, height, border_width) == MASK_PROCESSOR_SUCCESS &&
+          expand_mask_u8(q, expanded_u8, width, height, border_width) == MASK_PROCESSOR_SUCCESS,
+          "expand %dx%d b=%d failed", width, height, border_width);
+    int mismatches = 0;
+    for (size_t i = 0; i < n; i++) {
+        mismatches += (expanded[i] > 0.5) != (expanded_u8[i] >= 128);
+    }
+    CHECK(mismatches == 0, "expand_mask_u8 %s %dx%d b=%d: %d pixels differ",
+          kind, width, height, border_width, mismatches);
+
+    test_fill_pixels(source, n * 4);
+    memcpy(expected, source, n * 4);
+    memcpy(actual, source, n * 4);
+    apply_sticker_mask_native(expected, mask, width, height, 1, color, border_width, expanded);
+    CHECK(apply_sticker_mask_u8(actual, q, width, height, 1, color, expanded_u8) == MASK_PROCESSOR_SUCCESS,
+          "apply_sticker_mask_u8 %dx%d failed", width, height);
+    int rgb_mismatches = 0;
+    int worst_alpha = 0;
+    for (size_t i = 0; i < n; i++) {
+        rgb_mismatches += memcmp(expected + i * 4, actual + i * 4, 3) != 0;
+        const int error = abs(expected[i * 4 + 3] - actual[i * 4 + 3]);
+        worst_alpha = error > worst_alpha ? error : worst_alpha;
+    }
+    CHECK(rgb_mismatches == 0, "apply_sticker_mask_u8 %s %dx%d b=%d: %d pixels differ in RGB",
+          kind, width, height, border_width, rgb_mismatches);
+    CHECK(worst_alpha <= 6, "apply_sticker_mask_u8 %s %dx%d b=%d: alpha off by %d/255",
+          kind, width, height, border_width, worst_alpha);
+
+done:
+    free(expanded);
+    free(expanded_u8);
+    free(source);
+    free(expected);
+    free(actual);
+}
+
+static void run_cases(const char* config) {
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        const int width = sizes[s][0];
+        const int height = sizes[s][1];
+        const size_t n = (size_t)width * height;
+        double* mask = (double*)malloc(sizeof(double) * n);
+        uint8_t* q = (uint8_t*)malloc(n);
+        if (!mask || !q) {
+            CHECK(0, "out of memory");
+            free(mask);
+            free(q);
+            continue;
+        }
+
+        for (int kind = 0; kind < TEST_MASK_KIND_COUNT; kind++) {
+            char name[64];
+            snprintf(name, sizeof(name), "%s (%s)", test_mask_names[kind], config);
+            test_fill_mask(mask, width, height, (TestMaskKind)kind);
+
+            // The smoothing bound holds for any input
+            quantize(mask, q, n);
+            check_smooth(mask, q, width, height, name);
+
+            avoid_thresholds(mask, n);
+            quantize(mask, q, n);
+            for (size_t b = 0; b < sizeof(border_widths) / sizeof(border_widths[0]); b++) {
+                check_expand_apply(mask, q, width, height, border_widths[b], name);
+            }
+        }
+        free(mask);
+        free(q);
+    }
+}
+
+// Row and column bands must not change a single byte
+static void check_smooth_threads(void) {
+    static const int thread_sizes[][2] = { { 1, 1 }, { 5, 300 }, { 300, 5 }, { 1023, 517 } };
+    static const int kernel_sizes[] = { 2, 3, 15, 16, 61 };
+    const int threads = mask_processor_get_thread_count();
+
+    for (size_t s = 0; s < sizeof(thread_sizes) / sizeof(thread_sizes[0]); s++) {
+        const int width = thread_sizes[s][0];
+        const int height = thread_sizes[s][1];
+        const size_t n = (size_t)width * height;
+        double* mask = (double*)malloc(sizeof(double) * n);
+        uint8_t* q = (uint8_t*)malloc(n);
+        uint8_t* expected = (uint8_t*)malloc(n);
+        uint8_t* actual = (uint8_t*)malloc(n);
+        if (!mask || !q || !expected || !actual) {
+            CHECK(0, "out of memory");
+        } else {
+            test_fill_mask(mask, width, height, TEST_MASK_RANDOM);
+            quantize(mask, q, n);
+            for (size_t k = 0; k < sizeof(kernel_sizes) / sizeof(kernel_sizes[0]); k++) {
+                mask_processor_set_thread_count(1);
+                CHECK(smooth_mask_u8(q, expected, width, height, kernel_sizes[k]) ==
+                      MASK_PROCESSOR_SUCCESS, "smooth_mask_u8 %dx%d k=%d failed", width, height,
+                      kernel_sizes[k]);
+                mask_processor_set_thread_count(4);
+                CHECK(smooth_mask_u8(q, actual, width, height, kernel_sizes[k]) ==
+                      MASK_PROCESSOR_SUCCESS, "smooth_mask_u8 %dx%d k=%d failed", width, height,
+                      kernel_sizes[k]);
+                CHECK(memcmp(expected, actual, n) == 0,
+                      "smooth_mask_u8 %dx%d k=%d differs between 1 and 4 threads", width, height,
+                      kernel_sizes[k]);
+            }
+        }
+        free(mask);
+        free(q);
+        free(expected);
+        free(actual);
+    }
+    mask_processor_set_thread_count(threads);
+}
+
+int main(void) {
+    // Whole-image tiles, many small tiles with the distance transform for
+    // wide borders, and no tiling at all
+    run_cases("default tiles");
+    mask_processor_set_cache_size(16 * 1024);
+    run_cases("16 KB tiles");
+    mask_processor_set_tiling(0);
+    run_cases("untiled");
+    check_smooth_threads();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,213 @@
+#ifndef ASYNC_JOBS_H
+#define ASYNC_JOBS_H
+
+#include "mask_cache.h"
+#include "mask_processor.h"
+#include "processor_context.h"
+#include "sticker_session.h"
+#include "tensor_ops.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Kernels run off the calling thread, with completion posted to a Dart port
+ *
+ * Each *_async function queues a job and returns at once. A library-owned
+ * job thread runs queued jobs in order, each on the full thread pool. Cache
+ * puts, which mostly wait on the disk, run in order on a second thread, so
+ * they never hold up the kernels. When
+ * a job finishes, its result code is written to state->result and job_id
+ * is posted to port as an int64 message. Every buffer passed in, and the
+ * state, must stay valid, and must not be written by the caller, until
+ * that message arrives.
+ *
+ * The return value only reports whether the job was queued; a job that was
+ * queued always posts, whatever its result.
+ */
+
+/**
+ * Shared between a job and its submitter
+ *
+ * Zero every field before submitting. The submitter may read progress, and
+ * call mask_job_cancel, at any time until the completion message arrives.
+ */
+typedef struct {
+    // Result code, written before completion is posted
+    int32_t result;
+    // Set by mask_job_cancel
+    int32_t cancelled;
+    // Fraction done, from 0 to 1; an estimate that only goes up, and
+    // reaches 1 only when the job succeeded
+    float progress;
+} MaskJobState;
+
+// Dart_PostCObject, as handed over by NativeApi.postCObject
+typedef bool (*MaskPostCObjectFn)(int64_t port, void* message);
+
+/**
+ * Set the function jobs post their completion with
+ *
+ * Must be called before the first job is submitted; later calls replace it.
+ *
+ * @param post_cobject Dart_PostCObject
+ * @return Result code
+ */
+MaskProcessorResult mask_jobs_init(MaskPostCObjectFn post_cobject);
+
+/**
+ * Ask a job to stop
+ *
+ * A queued job does not start. A running job stops at its next band
+ * boundary, within a few milliseconds, and its result is
+ * MASK_PROCESSOR_ERROR_CANCELLED with its output buffers left partly
+ * written; a job that gets to finish first keeps its result. Either way
+ * completion is still posted.
+ *
+ * @param state State of a submitted job
+ */
+void mask_job_cancel(MaskJobState* state);
+
+// make_sticker_mask_fused (context may be NULL)
+MaskProcessorResult make_sticker_mask_fused_async(
+    int64_t port,
+    int64_t job_id,
+    MaskJobState* state,
+    MaskProcessorContext* context,
+    const uint8_t* src,
+    uint8_t* dst,
+    const double* mask,
+    int width,
+    int height,
+    int kernel_size,
+    int add_border,
+    RGBColor border_color,
+    int border_width
+);
+
+// smooth_mask_optimized (context may be NULL)
+MaskProcessorResult smooth_mask_async(
+    int64_t port,
+    int64_t job_id,
+    MaskJobState* state,
+    MaskProcessorContext* context,
+    const double* mask,
+    double* output,
+    int width,
+    int height,
+    int kernel_size
+);
+
+// expand_mask_optimized (context may be NULL)
+MaskProcessorResult expand_mask_async(
+    int64_t port,
+    int64_t job_id,
+    MaskJobState* state,
+    MaskProcessorContext* context,
+    const double* mask,
+    double* output,
+    int width,
+    int height,
+    int border_width
+);
+
+// compute_mask_sdf_native (context may be NULL)
+MaskProcessorResult compute_mask_sdf_async(
+    int64_t port,
+    int64_t job_id,
+    MaskJobState* state,
+    MaskProcessorContext* context,
+    const double* mask,
+    float* sdf,
+    int width,
+    int height
+);
+
+// apply_sticker_mask_sdf_to_native; src may equal dst for in-place
+MaskProcessorResult apply_sticker_mask_sdf_async(
+    int64_t port,
+    int64_t job_id,
+    MaskJobState* state,
+    const uint8_t* src,
+    uint8_t* dst,
+    const double* mask,
+    const float* sdf,
+    int width,
+    int height,
+    int add_border,
+    RGBColor border_color,
+    float border_width
+);
+
+// resize_rgba_to_nchw; mean and inv_std are copied (context may be NULL)
+MaskProcessorResult resize_rgba_to_nchw_async(
+    int64_t port,
+    int64_t job_id,
+    MaskJobState* state,
+    MaskProcessorContext* context,
+    const uint8_t* src,
+    int src_width,
+    int src_height,
+    float* dst,
+    int dst_width,
+    int dst_height,
+    const float* mean,
+    const float* inv_std
+);
+
+// upsample_mask_tensor (context may be NULL)
+MaskProcessorResult upsample_mask_tensor_async(
+    int64_t port,
+    int64_t job_id,
+    MaskJobState* state,
+    MaskProcessorContext* context,
+    const float* src,
+    int src_width,
+    int src_height,
+    void* dst,
+    MaskOutputFormat format,
+    int dst_width,
+    int dst_height,
+    int apply_sigmoid,
+    double threshold
+);
+
+// sticker_session_create; *session is set before the message is posted, and
+// is NULL when the job was cancelled
+MaskProcessorResult sticker_session_create_async(
+    int64_t port,
+    int64_t job_id,
+    MaskJobState* state,
+    StickerSession** session,
+    const uint8_t* src,
+    const double* mask,
+    int width,
+    int height,
+    int kernel_size,
+    int add_border,
+    RGBColor border_color,
+    float border_width
+);
+
+// mask_cache_put; key is copied, and the cache must stay open until the
+// message is posted. Runs on the disk thread, and a running put is not
+// cancelled.
+MaskProcessorResult mask_cache_put_async(
+    int64_t port,
+    int64_t job_id,
+    MaskJobState* state,
+    MaskCache* cache,
+    const MaskHash128* key,
+    const double* mask,
+    int width,
+    int height
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ASYNC_JOBS_H
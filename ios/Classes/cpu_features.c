@@ -0,0 +1,150 @@
+#include "cpu_features.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__APPLE__)
+#include <stdint.h>
+#include <sys/sysctl.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+
+// XCR0 bits: SSE and AVX state, plus opmask/ZMM state for AVX-512
+#define XCR0_AVX_STATE 0x06u
+#define XCR0_AVX512_STATE 0xE6u
+
+static unsigned int read_xcr0(void) {
+    unsigned int eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return eax;
+}
+
+static void detect_x86(CpuFeatures* features) {
+    unsigned int eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return;
+    }
+    features->sse2 = (edx >> 26) & 1;
+
+    const int osxsave = (ecx >> 27) & 1;
+    const int avx = (ecx >> 28) & 1;
+    if (!osxsave || !avx) {
+        return;
+    }
+
+    const unsigned int xcr0 = read_xcr0();
+    if ((xcr0 & XCR0_AVX_STATE) != XCR0_AVX_STATE) {
+        return;
+    }
+
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        return;
+    }
+    features->avx2 = (ebx >> 5) & 1;
+    features->avx512f = ((ebx >> 16) & 1) && (xcr0 & XCR0_AVX512_STATE) == XCR0_AVX512_STATE;
+}
+
+#elif (defined(__arm__) || defined(__aarch64__)) && defined(__linux__)
+#include <sys/auxv.h>
+
+#ifndef HWCAP_NEON
+#define HWCAP_NEON (1 << 12)
+#endif
+#ifndef HWCAP_ASIMD
+#define HWCAP_ASIMD (1 << 1)
+#endif
+
+static void detect_arm(CpuFeatures* features) {
+    const unsigned long hwcap = getauxval(AT_HWCAP);
+#ifdef __aarch64__
+    features->neon = (hwcap & HWCAP_ASIMD) != 0;
+#else
+    features->neon = (hwcap & HWCAP_NEON) != 0;
+#endif
+}
+
+#endif
+
+void cpu_features_detect(CpuFeatures* features) {
+    if (!features) {
+        return;
+    }
+    memset(features, 0, sizeof(*features));
+
+#if defined(__x86_64__) || defined(__i386__)
+    detect_x86(features);
+#elif (defined(__arm__) || defined(__aarch64__)) && defined(__linux__)
+    detect_arm(features);
+#elif defined(__aarch64__)
+    // Advanced SIMD is mandatory on AArch64
+    features->neon = 1;
+#endif
+
+#ifdef MASK_PROCESSOR_EMULATE_NEON
+    // The NEON kernels are built from portable vectors and run anywhere
+    features->neon = 1;
+#endif
+}
+
+#if defined(__linux__)
+// Read a sysfs cache attribute of cpu0; returns 0 on failure
+static int read_cache_attr(int index, const char* name, char* buffer, size_t size) {
+    char path[96];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/%s", index, name);
+
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return 0;
+    }
+    const int ok = fgets(buffer, (int)size, file) != NULL;
+    fclose(file);
+    return ok;
+}
+#endif
+
+size_t cpu_l2_cache_bytes(void) {
+#if defined(__APPLE__)
+    // Performance cores first on Apple silicon
+    static const char* const names[] = { "hw.perflevel0.l2cachesize", "hw.l2cachesize" };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        uint64_t value = 0;
+        size_t length = sizeof(value);
+        if (sysctlbyname(names[i], &value, &length, NULL, 0) == 0 && value > 0) {
+            return (size_t)value;
+        }
+    }
+#elif defined(__linux__)
+    char buffer[32];
+    for (int index = 0; index < 8; index++) {
+        if (!read_cache_attr(index, "level", buffer, sizeof(buffer))) {
+            break;
+        }
+        if (atoi(buffer) != 2) {
+            continue;
+        }
+        if (read_cache_attr(index, "type", buffer, sizeof(buffer)) &&
+            strncmp(buffer, "Instruction", 11) == 0) {
+            continue;
+        }
+        if (!read_cache_attr(index, "size", buffer, sizeof(buffer))) {
+            continue;
+        }
+
+        // "2048K" or "1M"
+        char* end = NULL;
+        size_t value = (size_t)strtoul(buffer, &end, 10);
+        if (end && (*end == 'K' || *end == 'k')) {
+            value *= 1024;
+        } else if (end && (*end == 'M' || *end == 'm')) {
+            value *= 1024 * 1024;
+        }
+        if (value > 0) {
+            return value;
+        }
+    }
+#endif
+    return CPU_DEFAULT_L2_CACHE_BYTES;
+}
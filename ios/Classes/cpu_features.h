@@ -0,0 +1,46 @@
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Typical per-core L2 of mobile CPUs, used when detection fails
+#define CPU_DEFAULT_L2_CACHE_BYTES (256 * 1024)
+
+// SIMD features usable by this process (CPU support and OS register state)
+typedef struct {
+    int sse2;
+    int avx2;
+    int avx512f;
+    int neon;
+} CpuFeatures;
+
+/**
+ * Detect SIMD features at runtime
+ *
+ * Uses CPUID/XGETBV on x86 and getauxval(AT_HWCAP) on ARM Linux/Android.
+ * AArch64 targets without getauxval (iOS) always report NEON, as do
+ * host builds with MASK_PROCESSOR_EMULATE_NEON.
+ *
+ * @param features Output feature flags
+ */
+void cpu_features_detect(CpuFeatures* features);
+
+/**
+ * Size of the L2 data cache of the first CPU
+ *
+ * Reads sysfs on Linux/Android and sysctl on Apple platforms; returns
+ * CPU_DEFAULT_L2_CACHE_BYTES when the size cannot be found.
+ *
+ * @return Cache size in bytes
+ */
+size_t cpu_l2_cache_bytes(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CPU_FEATURES_H
@@ -0,0 +1,104 @@
+#ifndef MASK_CACHE_H
+#define MASK_CACHE_H
+
+#include "content_hash.h"
+#include "mask_processor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Persistent on-disk cache of inference masks
+ *
+ * Masks are keyed by the content hash of their source image and stored as
+ * 8-bit values (round(mask * 255)) with run-length coding, which shrinks a
+ * typical mask 20-50x. The directory holds an append-only index log and a
+ * data file that is memory-mapped for reads:
+ *
+ * - a put writes and syncs the mask data before appending its index
+ *   record, so the index never points at data that is not on disk
+ * - index records carry a checksum; a torn record at the end of the log
+ *   (crash mid-append) is dropped when the cache is opened
+ * - least recently used masks are evicted once the stored bytes exceed the
+ *   budget, and the data file is compacted into a new generation, made
+ *   current by an atomic rename of the index, once most of it is dead
+ * - every hit appends a recency record; once the log holds several times
+ *   more records than live masks it is rewritten, by the same rename, to
+ *   one record per mask
+ *
+ * All functions are thread-safe.
+ */
+typedef struct MaskCache MaskCache;
+
+/**
+ * Open or create a cache in a directory
+ *
+ * @param cache Receives the cache, NULL on failure
+ * @param directory Cache directory (created if missing)
+ * @param max_bytes Budget for stored mask data
+ * @return Result code
+ */
+MaskProcessorResult mask_cache_open(MaskCache** cache, const char* directory, uint64_t max_bytes);
+
+/**
+ * Close a cache and release its files and mapping
+ *
+ * @param cache Cache to close (may be NULL)
+ */
+void mask_cache_close(MaskCache* cache);
+
+/**
+ * Look up a mask
+ *
+ * On a hit the mask is decoded into output as values q / 255.
+ *
+ * @param cache Cache
+ * @param key Content hash of the source image
+ * @param output Receives width * height mask values on a hit
+ * @param width Mask width; entries of another size miss
+ * @param height Mask height
+ * @param found Receives 1 on a hit, 0 on a miss
+ * @return Result code
+ */
+MaskProcessorResult mask_cache_get(
+    MaskCache* cache,
+    const MaskHash128* key,
+    double* output,
+    int width,
+    int height,
+    int* found
+);
+
+/**
+ * Store a mask, replacing any entry with the same key
+ *
+ * @param cache Cache
+ * @param key Content hash of the source image
+ * @param mask Mask values (0.0-1.0), width * height
+ * @param width Mask width
+ * @param height Mask height
+ * @return Result code
+ */
+MaskProcessorResult mask_cache_put(
+    MaskCache* cache,
+    const MaskHash128* key,
+    const double* mask,
+    int width,
+    int height
+);
+
+/**
+ * Current usage
+ *
+ * @param cache Cache
+ * @param bytes Receives the stored mask bytes (may be NULL)
+ * @param entries Receives the number of masks (may be NULL)
+ */
+void mask_cache_usage(MaskCache* cache, uint64_t* bytes, int* entries);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MASK_CACHE_H
@@ -0,0 +1,121 @@
+// syscall() is not declared under strict ISO C modes
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "perf_counters.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define COUNTER_COUNT 6
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} counter_events[COUNTER_COUNT] = {
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+                          (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+};
+
+// One set of counters per measuring thread
+static __thread int counter_fds[COUNTER_COUNT] = { -1, -1, -1, -1, -1, -1 };
+
+static void close_counters(void) {
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        if (counter_fds[i] >= 0) {
+            close(counter_fds[i]);
+            counter_fds[i] = -1;
+        }
+    }
+}
+
+MaskProcessorResult mask_perf_counters_start(void) {
+    close_counters();
+
+    int opened = 0;
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = counter_events[i].type;
+        attr.config = counter_events[i].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        counter_fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (counter_fds[i] >= 0) {
+            opened++;
+        }
+    }
+    if (!opened) {
+        return MASK_PROCESSOR_ERROR_PROCESSING;
+    }
+
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        if (counter_fds[i] >= 0) {
+            ioctl(counter_fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(counter_fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+    return MASK_PROCESSOR_SUCCESS;
+}
+
+MaskProcessorResult mask_perf_counters_stop(MaskPerfCounters* counters) {
+    if (!counters) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+
+    int64_t values[COUNTER_COUNT];
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        uint64_t value = 0;
+        values[i] = -1;
+        if (counter_fds[i] >= 0) {
+            ioctl(counter_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+            if (read(counter_fds[i], &value, sizeof(value)) == (ssize_t)sizeof(value)) {
+                values[i] = (int64_t)value;
+            }
+        }
+    }
+    close_counters();
+
+    counters->task_clock_ns = values[0];
+    counters->cycles = values[1];
+    counters->instructions = values[2];
+    counters->cache_references = values[3];
+    counters->cache_misses = values[4];
+    counters->l1d_read_misses = values[5];
+    return MASK_PROCESSOR_SUCCESS;
+}
+
+#else
+
+MaskProcessorResult mask_perf_counters_start(void) {
+    return MASK_PROCESSOR_ERROR_PROCESSING;
+}
+
+MaskProcessorResult mask_perf_counters_stop(MaskPerfCounters* counters) {
+    if (!counters) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+    counters->task_clock_ns = -1;
+    counters->cycles = -1;
+    counters->instructions = -1;
+    counters->cache_references = -1;
+    counters->cache_misses = -1;
+    counters->l1d_read_misses = -1;
+    return MASK_PROCESSOR_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include "mask_processor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Counts over one measured region of the calling thread; -1 where the
+// kernel or the hardware does not provide a counter
+typedef struct {
+    int64_t task_clock_ns;
+    int64_t cycles;
+    int64_t instructions;
+    int64_t cache_references;
+    int64_t cache_misses;
+    int64_t l1d_read_misses;
+} MaskPerfCounters;
+
+/**
+ * Start counting on the calling thread (Linux and Android perf events)
+ *
+ * Only the calling thread is counted, so measure with
+ * mask_processor_set_thread_count(1) to cover all of a kernel's work.
+ * Counters the kernel refuses (perf_event_paranoid, no PMU in a VM) are
+ * left out.
+ *
+ * @return MASK_PROCESSOR_ERROR_PROCESSING if no counter could be opened
+ */
+MaskProcessorResult mask_perf_counters_start(void);
+
+/**
+ * Stop counting and read the counters opened by mask_perf_counters_start
+ *
+ * @param counters Output counts
+ * @return Result code
+ */
+MaskProcessorResult mask_perf_counters_stop(MaskPerfCounters* counters);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PERF_COUNTERS_H
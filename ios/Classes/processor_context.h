@@ -0,0 +1,174 @@
+#ifndef PROCESSOR_CONTEXT_H
+#define PROCESSOR_CONTEXT_H
+
+#include "mask_processor.h"
+#include "sticker_batch.h"
+#include "tensor_ops.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Scratch memory and configuration reused across processing calls
+ *
+ * The *_ctx variants below match their plain counterparts output for
+ * output, but take every temporary buffer, on the calling thread and on
+ * the pool workers alike, from scratch stacks the context owns. A stack
+ * that runs out falls back to the heap once and is grown to fit between
+ * calls, so after the first call at a given size repeated calls make no
+ * heap allocations.
+ *
+ * A context serves one call at a time. A call made while another thread
+ * is using the context still succeeds, with its scratch from the heap.
+ */
+typedef struct MaskProcessorContext MaskProcessorContext;
+
+/**
+ * Create a context
+ *
+ * @param context Receives the context, NULL on failure
+ * @param thread_count Threads for the library pool (0 keeps the current
+ *        pool); the pool is shared by every context
+ * @return Result code
+ */
+MaskProcessorResult mask_processor_context_create(
+    MaskProcessorContext** context,
+    int thread_count
+);
+
+/**
+ * Destroy a context and free its scratch memory
+ *
+ * @param context Context to destroy (may be NULL)
+ */
+void mask_processor_context_destroy(MaskProcessorContext* context);
+
+/**
+ * Free the scratch memory, e.g. after processing an unusually large image
+ *
+ * The next calls grow it again.
+ *
+ * @param context Context
+ */
+void mask_processor_context_trim(MaskProcessorContext* context);
+
+/**
+ * Heap blocks the context has allocated since creation
+ *
+ * Stays constant across calls once the scratch stacks fit the workload.
+ *
+ * @param context Context
+ * @return Allocation count
+ */
+uint64_t mask_processor_context_heap_allocations(const MaskProcessorContext* context);
+
+/**
+ * Bytes of scratch and staging memory the context holds between calls
+ *
+ * @param context Context
+ * @return Reserved bytes
+ */
+size_t mask_processor_context_reserved_bytes(const MaskProcessorContext* context);
+
+/**
+ * Staging buffer for the arguments of the next calls
+ *
+ * For bindings that copy arguments into native memory. The buffer holds at
+ * least bytes and stays valid until a later call asks for more, or the
+ * context is trimmed or destroyed; growing it does not keep its contents.
+ *
+ * @param context Context
+ * @param bytes Bytes needed
+ * @return Buffer aligned for any element type, or NULL on failure
+ */
+void* mask_processor_context_staging(MaskProcessorContext* context, size_t bytes);
+
+// smooth_mask_optimized with context scratch
+MaskProcessorResult smooth_mask_ctx(
+    MaskProcessorContext* context,
+    const double* mask,
+    double* output,
+    int width,
+    int height,
+    int kernel_size
+);
+
+// expand_mask_optimized with context scratch
+MaskProcessorResult expand_mask_ctx(
+    MaskProcessorContext* context,
+    const double* mask,
+    double* output,
+    int width,
+    int height,
+    int border_width
+);
+
+// compute_mask_sdf_native with context scratch
+MaskProcessorResult compute_mask_sdf_ctx(
+    MaskProcessorContext* context,
+    const double* mask,
+    float* sdf,
+    int width,
+    int height
+);
+
+// make_sticker_mask_fused with context scratch
+MaskProcessorResult make_sticker_mask_fused_ctx(
+    MaskProcessorContext* context,
+    const uint8_t* src,
+    uint8_t* dst,
+    const double* mask,
+    int width,
+    int height,
+    int kernel_size,
+    int add_border,
+    RGBColor border_color,
+    int border_width
+);
+
+// resize_rgba_to_nchw with context scratch
+MaskProcessorResult resize_rgba_to_nchw_ctx(
+    MaskProcessorContext* context,
+    const uint8_t* src,
+    int src_width,
+    int src_height,
+    float* dst,
+    int dst_width,
+    int dst_height,
+    const float* mean,
+    const float* inv_std
+);
+
+// upsample_mask_tensor with context scratch
+MaskProcessorResult upsample_mask_tensor_ctx(
+    MaskProcessorContext* context,
+    const float* src,
+    int src_width,
+    int src_height,
+    void* dst,
+    MaskOutputFormat format,
+    int dst_width,
+    int dst_height,
+    int apply_sigmoid,
+    double threshold
+);
+
+// make_stickers_batch with context scratch
+MaskProcessorResult make_stickers_batch_ctx(
+    MaskProcessorContext* context,
+    const StickerBatchItem* items,
+    int count,
+    int32_t* results,
+    int kernel_size,
+    int add_border,
+    RGBColor border_color,
+    int border_width
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROCESSOR_CONTEXT_H
@@ -0,0 +1,192 @@
+#include "processor_stats.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Counters of one thread. Only the owning thread writes them, with plain
+// load-add-store sequences; readers load each field atomically while it
+// may be writing.
+typedef struct StatsBlock {
+    MaskStageStats stages[MASK_STAGE_COUNT];
+    // Reset generation the counters belong to
+    uint32_t epoch;
+    // Nonzero while a live thread owns the block
+    int owned;
+    // Set before the block is published and never changed
+    struct StatsBlock* next;
+} StatsBlock;
+
+// Every block created so far. Blocks are never freed: when a thread exits
+// its block is released, and the next new thread takes it over with its
+// counts, so exited threads stay in the totals.
+static StatsBlock* blocks = NULL;
+static uint32_t stats_epoch = 0;
+
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t block_key;
+static int key_created = 0;
+
+static __thread StatsBlock* thread_block = NULL;
+// Timed calls in progress on this thread
+static __thread int call_depth = 0;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void release_block(void* value) {
+    thread_block = NULL;
+    __atomic_store_n(&((StatsBlock*)value)->owned, 0, __ATOMIC_RELEASE);
+}
+
+static void create_key(void) {
+    key_created = pthread_key_create(&block_key, release_block) == 0;
+}
+
+static StatsBlock* claim_block(void) {
+    pthread_once(&key_once, create_key);
+
+    StatsBlock* block = __atomic_load_n(&blocks, __ATOMIC_ACQUIRE);
+    for (; block; block = block->next) {
+        int released = 0;
+        if (__atomic_compare_exchange_n(&block->owned, &released, 1, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+
+    if (!block) {
+        block = (StatsBlock*)calloc(1, sizeof(StatsBlock));
+        if (!block) {
+            return NULL;
+        }
+        block->owned = 1;
+        block->next = __atomic_load_n(&blocks, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&blocks, &block->next, block, 1,
+                                            __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        }
+    }
+
+    // Without the key the block stays claimed after the thread exits
+    if (key_created) {
+        pthread_setspecific(block_key, block);
+    }
+    thread_block = block;
+    return block;
+}
+
+// Only the owning thread adds, so no read-modify-write is needed
+static inline void add_counter(uint64_t* counter, uint64_t value) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + value,
+                     __ATOMIC_RELAXED);
+}
+
+static void record(MaskStage stage, uint64_t elapsed_ns, uint64_t bytes, int failed) {
+    StatsBlock* block = thread_block ? thread_block : claim_block();
+    if (!block) {
+        return;
+    }
+
+    // Clear counts from before the last reset; readers skip the block
+    // until the new epoch is stored
+    const uint32_t epoch = __atomic_load_n(&stats_epoch, __ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&block->epoch, __ATOMIC_RELAXED) != epoch) {
+        uint64_t* counters = (uint64_t*)block->stages;
+        const size_t counter_count = sizeof(MaskStageStats) / sizeof(uint64_t) * MASK_STAGE_COUNT;
+        for (size_t i = 0; i < counter_count; i++) {
+            __atomic_store_n(&counters[i], 0, __ATOMIC_RELAXED);
+        }
+        __atomic_store_n(&block->epoch, epoch, __ATOMIC_RELEASE);
+    }
+
+    const uint64_t micros = elapsed_ns / 1000;
+    int bucket = micros < 2 ? 0 : 63 - __builtin_clzll(micros);
+    if (bucket >= MASK_STATS_HISTOGRAM_BUCKETS) {
+        bucket = MASK_STATS_HISTOGRAM_BUCKETS - 1;
+    }
+
+    MaskStageStats* stats = &block->stages[stage];
+    add_counter(&stats->calls, 1);
+    add_counter(&stats->errors, failed ? 1 : 0);
+    add_counter(&stats->total_ns, elapsed_ns);
+    add_counter(&stats->bytes, bytes);
+    add_counter(&stats->histogram[bucket], 1);
+    if (elapsed_ns > __atomic_load_n(&stats->max_ns, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&stats->max_ns, elapsed_ns, __ATOMIC_RELAXED);
+    }
+}
+
+MaskStageTimer mask_stage_enter(MaskStage stage, uint64_t bytes) {
+    MaskStageTimer timer = { 0, bytes, stage, call_depth++ == 0 };
+    if (timer.outermost) {
+        timer.start_ns = now_ns();
+    }
+    return timer;
+}
+
+MaskProcessorResult mask_stage_leave(MaskStageTimer timer, MaskProcessorResult result) {
+    call_depth--;
+    if (timer.outermost) {
+        const int failed = result != MASK_PROCESSOR_SUCCESS;
+        record(timer.stage, now_ns() - timer.start_ns, failed ? 0 : timer.bytes, failed);
+    }
+    return result;
+}
+
+int mask_stage_set_nesting(int nesting) {
+    const int previous = call_depth;
+    call_depth = nesting;
+    return previous;
+}
+
+MaskProcessorResult mask_processor_record_stage(
+    MaskStage stage,
+    uint64_t elapsed_ns,
+    uint64_t bytes
+) {
+    if ((int)stage < 0 || stage >= MASK_STAGE_COUNT) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+    record(stage, elapsed_ns, bytes, 0);
+    return MASK_PROCESSOR_SUCCESS;
+}
+
+MaskProcessorResult mask_processor_get_stats(MaskProcessorStats* stats) {
+    if (!stats) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+    memset(stats, 0, sizeof(*stats));
+
+    const uint32_t epoch = __atomic_load_n(&stats_epoch, __ATOMIC_ACQUIRE);
+    for (StatsBlock* block = __atomic_load_n(&blocks, __ATOMIC_ACQUIRE); block;
+         block = block->next) {
+        // Not yet cleared since the last reset
+        if (__atomic_load_n(&block->epoch, __ATOMIC_ACQUIRE) != epoch) {
+            continue;
+        }
+
+        for (int s = 0; s < MASK_STAGE_COUNT; s++) {
+            MaskStageStats* from = &block->stages[s];
+            MaskStageStats* to = &stats->stages[s];
+            to->calls += __atomic_load_n(&from->calls, __ATOMIC_RELAXED);
+            to->errors += __atomic_load_n(&from->errors, __ATOMIC_RELAXED);
+            to->total_ns += __atomic_load_n(&from->total_ns, __ATOMIC_RELAXED);
+            to->bytes += __atomic_load_n(&from->bytes, __ATOMIC_RELAXED);
+            const uint64_t max_ns = __atomic_load_n(&from->max_ns, __ATOMIC_RELAXED);
+            if (max_ns > to->max_ns) {
+                to->max_ns = max_ns;
+            }
+            for (int b = 0; b < MASK_STATS_HISTOGRAM_BUCKETS; b++) {
+                to->histogram[b] += __atomic_load_n(&from->histogram[b], __ATOMIC_RELAXED);
+            }
+        }
+    }
+    return MASK_PROCESSOR_SUCCESS;
+}
+
+void mask_processor_reset_stats(void) {
+    __atomic_add_fetch(&stats_epoch, 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,235 @@
+#include "scratch_arena.h"
+#include "mask_processor.h"
+#include "thread_pool.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define BLOCK_FREED 1U
+#define BLOCK_OVERFLOW 2U
+
+// No block below this one in the stack
+#define NO_BLOCK ((size_t)-1)
+
+// Precedes every block, padded so the block stays aligned
+typedef union {
+    struct {
+        // Stack offset of the block below, or NO_BLOCK
+        size_t below;
+        // Header plus block, rounded up to the alignment
+        size_t bytes;
+        unsigned flags;
+        // malloc() result an overflow block lives in
+        void* raw;
+    } h;
+    uint8_t pad[MASK_SCRATCH_ALIGN];
+} BlockHeader;
+
+typedef struct {
+    void* raw;
+    uint8_t* base;
+    size_t capacity;
+    size_t used;
+    // Offset of the topmost block, or NO_BLOCK
+    size_t top;
+    // Bytes in live overflow blocks
+    size_t overflow;
+    // Largest used + overflow seen since the stack last grew
+    size_t high_water;
+    uint64_t heap_allocations;
+} ArenaStack;
+
+// Slot 0 plus one per thread running pool bands
+#define ARENA_SLOTS (MASK_PROCESSOR_MAX_THREADS + 1)
+
+struct MaskArena {
+    ArenaStack stacks[ARENA_SLOTS];
+};
+
+static __thread MaskScratchBinding binding = { NULL, 0 };
+
+static size_t round_up(size_t bytes) {
+    return (bytes + MASK_SCRATCH_ALIGN - 1) & ~(size_t)(MASK_SCRATCH_ALIGN - 1);
+}
+
+// Aligned block from malloc; *raw receives the pointer to free
+static uint8_t* aligned_block(size_t bytes, void** raw) {
+    *raw = malloc(bytes + MASK_SCRATCH_ALIGN - 1);
+    if (!*raw) {
+        return NULL;
+    }
+    return (uint8_t*)round_up((size_t)(uintptr_t)*raw);
+}
+
+MaskArena* mask_arena_create(void) {
+    MaskArena* arena = (MaskArena*)calloc(1, sizeof(MaskArena));
+    if (!arena) {
+        return NULL;
+    }
+    for (int i = 0; i < ARENA_SLOTS; i++) {
+        arena->stacks[i].top = NO_BLOCK;
+    }
+    return arena;
+}
+
+void mask_arena_destroy(MaskArena* arena) {
+    if (!arena) {
+        return;
+    }
+    for (int i = 0; i < ARENA_SLOTS; i++) {
+        free(arena->stacks[i].raw);
+    }
+    free(arena);
+}
+
+void mask_arena_prepare(MaskArena* arena) {
+    // Bands go to whichever thread is free, so every band slot is sized for
+    // the most scratch any of them needed
+    const int threads = mask_processor_get_thread_count();
+    size_t band_high_water = 0;
+    for (int i = 1; i <= threads; i++) {
+        if (arena->stacks[i].high_water > band_high_water) {
+            band_high_water = arena->stacks[i].high_water;
+        }
+    }
+    for (int i = 1; i <= threads; i++) {
+        arena->stacks[i].high_water = band_high_water;
+    }
+
+    for (int i = 0; i < ARENA_SLOTS; i++) {
+        ArenaStack* stack = &arena->stacks[i];
+        if (stack->high_water <= stack->capacity || stack->used != 0) {
+            continue;
+        }
+
+        free(stack->raw);
+        stack->capacity = 0;
+        stack->base = aligned_block(stack->high_water, &stack->raw);
+        if (stack->base) {
+            stack->capacity = stack->high_water;
+            stack->heap_allocations++;
+        }
+    }
+}
+
+void mask_arena_trim(MaskArena* arena) {
+    for (int i = 0; i < ARENA_SLOTS; i++) {
+        ArenaStack* stack = &arena->stacks[i];
+        if (stack->used == 0) {
+            free(stack->raw);
+            stack->raw = NULL;
+            stack->base = NULL;
+            stack->capacity = 0;
+            stack->high_water = 0;
+        }
+    }
+}
+
+uint64_t mask_arena_heap_allocations(const MaskArena* arena) {
+    uint64_t total = 0;
+    for (int i = 0; i < ARENA_SLOTS; i++) {
+        total += arena->stacks[i].heap_allocations;
+    }
+    return total;
+}
+
+size_t mask_arena_reserved_bytes(const MaskArena* arena) {
+    size_t total = 0;
+    for (int i = 0; i < ARENA_SLOTS; i++) {
+        total += arena->stacks[i].capacity;
+    }
+    return total;
+}
+
+MaskScratchBinding mask_scratch_bind(MaskArena* arena, int slot) {
+    const MaskScratchBinding previous = binding;
+    binding.arena = arena;
+    binding.slot = slot >= 0 && slot < ARENA_SLOTS ? slot : 0;
+    return previous;
+}
+
+void mask_scratch_restore(MaskScratchBinding previous) {
+    binding = previous;
+}
+
+MaskArena* mask_scratch_arena(void) {
+    return binding.arena;
+}
+
+void* mask_scratch_alloc(size_t bytes) {
+    if (!binding.arena) {
+        return malloc(bytes);
+    }
+
+    ArenaStack* stack = &binding.arena->stacks[binding.slot];
+    const size_t block_bytes = sizeof(BlockHeader) + round_up(bytes);
+    if (stack->used + stack->overflow + block_bytes > stack->high_water) {
+        stack->high_water = stack->used + stack->overflow + block_bytes;
+    }
+
+    BlockHeader* header;
+    if (stack->used + block_bytes <= stack->capacity) {
+        header = (BlockHeader*)(stack->base + stack->used);
+        header->h.below = stack->top;
+        header->h.flags = 0;
+        header->h.raw = NULL;
+        stack->top = stack->used;
+        stack->used += block_bytes;
+    } else {
+        void* raw;
+        header = (BlockHeader*)aligned_block(block_bytes, &raw);
+        if (!header) {
+            return NULL;
+        }
+        header->h.below = NO_BLOCK;
+        header->h.flags = BLOCK_OVERFLOW;
+        header->h.raw = raw;
+        stack->overflow += block_bytes;
+        stack->heap_allocations++;
+    }
+    header->h.bytes = block_bytes;
+    return header + 1;
+}
+
+void* mask_scratch_calloc(size_t count, size_t size) {
+    if (!binding.arena) {
+        return calloc(count, size);
+    }
+    if (size != 0 && count > (size_t)-1 / size) {
+        return NULL;
+    }
+
+    void* pointer = mask_scratch_alloc(count * size);
+    if (pointer) {
+        memset(pointer, 0, count * size);
+    }
+    return pointer;
+}
+
+void mask_scratch_free(void* pointer) {
+    if (!binding.arena) {
+        free(pointer);
+        return;
+    }
+    if (!pointer) {
+        return;
+    }
+
+    ArenaStack* stack = &binding.arena->stacks[binding.slot];
+    BlockHeader* header = (BlockHeader*)pointer - 1;
+    if (header->h.flags & BLOCK_OVERFLOW) {
+        stack->overflow -= header->h.bytes;
+        free(header->h.raw);
+        return;
+    }
+
+    // Pop this block and any freed blocks it was holding up
+    header->h.flags |= BLOCK_FREED;
+    while (stack->top != NO_BLOCK) {
+        BlockHeader* top = (BlockHeader*)(stack->base + stack->top);
+        if (!(top->h.flags & BLOCK_FREED)) {
+            break;
+        }
+        stack->used = stack->top;
+        stack->top = top->h.below;
+    }
+}
@@ -1,7 +1,284 @@
 #include "simd_optimizations.h"
+#include "bit_mask.h"
+#include "cpu_features.h"
+#include "thread_pool.h"
+#include "tiling.h"
+#include "scratch_arena.h"
+#include "processor_stats.h"
+#include <stdlib.h>
+#include <string.h>
 
-#ifdef __ARM_NEON
-#include <arm_neon.h>
+// Smallest band handed to another thread, in pixels
+#define PARALLEL_MIN_BAND_PIXELS 16384
+
+// Threshold constants matching mask_processor.c
+#define THRESHOLD 0.5
+#define THRESHOLD_HIGH (THRESHOLD + 0.05)
+#define THRESHOLD_LOW (THRESHOLD - 0.05)
+#define THRESHOLD_RANGE 0.1
+
+// Scalar blur for the edge columns [x_begin, x_end) of one row, where the
+// window is clipped and normalized by the number of valid taps
+static void blur_row_edges(
+    const double* src,
+    double* dst,
+    int width,
+    int half_kernel,
+    int x_begin,
+    int x_end
+) {
+    for (int x = x_begin; x < x_end; x++) {
+        const int x0 = x - half_kernel < 0 ? 0 : x - half_kernel;
+        const int x1 = x + half_kernel >= width ? width - 1 : x + half_kernel;
+        double sum = 0.0;
+        for (int nx = x0; nx <= x1; nx++) {
+            sum += src[nx];
+        }
+        dst[x] = sum * (1.0 / (x1 - x0 + 1));
+    }
+}
+
+typedef struct {
+    MaskBlurRowsFn rows;
+    const double* src;
+    double* dst;
+    int width;
+    int height;
+    int half_kernel;
+} BlurPassJob;
+
+// Scalar direct-sum passes, the same arithmetic as the vector kernels so
+// banded callers get identical output on every ISA
+static void blur_rows_h_scalar(
+    const double* src,
+    double* dst,
+    int width,
+    int height,
+    int half_kernel,
+    int y_begin,
+    int y_end
+) {
+    (void)height;
+    for (int y = y_begin; y < y_end; y++) {
+        blur_row_edges(src + y * width, dst + (y - y_begin) * width, width, half_kernel, 0, width);
+    }
+}
+
+static void blur_rows_v_scalar(
+    const double* src,
+    double* dst,
+    int width,
+    int height,
+    int half_kernel,
+    int y_begin,
+    int y_end
+) {
+    for (int y = y_begin; y < y_end; y++) {
+        const int y0 = y - half_kernel < 0 ? 0 : y - half_kernel;
+        const int y1 = y + half_kernel >= height ? height - 1 : y + half_kernel;
+        const double inv_count = 1.0 / (y1 - y0 + 1);
+        double* out = dst + (y - y_begin) * width;
+
+        for (int x = 0; x < width; x++) {
+            double sum = 0.0;
+            for (int ny = y0; ny <= y1; ny++) {
+                sum += src[ny * width + x];
+            }
+            out[x] = sum * inv_count;
+        }
+    }
+}
+
+// Running-sum passes on mask_running_sum_quantize values: O(1) per pixel at
+// any kernel size, and every window sum is exact, so a band restarting the
+// sum at y_begin gives the same rows as one pass over the whole image
+static void blur_rows_h_running(
+    const double* src,
+    double* dst,
+    int width,
+    int height,
+    int half_kernel,
+    int y_begin,
+    int y_end
+) {
+    (void)height;
+    const double scale = mask_running_sum_scale(half_kernel);
+    // Columns [half_kernel, middle_end) have the full window on both sides
+    const int middle_end = width - half_kernel - 1;
+    const int prefix_end = half_kernel < width ? half_kernel : width;
+    const int suffix_begin = middle_end > half_kernel ? middle_end : half_kernel;
+    const double inv_full = 1.0 / ((double)(2 * half_kernel + 1) * scale);
+
+    for (int y = y_begin; y < y_end; y++) {
+        const double* in = src + (size_t)y * width;
+        double* out = dst + (size_t)(y - y_begin) * width;
+        const int x1 = half_kernel < width ? half_kernel : width - 1;
+        double sum = 0.0;
+        for (int nx = 0; nx <= x1; nx++) {
+            sum += mask_running_sum_quantize(in[nx], scale);
+        }
+        int count = x1 + 1;
+
+        for (int x = 0; x < prefix_end; x++) {
+            out[x] = mask_running_sum_mean(sum, count, scale);
+            if (x + half_kernel + 1 < width) {
+                sum += mask_running_sum_quantize(in[x + half_kernel + 1], scale);
+                count++;
+            }
+        }
+        for (int x = half_kernel; x < middle_end; x++) {
+            out[x] = sum * inv_full;
+            sum += mask_running_sum_quantize(in[x + half_kernel + 1], scale) -
+                   mask_running_sum_quantize(in[x - half_kernel], scale);
+        }
+        for (int x = suffix_begin; x < width; x++) {
+            out[x] = mask_running_sum_mean(sum, count, scale);
+            sum -= mask_running_sum_quantize(in[x - half_kernel], scale);
+            count--;
+        }
+    }
+}
+
+// Columns per block of the vertical pass; the block's sums stay on the stack
+#define RUNNING_SUM_COLUMNS 256
+
+static void blur_rows_v_running(
+    const double* src,
+    double* dst,
+    int width,
+    int height,
+    int half_kernel,
+    int y_begin,
+    int y_end
+) {
+    const double scale = mask_running_sum_scale(half_kernel);
+    double sums[RUNNING_SUM_COLUMNS];
+
+    for (int x0 = 0; x0 < width; x0 += RUNNING_SUM_COLUMNS) {
+        const int columns = width - x0 < RUNNING_SUM_COLUMNS ? width - x0 : RUNNING_SUM_COLUMNS;
+        const int y0 = y_begin - half_kernel < 0 ? 0 : y_begin - half_kernel;
+        const int y1 = y_begin + half_kernel >= height ? height - 1 : y_begin + half_kernel;
+
+        memset(sums, 0, sizeof(double) * columns);
+        for (int ny = y0; ny <= y1; ny++) {
+            const double* in = src + (size_t)ny * width + x0;
+            for (int x = 0; x < columns; x++) {
+                sums[x] += mask_running_sum_quantize(in[x], scale);
+            }
+        }
+        int count = y1 - y0 + 1;
+
+        for (int y = y_begin; y < y_end; y++) {
+            double* out = dst + (size_t)(y - y_begin) * width + x0;
+            const double inv_count = 1.0 / ((double)count * scale);
+            const double* enter = y + half_kernel + 1 < height
+                ? src + (size_t)(y + half_kernel + 1) * width + x0 : NULL;
+            const double* leave = y - half_kernel >= 0
+                ? src + (size_t)(y - half_kernel) * width + x0 : NULL;
+
+            // Inside the image: write the row and slide the window in one sweep
+            if (enter && leave) {
+                for (int x = 0; x < columns; x++) {
+                    out[x] = sums[x] * inv_count;
+                    sums[x] += mask_running_sum_quantize(enter[x], scale) -
+                               mask_running_sum_quantize(leave[x], scale);
+                }
+                continue;
+            }
+
+            for (int x = 0; x < columns; x++) {
+                out[x] = sums[x] * inv_count;
+            }
+            if (enter) {
+                for (int x = 0; x < columns; x++) {
+                    sums[x] += mask_running_sum_quantize(enter[x], scale);
+                }
+                count++;
+            } else if (leave) {
+                for (int x = 0; x < columns; x++) {
+                    sums[x] -= mask_running_sum_quantize(leave[x], scale);
+                }
+                count--;
+            }
+        }
+    }
+}
+
+static void blur_pass_band(void* context, int y_begin, int y_end) {
+    const BlurPassJob* job = (const BlurPassJob*)context;
+    job->rows(job->src, job->dst + (size_t)y_begin * job->width, job->width, job->height,
+              job->half_kernel, y_begin, y_end);
+}
+
+// Separable blur on the thread pool. The horizontal pass finishes before the
+// vertical one starts, so every halo row is complete when it is read.
+static MaskProcessorResult smooth_mask_separable(
+    const double* mask,
+    double* output,
+    int width,
+    int height,
+    int kernel_size,
+    MaskBlurRowsFn horizontal,
+    MaskBlurRowsFn vertical
+) {
+    if (!mask || !output || width <= 0 || height <= 0 || kernel_size <= 0) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+
+    if (kernel_size <= 1) {
+        memcpy(output, mask, sizeof(double) * width * height);
+        return MASK_PROCESSOR_SUCCESS;
+    }
+
+    double* temp = (double*)mask_scratch_alloc(sizeof(double) * width * height);
+    if (!temp) {
+        return MASK_PROCESSOR_ERROR_MEMORY;
+    }
+
+    const int min_rows = width < PARALLEL_MIN_BAND_PIXELS ? PARALLEL_MIN_BAND_PIXELS / width : 1;
+    BlurPassJob job = { horizontal, mask, temp, width, height, kernel_size / 2 };
+    MaskProcessorResult result = mask_parallel_for(height, min_rows, blur_pass_band, &job);
+
+    if (result == MASK_PROCESSOR_SUCCESS) {
+        job.rows = vertical;
+        job.src = temp;
+        job.dst = output;
+        result = mask_parallel_for(height, min_rows, blur_pass_band, &job);
+    }
+
+    mask_scratch_free(temp);
+    return result;
+}
+
+static MaskProcessorResult smooth_mask_scalar(
+    const double* mask,
+    double* output,
+    int width,
+    int height,
+    int kernel_size
+) {
+    return smooth_mask_separable(mask, output, width, height, kernel_size,
+                                 blur_rows_h_scalar, blur_rows_v_scalar);
+}
+
+#ifdef MASK_PROCESSOR_HAS_NEON
+#include "simd_vector.h"
+
+// Alpha ramp for two mask values, the arithmetic of alpha_ramp_pd: clamped
+// before rounding half away from zero, and NaN gives 0
+static inline mp_i64x2 alpha_ramp_f64x2(mp_f64x2 m) {
+    const mp_f64x2 zero = mp_f64x2_splat(0.0);
+    const mp_f64x2 scale = mp_f64x2_splat(255.0);
+
+    mp_f64x2 x = (m - mp_f64x2_splat(THRESHOLD_LOW)) / mp_f64x2_splat(THRESHOLD_RANGE) * scale;
+    x = mp_f64x2_select((mp_i64x2)(x > zero), x, zero);
+    x = mp_f64x2_select((mp_i64x2)(x < scale), x, scale);
+
+    const mp_i64x2 t = __builtin_convertvector(x, mp_i64x2);
+    const mp_f64x2 frac = x - __builtin_convertvector(t, mp_f64x2);
+    // Comparisons give -1 where true
+    return t - (mp_i64x2)(frac >= mp_f64x2_splat(0.5));
+}
 
 MaskProcessorResult apply_sticker_mask_neon(
     uint8_t* pixels,
@@ -13,11 +290,126 @@ MaskProcessorResult apply_sticker_mask_neon(
     int border_width,
     const double* expanded_mask
 ) {
-    // Use NEON for vectorized operations where possible
-    // For now, fall back to standard implementation
-    // TODO: Implement full NEON optimization
-    return apply_sticker_mask_native(pixels, mask, width, height, 
-                                   add_border, border_color, border_width, expanded_mask);
+    if (!pixels || !mask || width <= 0 || height <= 0) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+
+    const int total_pixels = width * height;
+    const double* border_mask = expanded_mask ? expanded_mask : mask;
+
+    const mp_f64x2 high = mp_f64x2_splat(THRESHOLD_HIGH);
+    const mp_f64x2 low = mp_f64x2_splat(THRESHOLD_LOW);
+    const mp_f64x2 mid = mp_f64x2_splat(THRESHOLD);
+    const mp_i64x2 border_on = { add_border ? -1 : 0, add_border ? -1 : 0 };
+    const uint64_t border_rgba =
+        (uint64_t)border_color.r |
+        ((uint64_t)border_color.g << 8) |
+        ((uint64_t)border_color.b << 16) |
+        0xFF000000u;
+
+    int i = 0;
+    // 2 pixels per iteration, each in one 64-bit lane; same branch-free
+    // blends as apply_sticker_mask_sse2
+    for (; i + 2 <= total_pixels; i += 2) {
+        const mp_f64x2 m = mp_f64x2_load(mask + i);
+        const mp_f64x2 e = mp_f64x2_load(border_mask + i);
+
+        const mp_i64x2 is_fg = (mp_i64x2)(m > high);
+        const mp_i64x2 is_bg = (mp_i64x2)(m < low);
+        const mp_i64x2 is_border = is_bg & border_on & (mp_i64x2)(e > mid);
+        const mp_i64x2 classified = is_fg | is_bg;
+
+        // The ramp (the only division) only when a lane is in the transition band
+        mp_i64x2 alpha = is_fg & 255;
+        if (!(classified[0] & classified[1])) {
+            alpha |= ~classified & alpha_ramp_f64x2(m);
+        }
+
+        mp_u64x2 rgba = mp_u64x2_from_u32x2(pixels + i * 4);
+        rgba = (rgba & 0x00FFFFFFu) | ((mp_u64x2)alpha << 24);
+        rgba = (rgba & ~(mp_u64x2)is_border) | ((mp_u64x2)is_border & border_rgba);
+        mp_u64x2_store_u32x2(pixels + i * 4, rgba);
+    }
+
+    // Scalar tail
+    if (i < total_pixels) {
+        return apply_sticker_mask_native(pixels + i * 4, mask + i, total_pixels - i, 1,
+                                         add_border, border_color, border_width,
+                                         expanded_mask ? expanded_mask + i : NULL);
+    }
+
+    return MASK_PROCESSOR_SUCCESS;
+}
+
+static void blur_rows_h_neon(
+    const double* src,
+    double* dst,
+    int width,
+    int height,
+    int half_kernel,
+    int y_begin,
+    int y_end
+) {
+    (void)height;
+    const int taps = 2 * half_kernel + 1;
+    const mp_f64x2 inv_taps = mp_f64x2_splat(1.0 / taps);
+    // Columns whose window lies fully inside the row
+    const int interior_begin = half_kernel < width ? half_kernel : width;
+    const int interior_end = width - half_kernel > interior_begin ? width - half_kernel : interior_begin;
+
+    // Horizontal pass: scalar prologue/epilogue, 2 columns per vector inside
+    for (int y = y_begin; y < y_end; y++) {
+        const double* row = src + y * width;
+        double* out = dst + (y - y_begin) * width;
+
+        blur_row_edges(row, out, width, half_kernel, 0, interior_begin);
+
+        int x = interior_begin;
+        for (; x + 2 <= interior_end; x += 2) {
+            const double* window = row + x - half_kernel;
+            mp_f64x2 sum = mp_f64x2_load(window);
+            for (int k = 1; k < taps; k++) {
+                sum += mp_f64x2_load(window + k);
+            }
+            mp_f64x2_store(out + x, sum * inv_taps);
+        }
+        blur_row_edges(row, out, width, half_kernel, x, width);
+    }
+}
+
+static void blur_rows_v_neon(
+    const double* src,
+    double* dst,
+    int width,
+    int height,
+    int half_kernel,
+    int y_begin,
+    int y_end
+) {
+    // Vertical pass: clipped rows only change the per-row reciprocal
+    for (int y = y_begin; y < y_end; y++) {
+        const int y0 = y - half_kernel < 0 ? 0 : y - half_kernel;
+        const int y1 = y + half_kernel >= height ? height - 1 : y + half_kernel;
+        const double inv_count = 1.0 / (y1 - y0 + 1);
+        const mp_f64x2 inv_count_v = mp_f64x2_splat(inv_count);
+        double* out = dst + (y - y_begin) * width;
+
+        int x = 0;
+        for (; x + 2 <= width; x += 2) {
+            mp_f64x2 sum = mp_f64x2_load(src + y0 * width + x);
+            for (int ny = y0 + 1; ny <= y1; ny++) {
+                sum += mp_f64x2_load(src + ny * width + x);
+            }
+            mp_f64x2_store(out + x, sum * inv_count_v);
+        }
+        for (; x < width; x++) {
+            double sum = 0.0;
+            for (int ny = y0; ny <= y1; ny++) {
+                sum += src[ny * width + x];
+            }
+            out[x] = sum * inv_count;
+        }
+    }
 }
 
 MaskProcessorResult smooth_mask_neon(
@@ -27,17 +419,42 @@ MaskProcessorResult smooth_mask_neon(
     int height,
     int kernel_size
 ) {
-    // Use NEON for vectorized blur operations
-    // For now, fall back to standard implementation
-    // TODO: Implement full NEON optimization
-    return smooth_mask_native(mask, output, width, height, kernel_size);
+    return smooth_mask_separable(mask, output, width, height, kernel_size,
+                                 blur_rows_h_neon, blur_rows_v_neon);
 }
 
-#endif // __ARM_NEON
+#endif // MASK_PROCESSOR_HAS_NEON
 
 #ifdef __SSE2__
 #include <emmintrin.h>
 
+// Narrow two 64-bit compare masks to four 32-bit lane masks (one per pixel)
+static inline __m128i narrow_mask_pd(__m128d lo, __m128d hi) {
+    return _mm_castps_si128(_mm_shuffle_ps(
+        _mm_castpd_ps(lo), _mm_castpd_ps(hi), _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+// Alpha ramp for two mask values, bit-identical to
+// clamp_int((int)round((m - LOW) / RANGE * 255.0), 0, 255) in the scalar path.
+// Clamping before rounding gives the same result and keeps the conversion in
+// range; round-half-away is rebuilt from truncation since SSE2 has no roundpd.
+static inline __m128i alpha_ramp_pd(__m128d m) {
+    const __m128d low = _mm_set1_pd(THRESHOLD_LOW);
+    const __m128d range = _mm_set1_pd(THRESHOLD_RANGE);
+    const __m128d scale = _mm_set1_pd(255.0);
+    const __m128d half = _mm_set1_pd(0.5);
+
+    __m128d x = _mm_mul_pd(_mm_div_pd(_mm_sub_pd(m, low), range), scale);
+    // max_pd returns the second operand for NaN, matching the scalar clamp to 0
+    x = _mm_min_pd(_mm_max_pd(x, _mm_setzero_pd()), scale);
+
+    const __m128i t = _mm_cvttpd_epi32(x);
+    const __m128d frac = _mm_sub_pd(x, _mm_cvtepi32_pd(t));
+    const __m128i round_up = _mm_srli_epi32(
+        narrow_mask_pd(_mm_cmpge_pd(frac, half), _mm_setzero_pd()), 31);
+    return _mm_add_epi32(t, round_up);
+}
+
 MaskProcessorResult apply_sticker_mask_sse2(
     uint8_t* pixels,
     const double* mask,
@@ -48,11 +465,143 @@ MaskProcessorResult apply_sticker_mask_sse2(
     int border_width,
     const double* expanded_mask
 ) {
-    // Use SSE2 for vectorized operations where possible
-    // For now, fall back to standard implementation
-    // TODO: Implement full SSE2 optimization
-    return apply_sticker_mask_native(pixels, mask, width, height, 
-                                   add_border, border_color, border_width, expanded_mask);
+    if (!pixels || !mask || width <= 0 || height <= 0) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+
+    const int total_pixels = width * height;
+    const double* border_mask = expanded_mask ? expanded_mask : mask;
+
+    const __m128d high = _mm_set1_pd(THRESHOLD_HIGH);
+    const __m128d low = _mm_set1_pd(THRESHOLD_LOW);
+    const __m128d mid = _mm_set1_pd(THRESHOLD);
+    const __m128i rgb_bits = _mm_set1_epi32(0x00FFFFFF);
+    const __m128i border_on = _mm_set1_epi32(add_border ? -1 : 0);
+    const __m128i border_rgba = _mm_set1_epi32((int)(
+        (uint32_t)border_color.r |
+        ((uint32_t)border_color.g << 8) |
+        ((uint32_t)border_color.b << 16) |
+        0xFF000000u));
+    const __m128i opaque = _mm_set1_epi32(255);
+
+    int i = 0;
+    // 4 pixels (16 RGBA bytes) per iteration
+    for (; i + 4 <= total_pixels; i += 4) {
+        const __m128d m01 = _mm_loadu_pd(mask + i);
+        const __m128d m23 = _mm_loadu_pd(mask + i + 2);
+        const __m128d e01 = _mm_loadu_pd(border_mask + i);
+        const __m128d e23 = _mm_loadu_pd(border_mask + i + 2);
+
+        const __m128i is_fg = narrow_mask_pd(
+            _mm_cmpgt_pd(m01, high), _mm_cmpgt_pd(m23, high));
+        const __m128i is_bg = narrow_mask_pd(
+            _mm_cmplt_pd(m01, low), _mm_cmplt_pd(m23, low));
+        const __m128i is_border = _mm_and_si128(
+            _mm_and_si128(is_bg, border_on),
+            narrow_mask_pd(_mm_cmpgt_pd(e01, mid), _mm_cmpgt_pd(e23, mid)));
+
+        // Foreground is 255 and background 0; the ramp (the only division) is
+        // evaluated only when a lane actually sits in the transition band
+        __m128i alpha = _mm_and_si128(is_fg, opaque);
+        if (_mm_movemask_epi8(_mm_or_si128(is_fg, is_bg)) != 0xFFFF) {
+            const __m128i ramp = _mm_unpacklo_epi64(alpha_ramp_pd(m01), alpha_ramp_pd(m23));
+            alpha = _mm_or_si128(alpha, _mm_andnot_si128(_mm_or_si128(is_fg, is_bg), ramp));
+        }
+
+        __m128i rgba = _mm_loadu_si128((const __m128i*)(pixels + i * 4));
+        rgba = _mm_or_si128(_mm_and_si128(rgba, rgb_bits), _mm_slli_epi32(alpha, 24));
+        rgba = _mm_or_si128(_mm_andnot_si128(is_border, rgba),
+                            _mm_and_si128(is_border, border_rgba));
+        _mm_storeu_si128((__m128i*)(pixels + i * 4), rgba);
+    }
+
+    // Scalar tail
+    if (i < total_pixels) {
+        return apply_sticker_mask_native(pixels + i * 4, mask + i, total_pixels - i, 1,
+                                         add_border, border_color, border_width,
+                                         expanded_mask ? expanded_mask + i : NULL);
+    }
+
+    return MASK_PROCESSOR_SUCCESS;
+}
+
+static void blur_rows_h_sse2(
+    const double* src,
+    double* dst,
+    int width,
+    int height,
+    int half_kernel,
+    int y_begin,
+    int y_end
+) {
+    (void)height;
+    const int taps = 2 * half_kernel + 1;
+    const __m128d inv_taps = _mm_set1_pd(1.0 / taps);
+    // Columns whose window lies fully inside the row
+    const int interior_begin = half_kernel < width ? half_kernel : width;
+    const int interior_end = width - half_kernel > interior_begin ? width - half_kernel : interior_begin;
+
+    // Horizontal pass: scalar prologue/epilogue, 4 columns per iteration inside
+    for (int y = y_begin; y < y_end; y++) {
+        const double* row = src + y * width;
+        double* out = dst + (y - y_begin) * width;
+
+        blur_row_edges(row, out, width, half_kernel, 0, interior_begin);
+
+        int x = interior_begin;
+        for (; x + 4 <= interior_end; x += 4) {
+            const double* window = row + x - half_kernel;
+            __m128d sum01 = _mm_loadu_pd(window);
+            __m128d sum23 = _mm_loadu_pd(window + 2);
+            for (int k = 1; k < taps; k++) {
+                sum01 = _mm_add_pd(sum01, _mm_loadu_pd(window + k));
+                sum23 = _mm_add_pd(sum23, _mm_loadu_pd(window + k + 2));
+            }
+            _mm_storeu_pd(out + x, _mm_mul_pd(sum01, inv_taps));
+            _mm_storeu_pd(out + x + 2, _mm_mul_pd(sum23, inv_taps));
+        }
+        blur_row_edges(row, out, width, half_kernel, x, width);
+    }
+}
+
+static void blur_rows_v_sse2(
+    const double* src,
+    double* dst,
+    int width,
+    int height,
+    int half_kernel,
+    int y_begin,
+    int y_end
+) {
+    // Vertical pass: clipped rows only change the per-row reciprocal
+    for (int y = y_begin; y < y_end; y++) {
+        const int y0 = y - half_kernel < 0 ? 0 : y - half_kernel;
+        const int y1 = y + half_kernel >= height ? height - 1 : y + half_kernel;
+        const double inv_count = 1.0 / (y1 - y0 + 1);
+        const __m128d inv_count_v = _mm_set1_pd(inv_count);
+        double* out = dst + (y - y_begin) * width;
+
+        int x = 0;
+        for (; x + 4 <= width; x += 4) {
+            const double* col = src + y0 * width + x;
+            __m128d sum01 = _mm_loadu_pd(col);
+            __m128d sum23 = _mm_loadu_pd(col + 2);
+            for (int ny = y0 + 1; ny <= y1; ny++) {
+                col += width;
+                sum01 = _mm_add_pd(sum01, _mm_loadu_pd(col));
+                sum23 = _mm_add_pd(sum23, _mm_loadu_pd(col + 2));
+            }
+            _mm_storeu_pd(out + x, _mm_mul_pd(sum01, inv_count_v));
+            _mm_storeu_pd(out + x + 2, _mm_mul_pd(sum23, inv_count_v));
+        }
+        for (; x < width; x++) {
+            double sum = 0.0;
+            for (int ny = y0; ny <= y1; ny++) {
+                sum += src[ny * width + x];
+            }
+            out[x] = sum * inv_count;
+        }
+    }
 }
 
 MaskProcessorResult smooth_mask_sse2(
@@ -62,14 +611,544 @@ MaskProcessorResult smooth_mask_sse2(
     int height,
     int kernel_size
 ) {
-    // Use SSE2 for vectorized blur operations
-    // For now, fall back to standard implementation
-    // TODO: Implement full SSE2 optimization
-    return smooth_mask_native(mask, output, width, height, kernel_size);
+    return smooth_mask_separable(mask, output, width, height, kernel_size,
+                                 blur_rows_h_sse2, blur_rows_v_sse2);
 }
 
 #endif // __SSE2__
 
+#ifdef MASK_PROCESSOR_HAS_X86_AVX
+#include <immintrin.h>
+
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+
+// Gather the low halves of two 4x64-bit compare masks into one 8x32 mask
+TARGET_AVX2 static inline __m256i narrow_mask_pd256(__m256d lo, __m256d hi) {
+    const __m256 packed = _mm256_shuffle_ps(
+        _mm256_castpd_ps(lo), _mm256_castpd_ps(hi), _MM_SHUFFLE(2, 0, 2, 0));
+    return _mm256_permute4x64_epi64(_mm256_castps_si256(packed), _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+// Same ramp and rounding as alpha_ramp_pd, four lanes at a time
+TARGET_AVX2 static inline __m128i alpha_ramp_pd256(__m256d m) {
+    const __m256d scale = _mm256_set1_pd(255.0);
+
+    __m256d x = _mm256_mul_pd(
+        _mm256_div_pd(_mm256_sub_pd(m, _mm256_set1_pd(THRESHOLD_LOW)),
+                      _mm256_set1_pd(THRESHOLD_RANGE)),
+        scale);
+    x = _mm256_min_pd(_mm256_max_pd(x, _mm256_setzero_pd()), scale);
+
+    const __m256d t = _mm256_round_pd(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    const __m256d round_up = _mm256_and_pd(
+        _mm256_cmp_pd(_mm256_sub_pd(x, t), _mm256_set1_pd(0.5), _CMP_GE_OQ),
+        _mm256_set1_pd(1.0));
+    return _mm256_cvttpd_epi32(_mm256_add_pd(t, round_up));
+}
+
+TARGET_AVX2 MaskProcessorResult apply_sticker_mask_avx2(
+    uint8_t* pixels,
+    const double* mask,
+    int width,
+    int height,
+    int add_border,
+    RGBColor border_color,
+    int border_width,
+    const double* expanded_mask
+) {
+    if (!pixels || !mask || width <= 0 || height <= 0) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+
+    const int total_pixels = width * height;
+    const double* border_mask = expanded_mask ? expanded_mask : mask;
+
+    const __m256d high = _mm256_set1_pd(THRESHOLD_HIGH);
+    const __m256d low = _mm256_set1_pd(THRESHOLD_LOW);
+    const __m256d mid = _mm256_set1_pd(THRESHOLD);
+    const __m256i rgb_bits = _mm256_set1_epi32(0x00FFFFFF);
+    const __m256i border_on = _mm256_set1_epi32(add_border ? -1 : 0);
+    const __m256i border_rgba = _mm256_set1_epi32((int)(
+        (uint32_t)border_color.r |
+        ((uint32_t)border_color.g << 8) |
+        ((uint32_t)border_color.b << 16) |
+        0xFF000000u));
+    const __m256i opaque = _mm256_set1_epi32(255);
+
+    int i = 0;
+    // 8 pixels (32 RGBA bytes) per iteration
+    for (; i + 8 <= total_pixels; i += 8) {
+        const __m256d m0 = _mm256_loadu_pd(mask + i);
+        const __m256d m1 = _mm256_loadu_pd(mask + i + 4);
+        const __m256d e0 = _mm256_loadu_pd(border_mask + i);
+        const __m256d e1 = _mm256_loadu_pd(border_mask + i + 4);
+
+        const __m256i is_fg = narrow_mask_pd256(
+            _mm256_cmp_pd(m0, high, _CMP_GT_OQ), _mm256_cmp_pd(m1, high, _CMP_GT_OQ));
+        const __m256i is_bg = narrow_mask_pd256(
+            _mm256_cmp_pd(m0, low, _CMP_LT_OQ), _mm256_cmp_pd(m1, low, _CMP_LT_OQ));
+        const __m256i is_border = _mm256_and_si256(
+            _mm256_and_si256(is_bg, border_on),
+            narrow_mask_pd256(_mm256_cmp_pd(e0, mid, _CMP_GT_OQ),
+                              _mm256_cmp_pd(e1, mid, _CMP_GT_OQ)));
+
+        const __m256i is_solid = _mm256_or_si256(is_fg, is_bg);
+        __m256i alpha = _mm256_and_si256(is_fg, opaque);
+        if (_mm256_movemask_epi8(is_solid) != -1) {
+            const __m256i ramp = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(alpha_ramp_pd256(m0)), alpha_ramp_pd256(m1), 1);
+            alpha = _mm256_or_si256(alpha, _mm256_andnot_si256(is_solid, ramp));
+        }
+
+        __m256i rgba = _mm256_loadu_si256((const __m256i*)(pixels + i * 4));
+        rgba = _mm256_or_si256(_mm256_and_si256(rgba, rgb_bits), _mm256_slli_epi32(alpha, 24));
+        rgba = _mm256_blendv_epi8(rgba, border_rgba, is_border);
+        _mm256_storeu_si256((__m256i*)(pixels + i * 4), rgba);
+    }
+
+    // Scalar tail
+    if (i < total_pixels) {
+        return apply_sticker_mask_native(pixels + i * 4, mask + i, total_pixels - i, 1,
+                                         add_border, border_color, border_width,
+                                         expanded_mask ? expanded_mask + i : NULL);
+    }
+
+    return MASK_PROCESSOR_SUCCESS;
+}
+
+TARGET_AVX2 static void blur_rows_h_avx2(
+    const double* src,
+    double* dst,
+    int width,
+    int height,
+    int half_kernel,
+    int y_begin,
+    int y_end
+) {
+    (void)height;
+    const int taps = 2 * half_kernel + 1;
+    const __m256d inv_taps = _mm256_set1_pd(1.0 / taps);
+    const int interior_begin = half_kernel < width ? half_kernel : width;
+    const int interior_end = width - half_kernel > interior_begin ? width - half_kernel : interior_begin;
+
+    // Horizontal pass: scalar prologue/epilogue, 4 columns per vector inside
+    for (int y = y_begin; y < y_end; y++) {
+        const double* row = src + y * width;
+        double* out = dst + (y - y_begin) * width;
+
+        blur_row_edges(row, out, width, half_kernel, 0, interior_begin);
+
+        int x = interior_begin;
+        for (; x + 4 <= interior_end; x += 4) {
+            const double* window = row + x - half_kernel;
+            __m256d sum = _mm256_loadu_pd(window);
+            for (int k = 1; k < taps; k++) {
+                sum = _mm256_add_pd(sum, _mm256_loadu_pd(window + k));
+            }
+            _mm256_storeu_pd(out + x, _mm256_mul_pd(sum, inv_taps));
+        }
+        blur_row_edges(row, out, width, half_kernel, x, width);
+    }
+}
+
+TARGET_AVX2 static void blur_rows_v_avx2(
+    const double* src,
+    double* dst,
+    int width,
+    int height,
+    int half_kernel,
+    int y_begin,
+    int y_end
+) {
+    // Vertical pass: clipped rows only change the per-row reciprocal
+    for (int y = y_begin; y < y_end; y++) {
+        const int y0 = y - half_kernel < 0 ? 0 : y - half_kernel;
+        const int y1 = y + half_kernel >= height ? height - 1 : y + half_kernel;
+        const double inv_count = 1.0 / (y1 - y0 + 1);
+        const __m256d inv_count_v = _mm256_set1_pd(inv_count);
+        double* out = dst + (y - y_begin) * width;
+
+        int x = 0;
+        for (; x + 8 <= width; x += 8) {
+            const double* col = src + y0 * width + x;
+            __m256d sum0 = _mm256_loadu_pd(col);
+            __m256d sum1 = _mm256_loadu_pd(col + 4);
+            for (int ny = y0 + 1; ny <= y1; ny++) {
+                col += width;
+                sum0 = _mm256_add_pd(sum0, _mm256_loadu_pd(col));
+                sum1 = _mm256_add_pd(sum1, _mm256_loadu_pd(col + 4));
+            }
+            _mm256_storeu_pd(out + x, _mm256_mul_pd(sum0, inv_count_v));
+            _mm256_storeu_pd(out + x + 4, _mm256_mul_pd(sum1, inv_count_v));
+        }
+        for (; x < width; x++) {
+            double sum = 0.0;
+            for (int ny = y0; ny <= y1; ny++) {
+                sum += src[ny * width + x];
+            }
+            out[x] = sum * inv_count;
+        }
+    }
+}
+
+TARGET_AVX2 MaskProcessorResult smooth_mask_avx2(
+    const double* mask,
+    double* output,
+    int width,
+    int height,
+    int kernel_size
+) {
+    return smooth_mask_separable(mask, output, width, height, kernel_size,
+                                 blur_rows_h_avx2, blur_rows_v_avx2);
+}
+
+// Same ramp and rounding as alpha_ramp_pd, eight lanes at a time
+TARGET_AVX512 static inline __m256i alpha_ramp_pd512(__m512d m) {
+    const __m512d scale = _mm512_set1_pd(255.0);
+
+    __m512d x = _mm512_mul_pd(
+        _mm512_div_pd(_mm512_sub_pd(m, _mm512_set1_pd(THRESHOLD_LOW)),
+                      _mm512_set1_pd(THRESHOLD_RANGE)),
+        scale);
+    x = _mm512_min_pd(_mm512_max_pd(x, _mm512_setzero_pd()), scale);
+
+    const __m512d t = _mm512_roundscale_pd(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    const __mmask8 round_up = _mm512_cmp_pd_mask(_mm512_sub_pd(x, t), _mm512_set1_pd(0.5), _CMP_GE_OQ);
+    return _mm512_cvttpd_epi32(_mm512_mask_add_pd(t, round_up, t, _mm512_set1_pd(1.0)));
+}
+
+TARGET_AVX512 MaskProcessorResult apply_sticker_mask_avx512(
+    uint8_t* pixels,
+    const double* mask,
+    int width,
+    int height,
+    int add_border,
+    RGBColor border_color,
+    int border_width,
+    const double* expanded_mask
+) {
+    if (!pixels || !mask || width <= 0 || height <= 0) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+
+    const int total_pixels = width * height;
+    const double* border_mask = expanded_mask ? expanded_mask : mask;
+
+    const __m512d high = _mm512_set1_pd(THRESHOLD_HIGH);
+    const __m512d low = _mm512_set1_pd(THRESHOLD_LOW);
+    const __m512d mid = _mm512_set1_pd(THRESHOLD);
+    const __m512i rgb_bits = _mm512_set1_epi32(0x00FFFFFF);
+    const __m512i border_rgba = _mm512_set1_epi32((int)(
+        (uint32_t)border_color.r |
+        ((uint32_t)border_color.g << 8) |
+        ((uint32_t)border_color.b << 16) |
+        0xFF000000u));
+    const __m512i opaque = _mm512_set1_epi32(255);
+
+    int i = 0;
+    // 16 pixels (64 RGBA bytes) per iteration
+    for (; i + 16 <= total_pixels; i += 16) {
+        const __m512d m0 = _mm512_loadu_pd(mask + i);
+        const __m512d m1 = _mm512_loadu_pd(mask + i + 8);
+
+        const __mmask16 is_fg = (__mmask16)(
+            _mm512_cmp_pd_mask(m0, high, _CMP_GT_OQ) |
+            (_mm512_cmp_pd_mask(m1, high, _CMP_GT_OQ) << 8));
+        const __mmask16 is_bg = (__mmask16)(
+            _mm512_cmp_pd_mask(m0, low, _CMP_LT_OQ) |
+            (_mm512_cmp_pd_mask(m1, low, _CMP_LT_OQ) << 8));
+        __mmask16 is_border = 0;
+        if (add_border && is_bg) {
+            is_border = is_bg & (__mmask16)(
+                _mm512_cmp_pd_mask(_mm512_loadu_pd(border_mask + i), mid, _CMP_GT_OQ) |
+                (_mm512_cmp_pd_mask(_mm512_loadu_pd(border_mask + i + 8), mid, _CMP_GT_OQ) << 8));
+        }
+
+        const __mmask16 is_solid = is_fg | is_bg;
+        __m512i alpha = _mm512_maskz_mov_epi32(is_fg, opaque);
+        if (is_solid != 0xFFFF) {
+            const __m512i ramp = _mm512_inserti64x4(
+                _mm512_castsi256_si512(alpha_ramp_pd512(m0)), alpha_ramp_pd512(m1), 1);
+            alpha = _mm512_mask_mov_epi32(alpha, (__mmask16)~is_solid, ramp);
+        }
+
+        __m512i rgba = _mm512_loadu_si512((const void*)(pixels + i * 4));
+        rgba = _mm512_or_si512(_mm512_and_si512(rgba, rgb_bits), _mm512_slli_epi32(alpha, 24));
+        rgba = _mm512_mask_mov_epi32(rgba, is_border, border_rgba);
+        _mm512_storeu_si512((void*)(pixels + i * 4), rgba);
+    }
+
+    // Scalar tail
+    if (i < total_pixels) {
+        return apply_sticker_mask_native(pixels + i * 4, mask + i, total_pixels - i, 1,
+                                         add_border, border_color, border_width,
+                                         expanded_mask ? expanded_mask + i : NULL);
+    }
+
+    return MASK_PROCESSOR_SUCCESS;
+}
+
+TARGET_AVX512 static void blur_rows_h_avx512(
+    const double* src,
+    double* dst,
+    int width,
+    int height,
+    int half_kernel,
+    int y_begin,
+    int y_end
+) {
+    (void)height;
+    const int taps = 2 * half_kernel + 1;
+    const __m512d inv_taps = _mm512_set1_pd(1.0 / taps);
+    const int interior_begin = half_kernel < width ? half_kernel : width;
+    const int interior_end = width - half_kernel > interior_begin ? width - half_kernel : interior_begin;
+
+    // Horizontal pass: scalar prologue/epilogue, 8 columns per vector inside
+    for (int y = y_begin; y < y_end; y++) {
+        const double* row = src + y * width;
+        double* out = dst + (y - y_begin) * width;
+
+        blur_row_edges(row, out, width, half_kernel, 0, interior_begin);
+
+        int x = interior_begin;
+        for (; x + 8 <= interior_end; x += 8) {
+            const double* window = row + x - half_kernel;
+            __m512d sum = _mm512_loadu_pd(window);
+            for (int k = 1; k < taps; k++) {
+                sum = _mm512_add_pd(sum, _mm512_loadu_pd(window + k));
+            }
+            _mm512_storeu_pd(out + x, _mm512_mul_pd(sum, inv_taps));
+        }
+        blur_row_edges(row, out, width, half_kernel, x, width);
+    }
+}
+
+TARGET_AVX512 static void blur_rows_v_avx512(
+    const double* src,
+    double* dst,
+    int width,
+    int height,
+    int half_kernel,
+    int y_begin,
+    int y_end
+) {
+    // Vertical pass: clipped rows only change the per-row reciprocal
+    for (int y = y_begin; y < y_end; y++) {
+        const int y0 = y - half_kernel < 0 ? 0 : y - half_kernel;
+        const int y1 = y + half_kernel >= height ? height - 1 : y + half_kernel;
+        const double inv_count = 1.0 / (y1 - y0 + 1);
+        const __m512d inv_count_v = _mm512_set1_pd(inv_count);
+        double* out = dst + (y - y_begin) * width;
+
+        int x = 0;
+        for (; x + 8 <= width; x += 8) {
+            const double* col = src + y0 * width + x;
+            __m512d sum = _mm512_loadu_pd(col);
+            for (int ny = y0 + 1; ny <= y1; ny++) {
+                col += width;
+                sum = _mm512_add_pd(sum, _mm512_loadu_pd(col));
+            }
+            _mm512_storeu_pd(out + x, _mm512_mul_pd(sum, inv_count_v));
+        }
+        for (; x < width; x++) {
+            double sum = 0.0;
+            for (int ny = y0; ny <= y1; ny++) {
+                sum += src[ny * width + x];
+            }
+            out[x] = sum * inv_count;
+        }
+    }
+}
+
+TARGET_AVX512 MaskProcessorResult smooth_mask_avx512(
+    const double* mask,
+    double* output,
+    int width,
+    int height,
+    int kernel_size
+) {
+    return smooth_mask_separable(mask, output, width, height, kernel_size,
+                                 blur_rows_h_avx512, blur_rows_v_avx512);
+}
+
+#endif // MASK_PROCESSOR_HAS_X86_AVX
+
+// Runtime dispatch table, filled once at library load
+typedef MaskProcessorResult (*ApplyStickerMaskFn)(
+    uint8_t*, const double*, int, int, int, RGBColor, int, const double*);
+typedef MaskProcessorResult (*SmoothMaskFn)(const double*, double*, int, int, int);
+typedef MaskProcessorResult (*ExpandMaskFn)(const double*, double*, int, int, int);
+
+typedef struct {
+    MaskProcessorIsa isa;
+    ApplyStickerMaskFn apply_sticker_mask;
+    SmoothMaskFn smooth_mask;
+    ExpandMaskFn expand_mask;
+    MaskBlurRowsFn blur_rows_h;
+    MaskBlurRowsFn blur_rows_v;
+} MaskKernelTable;
+
+static MaskKernelTable kernel_table = {
+    MASK_PROCESSOR_ISA_SCALAR,
+    apply_sticker_mask_native,
+    smooth_mask_scalar,
+    expand_mask_native,
+    blur_rows_h_scalar,
+    blur_rows_v_scalar
+};
+static int kernel_table_ready = 0;
+
+// Fill the table for an ISA; returns 0 if this build has no kernels for it
+static int kernel_table_fill(MaskKernelTable* table, MaskProcessorIsa isa) {
+    // Dilation has no vector kernel yet, every ISA shares the native one
+    table->expand_mask = expand_mask_native;
+
+    switch (isa) {
+    case MASK_PROCESSOR_ISA_SCALAR:
+        table->apply_sticker_mask = apply_sticker_mask_native;
+        table->smooth_mask = smooth_mask_scalar;
+        table->blur_rows_h = blur_rows_h_scalar;
+        table->blur_rows_v = blur_rows_v_scalar;
+        break;
+#ifdef __SSE2__
+    case MASK_PROCESSOR_ISA_SSE2:
+        table->apply_sticker_mask = apply_sticker_mask_sse2;
+        table->smooth_mask = smooth_mask_sse2;
+        table->blur_rows_h = blur_rows_h_sse2;
+        table->blur_rows_v = blur_rows_v_sse2;
+        break;
+#endif
+#ifdef MASK_PROCESSOR_HAS_X86_AVX
+    case MASK_PROCESSOR_ISA_AVX2:
+        table->apply_sticker_mask = apply_sticker_mask_avx2;
+        table->smooth_mask = smooth_mask_avx2;
+        table->blur_rows_h = blur_rows_h_avx2;
+        table->blur_rows_v = blur_rows_v_avx2;
+        break;
+    case MASK_PROCESSOR_ISA_AVX512:
+        table->apply_sticker_mask = apply_sticker_mask_avx512;
+        table->smooth_mask = smooth_mask_avx512;
+        table->blur_rows_h = blur_rows_h_avx512;
+        table->blur_rows_v = blur_rows_v_avx512;
+        break;
+#endif
+#ifdef MASK_PROCESSOR_HAS_NEON
+    case MASK_PROCESSOR_ISA_NEON:
+        table->apply_sticker_mask = apply_sticker_mask_neon;
+        table->smooth_mask = smooth_mask_neon;
+        table->blur_rows_h = blur_rows_h_neon;
+        table->blur_rows_v = blur_rows_v_neon;
+        break;
+#endif
+    default:
+        return 0;
+    }
+
+    table->isa = isa;
+    return 1;
+}
+
+static int isa_supported(const CpuFeatures* features, MaskProcessorIsa isa) {
+    switch (isa) {
+    case MASK_PROCESSOR_ISA_SCALAR: return 1;
+    case MASK_PROCESSOR_ISA_SSE2: return features->sse2;
+    case MASK_PROCESSOR_ISA_AVX2: return features->avx2;
+    case MASK_PROCESSOR_ISA_AVX512: return features->avx512f;
+    case MASK_PROCESSOR_ISA_NEON: return features->neon;
+    default: return 0;
+    }
+}
+
+__attribute__((constructor))
+static void kernel_table_init(void) {
+    if (kernel_table_ready) {
+        return;
+    }
+
+    // Preferred order, best first
+    static const MaskProcessorIsa candidates[] = {
+        MASK_PROCESSOR_ISA_AVX512,
+        MASK_PROCESSOR_ISA_AVX2,
+        MASK_PROCESSOR_ISA_NEON,
+        MASK_PROCESSOR_ISA_SSE2,
+        MASK_PROCESSOR_ISA_SCALAR
+    };
+
+    CpuFeatures features;
+    cpu_features_detect(&features);
+
+    MaskKernelTable table = kernel_table;
+    for (size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); i++) {
+        if (isa_supported(&features, candidates[i]) &&
+            kernel_table_fill(&table, candidates[i])) {
+            break;
+        }
+    }
+
+    kernel_table = table;
+    kernel_table_ready = 1;
+}
+
+MaskProcessorIsa mask_processor_get_active_isa(void) {
+    kernel_table_init();
+    return kernel_table.isa;
+}
+
+MaskProcessorResult mask_processor_select_isa(MaskProcessorIsa isa) {
+    kernel_table_init();
+
+    CpuFeatures features;
+    cpu_features_detect(&features);
+
+    MaskKernelTable table = kernel_table;
+    if (!isa_supported(&features, isa) || !kernel_table_fill(&table, isa)) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+
+    kernel_table = table;
+    return MASK_PROCESSOR_SUCCESS;
+}
+
+typedef struct {
+    ApplyStickerMaskFn apply;
+    const uint8_t* src;
+    uint8_t* dst;
+    const double* mask;
+    int width;
+    int add_border;
+    RGBColor border_color;
+    int border_width;
+    const double* expanded_mask;
+    int result;
+} ApplyJob;
+
+// Apply the kernel to rows [y_begin, y_end), copying each slice of
+// MASK_PROCESSOR_COPY_BAND_PIXELS first when working out of place so it is
+// still in cache when the kernel reads it back
+static void apply_band(void* context, int y_begin, int y_end) {
+    ApplyJob* job = (ApplyJob*)context;
+    const int width = job->width;
+    const int band_rows = width < MASK_PROCESSOR_COPY_BAND_PIXELS
+        ? MASK_PROCESSOR_COPY_BAND_PIXELS / width : 1;
+
+    for (int y = y_begin; y < y_end; y += band_rows) {
+        const int rows = y_end - y < band_rows ? y_end - y : band_rows;
+        const size_t offset = (size_t)y * width;
+
+        if (job->dst != job->src) {
+            memcpy(job->dst + offset * 4, job->src + offset * 4, (size_t)rows * width * 4);
+        }
+        const MaskProcessorResult result = job->apply(
+            job->dst + offset * 4, job->mask + offset, width, rows, job->add_border,
+            job->border_color, job->border_width,
+            job->expanded_mask ? job->expanded_mask + offset : NULL);
+        if (result != MASK_PROCESSOR_SUCCESS) {
+            __atomic_store_n(&job->result, result, __ATOMIC_RELAXED);
+        }
+    }
+}
+
 // Auto-dispatch implementations
 MaskProcessorResult apply_sticker_mask_optimized(
     uint8_t* pixels,
@@ -81,16 +1160,127 @@ MaskProcessorResult apply_sticker_mask_optimized(
     int border_width,
     const double* expanded_mask
 ) {
-#ifdef __ARM_NEON
-    return apply_sticker_mask_neon(pixels, mask, width, height, 
-                                 add_border, border_color, border_width, expanded_mask);
-#elif defined(__SSE2__)
-    return apply_sticker_mask_sse2(pixels, mask, width, height, 
-                                 add_border, border_color, border_width, expanded_mask);
-#else
-    return apply_sticker_mask_native(pixels, mask, width, height, 
-                                   add_border, border_color, border_width, expanded_mask);
-#endif
+    return apply_sticker_mask_to_optimized(pixels, pixels, mask, width, height, add_border,
+                                           border_color, border_width, expanded_mask);
+}
+
+MaskProcessorResult apply_sticker_mask_to_optimized(
+    const uint8_t* src,
+    uint8_t* dst,
+    const double* mask,
+    int width,
+    int height,
+    int add_border,
+    RGBColor border_color,
+    int border_width,
+    const double* expanded_mask
+) {
+    const MaskStageTimer timer = mask_stage_enter(
+        MASK_STAGE_COMPOSITE, mask_stage_bytes(width, height, expanded_mask ? 24 : 16));
+    if (!src || !dst || !mask || width <= 0 || height <= 0) {
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_INVALID_PARAMS);
+    }
+
+    kernel_table_init();
+
+    ApplyJob job = {
+        kernel_table.apply_sticker_mask, src, dst, mask, width, add_border,
+        border_color, border_width, expanded_mask, MASK_PROCESSOR_SUCCESS
+    };
+    const int min_rows = width < PARALLEL_MIN_BAND_PIXELS ? PARALLEL_MIN_BAND_PIXELS / width : 1;
+    const MaskProcessorResult result = mask_parallel_for(height, min_rows, apply_band, &job);
+
+    return mask_stage_leave(
+        timer, result != MASK_PROCESSOR_SUCCESS ? result : (MaskProcessorResult)job.result);
+}
+
+typedef struct {
+    MaskBlurRowsFn horizontal;
+    MaskBlurRowsFn vertical;
+    const double* mask;
+    double* output;
+    int width;
+    int height;
+    int half_kernel;
+    int tile_width;
+} SmoothTileJob;
+
+// Blur one tile: the horizontal pass runs over the clipped halo rows and
+// columns, one row at a time, and keeps the tile's columns; the vertical
+// pass writes the tile's rows straight to the output. The halo reaches the
+// image edge wherever the clamp could, so every window matches the
+// untiled kernels.
+static void smooth_tile(void* context, const MaskTile* tile, void* scratch) {
+    const SmoothTileJob* job = (const SmoothTileJob*)context;
+    const int width = job->width;
+    const int half_kernel = job->half_kernel;
+    const int r0 = tile->y0 - half_kernel < 0 ? 0 : tile->y0 - half_kernel;
+    const int r1 = tile->y1 + half_kernel > job->height ? job->height : tile->y1 + half_kernel;
+    const int c0 = tile->x0 - half_kernel < 0 ? 0 : tile->x0 - half_kernel;
+    const int c1 = tile->x1 + half_kernel > width ? width : tile->x1 + half_kernel;
+    const int tile_width = tile->x1 - tile->x0;
+
+    double* row = (double*)scratch;
+    double* columns = row + job->tile_width + 2 * half_kernel;
+
+    for (int y = r0; y < r1; y++) {
+        job->horizontal(job->mask + (size_t)y * width + c0, row, c1 - c0, 1, half_kernel, 0, 1);
+        memcpy(columns + (size_t)(y - r0) * tile_width, row + (tile->x0 - c0),
+               sizeof(double) * tile_width);
+    }
+    for (int y = tile->y0; y < tile->y1; y++) {
+        job->vertical(columns, job->output + (size_t)y * width + tile->x0, tile_width,
+                      r1 - r0, half_kernel, y - r0, y - r0 + 1);
+    }
+}
+
+static MaskProcessorResult smooth_tiles(
+    const double* mask,
+    double* output,
+    int width,
+    int height,
+    int kernel_size,
+    const MaskTilePlan* plan
+) {
+    const int half_kernel = kernel_size / 2;
+    SmoothTileJob job = {
+        kernel_table.blur_rows_h, kernel_table.blur_rows_v, mask, output,
+        width, height, half_kernel, plan->tile_width
+    };
+    const size_t scratch = sizeof(double) *
+        ((size_t)plan->tile_width + 2 * half_kernel +
+         (size_t)(plan->tile_height + 2 * half_kernel) * plan->tile_width);
+    return mask_parallel_tiles(plan, scratch, smooth_tile, &job);
+}
+
+MaskProcessorResult smooth_mask_tiled(
+    const double* mask,
+    double* output,
+    int width,
+    int height,
+    int kernel_size
+) {
+    const MaskStageTimer timer = mask_stage_enter(
+        MASK_STAGE_SMOOTH, mask_stage_bytes(width, height, 16));
+    if (!mask || !output || width <= 0 || height <= 0 || kernel_size <= 0) {
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_INVALID_PARAMS);
+    }
+    if (kernel_size <= 1) {
+        memcpy(output, mask, sizeof(double) * width * height);
+        return mask_stage_leave(timer, MASK_PROCESSOR_SUCCESS);
+    }
+
+    if (kernel_size > MASK_PROCESSOR_DIRECT_SUM_MAX_KERNEL) {
+        return mask_stage_leave(timer, smooth_mask_separable(
+            mask, output, width, height, kernel_size, blur_rows_h_running, blur_rows_v_running));
+    }
+
+    kernel_table_init();
+
+    // Input rows and the tile's horizontal pass
+    MaskTilePlan plan;
+    mask_tile_plan(&plan, width, height, kernel_size / 2, 2 * sizeof(double));
+    return mask_stage_leave(timer, smooth_tiles(mask, output, width, height, kernel_size, &plan));
 }
 
 MaskProcessorResult smooth_mask_optimized(
@@ -100,11 +1290,92 @@ MaskProcessorResult smooth_mask_optimized(
     int height,
     int kernel_size
 ) {
-#ifdef __ARM_NEON
-    return smooth_mask_neon(mask, output, width, height, kernel_size);
-#elif defined(__SSE2__)
-    return smooth_mask_sse2(mask, output, width, height, kernel_size);
-#else
-    return smooth_mask_native(mask, output, width, height, kernel_size);
-#endif
-}
\ No newline at end of file
+    const MaskStageTimer timer = mask_stage_enter(
+        MASK_STAGE_SMOOTH, mask_stage_bytes(width, height, 16));
+    kernel_table_init();
+    if (kernel_size > MASK_PROCESSOR_DIRECT_SUM_MAX_KERNEL) {
+        return mask_stage_leave(timer, smooth_mask_separable(
+            mask, output, width, height, kernel_size, blur_rows_h_running, blur_rows_v_running));
+    }
+
+    if (mask && output && width > 0 && height > 0 && kernel_size > 1) {
+        MaskTilePlan plan;
+        mask_tile_plan(&plan, width, height, kernel_size / 2, 2 * sizeof(double));
+        if (mask_tile_worthwhile(&plan)) {
+            return mask_stage_leave(
+                timer, smooth_tiles(mask, output, width, height, kernel_size, &plan));
+        }
+    }
+    return mask_stage_leave(
+        timer, kernel_table.smooth_mask(mask, output, width, height, kernel_size));
+}
+
+MaskProcessorResult expand_mask_optimized(
+    const double* mask,
+    double* output,
+    int width,
+    int height,
+    int border_width
+) {
+    const MaskStageTimer timer = mask_stage_enter(
+        MASK_STAGE_EXPAND, mask_stage_bytes(width, height, 16));
+    kernel_table_init();
+    if (mask && output && expand_mask_tiles_worthwhile(width, height, border_width)) {
+        return mask_stage_leave(
+            timer, expand_mask_tiled(mask, output, width, height, border_width));
+    }
+    return mask_stage_leave(
+        timer, kernel_table.expand_mask(mask, output, width, height, border_width));
+}
+
+int mask_blur_row_kernels(int kernel_size, MaskBlurRowsFn* horizontal, MaskBlurRowsFn* vertical) {
+    if (kernel_size > MASK_PROCESSOR_DIRECT_SUM_MAX_KERNEL) {
+        *horizontal = blur_rows_h_running;
+        *vertical = blur_rows_v_running;
+        return 1;
+    }
+    kernel_table_init();
+    *horizontal = kernel_table.blur_rows_h;
+    *vertical = kernel_table.blur_rows_v;
+    return 0;
+}
+
+MaskProcessorResult smooth_mask_rows_optimized(
+    const double* mask,
+    double* output,
+    double* scratch,
+    int width,
+    int height,
+    int kernel_size,
+    int y_begin,
+    int y_end
+) {
+    if (!mask || !output || width <= 0 || height <= 0 || kernel_size <= 0 ||
+        y_begin < 0 || y_end > height || y_begin >= y_end) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+
+    if (kernel_size <= 1) {
+        memcpy(output, mask + (size_t)y_begin * width, sizeof(double) * width * (y_end - y_begin));
+        return MASK_PROCESSOR_SUCCESS;
+    }
+    if (!scratch) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+
+    MaskBlurRowsFn horizontal;
+    MaskBlurRowsFn vertical;
+    mask_blur_row_kernels(kernel_size, &horizontal, &vertical);
+
+    // Horizontal pass over the band plus its clipped halo into scratch, then
+    // the vertical pass with scratch row 0 standing for image row `first`.
+    // The halo reaches the image edge wherever the clamp could, so clamping
+    // to the scratch rows gives the same windows as the full image.
+    const int half_kernel = kernel_size / 2;
+    const int first = y_begin - half_kernel < 0 ? 0 : y_begin - half_kernel;
+    const int last = y_end + half_kernel > height ? height : y_end + half_kernel;
+
+    horizontal(mask, scratch, width, height, half_kernel, first, last);
+    vertical(scratch, output, width, last - first, half_kernel, y_begin - first, y_end - first);
+    return MASK_PROCESSOR_SUCCESS;
+}
@@ -0,0 +1,556 @@
+#include "sticker_pipeline.h"
+#include "bit_mask.h"
+#include "simd_optimizations.h"
+#include "thread_pool.h"
+#include "scratch_arena.h"
+#include "processor_stats.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Threshold constants matching mask_processor.c
+#define THRESHOLD 0.5
+#define THRESHOLD_HIGH (THRESHOLD + 0.05)
+#define THRESHOLD_LOW (THRESHOLD - 0.05)
+#define THRESHOLD_RANGE 0.1
+
+// Smallest band handed to another thread, in pixels
+#define PARALLEL_MIN_BAND_PIXELS 16384
+
+// Bands redo the blur and dilation of their halo rows, so keep each band at
+// least this many times taller than its halo
+#define BAND_HALO_RATIO 4
+
+// Alpha, background and border rows in flight between smoothing and
+// output. Rows live in rings indexed by image row modulo the ring size,
+// which covers every row still in flight.
+typedef struct {
+    int width;
+    int words;
+    // Dilation radius, 0 without a border
+    int radius;
+    // Disc half-width per row offset 0..radius, capped at width - 1
+    const int* half_width;
+    RGBColor border_color;
+    uint8_t* alpha;         // alpha_rows rows of final alpha
+    uint64_t* background;   // alpha_rows packed rows, set where mask < low
+    uint64_t* seeds;        // one packed row, set where mask > threshold
+    uint64_t* dilated;      // horizontal dilations of the seed row
+    uint64_t* border;       // border_rows packed rows of dilated seeds
+    int alpha_rows;
+    int border_rows;
+} RowRings;
+
+// Disc half-widths for a radius, capped at width - 1 (NULL on failure)
+static int* disc_half_widths(int radius, int width) {
+    int* half_width = (int*)mask_scratch_alloc(sizeof(int) * (radius + 1));
+    if (!half_width) {
+        return NULL;
+    }
+
+    const int max_shift = radius < width - 1 ? radius : width - 1;
+    for (int dy = 0; dy <= radius; dy++) {
+        const int hw = (int)floor(sqrt((double)radius * radius - (double)dy * dy));
+        half_width[dy] = hw < max_shift ? hw : max_shift;
+    }
+    return half_width;
+}
+
+static void row_rings_free(RowRings* rings) {
+    mask_scratch_free(rings->alpha);
+    mask_scratch_free(rings->background);
+    mask_scratch_free(rings->seeds);
+    mask_scratch_free(rings->dilated);
+    mask_scratch_free(rings->border);
+}
+
+// Rings for rows of a band of max_rows rows; returns 0 on allocation failure
+static int row_rings_init(
+    RowRings* rings,
+    int width,
+    int radius,
+    const int* half_width,
+    RGBColor border_color,
+    int max_rows
+) {
+    const size_t words = ((size_t)width + 63) / 64;
+
+    rings->width = width;
+    rings->words = (int)words;
+    rings->radius = radius;
+    rings->half_width = half_width;
+    rings->border_color = border_color;
+    rings->alpha_rows = radius + 1 < max_rows ? radius + 1 : max_rows;
+    rings->border_rows = 2 * radius + 1 < max_rows ? 2 * radius + 1 : max_rows;
+
+    rings->alpha = (uint8_t*)mask_scratch_alloc((size_t)width * rings->alpha_rows);
+    rings->background = (uint64_t*)mask_scratch_alloc(sizeof(uint64_t) * words * rings->alpha_rows);
+    rings->seeds = NULL;
+    rings->dilated = NULL;
+    rings->border = NULL;
+    if (radius > 0) {
+        rings->seeds = (uint64_t*)mask_scratch_alloc(sizeof(uint64_t) * words);
+        rings->dilated = (uint64_t*)mask_scratch_alloc(sizeof(uint64_t) * words * (half_width[0] + 1));
+        rings->border = (uint64_t*)mask_scratch_calloc(words * rings->border_rows, sizeof(uint64_t));
+    }
+
+    return rings->alpha && rings->background &&
+           (radius == 0 || (rings->seeds && rings->dilated && rings->border));
+}
+
+// Final alpha of a smoothed row, with the background pixels marked
+static void classify_row(const double* row, uint8_t* alpha, uint64_t* background, int width) {
+    for (int x0 = 0; x0 < width; x0 += 64) {
+        const int n = width - x0 < 64 ? width - x0 : 64;
+        uint64_t word = 0;
+
+        for (int b = 0; b < n; b++) {
+            const double mask_value = row[x0 + b];
+            if (mask_value > THRESHOLD_HIGH) {
+                alpha[x0 + b] = 255;
+            } else if (mask_value < THRESHOLD_LOW) {
+                alpha[x0 + b] = 0;
+                word |= (uint64_t)1 << b;
+            } else {
+                int value = (int)round((mask_value - THRESHOLD_LOW) / THRESHOLD_RANGE * 255.0);
+                if (value < 0) value = 0;
+                if (value > 255) value = 255;
+                alpha[x0 + b] = (uint8_t)value;
+            }
+        }
+        background[x0 >> 6] = word;
+    }
+}
+
+// OR the disc around every seed of row s into the border rows in [y_begin, y_end)
+static void scatter_seeds(RowRings* rings, const double* row, int s, int y_begin, int y_end) {
+    const int width = rings->width;
+    const int words = rings->words;
+    const int radius = rings->radius;
+    uint64_t* seeds = rings->seeds;
+
+    uint64_t any = 0;
+    for (int x0 = 0; x0 < width; x0 += 64) {
+        const int n = width - x0 < 64 ? width - x0 : 64;
+        uint64_t word = 0;
+        for (int b = 0; b < n; b++) {
+            word |= (uint64_t)(row[x0 + b] > THRESHOLD) << b;
+        }
+        seeds[x0 >> 6] = word;
+        any |= word;
+    }
+    if (!any) {
+        return;
+    }
+
+    bit_mask_row_dilations(seeds, rings->dilated, width, rings->half_width[0]);
+
+    const int t0 = s - radius > y_begin ? s - radius : y_begin;
+    const int t1 = s + radius < y_end - 1 ? s + radius : y_end - 1;
+    for (int t = t0; t <= t1; t++) {
+        const int dy = t > s ? t - s : s - t;
+        const uint64_t* src = rings->dilated + rings->half_width[dy] * words;
+        uint64_t* dst = rings->border + (t % rings->border_rows) * words;
+        for (int i = 0; i < words; i++) {
+            dst[i] |= src[i];
+        }
+    }
+}
+
+// Take smoothed row s: scatter its seeds and, if it is one of the rows
+// [y_begin, y_end) being produced, keep its alpha
+static void row_rings_add(RowRings* rings, const double* row, int s, int y_begin, int y_end) {
+    if (rings->radius > 0) {
+        scatter_seeds(rings, row, s, y_begin, y_end);
+    }
+    if (s >= y_begin && s < y_end) {
+        const int slot = s % rings->alpha_rows;
+        classify_row(row, rings->alpha + (size_t)slot * rings->width,
+                     rings->background + (size_t)slot * rings->words, rings->width);
+    }
+}
+
+// Write output row y from its source pixels, alpha and border rows. Every
+// seed within radius of y must have been added.
+static void row_rings_emit(RowRings* rings, int y, const uint8_t* in, uint8_t* out) {
+    const int width = rings->width;
+    const int words = rings->words;
+    const uint8_t* alpha = rings->alpha + (size_t)(y % rings->alpha_rows) * width;
+    const uint64_t* background = rings->background + (size_t)(y % rings->alpha_rows) * words;
+    uint64_t* border = rings->radius > 0
+        ? rings->border + (size_t)(y % rings->border_rows) * words
+        : NULL;
+
+    for (int x0 = 0; x0 < width; x0 += 64) {
+        const int n = width - x0 < 64 ? width - x0 : 64;
+        const uint64_t paint = border ? background[x0 >> 6] & border[x0 >> 6] : 0;
+
+        for (int b = 0; b < n; b++) {
+            const int x = x0 + b;
+            if ((paint >> b) & 1) {
+                // Border pixel
+                out[x * 4 + 0] = rings->border_color.r;
+                out[x * 4 + 1] = rings->border_color.g;
+                out[x * 4 + 2] = rings->border_color.b;
+                out[x * 4 + 3] = 255;
+            } else {
+                out[x * 4 + 0] = in[x * 4 + 0];
+                out[x * 4 + 1] = in[x * 4 + 1];
+                out[x * 4 + 2] = in[x * 4 + 2];
+                out[x * 4 + 3] = alpha[x];
+            }
+        }
+    }
+
+    // The slot is reused by row y + border_rows
+    if (border) {
+        memset(border, 0, sizeof(uint64_t) * words);
+    }
+}
+
+typedef struct {
+    const uint8_t* src;
+    uint8_t* dst;
+    const double* mask;
+    int width;
+    int height;
+    int kernel_size;
+    RGBColor border_color;
+    int radius;
+    const int* half_width;
+    int band_rows;
+    int result;
+} FusedJob;
+
+// Rows [y_begin, y_end): smooth the band and its halo a step at a time,
+// feed each row to the rings, and write each row once every seed within
+// radius of it has been seen
+static int run_band(FusedJob* job, int y_begin, int y_end) {
+    const int width = job->width;
+    const int radius = job->radius;
+    const int half_kernel = job->kernel_size / 2;
+
+    int step_rows = MASK_PROCESSOR_COPY_BAND_PIXELS / width;
+    if (step_rows < 8 * half_kernel) step_rows = 8 * half_kernel;
+    if (step_rows < 1) step_rows = 1;
+
+    RowRings rings;
+    double* smoothed = (double*)mask_scratch_alloc(sizeof(double) * width * step_rows);
+    double* blur_scratch = (double*)mask_scratch_alloc(sizeof(double) * width * (step_rows + job->kernel_size));
+    const int rings_ok = row_rings_init(&rings, width, radius, job->half_width,
+                                        job->border_color, y_end - y_begin);
+    if (!smoothed || !blur_scratch || !rings_ok) {
+        mask_scratch_free(smoothed);
+        mask_scratch_free(blur_scratch);
+        row_rings_free(&rings);
+        return MASK_PROCESSOR_ERROR_MEMORY;
+    }
+
+    const int s_begin = y_begin - radius < 0 ? 0 : y_begin - radius;
+    const int s_end = y_end + radius > job->height ? job->height : y_end + radius;
+    int next_row = y_begin;
+    MaskProcessorResult result = MASK_PROCESSOR_SUCCESS;
+
+    // There are only as many bands as threads, so each step checks for
+    // cancellation and reports its share of the band
+    for (int s0 = s_begin; s0 < s_end && result == MASK_PROCESSOR_SUCCESS; s0 += step_rows) {
+        if (mask_job_cancelled()) {
+            result = MASK_PROCESSOR_ERROR_CANCELLED;
+            break;
+        }
+        mask_job_band_progress((double)(s0 - s_begin) / (s_end - s_begin));
+
+        const int s1 = s0 + step_rows < s_end ? s0 + step_rows : s_end;
+        result = smooth_mask_rows_optimized(job->mask, smoothed, blur_scratch,
+                                            width, job->height, job->kernel_size, s0, s1);
+
+        for (int s = s0; s < s1 && result == MASK_PROCESSOR_SUCCESS; s++) {
+            row_rings_add(&rings, smoothed + (size_t)(s - s0) * width, s, y_begin, y_end);
+            while (next_row < y_end && next_row + radius <= s) {
+                const size_t offset = (size_t)next_row * width * 4;
+                row_rings_emit(&rings, next_row, job->src + offset, job->dst + offset);
+                next_row++;
+            }
+        }
+    }
+
+    // Rows within radius of the bottom edge have seen every seed by now
+    while (result == MASK_PROCESSOR_SUCCESS && next_row < y_end) {
+        const size_t offset = (size_t)next_row * width * 4;
+        row_rings_emit(&rings, next_row, job->src + offset, job->dst + offset);
+        next_row++;
+    }
+
+    mask_scratch_free(smoothed);
+    mask_scratch_free(blur_scratch);
+    row_rings_free(&rings);
+    return result;
+}
+
+static void fused_bands(void* context, int band_begin, int band_end) {
+    FusedJob* job = (FusedJob*)context;
+
+    for (int band = band_begin; band < band_end; band++) {
+        const int y_begin = band * job->band_rows;
+        const int y_end = y_begin + job->band_rows < job->height
+            ? y_begin + job->band_rows : job->height;
+        if (y_begin >= y_end) {
+            continue;
+        }
+
+        const int result = run_band(job, y_begin, y_end);
+        if (result != MASK_PROCESSOR_SUCCESS) {
+            __atomic_store_n(&job->result, result, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+MaskProcessorResult make_sticker_mask_fused(
+    const uint8_t* src,
+    uint8_t* dst,
+    const double* mask,
+    int width,
+    int height,
+    int kernel_size,
+    int add_border,
+    RGBColor border_color,
+    int border_width
+) {
+    const MaskStageTimer timer = mask_stage_enter(
+        MASK_STAGE_FUSED, mask_stage_bytes(width, height, 16));
+    if (!src || !dst || !mask || width <= 0 || height <= 0 ||
+        kernel_size <= 0 || border_width < 0) {
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_INVALID_PARAMS);
+    }
+
+    const int radius = add_border ? border_width : 0;
+    int* half_width = disc_half_widths(radius, width);
+    if (!half_width) {
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_MEMORY);
+    }
+
+    // One band per thread, unless the halos would dominate; a single band
+    // inside another pass, such as a batch, where the bands would run inline
+    const int halo = radius + kernel_size / 2;
+    int min_rows = width < PARALLEL_MIN_BAND_PIXELS ? PARALLEL_MIN_BAND_PIXELS / width : 1;
+    if (min_rows < BAND_HALO_RATIO * halo) min_rows = BAND_HALO_RATIO * halo;
+    int bands = height / min_rows;
+    const int threads = mask_parallel_thread_count();
+    if (bands > threads) bands = threads;
+    if (bands < 1) bands = 1;
+
+    FusedJob job = {
+        src, dst, mask, width, height, kernel_size, border_color, radius,
+        half_width, (height + bands - 1) / bands, MASK_PROCESSOR_SUCCESS
+    };
+    const MaskProcessorResult result = mask_parallel_for(bands, 1, fused_bands, &job);
+
+    mask_scratch_free(half_width);
+    return mask_stage_leave(
+        timer, result != MASK_PROCESSOR_SUCCESS ? result : (MaskProcessorResult)job.result);
+}
+
+struct StickerStream {
+    int width;
+    int height;
+    int kernel_size;
+    int half_kernel;
+    int lag;
+    MaskBlurRowsFn horizontal;
+    MaskBlurRowsFn vertical;
+    int* half_width;
+    RowRings rings;
+    // Horizontally blurred mask rows [window_first, pushed)
+    double* window;
+    int window_first;
+    int window_rows;
+    double* smoothed;
+    // Running-sum kernels: per-column sums of the quantized rows under the
+    // next row's window up to sums_end, slid instead of re-summed
+    int running;
+    double running_scale;
+    double* column_sums;
+    int sums_end;
+    // Source pixels of rows [emitted, pushed), lag + 1 rows
+    uint8_t* pixels;
+    int pixel_rows;
+    int pushed;
+    int smoothed_rows;
+    int emitted;
+};
+
+MaskProcessorResult sticker_stream_create(
+    StickerStream** stream,
+    int width,
+    int height,
+    int kernel_size,
+    int add_border,
+    RGBColor border_color,
+    int border_width
+) {
+    if (!stream || width <= 0 || height <= 0 || kernel_size <= 0 || border_width < 0) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+    *stream = NULL;
+
+    StickerStream* s = (StickerStream*)calloc(1, sizeof(StickerStream));
+    if (!s) {
+        return MASK_PROCESSOR_ERROR_MEMORY;
+    }
+
+    // The rings outlive this call, so they never come from a scratch arena
+    const MaskScratchBinding binding = mask_scratch_bind(NULL, 0);
+    const int radius = add_border ? border_width : 0;
+    s->width = width;
+    s->height = height;
+    s->kernel_size = kernel_size;
+    s->half_kernel = kernel_size / 2;
+    s->lag = radius + s->half_kernel;
+    s->running = mask_blur_row_kernels(kernel_size, &s->horizontal, &s->vertical);
+
+    // Room for twice the blur taps, so the window slides once per taps rows
+    s->window_rows = 2 * (2 * s->half_kernel + 1);
+    s->pixel_rows = s->lag + 1;
+    s->half_width = disc_half_widths(radius, width);
+    s->window = (double*)malloc(sizeof(double) * width * s->window_rows);
+    s->smoothed = (double*)malloc(sizeof(double) * width);
+    s->running_scale = mask_running_sum_scale(s->half_kernel);
+    s->column_sums = s->running ? (double*)calloc((size_t)width, sizeof(double)) : NULL;
+    s->pixels = (uint8_t*)malloc((size_t)width * 4 * s->pixel_rows);
+    const int rings_ok = s->half_width &&
+        row_rings_init(&s->rings, width, radius, s->half_width, border_color, height);
+    mask_scratch_restore(binding);
+
+    if (!rings_ok || !s->window || !s->smoothed || !s->pixels ||
+        (s->running && !s->column_sums)) {
+        sticker_stream_destroy(s);
+        return MASK_PROCESSOR_ERROR_MEMORY;
+    }
+
+    *stream = s;
+    return MASK_PROCESSOR_SUCCESS;
+}
+
+void sticker_stream_destroy(StickerStream* stream) {
+    if (!stream) {
+        return;
+    }
+    const MaskScratchBinding binding = mask_scratch_bind(NULL, 0);
+    row_rings_free(&stream->rings);
+    mask_scratch_restore(binding);
+    free(stream->half_width);
+    free(stream->window);
+    free(stream->smoothed);
+    free(stream->column_sums);
+    free(stream->pixels);
+    free(stream);
+}
+
+int sticker_stream_lag(const StickerStream* stream) {
+    return stream ? stream->lag : 0;
+}
+
+// Vertical running-sum pass for one row: add the rows entering its clipped
+// window, take the means, then drop the top row of the window, which the
+// next row no longer covers, while the window buffer still holds it
+static void stream_vertical_running(StickerStream* s, int row) {
+    const int width = s->width;
+    const double scale = s->running_scale;
+    const int y0 = row - s->half_kernel < 0 ? 0 : row - s->half_kernel;
+    const int y1 = row + s->half_kernel >= s->height ? s->height - 1 : row + s->half_kernel;
+
+    for (; s->sums_end <= y1; s->sums_end++) {
+        const double* in = s->window + (size_t)(s->sums_end - s->window_first) * width;
+        for (int x = 0; x < width; x++) {
+            s->column_sums[x] += mask_running_sum_quantize(in[x], scale);
+        }
+    }
+    for (int x = 0; x < width; x++) {
+        s->smoothed[x] = mask_running_sum_mean(s->column_sums[x], y1 - y0 + 1, scale);
+    }
+    if (row - s->half_kernel >= 0) {
+        const double* in = s->window + (size_t)(row - s->half_kernel - s->window_first) * width;
+        for (int x = 0; x < width; x++) {
+            s->column_sums[x] -= mask_running_sum_quantize(in[x], scale);
+        }
+    }
+}
+
+// Smooth every row whose blur taps have arrived and write every row whose
+// border seeds have all been seen
+static void stream_advance(StickerStream* s, uint8_t* output, int* output_rows) {
+    const int width = s->width;
+
+    while (s->smoothed_rows < s->height &&
+           (s->smoothed_rows + s->half_kernel < s->pushed || s->pushed == s->height)) {
+        const int row = s->smoothed_rows;
+        if (s->running) {
+            stream_vertical_running(s, row);
+            row_rings_add(&s->rings, s->smoothed, row, 0, s->height);
+        } else if (s->half_kernel > 0) {
+            s->vertical(s->window, s->smoothed, width, s->pushed - s->window_first,
+                        s->half_kernel, row - s->window_first, row - s->window_first + 1);
+            row_rings_add(&s->rings, s->smoothed, row, 0, s->height);
+        } else {
+            row_rings_add(&s->rings, s->window + (size_t)(row - s->window_first) * width,
+                          row, 0, s->height);
+        }
+        s->smoothed_rows++;
+
+        while (s->emitted < s->height &&
+               (s->emitted + s->rings.radius < s->smoothed_rows || s->smoothed_rows == s->height)) {
+            const uint8_t* in = s->pixels + (size_t)(s->emitted % s->pixel_rows) * width * 4;
+            row_rings_emit(&s->rings, s->emitted, in,
+                           output + (size_t)*output_rows * width * 4);
+            (*output_rows)++;
+            s->emitted++;
+        }
+    }
+}
+
+MaskProcessorResult sticker_stream_push(
+    StickerStream* stream,
+    const uint8_t* pixels,
+    const double* mask,
+    int rows,
+    uint8_t* output,
+    int* output_rows
+) {
+    const MaskStageTimer timer = mask_stage_enter(
+        MASK_STAGE_STREAM, stream ? mask_stage_bytes(stream->width, rows, 16) : 0);
+    if (!stream || !pixels || !mask || !output || !output_rows ||
+        rows <= 0 || rows > stream->height - stream->pushed) {
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_INVALID_PARAMS);
+    }
+
+    StickerStream* s = stream;
+    const int width = s->width;
+    *output_rows = 0;
+
+    for (int i = 0; i < rows; i++) {
+        const int row = s->pushed;
+
+        // Drop rows no longer under any blur window once the window is full
+        if (row - s->window_first == s->window_rows) {
+            int first = s->smoothed_rows - s->half_kernel;
+            if (first < s->window_first) first = s->window_first;
+            memmove(s->window, s->window + (size_t)(first - s->window_first) * width,
+                    sizeof(double) * width * (row - first));
+            s->window_first = first;
+        }
+
+        double* blurred = s->window + (size_t)(row - s->window_first) * width;
+        if (s->half_kernel > 0) {
+            s->horizontal(mask + (size_t)i * width, blurred, width, 1, s->half_kernel, 0, 1);
+        } else {
+            memcpy(blurred, mask + (size_t)i * width, sizeof(double) * width);
+        }
+        memcpy(s->pixels + (size_t)(row % s->pixel_rows) * width * 4,
+               pixels + (size_t)i * width * 4, (size_t)width * 4);
+        s->pushed++;
+
+        stream_advance(s, output, output_rows);
+    }
+
+    return mask_stage_leave(timer, MASK_PROCESSOR_SUCCESS);
+}
@@ -0,0 +1,389 @@
+#include "tensor_ops.h"
+#include "simd_vector.h"
+#include "thread_pool.h"
+#include "scratch_arena.h"
+#include "processor_stats.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Smallest band handed to another thread, in source pixels read
+#define PARALLEL_MIN_BAND_PIXELS 16384
+
+// Source pixels [first, first + count) under one output coordinate, with
+// their coverage weights at weights[0..count) summing to 1
+typedef struct {
+    int first;
+    int count;
+    const float* weights;
+} AreaSpan;
+
+// Footprints of dst_size outputs over src_size inputs. spans and weights
+// must hold dst_size and dst_size * area_span_taps() entries.
+static int area_span_taps(int src_size, int dst_size) {
+    return (src_size + dst_size - 1) / dst_size + 1;
+}
+
+static void area_spans(int src_size, int dst_size, AreaSpan* spans, float* weights) {
+    const double scale = (double)src_size / dst_size;
+    const int taps = area_span_taps(src_size, dst_size);
+
+    for (int i = 0; i < dst_size; i++) {
+        const double start = i * scale;
+        const double end = (i + 1) * scale < src_size ? (i + 1) * scale : src_size;
+        int first = (int)floor(start);
+        int last = (int)ceil(end) - 1;
+        if (first > src_size - 1) first = src_size - 1;
+        if (last > src_size - 1) last = src_size - 1;
+        if (last < first) last = first;
+
+        float* w = weights + (size_t)i * taps;
+        int count = 0;
+        for (int s = first; s <= last; s++) {
+            const double lo = s > start ? s : start;
+            const double hi = s + 1 < end ? s + 1 : end;
+            w[count++] = (float)((hi - lo) / scale);
+        }
+
+        spans[i].first = first;
+        spans[i].count = count;
+        spans[i].weights = w;
+    }
+}
+
+typedef struct {
+    const uint8_t* src;
+    int src_width;
+    float* dst;
+    int dst_width;
+    int dst_height;
+    const AreaSpan* columns;
+    const AreaSpan* rows;
+    // out = acc * scale + offset folds in the 1/255, mean and inv_std
+    mp_f32x4 scale;
+    mp_f32x4 offset;
+    int result;
+} ResizeJob;
+
+// One source row resampled horizontally, 4 floats per output pixel
+static void resize_row(const ResizeJob* job, const uint8_t* src_row, float* out) {
+    for (int x = 0; x < job->dst_width; x++) {
+        const AreaSpan* span = &job->columns[x];
+        const uint8_t* px = src_row + (size_t)span->first * 4;
+        mp_f32x4 sum = mp_f32x4_splat(0.0f);
+        for (int t = 0; t < span->count; t++) {
+            sum += mp_f32x4_splat(span->weights[t]) * mp_f32x4_from_u8x4(px + t * 4);
+        }
+        mp_f32x4_store(out + x * 4, sum);
+    }
+}
+
+// Output rows [y_begin, y_end). Consecutive rows share the source row on
+// their boundary, so the last resampled row is kept for the next one.
+static void resize_band(void* context, int y_begin, int y_end) {
+    ResizeJob* job = (ResizeJob*)context;
+    const int dst_width = job->dst_width;
+    const size_t plane = (size_t)dst_width * job->dst_height;
+
+    float* row = (float*)mask_scratch_alloc(sizeof(float) * 4 * dst_width);
+    float* acc = (float*)mask_scratch_alloc(sizeof(float) * 4 * dst_width);
+    if (!row || !acc) {
+        mask_scratch_free(row);
+        mask_scratch_free(acc);
+        __atomic_store_n(&job->result, MASK_PROCESSOR_ERROR_MEMORY, __ATOMIC_RELAXED);
+        return;
+    }
+
+    int cached = -1;
+    for (int y = y_begin; y < y_end; y++) {
+        const AreaSpan* span = &job->rows[y];
+        memset(acc, 0, sizeof(float) * 4 * dst_width);
+
+        for (int t = 0; t < span->count; t++) {
+            const int sy = span->first + t;
+            if (sy != cached) {
+                resize_row(job, job->src + (size_t)sy * job->src_width * 4, row);
+                cached = sy;
+            }
+            const mp_f32x4 weight = mp_f32x4_splat(span->weights[t]);
+            for (int x = 0; x < dst_width; x++) {
+                mp_f32x4_store(acc + x * 4,
+                               mp_f32x4_load(acc + x * 4) + weight * mp_f32x4_load(row + x * 4));
+            }
+        }
+
+        float* r = job->dst + (size_t)y * dst_width;
+        float* g = r + plane;
+        float* b = g + plane;
+        for (int x = 0; x < dst_width; x++) {
+            const mp_f32x4 value = mp_f32x4_load(acc + x * 4) * job->scale + job->offset;
+            r[x] = value[0];
+            g[x] = value[1];
+            b[x] = value[2];
+        }
+    }
+
+    mask_scratch_free(row);
+    mask_scratch_free(acc);
+}
+
+MaskProcessorResult resize_rgba_to_nchw(
+    const uint8_t* src,
+    int src_width,
+    int src_height,
+    float* dst,
+    int dst_width,
+    int dst_height,
+    const float* mean,
+    const float* inv_std
+) {
+    const MaskStageTimer timer = mask_stage_enter(
+        MASK_STAGE_PREPROCESS,
+        mask_stage_bytes(src_width, src_height, 4) +
+            mask_stage_bytes(dst_width, dst_height, 3 * sizeof(float)));
+    if (!src || !dst || !mean || !inv_std || src_width <= 0 || src_height <= 0 ||
+        dst_width <= 0 || dst_height <= 0) {
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_INVALID_PARAMS);
+    }
+
+    const int taps_x = area_span_taps(src_width, dst_width);
+    const int taps_y = area_span_taps(src_height, dst_height);
+    AreaSpan* columns = (AreaSpan*)mask_scratch_alloc(sizeof(AreaSpan) * dst_width);
+    AreaSpan* rows = (AreaSpan*)mask_scratch_alloc(sizeof(AreaSpan) * dst_height);
+    float* weights_x = (float*)mask_scratch_alloc(sizeof(float) * dst_width * taps_x);
+    float* weights_y = (float*)mask_scratch_alloc(sizeof(float) * dst_height * taps_y);
+    if (!columns || !rows || !weights_x || !weights_y) {
+        mask_scratch_free(columns);
+        mask_scratch_free(rows);
+        mask_scratch_free(weights_x);
+        mask_scratch_free(weights_y);
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_MEMORY);
+    }
+    area_spans(src_width, dst_width, columns, weights_x);
+    area_spans(src_height, dst_height, rows, weights_y);
+
+    ResizeJob job;
+    job.src = src;
+    job.src_width = src_width;
+    job.dst = dst;
+    job.dst_width = dst_width;
+    job.dst_height = dst_height;
+    job.columns = columns;
+    job.rows = rows;
+    job.scale = (mp_f32x4){
+        inv_std[0] / 255.0f, inv_std[1] / 255.0f, inv_std[2] / 255.0f, 0.0f
+    };
+    job.offset = (mp_f32x4){
+        -mean[0] * inv_std[0], -mean[1] * inv_std[1], -mean[2] * inv_std[2], 0.0f
+    };
+    job.result = MASK_PROCESSOR_SUCCESS;
+
+    // Each output row reads about taps_y source rows
+    const int row_pixels = src_width * (taps_y - 1 > 0 ? taps_y - 1 : 1);
+    const int min_rows = row_pixels < PARALLEL_MIN_BAND_PIXELS
+        ? PARALLEL_MIN_BAND_PIXELS / row_pixels
+        : 1;
+    const MaskProcessorResult result = mask_parallel_for(dst_height, min_rows, resize_band, &job);
+
+    mask_scratch_free(columns);
+    mask_scratch_free(rows);
+    mask_scratch_free(weights_x);
+    mask_scratch_free(weights_y);
+    return mask_stage_leave(
+        timer, result != MASK_PROCESSOR_SUCCESS ? result : (MaskProcessorResult)job.result);
+}
+
+typedef struct {
+    const float* src;
+    int src_width;
+    int src_height;
+    void* dst;
+    MaskOutputFormat format;
+    int dst_width;
+    int dst_height;
+    int apply_sigmoid;
+    double threshold;
+    // Left source column and weight of each output column
+    const int* column_x;
+    const double* column_w;
+    int result;
+} UpsampleJob;
+
+// Source row sy interpolated across the output width (sigmoid applied to
+// the source values when requested); values is src_width scratch
+static void upsample_row(const UpsampleJob* job, int sy, double* values, double* out) {
+    const float* row = job->src + (size_t)sy * job->src_width;
+    for (int x = 0; x < job->src_width; x++) {
+        values[x] = job->apply_sigmoid ? 1.0 / (1.0 + exp(-(double)row[x])) : row[x];
+    }
+
+    const int last = job->src_width - 1;
+    for (int x = 0; x < job->dst_width; x++) {
+        const int x1 = job->column_x[x];
+        const int x2 = x1 + 1 < last ? x1 + 1 : last;
+        const double wx = job->column_w[x];
+        out[x] = values[x1] * (1.0 - wx) + values[x2] * wx;
+    }
+}
+
+static void store_row(const UpsampleJob* job, const double* row, int y) {
+    const int width = job->dst_width;
+    const size_t offset = (size_t)y * width;
+
+    switch (job->format) {
+    case MASK_OUTPUT_FLOAT64: {
+        // Unthresholded doubles are interpolated in place
+        double* out = (double*)job->dst + offset;
+        if (job->threshold >= 0.0) {
+            for (int x = 0; x < width; x++) out[x] = row[x] > job->threshold ? 1.0 : 0.0;
+        }
+        break;
+    }
+    case MASK_OUTPUT_FLOAT32: {
+        float* out = (float*)job->dst + offset;
+        if (job->threshold >= 0.0) {
+            for (int x = 0; x < width; x++) out[x] = row[x] > job->threshold ? 1.0f : 0.0f;
+        } else {
+            for (int x = 0; x < width; x++) out[x] = (float)row[x];
+        }
+        break;
+    }
+    case MASK_OUTPUT_UINT8: {
+        uint8_t* out = (uint8_t*)job->dst + offset;
+        if (job->threshold >= 0.0) {
+            for (int x = 0; x < width; x++) out[x] = row[x] > job->threshold ? 255 : 0;
+        } else {
+            for (int x = 0; x < width; x++) {
+                const double v = row[x] * 255.0 + 0.5;
+                out[x] = v <= 0.0 ? 0 : v >= 255.0 ? 255 : (uint8_t)v;
+            }
+        }
+        break;
+    }
+    }
+}
+
+// Output rows [y_begin, y_end). Source rows are interpolated horizontally
+// once each and kept while consecutive output rows fall between them.
+static void upsample_band(void* context, int y_begin, int y_end) {
+    UpsampleJob* job = (UpsampleJob*)context;
+    const int width = job->dst_width;
+    const double scale_y = (double)job->src_height / job->dst_height;
+
+    double* values = (double*)mask_scratch_alloc(sizeof(double) * job->src_width);
+    double* top = (double*)mask_scratch_alloc(sizeof(double) * width);
+    double* bottom = (double*)mask_scratch_alloc(sizeof(double) * width);
+    double* row = (double*)mask_scratch_alloc(sizeof(double) * width);
+    if (!values || !top || !bottom || !row) {
+        mask_scratch_free(values);
+        mask_scratch_free(top);
+        mask_scratch_free(bottom);
+        mask_scratch_free(row);
+        __atomic_store_n(&job->result, MASK_PROCESSOR_ERROR_MEMORY, __ATOMIC_RELAXED);
+        return;
+    }
+
+    const int in_place = job->format == MASK_OUTPUT_FLOAT64 && job->threshold < 0.0;
+    int top_row = -1;
+    int bottom_row = -1;
+    for (int y = y_begin; y < y_end; y++) {
+        const double src_y = y * scale_y;
+        int y1 = (int)floor(src_y);
+        if (y1 > job->src_height - 1) y1 = job->src_height - 1;
+        const int y2 = y1 + 1 < job->src_height - 1 ? y1 + 1 : job->src_height - 1;
+        const double wy = src_y - y1;
+
+        if (y1 != top_row) {
+            if (y1 == bottom_row) {
+                double* swap = top;
+                top = bottom;
+                bottom = swap;
+                bottom_row = -1;
+            } else {
+                upsample_row(job, y1, values, top);
+            }
+            top_row = y1;
+        }
+        if (y2 != bottom_row) {
+            if (y2 == top_row) {
+                memcpy(bottom, top, sizeof(double) * width);
+            } else {
+                upsample_row(job, y2, values, bottom);
+            }
+            bottom_row = y2;
+        }
+
+        double* out = in_place ? (double*)job->dst + (size_t)y * width : row;
+        const mp_f64x2 w_top = mp_f64x2_splat(1.0 - wy);
+        const mp_f64x2 w_bottom = mp_f64x2_splat(wy);
+        int x = 0;
+        for (; x + 2 <= width; x += 2) {
+            mp_f64x2_store(out + x, mp_f64x2_load(top + x) * w_top +
+                                    mp_f64x2_load(bottom + x) * w_bottom);
+        }
+        for (; x < width; x++) {
+            out[x] = top[x] * (1.0 - wy) + bottom[x] * wy;
+        }
+
+        store_row(job, out, y);
+    }
+
+    mask_scratch_free(values);
+    mask_scratch_free(top);
+    mask_scratch_free(bottom);
+    mask_scratch_free(row);
+}
+
+MaskProcessorResult upsample_mask_tensor(
+    const float* src,
+    int src_width,
+    int src_height,
+    void* dst,
+    MaskOutputFormat format,
+    int dst_width,
+    int dst_height,
+    int apply_sigmoid,
+    double threshold
+) {
+    const int dst_bytes = format == MASK_OUTPUT_FLOAT64 ? 8 : (format == MASK_OUTPUT_FLOAT32 ? 4 : 1);
+    const MaskStageTimer timer = mask_stage_enter(
+        MASK_STAGE_POSTPROCESS,
+        mask_stage_bytes(src_width, src_height, sizeof(float)) +
+            mask_stage_bytes(dst_width, dst_height, dst_bytes));
+    if (!src || !dst || src_width <= 0 || src_height <= 0 ||
+        dst_width <= 0 || dst_height <= 0 ||
+        format < MASK_OUTPUT_FLOAT64 || format > MASK_OUTPUT_UINT8) {
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_INVALID_PARAMS);
+    }
+
+    int* column_x = (int*)mask_scratch_alloc(sizeof(int) * dst_width);
+    double* column_w = (double*)mask_scratch_alloc(sizeof(double) * dst_width);
+    if (!column_x || !column_w) {
+        mask_scratch_free(column_x);
+        mask_scratch_free(column_w);
+        return mask_stage_leave(timer, MASK_PROCESSOR_ERROR_MEMORY);
+    }
+
+    const double scale_x = (double)src_width / dst_width;
+    for (int x = 0; x < dst_width; x++) {
+        const double src_x = x * scale_x;
+        int x1 = (int)floor(src_x);
+        if (x1 > src_width - 1) x1 = src_width - 1;
+        column_x[x] = x1;
+        column_w[x] = src_x - x1;
+    }
+
+    UpsampleJob job = {
+        src, src_width, src_height, dst, format, dst_width, dst_height,
+        apply_sigmoid, threshold, column_x, column_w, MASK_PROCESSOR_SUCCESS
+    };
+    const int min_rows = dst_width < PARALLEL_MIN_BAND_PIXELS
+        ? PARALLEL_MIN_BAND_PIXELS / dst_width
+        : 1;
+    const MaskProcessorResult result = mask_parallel_for(dst_height, min_rows, upsample_band, &job);
+
+    mask_scratch_free(column_x);
+    mask_scratch_free(column_w);
+    return mask_stage_leave(
+        timer, result != MASK_PROCESSOR_SUCCESS ? result : (MaskProcessorResult)job.result);
+}
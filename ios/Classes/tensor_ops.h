@@ -0,0 +1,87 @@
+#ifndef TENSOR_OPS_H
+#define TENSOR_OPS_H
+
+#include "mask_processor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Resample RGBA pixels into a normalized float NCHW tensor
+ *
+ * Area resampling: each output pixel is the mean of the source pixels its
+ * footprint covers, weighted by coverage, so downscaling never skips
+ * pixels. The result is normalized per channel as
+ * (value / 255 - mean[c]) * inv_std[c] and written as three planes
+ * (R, G, B) of dst_width * dst_height floats. Alpha is ignored.
+ *
+ * @param src Source RGBA pixel data
+ * @param src_width Source width
+ * @param src_height Source height
+ * @param dst Output tensor, 3 * dst_width * dst_height floats
+ * @param dst_width Output width
+ * @param dst_height Output height
+ * @param mean Per-channel mean (3 values, 0.0-1.0 scale)
+ * @param inv_std Per-channel reciprocal standard deviation (3 values)
+ * @return Result code
+ */
+MaskProcessorResult resize_rgba_to_nchw(
+    const uint8_t* src,
+    int src_width,
+    int src_height,
+    float* dst,
+    int dst_width,
+    int dst_height,
+    const float* mean,
+    const float* inv_std
+);
+
+// Element type of an upsampled mask
+typedef enum {
+    MASK_OUTPUT_FLOAT64 = 0,
+    MASK_OUTPUT_FLOAT32 = 1,
+    // round(value * 255), as taken by the 8-bit mask variants
+    MASK_OUTPUT_UINT8 = 2
+} MaskOutputFormat;
+
+/**
+ * Upsample a model output mask to full resolution
+ *
+ * Bilinear interpolation sampling source coordinate x * src_width /
+ * dst_width (no half-pixel offset), as the Dart fallback does. With
+ * apply_sigmoid the source values are logits and go through the logistic
+ * function first, once per model pixel. With threshold >= 0 every output
+ * is binarized to 1 (255 for uint8) above threshold and 0 otherwise.
+ *
+ * The float64 output can be passed straight to the smoothing stage or
+ * make_sticker_mask_fused.
+ *
+ * @param src Model output, src_width * src_height floats
+ * @param src_width Model output width
+ * @param src_height Model output height
+ * @param dst Output mask, dst_width * dst_height elements of format
+ * @param format Output element type
+ * @param dst_width Output width
+ * @param dst_height Output height
+ * @param apply_sigmoid Whether src holds logits
+ * @param threshold Binarization threshold, negative to keep values
+ * @return Result code
+ */
+MaskProcessorResult upsample_mask_tensor(
+    const float* src,
+    int src_width,
+    int src_height,
+    void* dst,
+    MaskOutputFormat format,
+    int dst_width,
+    int dst_height,
+    int apply_sigmoid,
+    double threshold
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TENSOR_OPS_H
@@ -0,0 +1,351 @@
+#include "thread_pool.h"
+#include "mask_processor.h"
+#include "scratch_arena.h"
+#include "processor_stats.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Bands handed out per thread, so uneven bands still balance
+#define BANDS_PER_THREAD 4
+// Bands a monitored pass is split into when it runs inline, so it can stop
+// and report progress part way
+#define MONITORED_INLINE_BANDS 16
+// Progress units per item, so bands can report fractions of themselves
+#define PROGRESS_UNITS_PER_ITEM 1024
+// Progress stays below this until the owner of the monitor finishes the job
+#define PROGRESS_CAP 0.99f
+
+// Progress of one monitored pass
+typedef struct {
+    MaskJobMonitor* monitor;
+    int64_t done;
+    int64_t total;
+} PassProgress;
+
+typedef struct {
+    pthread_t workers[MASK_PROCESSOR_MAX_THREADS];
+    int worker_count;
+    int shutdown;
+
+    // Current job
+    unsigned generation;
+    int active_workers;
+    MaskBandFn fn;
+    void* context;
+    // Scratch arena of the submitting call; each band thread has a slot
+    MaskArena* arena;
+    // Monitor of the submitting thread, and its pass when it is one
+    MaskJobMonitor* monitor;
+    PassProgress* pass;
+    int count;
+    int band;
+    int next;
+} ThreadPool;
+
+static ThreadPool pool;
+// Held by the thread that owns the pool for a whole job
+static pthread_mutex_t submit_lock = PTHREAD_MUTEX_INITIALIZER;
+// Guards the job fields and worker wake-ups
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_ready = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t work_done = PTHREAD_COND_INITIALIZER;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+// Set while this thread runs bands, so nested calls stay inline
+static __thread int in_parallel_region = 0;
+// Job monitor of this thread, and the pass its bands count toward
+static __thread MaskJobMonitor* current_monitor = NULL;
+static __thread PassProgress* current_pass = NULL;
+// Progress units of the band running on this thread, and those reported
+static __thread int64_t band_units = 0;
+static __thread int64_t band_reported = 0;
+
+static int monitor_cancelled(const MaskJobMonitor* monitor) {
+    return monitor && __atomic_load_n(monitor->cancel, __ATOMIC_RELAXED) != 0;
+}
+
+// Count units of the pass as done and raise the job progress to match
+static void pass_advance(PassProgress* pass, int64_t units) {
+    if (units <= 0) {
+        return;
+    }
+    const int64_t done = __atomic_add_fetch(&pass->done, units, __ATOMIC_RELAXED);
+    const MaskJobMonitor* monitor = pass->monitor;
+    float progress = (float)((monitor->passes_done + (double)done / pass->total) / monitor->passes);
+    if (progress > PROGRESS_CAP) {
+        progress = PROGRESS_CAP;
+    }
+
+    float seen;
+    __atomic_load(monitor->progress, &seen, __ATOMIC_RELAXED);
+    while (progress > seen &&
+           !__atomic_compare_exchange(monitor->progress, &seen, &progress, 0,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+// Run one band unless the job was cancelled
+static void run_band(MaskBandFn fn, void* context, int begin, int end) {
+    if (monitor_cancelled(current_monitor)) {
+        return;
+    }
+    PassProgress* pass = current_pass;
+    if (!pass) {
+        fn(context, begin, end);
+        return;
+    }
+
+    band_units = (int64_t)(end - begin) * PROGRESS_UNITS_PER_ITEM;
+    band_reported = 0;
+    fn(context, begin, end);
+    pass_advance(pass, band_units - band_reported);
+    band_units = 0;
+}
+
+static void run_bands(void) {
+    in_parallel_region = 1;
+    // What the bands call is timed as part of the call that submitted them
+    const int nesting = mask_stage_set_nesting(1);
+    for (;;) {
+        const int begin = __atomic_fetch_add(&pool.next, pool.band, __ATOMIC_RELAXED);
+        if (begin >= pool.count) {
+            break;
+        }
+        const int end = pool.count - begin < pool.band ? pool.count : begin + pool.band;
+        run_band(pool.fn, pool.context, begin, end);
+    }
+    mask_stage_set_nesting(nesting);
+    in_parallel_region = 0;
+}
+
+MaskJobMonitor* mask_job_monitor_attach(MaskJobMonitor* monitor) {
+    MaskJobMonitor* previous = current_monitor;
+    current_monitor = monitor;
+    return previous;
+}
+
+int mask_job_cancelled(void) {
+    return monitor_cancelled(current_monitor);
+}
+
+void mask_job_band_progress(double fraction) {
+    if (!current_pass || band_units == 0) {
+        return;
+    }
+    if (fraction > 1.0) {
+        fraction = 1.0;
+    }
+    const int64_t reported = (int64_t)(fraction * band_units);
+    pass_advance(current_pass, reported - band_reported);
+    if (reported > band_reported) {
+        band_reported = reported;
+    }
+}
+
+static void* worker_main(void* arg) {
+    const int slot = (int)(intptr_t)arg;
+    unsigned seen = 0;
+
+    pthread_mutex_lock(&pool_lock);
+    for (;;) {
+        while (!pool.shutdown && pool.generation == seen) {
+            pthread_cond_wait(&work_ready, &pool_lock);
+        }
+        if (pool.shutdown) {
+            break;
+        }
+        seen = pool.generation;
+        MaskArena* arena = pool.arena;
+        current_monitor = pool.monitor;
+        current_pass = pool.pass;
+        pthread_mutex_unlock(&pool_lock);
+
+        const MaskScratchBinding previous = mask_scratch_bind(arena, slot);
+        run_bands();
+        mask_scratch_restore(previous);
+        current_monitor = NULL;
+        current_pass = NULL;
+
+        pthread_mutex_lock(&pool_lock);
+        if (--pool.active_workers == 0) {
+            pthread_cond_signal(&work_done);
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+    return NULL;
+}
+
+static int default_thread_count(void) {
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) {
+        return 1;
+    }
+    return cpus > MASK_PROCESSOR_MAX_THREADS ? MASK_PROCESSOR_MAX_THREADS : (int)cpus;
+}
+
+// Requires submit_lock
+static void stop_workers(void) {
+    pthread_mutex_lock(&pool_lock);
+    pool.shutdown = 1;
+    pthread_cond_broadcast(&work_ready);
+    pthread_mutex_unlock(&pool_lock);
+
+    for (int i = 0; i < pool.worker_count; i++) {
+        pthread_join(pool.workers[i], NULL);
+    }
+    pool.worker_count = 0;
+    pool.shutdown = 0;
+}
+
+// Requires submit_lock; the caller is the remaining thread
+static void start_workers(int thread_count) {
+    // Workers compare against the generation they last saw, starting at 0
+    pool.generation = 0;
+    for (int i = 0; i < thread_count - 1; i++) {
+        if (pthread_create(&pool.workers[i], NULL, worker_main, (void*)(intptr_t)(i + 1)) != 0) {
+            break;
+        }
+        pool.worker_count++;
+    }
+}
+
+static void pool_init(void) {
+    pthread_mutex_lock(&submit_lock);
+    start_workers(default_thread_count());
+    pthread_mutex_unlock(&submit_lock);
+}
+
+MaskProcessorResult mask_processor_set_thread_count(int thread_count) {
+    if (thread_count < 0 || thread_count > MASK_PROCESSOR_MAX_THREADS) {
+        return MASK_PROCESSOR_ERROR_INVALID_PARAMS;
+    }
+    if (in_parallel_region) {
+        return MASK_PROCESSOR_ERROR_PROCESSING;
+    }
+
+    pthread_once(&pool_once, pool_init);
+    if (thread_count == 0) {
+        thread_count = default_thread_count();
+    }
+
+    pthread_mutex_lock(&submit_lock);
+    stop_workers();
+    start_workers(thread_count);
+    const int started = pool.worker_count + 1;
+    pthread_mutex_unlock(&submit_lock);
+
+    return started == thread_count ? MASK_PROCESSOR_SUCCESS : MASK_PROCESSOR_ERROR_PROCESSING;
+}
+
+int mask_processor_get_thread_count(void) {
+    pthread_once(&pool_once, pool_init);
+
+    // Bands run while their submitter holds submit_lock, so the pool cannot
+    // be resized under them, and taking the lock here would deadlock
+    if (in_parallel_region) {
+        return pool.worker_count + 1;
+    }
+
+    pthread_mutex_lock(&submit_lock);
+    const int thread_count = pool.worker_count + 1;
+    pthread_mutex_unlock(&submit_lock);
+    return thread_count;
+}
+
+// Hand a pass to the pool, with the caller running bands too. Requires
+// submit_lock.
+static void run_pool(int count, int min_band, MaskBandFn fn, void* context) {
+    const int threads = pool.worker_count + 1;
+    int band = (count + threads * BANDS_PER_THREAD - 1) / (threads * BANDS_PER_THREAD);
+    if (band < min_band) {
+        band = min_band;
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    pool.fn = fn;
+    pool.context = context;
+    pool.arena = mask_scratch_arena();
+    pool.monitor = current_monitor;
+    pool.pass = current_pass;
+    pool.count = count;
+    pool.band = band;
+    pool.next = 0;
+    pool.active_workers = pool.worker_count;
+    pool.generation++;
+    pthread_cond_broadcast(&work_ready);
+    pthread_mutex_unlock(&pool_lock);
+
+    // The caller runs its bands in the slot after the workers' slots, so
+    // scratch from before the job stays apart and every band slot is alike
+    const MaskScratchBinding previous = mask_scratch_bind(pool.arena, threads);
+    run_bands();
+    mask_scratch_restore(previous);
+
+    pthread_mutex_lock(&pool_lock);
+    while (pool.active_workers > 0) {
+        pthread_cond_wait(&work_done, &pool_lock);
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
+
+// A pass the pool did not take, run on the calling thread. Monitored passes
+// are split into bands so they can stop and report part way.
+static void run_inline(int count, MaskBandFn fn, void* context) {
+    if (!current_pass) {
+        fn(context, 0, count);
+        return;
+    }
+
+    const int band = (count + MONITORED_INLINE_BANDS - 1) / MONITORED_INLINE_BANDS;
+    for (int begin = 0; begin < count; begin += band) {
+        run_band(fn, context, begin, count - begin < band ? count : begin + band);
+    }
+}
+
+MaskProcessorResult mask_parallel_for(int count, int min_band, MaskBandFn fn, void* context) {
+    if (count <= 0) {
+        return MASK_PROCESSOR_SUCCESS;
+    }
+    if (min_band < 1) {
+        min_band = 1;
+    }
+
+    pthread_once(&pool_once, pool_init);
+
+    // Calls from inside a band are part of the pass that band belongs to
+    if (in_parallel_region || current_pass) {
+        fn(context, 0, count);
+        return MASK_PROCESSOR_SUCCESS;
+    }
+
+    MaskJobMonitor* monitor = current_monitor;
+    PassProgress pass = { monitor, 0, (int64_t)count * PROGRESS_UNITS_PER_ITEM };
+    current_pass = monitor ? &pass : NULL;
+
+    // Small ranges and a busy pool run inline
+    if (count <= min_band || pthread_mutex_trylock(&submit_lock) != 0) {
+        run_inline(count, fn, context);
+    } else if (pool.worker_count == 0) {
+        pthread_mutex_unlock(&submit_lock);
+        run_inline(count, fn, context);
+    } else {
+        run_pool(count, min_band, fn, context);
+        pthread_mutex_unlock(&submit_lock);
+    }
+
+    current_pass = NULL;
+    if (!monitor) {
+        return MASK_PROCESSOR_SUCCESS;
+    }
+    monitor->passes_done++;
+    return monitor_cancelled(monitor) ? MASK_PROCESSOR_ERROR_CANCELLED : MASK_PROCESSOR_SUCCESS;
+}
+
+int mask_parallel_thread_count(void) {
+    if (in_parallel_region || current_pass) {
+        return 1;
+    }
+    return mask_processor_get_thread_count();
+}
@@ -0,0 +1,85 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include "mask_processor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Upper bound for mask_processor_set_thread_count
+#define MASK_PROCESSOR_MAX_THREADS 64
+
+// Processes items [begin, end) of a parallel range
+typedef void (*MaskBandFn)(void* context, int begin, int end);
+
+/**
+ * Cancellation and progress of a job made of parallel passes
+ *
+ * While a monitor is attached to a thread, every mask_parallel_for it
+ * makes outside a band is one pass of the job, split into bands even when
+ * it runs inline. No band starts once *cancel is non-zero, and the pass
+ * then returns MASK_PROCESSOR_ERROR_CANCELLED. *progress is raised as
+ * bands finish, to (passes_done + fraction of the current pass) / passes,
+ * and stays below 1 until the owner sets it.
+ */
+typedef struct {
+    const int32_t* cancel;
+    float* progress;
+    // Passes the job is expected to make
+    int passes;
+    // Passes finished so far
+    int passes_done;
+} MaskJobMonitor;
+
+/**
+ * Attach a monitor to the calling thread
+ *
+ * @param monitor Monitor, or NULL to detach
+ * @return The monitor attached before
+ */
+MaskJobMonitor* mask_job_monitor_attach(MaskJobMonitor* monitor);
+
+/**
+ * Whether the job running on this thread, in a band or not, was cancelled
+ *
+ * For kernels whose bands are long enough to check within.
+ */
+int mask_job_cancelled(void);
+
+/**
+ * Report that fraction (0 to 1) of the band running on this thread is
+ * done, for bands long enough to report within; no-op outside a
+ * monitored pass
+ */
+void mask_job_band_progress(double fraction);
+
+/**
+ * Split [0, count) into bands and run them on the library thread pool
+ *
+ * The calling thread takes part and the call returns once every band is
+ * done. Bands are at least min_band items. Each item is handled by exactly
+ * one band, so kernels whose items are independent give the same output
+ * for any thread count. Calls made from inside a band, or while another
+ * thread owns the pool, run inline on the calling thread.
+ *
+ * @param count Number of items
+ * @param min_band Smallest band worth handing to another thread
+ * @param fn Band function
+ * @param context Passed through to fn
+ * @return MASK_PROCESSOR_SUCCESS, or MASK_PROCESSOR_ERROR_CANCELLED if a
+ *         monitored job was cancelled and bands may have been skipped
+ */
+MaskProcessorResult mask_parallel_for(int count, int min_band, MaskBandFn fn, void* context);
+
+/**
+ * Threads a mask_parallel_for call made here would run on: 1 inside a band,
+ * where calls run inline, otherwise the pool size
+ */
+int mask_parallel_thread_count(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,89 @@
+#ifndef TILING_H
+#define TILING_H
+
+#include "mask_processor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Tile widths are a multiple of this many columns: one word of a packed
+// row, eight cache lines of doubles
+#define MASK_TILE_ALIGN 64
+
+// Halo work a tiled kernel accepts, as tile area (with halo) over core area
+#define MASK_TILE_MAX_OVERHEAD 2.0
+
+// Core region [x0, x1) x [y0, y1) of one tile; kernels read up to the plan's
+// halo beyond it, clipped to the image
+typedef struct {
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+} MaskTile;
+
+// Grid of equal tiles (the last column and row may be smaller)
+typedef struct {
+    int width;
+    int height;
+    int halo;
+    int tile_width;
+    int tile_height;
+    int columns;
+    int rows;
+} MaskTilePlan;
+
+// Processes one tile with band-owned scratch
+typedef void (*MaskTileFn)(void* context, const MaskTile* tile, void* scratch);
+
+/**
+ * Size tiles so one tile plus its halo fits half the cache
+ *
+ * @param plan Output plan
+ * @param width Image width
+ * @param height Image height
+ * @param halo Rows and columns read beyond each tile
+ * @param bytes_per_pixel Working-set bytes per pixel of a tile
+ */
+void mask_tile_plan(MaskTilePlan* plan, int width, int height, int halo, size_t bytes_per_pixel);
+
+/**
+ * Area of a full tile with its halo over the core area
+ */
+double mask_tile_overhead(const MaskTilePlan* plan);
+
+/**
+ * Whether a kernel with this plan should run tiled
+ *
+ * False when tiling is disabled, the image is a single tile, or the halo
+ * work exceeds MASK_TILE_MAX_OVERHEAD.
+ */
+int mask_tile_worthwhile(const MaskTilePlan* plan);
+
+/**
+ * Run every tile of a plan on the thread pool
+ *
+ * Tiles are independent, so each is written by exactly one thread. Tiles
+ * go out in row-major order, so a band of consecutive tiles shares its
+ * halo rows in cache. Each band allocates scratch_bytes once and passes it
+ * to fn for each of its tiles.
+ *
+ * @param plan Tile grid
+ * @param scratch_bytes Scratch per band (may be 0)
+ * @param fn Tile function
+ * @param context Passed through to fn
+ * @return MASK_PROCESSOR_ERROR_MEMORY if a band could not get its scratch
+ */
+MaskProcessorResult mask_parallel_tiles(
+    const MaskTilePlan* plan,
+    size_t scratch_bytes,
+    MaskTileFn fn,
+    void* context
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TILING_H
@@ -4,6 +4,7 @@ import 'package:flutter/foundation.dart';
 import 'package:flutter/services.dart';
 import 'src/constants.dart';
 import 'src/exceptions.dart';
+import 'src/native_mask_processor.dart';
 import 'src/onnx_sticker_processor.dart';
 import 'src/onnx_visual_effect_overlay.dart';
 import 'src/visual_effect_builder.dart';
@@ -52,6 +53,27 @@ class FlutterStickerMaker {
     }
   }
 
+  /// Keeps background masks in [directory] across app launches, so making
+  /// a sticker from the same photo again skips segmentation.
+  ///
+  /// Applies to the ONNX implementation. Masks are stored at 8-bit
+  /// precision within [maxBytes]; least recently used masks are evicted.
+  ///
+  /// **Returns:**
+  /// - [bool]: Whether the cache is in use
+  ///
+  /// **Example:**
+  /// ```dart
+  /// final dir = await getApplicationCacheDirectory();
+  /// FlutterStickerMaker.enableDiskCache('${dir.path}/sticker_masks');
+  /// ```
+  static bool enableDiskCache(
+    String directory, {
+    int maxBytes = StickerDefaults.diskCacheMaxBytes,
+  }) {
+    return OnnxStickerProcessor.enableDiskCache(directory, maxBytes: maxBytes);
+  }
+
   /// Creates a sticker by removing background from an image using ML Kit.
   ///
   /// **Parameters:**
@@ -105,6 +127,21 @@ class FlutterStickerMaker {
       // Determine which implementation to use based on platform and version
       _isUsingOnnx = await _shouldUseOnnx();
       if (_isUsingOnnx) {
+        // The timeout cancels the native jobs in flight, so a timed-out
+        // sticker stops using the CPU instead of finishing unobserved
+        final control = NativeJobControl();
+        final timeout = Duration(
+          seconds: StickerDefaults.processingTimeoutSeconds,
+        );
+        final elapsed = Stopwatch()..start();
+        Future<T> withTimeout<T>(Future<T> future) => future.timeout(
+          timeout - elapsed.elapsed,
+          onTimeout: () {
+            control.cancel();
+            throw TimeoutException('Sticker processing timed out', timeout);
+          },
+        );
+
         // Use ONNX implementation for Android and iOS < 17
         final pixelImage = await OnnxStickerProcessor.getPixelsFromImage(
           imageBytes,
@@ -116,7 +153,9 @@ class FlutterStickerMaker {
           );
         }
 
-        final mask = await OnnxStickerProcessor.generateMask(pixelImage);
+        final mask = await withTimeout(
+          OnnxStickerProcessor.generateMask(pixelImage, control: control),
+        );
         if (mask == null) {
           throw StickerException(
             'Failed to generate mask for the image',
@@ -125,12 +164,15 @@ class FlutterStickerMaker {
         }
 
         final process =
-            () => OnnxStickerProcessor.applyStickerEffect(
-              pixelImage,
-              mask,
-              addBorder: addBorder,
-              borderColor: borderColor,
-              borderWidth: borderWidth,
+            () => withTimeout(
+              OnnxStickerProcessor.applyStickerEffect(
+                pixelImage,
+                mask,
+                addBorder: addBorder,
+                borderColor: borderColor,
+                borderWidth: borderWidth,
+                control: control,
+              ),
             );
 
         if (!wantsVisualEffect) {
@@ -36,6 +36,21 @@ class StickerDefaults {
   /// Minimum allowed border width in pixels
   static const double minBorderWidth = 0.0;
 
+  /// Box blur kernel size used to smooth mask edges before compositing
+  static const int maskSmoothingKernelSize = 3;
+
+  /// Largest image, in pixels, kept as a restylable sticker session. A
+  /// session holds ~24 bytes per pixel (source, output, smoothed mask, SDF
+  /// and band index), so this caps it near 200 MB; larger images recomposite
+  /// from the cached SDF instead.
+  static const int maxStickerSessionPixels = 4096 * 2048;
+
+  /// Seconds an unused sticker session is kept before its memory is freed
+  static const int stickerSessionIdleSeconds = 60;
+
+  /// Default budget for the persistent mask cache in bytes
+  static const int diskCacheMaxBytes = 64 << 20;
+
   /// Processing timeout in seconds
   static const int processingTimeoutSeconds = 30;
 
@@ -1,5 +1,8 @@
+import 'dart:async';
 import 'dart:ffi' as ffi;
 import 'dart:io';
+import 'dart:isolate';
+import 'dart:typed_data';
 
 import 'package:ffi/ffi.dart';
 import 'package:flutter/foundation.dart';
@@ -14,12 +17,177 @@ final class RGBColor extends ffi.Struct {
   external int b;
 }
 
+/// Binary mask with 1 bit per pixel (see bit_mask.h)
+final class BitMask extends ffi.Struct {
+  external ffi.Pointer<ffi.Uint64> words;
+  @ffi.Int32()
+  external int width;
+  @ffi.Int32()
+  external int height;
+  @ffi.Int32()
+  external int wordsPerRow;
+}
+
+/// Perf event counts of one measured region (see perf_counters.h)
+final class MaskPerfCounters extends ffi.Struct {
+  @ffi.Int64()
+  external int taskClockNs;
+  @ffi.Int64()
+  external int cycles;
+  @ffi.Int64()
+  external int instructions;
+  @ffi.Int64()
+  external int cacheReferences;
+  @ffi.Int64()
+  external int cacheMisses;
+  @ffi.Int64()
+  external int l1dReadMisses;
+}
+
+/// Element types of an upsampled mask (see tensor_ops.h)
+class MaskOutputFormat {
+  static const int float64 = 0;
+  static const int float32 = 1;
+  static const int uint8 = 2;
+}
+
+/// Row-streaming pipeline state (see sticker_pipeline.h)
+final class StickerStream extends ffi.Opaque {}
+
+/// 128-bit content hash (see content_hash.h)
+final class MaskHash128 extends ffi.Struct {
+  @ffi.Uint64()
+  external int low;
+  @ffi.Uint64()
+  external int high;
+}
+
+/// Persistent mask cache state (see mask_cache.h)
+final class MaskCache extends ffi.Opaque {}
+
+/// Restylable sticker state (see sticker_session.h)
+final class StickerSession extends ffi.Opaque {}
+
+/// Reusable scratch memory (see processor_context.h)
+final class MaskProcessorContext extends ffi.Opaque {}
+
+/// State shared with an async job (see async_jobs.h)
+final class MaskJobState extends ffi.Struct {
+  @ffi.Int32()
+  external int result;
+  @ffi.Int32()
+  external int cancelled;
+  @ffi.Float()
+  external double progress;
+}
+
+/// One image of a batch (see sticker_batch.h)
+final class StickerBatchItem extends ffi.Struct {
+  external ffi.Pointer<ffi.Uint8> src;
+  external ffi.Pointer<ffi.Uint8> dst;
+  external ffi.Pointer<ffi.Double> mask;
+  @ffi.Int32()
+  external int width;
+  @ffi.Int32()
+  external int height;
+}
+
+/// Calls, time and bytes of one stage (see processor_stats.h)
+final class MaskStageStats extends ffi.Struct {
+  @ffi.Uint64()
+  external int calls;
+  @ffi.Uint64()
+  external int errors;
+  @ffi.Uint64()
+  external int totalNs;
+  @ffi.Uint64()
+  external int maxNs;
+  @ffi.Uint64()
+  external int bytes;
+  @ffi.Array(MaskStage.histogramBuckets)
+  external ffi.Array<ffi.Uint64> histogram;
+}
+
+/// Statistics of every stage (see processor_stats.h)
+final class MaskProcessorStats extends ffi.Struct {
+  @ffi.Array(MaskStage.count)
+  external ffi.Array<MaskStageStats> stages;
+}
+
 /// Result codes for native functions
 class MaskProcessorResult {
   static const int success = 0;
   static const int errorInvalidParams = -1;
   static const int errorMemory = -2;
   static const int errorProcessing = -3;
+  static const int errorCancelled = -4;
+}
+
+/// Instruction sets selectable by the native kernel dispatch table
+class MaskProcessorIsa {
+  static const int scalar = 0;
+  static const int sse2 = 1;
+  static const int avx2 = 2;
+  static const int avx512 = 3;
+  static const int neon = 4;
+
+  /// Human-readable name for telemetry
+  static String name(int isa) {
+    switch (isa) {
+      case scalar:
+        return 'scalar';
+      case sse2:
+        return 'sse2';
+      case avx2:
+        return 'avx2';
+      case avx512:
+        return 'avx512';
+      case neon:
+        return 'neon';
+      default:
+        return 'unknown';
+    }
+  }
+}
+
+/// Stages the native stage statistics are kept for (see processor_stats.h)
+class MaskStage {
+  static const int preprocess = 0;
+  static const int inference = 1;
+  static const int postprocess = 2;
+  static const int smooth = 3;
+  static const int expand = 4;
+  static const int sdf = 5;
+  static const int composite = 6;
+  static const int fused = 7;
+  static const int stream = 8;
+  static const int session = 9;
+  static const int hash = 10;
+  static const int encode = 11;
+  static const int count = 12;
+
+  /// Latency histogram buckets per stage
+  static const int histogramBuckets = 32;
+
+  static const List<String> _names = [
+    'preprocess',
+    'inference',
+    'postprocess',
+    'smooth',
+    'expand',
+    'sdf',
+    'composite',
+    'fused',
+    'stream',
+    'session',
+    'hash',
+    'encode',
+  ];
+
+  /// Human-readable name for telemetry
+  static String name(int stage) {
+    return stage >= 0 && stage < count ? _names[stage] : 'unknown';
+  }
 }
 
 /// Native function typedefs
@@ -47,6 +215,32 @@ typedef ApplyStickerMaskNativeDart =
       ffi.Pointer<ffi.Double> expandedMask,
     );
 
+typedef ApplyStickerMaskToNativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<ffi.Uint8> src,
+      ffi.Pointer<ffi.Uint8> dst,
+      ffi.Pointer<ffi.Double> mask,
+      ffi.Int32 width,
+      ffi.Int32 height,
+      ffi.Int32 addBorder,
+      RGBColor borderColor,
+      ffi.Int32 borderWidth,
+      ffi.Pointer<ffi.Double> expandedMask,
+    );
+
+typedef ApplyStickerMaskToNativeDart =
+    int Function(
+      ffi.Pointer<ffi.Uint8> src,
+      ffi.Pointer<ffi.Uint8> dst,
+      ffi.Pointer<ffi.Double> mask,
+      int width,
+      int height,
+      int addBorder,
+      RGBColor borderColor,
+      int borderWidth,
+      ffi.Pointer<ffi.Double> expandedMask,
+    );
+
 typedef SmoothMaskNativeC =
     ffi.Int32 Function(
       ffi.Pointer<ffi.Double> mask,
@@ -83,340 +277,4320 @@ typedef ExpandMaskNativeDart =
       int borderWidth,
     );
 
-/// Native library loader
-class NativeMaskProcessor {
-  static ffi.DynamicLibrary? _lib;
-  static ApplyStickerMaskNativeDart? _applyStickerMaskOptimized;
-  static SmoothMaskNativeDart? _smoothMaskOptimized;
-  static ExpandMaskNativeDart? _expandMaskNative;
-
-  static bool _initialized = false;
-  static bool _available = false;
+typedef ComputeMaskSdfNativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<ffi.Double> mask,
+      ffi.Pointer<ffi.Float> sdf,
+      ffi.Int32 width,
+      ffi.Int32 height,
+    );
 
-  /// Initialize the native library
-  static bool initialize() {
-    if (_initialized) return _available;
+typedef ComputeMaskSdfNativeDart =
+    int Function(
+      ffi.Pointer<ffi.Double> mask,
+      ffi.Pointer<ffi.Float> sdf,
+      int width,
+      int height,
+    );
 
-    try {
-      if (Platform.isAndroid) {
-        _lib = ffi.DynamicLibrary.open('libflutter_sticker_maker_native.so');
-      } else if (Platform.isIOS) {
-        _lib = ffi.DynamicLibrary.process();
-      } else {
-        _initialized = true;
-        _available = false;
-        return false;
-      }
+typedef ApplyStickerMaskSdfNativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<ffi.Uint8> pixels,
+      ffi.Pointer<ffi.Double> mask,
+      ffi.Pointer<ffi.Float> sdf,
+      ffi.Int32 width,
+      ffi.Int32 height,
+      ffi.Int32 addBorder,
+      RGBColor borderColor,
+      ffi.Float borderWidth,
+    );
 
-      // Load function pointers
-      _applyStickerMaskOptimized =
-          _lib!
-              .lookup<ffi.NativeFunction<ApplyStickerMaskNativeC>>(
-                'apply_sticker_mask_optimized',
-              )
-              .asFunction<ApplyStickerMaskNativeDart>();
+typedef ApplyStickerMaskSdfNativeDart =
+    int Function(
+      ffi.Pointer<ffi.Uint8> pixels,
+      ffi.Pointer<ffi.Double> mask,
+      ffi.Pointer<ffi.Float> sdf,
+      int width,
+      int height,
+      int addBorder,
+      RGBColor borderColor,
+      double borderWidth,
+    );
 
-      _smoothMaskOptimized =
-          _lib!
-              .lookup<ffi.NativeFunction<SmoothMaskNativeC>>(
-                'smooth_mask_optimized',
-              )
-              .asFunction<SmoothMaskNativeDart>();
+typedef ApplyStickerMaskSdfToNativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<ffi.Uint8> src,
+      ffi.Pointer<ffi.Uint8> dst,
+      ffi.Pointer<ffi.Double> mask,
+      ffi.Pointer<ffi.Float> sdf,
+      ffi.Int32 width,
+      ffi.Int32 height,
+      ffi.Int32 addBorder,
+      RGBColor borderColor,
+      ffi.Float borderWidth,
+    );
 
-      _expandMaskNative =
-          _lib!
-              .lookup<ffi.NativeFunction<ExpandMaskNativeC>>(
-                'expand_mask_native',
-              )
-              .asFunction<ExpandMaskNativeDart>();
+typedef ApplyStickerMaskSdfToNativeDart =
+    int Function(
+      ffi.Pointer<ffi.Uint8> src,
+      ffi.Pointer<ffi.Uint8> dst,
+      ffi.Pointer<ffi.Double> mask,
+      ffi.Pointer<ffi.Float> sdf,
+      int width,
+      int height,
+      int addBorder,
+      RGBColor borderColor,
+      double borderWidth,
+    );
 
-      _available = true;
-    } catch (e) {
-      _available = false;
-    }
+typedef BitMaskCreateNativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<BitMask> mask,
+      ffi.Int32 width,
+      ffi.Int32 height,
+    );
 
-    _initialized = true;
-    return _available;
-  }
+typedef BitMaskCreateNativeDart =
+    int Function(ffi.Pointer<BitMask> mask, int width, int height);
 
-  /// Check if native processing is available
-  static bool get isAvailable => _available;
+typedef BitMaskDestroyNativeC = ffi.Void Function(ffi.Pointer<BitMask> mask);
 
-  /// Apply sticker mask effects using native code
-  static int applyStickerMask(
-    Uint8List pixels,
-    List<double> mask,
-    int width,
-    int height,
-    bool addBorder,
-    List<int> borderColorRgb,
-    int borderWidth,
-    List<double>? expandedMask,
-  ) {
-    if (!_available || _applyStickerMaskOptimized == null) {
-      return MaskProcessorResult.errorProcessing;
-    }
+typedef BitMaskDestroyNativeDart = void Function(ffi.Pointer<BitMask> mask);
 
-    // Validate input parameters
-    if (pixels.isEmpty || mask.isEmpty || width <= 0 || height <= 0) {
-      return MaskProcessorResult.errorInvalidParams;
-    }
+typedef ExpandMaskPackedNativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<ffi.Double> mask,
+      ffi.Pointer<BitMask> output,
+      ffi.Int32 borderWidth,
+    );
 
-    // Validate array sizes
-    final expectedPixelCount = width * height * 4; // RGBA
-    final expectedMaskCount = width * height;
+typedef ExpandMaskPackedNativeDart =
+    int Function(
+      ffi.Pointer<ffi.Double> mask,
+      ffi.Pointer<BitMask> output,
+      int borderWidth,
+    );
 
-    if (pixels.length != expectedPixelCount ||
-        mask.length != expectedMaskCount) {
-      return MaskProcessorResult.errorInvalidParams;
-    }
+typedef ApplyStickerMaskPackedNativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<ffi.Uint8> pixels,
+      ffi.Pointer<ffi.Double> mask,
+      ffi.Int32 width,
+      ffi.Int32 height,
+      ffi.Int32 addBorder,
+      RGBColor borderColor,
+      ffi.Pointer<BitMask> expandedMask,
+    );
 
-    // Allocate native memory with proper size checks
-    ffi.Pointer<ffi.Uint8> pixelsPtr = ffi.nullptr;
-    ffi.Pointer<ffi.Double> maskPtr = ffi.nullptr;
-    ffi.Pointer<ffi.Double> expandedMaskPtr = ffi.nullptr;
-    ffi.Pointer<RGBColor> borderColor = ffi.nullptr;
+typedef ApplyStickerMaskPackedNativeDart =
+    int Function(
+      ffi.Pointer<ffi.Uint8> pixels,
+      ffi.Pointer<ffi.Double> mask,
+      int width,
+      int height,
+      int addBorder,
+      RGBColor borderColor,
+      ffi.Pointer<BitMask> expandedMask,
+    );
 
-    try {
-      // Allocate memory
-      pixelsPtr = malloc.allocate<ffi.Uint8>(
-        pixels.length * ffi.sizeOf<ffi.Uint8>(),
-      );
-      maskPtr = malloc.allocate<ffi.Double>(
-        mask.length * ffi.sizeOf<ffi.Double>(),
-      );
+typedef ApplyStickerMaskPackedToNativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<ffi.Uint8> src,
+      ffi.Pointer<ffi.Uint8> dst,
+      ffi.Pointer<ffi.Double> mask,
+      ffi.Int32 width,
+      ffi.Int32 height,
+      ffi.Int32 addBorder,
+      RGBColor borderColor,
+      ffi.Pointer<BitMask> expandedMask,
+    );
 
-      if (expandedMask != null && expandedMask.isNotEmpty) {
-        expandedMaskPtr = malloc.allocate<ffi.Double>(
-          expandedMask.length * ffi.sizeOf<ffi.Double>(),
-        );
-      }
+typedef ApplyStickerMaskPackedToNativeDart =
+    int Function(
+      ffi.Pointer<ffi.Uint8> src,
+      ffi.Pointer<ffi.Uint8> dst,
+      ffi.Pointer<ffi.Double> mask,
+      int width,
+      int height,
+      int addBorder,
+      RGBColor borderColor,
+      ffi.Pointer<BitMask> expandedMask,
+    );
 
-      // Verify pointers are valid
-      if (pixelsPtr == ffi.nullptr || maskPtr == ffi.nullptr) {
-        return MaskProcessorResult.errorMemory;
-      }
+typedef MakeStickerMaskFusedNativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<ffi.Uint8> src,
+      ffi.Pointer<ffi.Uint8> dst,
+      ffi.Pointer<ffi.Double> mask,
+      ffi.Int32 width,
+      ffi.Int32 height,
+      ffi.Int32 kernelSize,
+      ffi.Int32 addBorder,
+      RGBColor borderColor,
+      ffi.Int32 borderWidth,
+    );
 
-      // Copy data to native memory safely
-      for (int i = 0; i < pixels.length; i++) {
-        pixelsPtr[i] = pixels[i];
-      }
+typedef MakeStickerMaskFusedNativeDart =
+    int Function(
+      ffi.Pointer<ffi.Uint8> src,
+      ffi.Pointer<ffi.Uint8> dst,
+      ffi.Pointer<ffi.Double> mask,
+      int width,
+      int height,
+      int kernelSize,
+      int addBorder,
+      RGBColor borderColor,
+      int borderWidth,
+    );
 
-      for (int i = 0; i < mask.length; i++) {
-        maskPtr[i] = mask[i];
-      }
+typedef StickerStreamCreateNativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<ffi.Pointer<StickerStream>> stream,
+      ffi.Int32 width,
+      ffi.Int32 height,
+      ffi.Int32 kernelSize,
+      ffi.Int32 addBorder,
+      RGBColor borderColor,
+      ffi.Int32 borderWidth,
+    );
 
-      if (expandedMask != null && expandedMaskPtr != ffi.nullptr) {
-        for (int i = 0; i < expandedMask.length; i++) {
-          expandedMaskPtr[i] = expandedMask[i];
-        }
-      }
+typedef StickerStreamCreateNativeDart =
+    int Function(
+      ffi.Pointer<ffi.Pointer<StickerStream>> stream,
+      int width,
+      int height,
+      int kernelSize,
+      int addBorder,
+      RGBColor borderColor,
+      int borderWidth,
+    );
 
-      // Create border color
-      borderColor = malloc.allocate<RGBColor>(ffi.sizeOf<RGBColor>());
-      if (borderColor == ffi.nullptr) {
-        return MaskProcessorResult.errorMemory;
-      }
+typedef StickerStreamDestroyNativeC =
+    ffi.Void Function(ffi.Pointer<StickerStream> stream);
 
-      borderColor.ref.r = borderColorRgb[0];
-      borderColor.ref.g = borderColorRgb[1];
-      borderColor.ref.b = borderColorRgb[2];
+typedef StickerStreamDestroyNativeDart =
+    void Function(ffi.Pointer<StickerStream> stream);
 
-      // Call native function
-      final result = _applyStickerMaskOptimized!(
-        pixelsPtr,
-        maskPtr,
-        width,
-        height,
-        addBorder ? 1 : 0,
-        borderColor.ref,
-        borderWidth,
-        expandedMaskPtr,
-      );
+typedef StickerStreamLagNativeC =
+    ffi.Int32 Function(ffi.Pointer<StickerStream> stream);
 
-      // Copy result back safely
-      if (result == MaskProcessorResult.success) {
-        for (int i = 0; i < pixels.length; i++) {
-          pixels[i] = pixelsPtr[i];
-        }
-      }
+typedef StickerStreamLagNativeDart =
+    int Function(ffi.Pointer<StickerStream> stream);
 
-      return result;
+typedef StickerStreamPushNativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<StickerStream> stream,
+      ffi.Pointer<ffi.Uint8> pixels,
+      ffi.Pointer<ffi.Double> mask,
+      ffi.Int32 rows,
+      ffi.Pointer<ffi.Uint8> output,
+      ffi.Pointer<ffi.Int32> outputRows,
+    );
+
+typedef StickerStreamPushNativeDart =
+    int Function(
+      ffi.Pointer<StickerStream> stream,
+      ffi.Pointer<ffi.Uint8> pixels,
+      ffi.Pointer<ffi.Double> mask,
+      int rows,
+      ffi.Pointer<ffi.Uint8> output,
+      ffi.Pointer<ffi.Int32> outputRows,
+    );
+
+typedef ResizeRgbaToNchwNativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<ffi.Uint8> src,
+      ffi.Int32 srcWidth,
+      ffi.Int32 srcHeight,
+      ffi.Pointer<ffi.Float> dst,
+      ffi.Int32 dstWidth,
+      ffi.Int32 dstHeight,
+      ffi.Pointer<ffi.Float> mean,
+      ffi.Pointer<ffi.Float> invStd,
+    );
+
+typedef ResizeRgbaToNchwNativeDart =
+    int Function(
+      ffi.Pointer<ffi.Uint8> src,
+      int srcWidth,
+      int srcHeight,
+      ffi.Pointer<ffi.Float> dst,
+      int dstWidth,
+      int dstHeight,
+      ffi.Pointer<ffi.Float> mean,
+      ffi.Pointer<ffi.Float> invStd,
+    );
+
+typedef UpsampleMaskTensorNativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<ffi.Float> src,
+      ffi.Int32 srcWidth,
+      ffi.Int32 srcHeight,
+      ffi.Pointer<ffi.Void> dst,
+      ffi.Int32 format,
+      ffi.Int32 dstWidth,
+      ffi.Int32 dstHeight,
+      ffi.Int32 applySigmoid,
+      ffi.Double threshold,
+    );
+
+typedef UpsampleMaskTensorNativeDart =
+    int Function(
+      ffi.Pointer<ffi.Float> src,
+      int srcWidth,
+      int srcHeight,
+      ffi.Pointer<ffi.Void> dst,
+      int format,
+      int dstWidth,
+      int dstHeight,
+      int applySigmoid,
+      double threshold,
+    );
+
+typedef ContentHashNativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<ffi.Uint8> data,
+      ffi.Size length,
+      ffi.Uint64 seed,
+      ffi.Pointer<MaskHash128> hash,
+    );
+
+typedef ContentHashNativeDart =
+    int Function(
+      ffi.Pointer<ffi.Uint8> data,
+      int length,
+      int seed,
+      ffi.Pointer<MaskHash128> hash,
+    );
+
+typedef MaskCacheOpenNativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<ffi.Pointer<MaskCache>> cache,
+      ffi.Pointer<Utf8> directory,
+      ffi.Uint64 maxBytes,
+    );
+
+typedef MaskCacheOpenNativeDart =
+    int Function(
+      ffi.Pointer<ffi.Pointer<MaskCache>> cache,
+      ffi.Pointer<Utf8> directory,
+      int maxBytes,
+    );
+
+typedef MaskCacheCloseNativeC = ffi.Void Function(ffi.Pointer<MaskCache> cache);
+
+typedef MaskCacheCloseNativeDart = void Function(ffi.Pointer<MaskCache> cache);
+
+typedef MaskCacheGetNativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<MaskCache> cache,
+      ffi.Pointer<MaskHash128> key,
+      ffi.Pointer<ffi.Double> output,
+      ffi.Int32 width,
+      ffi.Int32 height,
+      ffi.Pointer<ffi.Int32> found,
+    );
+
+typedef MaskCacheGetNativeDart =
+    int Function(
+      ffi.Pointer<MaskCache> cache,
+      ffi.Pointer<MaskHash128> key,
+      ffi.Pointer<ffi.Double> output,
+      int width,
+      int height,
+      ffi.Pointer<ffi.Int32> found,
+    );
+
+typedef MaskCachePutNativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<MaskCache> cache,
+      ffi.Pointer<MaskHash128> key,
+      ffi.Pointer<ffi.Double> mask,
+      ffi.Int32 width,
+      ffi.Int32 height,
+    );
+
+typedef MaskCachePutNativeDart =
+    int Function(
+      ffi.Pointer<MaskCache> cache,
+      ffi.Pointer<MaskHash128> key,
+      ffi.Pointer<ffi.Double> mask,
+      int width,
+      int height,
+    );
+
+typedef MaskCachePutAsyncNativeC =
+    ffi.Int32 Function(
+      ffi.Int64 port,
+      ffi.Int64 jobId,
+      ffi.Pointer<MaskJobState> state,
+      ffi.Pointer<MaskCache> cache,
+      ffi.Pointer<MaskHash128> key,
+      ffi.Pointer<ffi.Double> mask,
+      ffi.Int32 width,
+      ffi.Int32 height,
+    );
+
+typedef MaskCachePutAsyncNativeDart =
+    int Function(
+      int port,
+      int jobId,
+      ffi.Pointer<MaskJobState> state,
+      ffi.Pointer<MaskCache> cache,
+      ffi.Pointer<MaskHash128> key,
+      ffi.Pointer<ffi.Double> mask,
+      int width,
+      int height,
+    );
+
+typedef MaskCacheUsageNativeC =
+    ffi.Void Function(
+      ffi.Pointer<MaskCache> cache,
+      ffi.Pointer<ffi.Uint64> bytes,
+      ffi.Pointer<ffi.Int32> entries,
+    );
+
+typedef MaskCacheUsageNativeDart =
+    void Function(
+      ffi.Pointer<MaskCache> cache,
+      ffi.Pointer<ffi.Uint64> bytes,
+      ffi.Pointer<ffi.Int32> entries,
+    );
+
+typedef StickerSessionCreateNativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<ffi.Pointer<StickerSession>> session,
+      ffi.Pointer<ffi.Uint8> src,
+      ffi.Pointer<ffi.Double> mask,
+      ffi.Int32 width,
+      ffi.Int32 height,
+      ffi.Int32 kernelSize,
+      ffi.Int32 addBorder,
+      RGBColor borderColor,
+      ffi.Float borderWidth,
+    );
+
+typedef StickerSessionCreateNativeDart =
+    int Function(
+      ffi.Pointer<ffi.Pointer<StickerSession>> session,
+      ffi.Pointer<ffi.Uint8> src,
+      ffi.Pointer<ffi.Double> mask,
+      int width,
+      int height,
+      int kernelSize,
+      int addBorder,
+      RGBColor borderColor,
+      double borderWidth,
+    );
+
+typedef StickerSessionDestroyNativeC =
+    ffi.Void Function(ffi.Pointer<StickerSession> session);
+
+typedef StickerSessionDestroyNativeDart =
+    void Function(ffi.Pointer<StickerSession> session);
+
+typedef StickerSessionPixelsNativeC =
+    ffi.Pointer<ffi.Uint8> Function(ffi.Pointer<StickerSession> session);
+
+typedef StickerSessionPixelsNativeDart =
+    ffi.Pointer<ffi.Uint8> Function(ffi.Pointer<StickerSession> session);
+
+typedef StickerSessionSetBorderColorNativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<StickerSession> session,
+      RGBColor borderColor,
+    );
+
+typedef StickerSessionSetBorderColorNativeDart =
+    int Function(ffi.Pointer<StickerSession> session, RGBColor borderColor);
+
+typedef StickerSessionSetBorderWidthNativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<StickerSession> session,
+      ffi.Float borderWidth,
+    );
+
+typedef StickerSessionSetBorderWidthNativeDart =
+    int Function(ffi.Pointer<StickerSession> session, double borderWidth);
+
+typedef StickerSessionSetAddBorderNativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<StickerSession> session,
+      ffi.Int32 addBorder,
+    );
+
+typedef StickerSessionSetAddBorderNativeDart =
+    int Function(ffi.Pointer<StickerSession> session, int addBorder);
+
+typedef MaskProcessorContextCreateNativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<ffi.Pointer<MaskProcessorContext>> context,
+      ffi.Int32 threadCount,
+    );
+
+typedef MaskProcessorContextCreateNativeDart =
+    int Function(
+      ffi.Pointer<ffi.Pointer<MaskProcessorContext>> context,
+      int threadCount,
+    );
+
+/// Shared by mask_processor_context_destroy and mask_processor_context_trim
+typedef MaskProcessorContextReleaseNativeC =
+    ffi.Void Function(ffi.Pointer<MaskProcessorContext> context);
+
+typedef MaskProcessorContextReleaseNativeDart =
+    void Function(ffi.Pointer<MaskProcessorContext> context);
+
+typedef MaskProcessorContextHeapAllocationsNativeC =
+    ffi.Uint64 Function(ffi.Pointer<MaskProcessorContext> context);
+
+typedef MaskProcessorContextHeapAllocationsNativeDart =
+    int Function(ffi.Pointer<MaskProcessorContext> context);
+
+typedef MaskProcessorContextReservedBytesNativeC =
+    ffi.Size Function(ffi.Pointer<MaskProcessorContext> context);
+
+typedef MaskProcessorContextReservedBytesNativeDart =
+    int Function(ffi.Pointer<MaskProcessorContext> context);
+
+typedef MaskProcessorContextStagingNativeC =
+    ffi.Pointer<ffi.Void> Function(
+      ffi.Pointer<MaskProcessorContext> context,
+      ffi.Size bytes,
+    );
+
+typedef MaskProcessorContextStagingNativeDart =
+    ffi.Pointer<ffi.Void> Function(
+      ffi.Pointer<MaskProcessorContext> context,
+      int bytes,
+    );
+
+/// Shared by smooth_mask_ctx and expand_mask_ctx
+typedef FilterMaskCtxNativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<MaskProcessorContext> context,
+      ffi.Pointer<ffi.Double> mask,
+      ffi.Pointer<ffi.Double> output,
+      ffi.Int32 width,
+      ffi.Int32 height,
+      ffi.Int32 size,
+    );
+
+typedef FilterMaskCtxNativeDart =
+    int Function(
+      ffi.Pointer<MaskProcessorContext> context,
+      ffi.Pointer<ffi.Double> mask,
+      ffi.Pointer<ffi.Double> output,
+      int width,
+      int height,
+      int size,
+    );
+
+typedef ComputeMaskSdfCtxNativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<MaskProcessorContext> context,
+      ffi.Pointer<ffi.Double> mask,
+      ffi.Pointer<ffi.Float> sdf,
+      ffi.Int32 width,
+      ffi.Int32 height,
+    );
+
+typedef ComputeMaskSdfCtxNativeDart =
+    int Function(
+      ffi.Pointer<MaskProcessorContext> context,
+      ffi.Pointer<ffi.Double> mask,
+      ffi.Pointer<ffi.Float> sdf,
+      int width,
+      int height,
+    );
+
+typedef MakeStickerMaskFusedCtxNativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<MaskProcessorContext> context,
+      ffi.Pointer<ffi.Uint8> src,
+      ffi.Pointer<ffi.Uint8> dst,
+      ffi.Pointer<ffi.Double> mask,
+      ffi.Int32 width,
+      ffi.Int32 height,
+      ffi.Int32 kernelSize,
+      ffi.Int32 addBorder,
+      RGBColor borderColor,
+      ffi.Int32 borderWidth,
+    );
+
+typedef MakeStickerMaskFusedCtxNativeDart =
+    int Function(
+      ffi.Pointer<MaskProcessorContext> context,
+      ffi.Pointer<ffi.Uint8> src,
+      ffi.Pointer<ffi.Uint8> dst,
+      ffi.Pointer<ffi.Double> mask,
+      int width,
+      int height,
+      int kernelSize,
+      int addBorder,
+      RGBColor borderColor,
+      int borderWidth,
+    );
+
+typedef ResizeRgbaToNchwCtxNativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<MaskProcessorContext> context,
+      ffi.Pointer<ffi.Uint8> src,
+      ffi.Int32 srcWidth,
+      ffi.Int32 srcHeight,
+      ffi.Pointer<ffi.Float> dst,
+      ffi.Int32 dstWidth,
+      ffi.Int32 dstHeight,
+      ffi.Pointer<ffi.Float> mean,
+      ffi.Pointer<ffi.Float> invStd,
+    );
+
+typedef ResizeRgbaToNchwCtxNativeDart =
+    int Function(
+      ffi.Pointer<MaskProcessorContext> context,
+      ffi.Pointer<ffi.Uint8> src,
+      int srcWidth,
+      int srcHeight,
+      ffi.Pointer<ffi.Float> dst,
+      int dstWidth,
+      int dstHeight,
+      ffi.Pointer<ffi.Float> mean,
+      ffi.Pointer<ffi.Float> invStd,
+    );
+
+typedef UpsampleMaskTensorCtxNativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<MaskProcessorContext> context,
+      ffi.Pointer<ffi.Float> src,
+      ffi.Int32 srcWidth,
+      ffi.Int32 srcHeight,
+      ffi.Pointer<ffi.Void> dst,
+      ffi.Int32 format,
+      ffi.Int32 dstWidth,
+      ffi.Int32 dstHeight,
+      ffi.Int32 applySigmoid,
+      ffi.Double threshold,
+    );
+
+typedef UpsampleMaskTensorCtxNativeDart =
+    int Function(
+      ffi.Pointer<MaskProcessorContext> context,
+      ffi.Pointer<ffi.Float> src,
+      int srcWidth,
+      int srcHeight,
+      ffi.Pointer<ffi.Void> dst,
+      int format,
+      int dstWidth,
+      int dstHeight,
+      int applySigmoid,
+      double threshold,
+    );
+
+typedef MakeStickersBatchNativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<StickerBatchItem> items,
+      ffi.Int32 count,
+      ffi.Pointer<ffi.Int32> results,
+      ffi.Int32 kernelSize,
+      ffi.Int32 addBorder,
+      RGBColor borderColor,
+      ffi.Int32 borderWidth,
+    );
+
+typedef MakeStickersBatchNativeDart =
+    int Function(
+      ffi.Pointer<StickerBatchItem> items,
+      int count,
+      ffi.Pointer<ffi.Int32> results,
+      int kernelSize,
+      int addBorder,
+      RGBColor borderColor,
+      int borderWidth,
+    );
+
+typedef MakeStickersBatchCtxNativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<MaskProcessorContext> context,
+      ffi.Pointer<StickerBatchItem> items,
+      ffi.Int32 count,
+      ffi.Pointer<ffi.Int32> results,
+      ffi.Int32 kernelSize,
+      ffi.Int32 addBorder,
+      RGBColor borderColor,
+      ffi.Int32 borderWidth,
+    );
+
+typedef MakeStickersBatchCtxNativeDart =
+    int Function(
+      ffi.Pointer<MaskProcessorContext> context,
+      ffi.Pointer<StickerBatchItem> items,
+      int count,
+      ffi.Pointer<ffi.Int32> results,
+      int kernelSize,
+      int addBorder,
+      RGBColor borderColor,
+      int borderWidth,
+    );
+
+typedef MaskJobsInitNativeC =
+    ffi.Int32 Function(ffi.Pointer<ffi.Void> postCObject);
+
+typedef MaskJobsInitNativeDart =
+    int Function(ffi.Pointer<ffi.Void> postCObject);
+
+typedef MaskJobCancelNativeC =
+    ffi.Void Function(ffi.Pointer<MaskJobState> state);
+
+typedef MaskJobCancelNativeDart =
+    void Function(ffi.Pointer<MaskJobState> state);
+
+typedef MakeStickerMaskFusedAsyncNativeC =
+    ffi.Int32 Function(
+      ffi.Int64 port,
+      ffi.Int64 jobId,
+      ffi.Pointer<MaskJobState> state,
+      ffi.Pointer<MaskProcessorContext> context,
+      ffi.Pointer<ffi.Uint8> src,
+      ffi.Pointer<ffi.Uint8> dst,
+      ffi.Pointer<ffi.Double> mask,
+      ffi.Int32 width,
+      ffi.Int32 height,
+      ffi.Int32 kernelSize,
+      ffi.Int32 addBorder,
+      RGBColor borderColor,
+      ffi.Int32 borderWidth,
+    );
+
+typedef MakeStickerMaskFusedAsyncNativeDart =
+    int Function(
+      int port,
+      int jobId,
+      ffi.Pointer<MaskJobState> state,
+      ffi.Pointer<MaskProcessorContext> context,
+      ffi.Pointer<ffi.Uint8> src,
+      ffi.Pointer<ffi.Uint8> dst,
+      ffi.Pointer<ffi.Double> mask,
+      int width,
+      int height,
+      int kernelSize,
+      int addBorder,
+      RGBColor borderColor,
+      int borderWidth,
+    );
+
+/// Shared by smooth_mask_async and expand_mask_async
+typedef FilterMaskAsyncNativeC =
+    ffi.Int32 Function(
+      ffi.Int64 port,
+      ffi.Int64 jobId,
+      ffi.Pointer<MaskJobState> state,
+      ffi.Pointer<MaskProcessorContext> context,
+      ffi.Pointer<ffi.Double> mask,
+      ffi.Pointer<ffi.Double> output,
+      ffi.Int32 width,
+      ffi.Int32 height,
+      ffi.Int32 size,
+    );
+
+typedef FilterMaskAsyncNativeDart =
+    int Function(
+      int port,
+      int jobId,
+      ffi.Pointer<MaskJobState> state,
+      ffi.Pointer<MaskProcessorContext> context,
+      ffi.Pointer<ffi.Double> mask,
+      ffi.Pointer<ffi.Double> output,
+      int width,
+      int height,
+      int size,
+    );
+
+typedef ComputeMaskSdfAsyncNativeC =
+    ffi.Int32 Function(
+      ffi.Int64 port,
+      ffi.Int64 jobId,
+      ffi.Pointer<MaskJobState> state,
+      ffi.Pointer<MaskProcessorContext> context,
+      ffi.Pointer<ffi.Double> mask,
+      ffi.Pointer<ffi.Float> sdf,
+      ffi.Int32 width,
+      ffi.Int32 height,
+    );
+
+typedef ComputeMaskSdfAsyncNativeDart =
+    int Function(
+      int port,
+      int jobId,
+      ffi.Pointer<MaskJobState> state,
+      ffi.Pointer<MaskProcessorContext> context,
+      ffi.Pointer<ffi.Double> mask,
+      ffi.Pointer<ffi.Float> sdf,
+      int width,
+      int height,
+    );
+
+typedef ApplyStickerMaskSdfAsyncNativeC =
+    ffi.Int32 Function(
+      ffi.Int64 port,
+      ffi.Int64 jobId,
+      ffi.Pointer<MaskJobState> state,
+      ffi.Pointer<ffi.Uint8> src,
+      ffi.Pointer<ffi.Uint8> dst,
+      ffi.Pointer<ffi.Double> mask,
+      ffi.Pointer<ffi.Float> sdf,
+      ffi.Int32 width,
+      ffi.Int32 height,
+      ffi.Int32 addBorder,
+      RGBColor borderColor,
+      ffi.Float borderWidth,
+    );
+
+typedef ApplyStickerMaskSdfAsyncNativeDart =
+    int Function(
+      int port,
+      int jobId,
+      ffi.Pointer<MaskJobState> state,
+      ffi.Pointer<ffi.Uint8> src,
+      ffi.Pointer<ffi.Uint8> dst,
+      ffi.Pointer<ffi.Double> mask,
+      ffi.Pointer<ffi.Float> sdf,
+      int width,
+      int height,
+      int addBorder,
+      RGBColor borderColor,
+      double borderWidth,
+    );
+
+typedef ResizeRgbaToNchwAsyncNativeC =
+    ffi.Int32 Function(
+      ffi.Int64 port,
+      ffi.Int64 jobId,
+      ffi.Pointer<MaskJobState> state,
+      ffi.Pointer<MaskProcessorContext> context,
+      ffi.Pointer<ffi.Uint8> src,
+      ffi.Int32 srcWidth,
+      ffi.Int32 srcHeight,
+      ffi.Pointer<ffi.Float> dst,
+      ffi.Int32 dstWidth,
+      ffi.Int32 dstHeight,
+      ffi.Pointer<ffi.Float> mean,
+      ffi.Pointer<ffi.Float> invStd,
+    );
+
+typedef ResizeRgbaToNchwAsyncNativeDart =
+    int Function(
+      int port,
+      int jobId,
+      ffi.Pointer<MaskJobState> state,
+      ffi.Pointer<MaskProcessorContext> context,
+      ffi.Pointer<ffi.Uint8> src,
+      int srcWidth,
+      int srcHeight,
+      ffi.Pointer<ffi.Float> dst,
+      int dstWidth,
+      int dstHeight,
+      ffi.Pointer<ffi.Float> mean,
+      ffi.Pointer<ffi.Float> invStd,
+    );
+
+typedef UpsampleMaskTensorAsyncNativeC =
+    ffi.Int32 Function(
+      ffi.Int64 port,
+      ffi.Int64 jobId,
+      ffi.Pointer<MaskJobState> state,
+      ffi.Pointer<MaskProcessorContext> context,
+      ffi.Pointer<ffi.Float> src,
+      ffi.Int32 srcWidth,
+      ffi.Int32 srcHeight,
+      ffi.Pointer<ffi.Void> dst,
+      ffi.Int32 format,
+      ffi.Int32 dstWidth,
+      ffi.Int32 dstHeight,
+      ffi.Int32 applySigmoid,
+      ffi.Double threshold,
+    );
+
+typedef UpsampleMaskTensorAsyncNativeDart =
+    int Function(
+      int port,
+      int jobId,
+      ffi.Pointer<MaskJobState> state,
+      ffi.Pointer<MaskProcessorContext> context,
+      ffi.Pointer<ffi.Float> src,
+      int srcWidth,
+      int srcHeight,
+      ffi.Pointer<ffi.Void> dst,
+      int format,
+      int dstWidth,
+      int dstHeight,
+      int applySigmoid,
+      double threshold,
+    );
+
+typedef StickerSessionCreateAsyncNativeC =
+    ffi.Int32 Function(
+      ffi.Int64 port,
+      ffi.Int64 jobId,
+      ffi.Pointer<MaskJobState> state,
+      ffi.Pointer<ffi.Pointer<StickerSession>> session,
+      ffi.Pointer<ffi.Uint8> src,
+      ffi.Pointer<ffi.Double> mask,
+      ffi.Int32 width,
+      ffi.Int32 height,
+      ffi.Int32 kernelSize,
+      ffi.Int32 addBorder,
+      RGBColor borderColor,
+      ffi.Float borderWidth,
+    );
+
+typedef StickerSessionCreateAsyncNativeDart =
+    int Function(
+      int port,
+      int jobId,
+      ffi.Pointer<MaskJobState> state,
+      ffi.Pointer<ffi.Pointer<StickerSession>> session,
+      ffi.Pointer<ffi.Uint8> src,
+      ffi.Pointer<ffi.Double> mask,
+      int width,
+      int height,
+      int kernelSize,
+      int addBorder,
+      RGBColor borderColor,
+      double borderWidth,
+    );
+
+typedef ApplyStickerMaskU8NativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<ffi.Uint8> pixels,
+      ffi.Pointer<ffi.Uint8> mask,
+      ffi.Int32 width,
+      ffi.Int32 height,
+      ffi.Int32 addBorder,
+      RGBColor borderColor,
+      ffi.Pointer<ffi.Uint8> expandedMask,
+    );
+
+typedef ApplyStickerMaskU8NativeDart =
+    int Function(
+      ffi.Pointer<ffi.Uint8> pixels,
+      ffi.Pointer<ffi.Uint8> mask,
+      int width,
+      int height,
+      int addBorder,
+      RGBColor borderColor,
+      ffi.Pointer<ffi.Uint8> expandedMask,
+    );
+
+/// Shared by smooth_mask_u8 and expand_mask_u8
+typedef FilterMaskU8NativeC =
+    ffi.Int32 Function(
+      ffi.Pointer<ffi.Uint8> mask,
+      ffi.Pointer<ffi.Uint8> output,
+      ffi.Int32 width,
+      ffi.Int32 height,
+      ffi.Int32 size,
+    );
+
+typedef FilterMaskU8NativeDart =
+    int Function(
+      ffi.Pointer<ffi.Uint8> mask,
+      ffi.Pointer<ffi.Uint8> output,
+      int width,
+      int height,
+      int size,
+    );
+
+typedef GetActiveIsaNativeC = ffi.Int32 Function();
+
+typedef GetActiveIsaNativeDart = int Function();
+
+typedef SetThreadCountNativeC = ffi.Int32 Function(ffi.Int32 threadCount);
+
+typedef SetThreadCountNativeDart = int Function(int threadCount);
+
+typedef GetThreadCountNativeC = ffi.Int32 Function();
+
+typedef GetThreadCountNativeDart = int Function();
+
+typedef SetTilingNativeC = ffi.Void Function(ffi.Int32 enabled);
+
+typedef SetTilingNativeDart = void Function(int enabled);
+
+typedef SetCacheSizeNativeC = ffi.Void Function(ffi.Size bytes);
+
+typedef SetCacheSizeNativeDart = void Function(int bytes);
+
+typedef GetCacheSizeNativeC = ffi.Size Function();
+
+typedef GetCacheSizeNativeDart = int Function();
+
+typedef PerfCountersStartNativeC = ffi.Int32 Function();
+
+typedef PerfCountersStartNativeDart = int Function();
+
+typedef PerfCountersStopNativeC =
+    ffi.Int32 Function(ffi.Pointer<MaskPerfCounters> counters);
+
+typedef PerfCountersStopNativeDart =
+    int Function(ffi.Pointer<MaskPerfCounters> counters);
+
+typedef GetStatsNativeC =
+    ffi.Int32 Function(ffi.Pointer<MaskProcessorStats> stats);
+
+typedef GetStatsNativeDart =
+    int Function(ffi.Pointer<MaskProcessorStats> stats);
+
+typedef ResetStatsNativeC = ffi.Void Function();
+
+typedef ResetStatsNativeDart = void Function();
+
+typedef RecordStageNativeC =
+    ffi.Int32 Function(ffi.Int32 stage, ffi.Uint64 elapsedNs, ffi.Uint64 bytes);
+
+typedef RecordStageNativeDart =
+    int Function(int stage, int elapsedNs, int bytes);
+
+/// Native library loader
+class NativeMaskProcessor {
+  static ffi.DynamicLibrary? _lib;
+  static ApplyStickerMaskNativeDart? _applyStickerMaskOptimized;
+  static ApplyStickerMaskNativeDart? _applyStickerMaskNative;
+  static ApplyStickerMaskToNativeDart? _applyStickerMaskToOptimized;
+  static SmoothMaskNativeDart? _smoothMaskOptimized;
+  static ExpandMaskNativeDart? _expandMaskOptimized;
+  static GetActiveIsaNativeDart? _getActiveIsa;
+  static SetThreadCountNativeDart? _setThreadCount;
+  static GetThreadCountNativeDart? _getThreadCount;
+  static SetTilingNativeDart? _setTiling;
+  static SetCacheSizeNativeDart? _setCacheSize;
+  static GetCacheSizeNativeDart? _getCacheSize;
+  static PerfCountersStartNativeDart? _perfCountersStart;
+  static PerfCountersStopNativeDart? _perfCountersStop;
+  static GetStatsNativeDart? _getStats;
+  static ResetStatsNativeDart? _resetStats;
+  static RecordStageNativeDart? _recordStage;
+  static ComputeMaskSdfNativeDart? _computeMaskSdf;
+  static ApplyStickerMaskSdfNativeDart? _applyStickerMaskSdf;
+  static ApplyStickerMaskSdfToNativeDart? _applyStickerMaskSdfTo;
+  static ApplyStickerMaskU8NativeDart? _applyStickerMaskU8;
+  static FilterMaskU8NativeDart? _smoothMaskU8;
+  static FilterMaskU8NativeDart? _expandMaskU8;
+  static BitMaskCreateNativeDart? _bitMaskCreate;
+  static BitMaskDestroyNativeDart? _bitMaskDestroy;
+  static ExpandMaskPackedNativeDart? _expandMaskPacked;
+  static ApplyStickerMaskPackedNativeDart? _applyStickerMaskPacked;
+  static ApplyStickerMaskPackedToNativeDart? _applyStickerMaskPackedTo;
+  static MakeStickerMaskFusedNativeDart? _makeStickerMaskFused;
+  static StickerStreamCreateNativeDart? _stickerStreamCreate;
+  static StickerStreamDestroyNativeDart? _stickerStreamDestroy;
+  static StickerStreamLagNativeDart? _stickerStreamLag;
+  static StickerStreamPushNativeDart? _stickerStreamPush;
+  static ffi.NativeFinalizer? _stickerStreamFinalizer;
+  static ResizeRgbaToNchwNativeDart? _resizeRgbaToNchw;
+  static UpsampleMaskTensorNativeDart? _upsampleMaskTensor;
+  static ContentHashNativeDart? _contentHash;
+  static MaskCacheOpenNativeDart? _maskCacheOpen;
+  static MaskCacheCloseNativeDart? _maskCacheClose;
+  static MaskCacheGetNativeDart? _maskCacheGet;
+  static MaskCachePutNativeDart? _maskCachePut;
+  static MaskCacheUsageNativeDart? _maskCacheUsage;
+  static ffi.NativeFinalizer? _maskCacheFinalizer;
+  static StickerSessionCreateNativeDart? _stickerSessionCreate;
+  static StickerSessionDestroyNativeDart? _stickerSessionDestroy;
+  static StickerSessionPixelsNativeDart? _stickerSessionPixels;
+  static StickerSessionSetBorderColorNativeDart? _stickerSessionSetBorderColor;
+  static StickerSessionSetBorderWidthNativeDart? _stickerSessionSetBorderWidth;
+  static StickerSessionSetAddBorderNativeDart? _stickerSessionSetAddBorder;
+  static ffi.NativeFinalizer? _stickerSessionFinalizer;
+  static MaskProcessorContextCreateNativeDart? _contextCreate;
+  static MaskProcessorContextReleaseNativeDart? _contextDestroy;
+  static MaskProcessorContextReleaseNativeDart? _contextTrim;
+  static MaskProcessorContextHeapAllocationsNativeDart? _contextHeapAllocations;
+  static MaskProcessorContextReservedBytesNativeDart? _contextReservedBytes;
+  static MaskProcessorContextStagingNativeDart? _contextStaging;
+  static ffi.NativeFinalizer? _contextFinalizer;
+  static FilterMaskCtxNativeDart? _smoothMaskCtx;
+  static FilterMaskCtxNativeDart? _expandMaskCtx;
+  static ComputeMaskSdfCtxNativeDart? _computeMaskSdfCtx;
+  static MakeStickerMaskFusedCtxNativeDart? _makeStickerMaskFusedCtx;
+  static ResizeRgbaToNchwCtxNativeDart? _resizeRgbaToNchwCtx;
+  static UpsampleMaskTensorCtxNativeDart? _upsampleMaskTensorCtx;
+  static MakeStickersBatchNativeDart? _makeStickersBatch;
+  static MakeStickersBatchCtxNativeDart? _makeStickersBatchCtx;
+  static MaskJobsInitNativeDart? _maskJobsInit;
+  static MaskJobCancelNativeDart? _maskJobCancel;
+  static MakeStickerMaskFusedAsyncNativeDart? _makeStickerMaskFusedAsync;
+  static FilterMaskAsyncNativeDart? _smoothMaskAsync;
+  static FilterMaskAsyncNativeDart? _expandMaskAsync;
+  static ComputeMaskSdfAsyncNativeDart? _computeMaskSdfAsync;
+  static ApplyStickerMaskSdfAsyncNativeDart? _applyStickerMaskSdfAsync;
+  static ResizeRgbaToNchwAsyncNativeDart? _resizeRgbaToNchwAsync;
+  static UpsampleMaskTensorAsyncNativeDart? _upsampleMaskTensorAsync;
+  static StickerSessionCreateAsyncNativeDart? _stickerSessionCreateAsync;
+  static MaskCachePutAsyncNativeDart? _maskCachePutAsync;
+
+  // Async jobs in flight by id, and the port their completions arrive on
+  // while any are
+  static final Map<int, _NativeJob> _jobs = {};
+  static RawReceivePort? _jobPort;
+  static int _nextJobId = 0;
+
+  // Native addresses of buffers handed out by the allocate methods
+  static final Expando<ffi.Pointer<ffi.Void>> _nativeBuffers = Expando(
+    'nativeBuffers',
+  );
+
+  static bool _initialized = false;
+  static bool _available = false;
+
+  /// Initialize the native library
+  static bool initialize() {
+    if (_initialized) return _available;
+
+    try {
+      if (Platform.isAndroid) {
+        _lib = ffi.DynamicLibrary.open('libflutter_sticker_maker_native.so');
+      } else if (Platform.isIOS) {
+        _lib = ffi.DynamicLibrary.process();
+      } else {
+        _initialized = true;
+        _available = false;
+        return false;
+      }
+
+      // Load function pointers
+      _applyStickerMaskOptimized =
+          _lib!
+              .lookup<ffi.NativeFunction<ApplyStickerMaskNativeC>>(
+                'apply_sticker_mask_optimized',
+              )
+              .asFunction<ApplyStickerMaskNativeDart>();
+
+      _applyStickerMaskNative =
+          _lib!
+              .lookup<ffi.NativeFunction<ApplyStickerMaskNativeC>>(
+                'apply_sticker_mask_native',
+              )
+              .asFunction<ApplyStickerMaskNativeDart>();
+
+      _applyStickerMaskToOptimized =
+          _lib!
+              .lookup<ffi.NativeFunction<ApplyStickerMaskToNativeC>>(
+                'apply_sticker_mask_to_optimized',
+              )
+              .asFunction<ApplyStickerMaskToNativeDart>();
+
+      _smoothMaskOptimized =
+          _lib!
+              .lookup<ffi.NativeFunction<SmoothMaskNativeC>>(
+                'smooth_mask_optimized',
+              )
+              .asFunction<SmoothMaskNativeDart>();
+
+      _expandMaskOptimized =
+          _lib!
+              .lookup<ffi.NativeFunction<ExpandMaskNativeC>>(
+                'expand_mask_optimized',
+              )
+              .asFunction<ExpandMaskNativeDart>();
+
+      _getActiveIsa =
+          _lib!
+              .lookup<ffi.NativeFunction<GetActiveIsaNativeC>>(
+                'mask_processor_get_active_isa',
+              )
+              .asFunction<GetActiveIsaNativeDart>();
+
+      _setThreadCount =
+          _lib!
+              .lookup<ffi.NativeFunction<SetThreadCountNativeC>>(
+                'mask_processor_set_thread_count',
+              )
+              .asFunction<SetThreadCountNativeDart>();
+
+      _getThreadCount =
+          _lib!
+              .lookup<ffi.NativeFunction<GetThreadCountNativeC>>(
+                'mask_processor_get_thread_count',
+              )
+              .asFunction<GetThreadCountNativeDart>();
+
+      _setTiling =
+          _lib!
+              .lookup<ffi.NativeFunction<SetTilingNativeC>>(
+                'mask_processor_set_tiling',
+              )
+              .asFunction<SetTilingNativeDart>();
+
+      _setCacheSize =
+          _lib!
+              .lookup<ffi.NativeFunction<SetCacheSizeNativeC>>(
+                'mask_processor_set_cache_size',
+              )
+              .asFunction<SetCacheSizeNativeDart>();
+
+      _getCacheSize =
+          _lib!
+              .lookup<ffi.NativeFunction<GetCacheSizeNativeC>>(
+                'mask_processor_get_cache_size',
+              )
+              .asFunction<GetCacheSizeNativeDart>();
+
+      _perfCountersStart =
+          _lib!
+              .lookup<ffi.NativeFunction<PerfCountersStartNativeC>>(
+                'mask_perf_counters_start',
+              )
+              .asFunction<PerfCountersStartNativeDart>();
+
+      _perfCountersStop =
+          _lib!
+              .lookup<ffi.NativeFunction<PerfCountersStopNativeC>>(
+                'mask_perf_counters_stop',
+              )
+              .asFunction<PerfCountersStopNativeDart>();
+
+      _getStats =
+          _lib!
+              .lookup<ffi.NativeFunction<GetStatsNativeC>>(
+                'mask_processor_get_stats',
+              )
+              .asFunction<GetStatsNativeDart>();
+
+      _resetStats =
+          _lib!
+              .lookup<ffi.NativeFunction<ResetStatsNativeC>>(
+                'mask_processor_reset_stats',
+              )
+              .asFunction<ResetStatsNativeDart>();
+
+      _recordStage =
+          _lib!
+              .lookup<ffi.NativeFunction<RecordStageNativeC>>(
+                'mask_processor_record_stage',
+              )
+              .asFunction<RecordStageNativeDart>();
+
+      _computeMaskSdf =
+          _lib!
+              .lookup<ffi.NativeFunction<ComputeMaskSdfNativeC>>(
+                'compute_mask_sdf_native',
+              )
+              .asFunction<ComputeMaskSdfNativeDart>();
+
+      _applyStickerMaskSdf =
+          _lib!
+              .lookup<ffi.NativeFunction<ApplyStickerMaskSdfNativeC>>(
+                'apply_sticker_mask_sdf_native',
+              )
+              .asFunction<ApplyStickerMaskSdfNativeDart>();
+
+      _applyStickerMaskSdfTo =
+          _lib!
+              .lookup<ffi.NativeFunction<ApplyStickerMaskSdfToNativeC>>(
+                'apply_sticker_mask_sdf_to_native',
+              )
+              .asFunction<ApplyStickerMaskSdfToNativeDart>();
+
+      _applyStickerMaskU8 =
+          _lib!
+              .lookup<ffi.NativeFunction<ApplyStickerMaskU8NativeC>>(
+                'apply_sticker_mask_u8',
+              )
+              .asFunction<ApplyStickerMaskU8NativeDart>();
+
+      _smoothMaskU8 =
+          _lib!
+              .lookup<ffi.NativeFunction<FilterMaskU8NativeC>>('smooth_mask_u8')
+              .asFunction<FilterMaskU8NativeDart>();
+
+      _expandMaskU8 =
+          _lib!
+              .lookup<ffi.NativeFunction<FilterMaskU8NativeC>>('expand_mask_u8')
+              .asFunction<FilterMaskU8NativeDart>();
+
+      _bitMaskCreate =
+          _lib!
+              .lookup<ffi.NativeFunction<BitMaskCreateNativeC>>(
+                'bit_mask_create',
+              )
+              .asFunction<BitMaskCreateNativeDart>();
+
+      _bitMaskDestroy =
+          _lib!
+              .lookup<ffi.NativeFunction<BitMaskDestroyNativeC>>(
+                'bit_mask_destroy',
+              )
+              .asFunction<BitMaskDestroyNativeDart>();
+
+      _expandMaskPacked =
+          _lib!
+              .lookup<ffi.NativeFunction<ExpandMaskPackedNativeC>>(
+                'expand_mask_packed',
+              )
+              .asFunction<ExpandMaskPackedNativeDart>();
+
+      _applyStickerMaskPacked =
+          _lib!
+              .lookup<ffi.NativeFunction<ApplyStickerMaskPackedNativeC>>(
+                'apply_sticker_mask_packed',
+              )
+              .asFunction<ApplyStickerMaskPackedNativeDart>();
+
+      _applyStickerMaskPackedTo =
+          _lib!
+              .lookup<ffi.NativeFunction<ApplyStickerMaskPackedToNativeC>>(
+                'apply_sticker_mask_packed_to',
+              )
+              .asFunction<ApplyStickerMaskPackedToNativeDart>();
+
+      _makeStickerMaskFused =
+          _lib!
+              .lookup<ffi.NativeFunction<MakeStickerMaskFusedNativeC>>(
+                'make_sticker_mask_fused',
+              )
+              .asFunction<MakeStickerMaskFusedNativeDart>();
+
+      _stickerStreamCreate =
+          _lib!
+              .lookup<ffi.NativeFunction<StickerStreamCreateNativeC>>(
+                'sticker_stream_create',
+              )
+              .asFunction<StickerStreamCreateNativeDart>();
+
+      _stickerStreamLag =
+          _lib!
+              .lookup<ffi.NativeFunction<StickerStreamLagNativeC>>(
+                'sticker_stream_lag',
+              )
+              .asFunction<StickerStreamLagNativeDart>();
+
+      _stickerStreamPush =
+          _lib!
+              .lookup<ffi.NativeFunction<StickerStreamPushNativeC>>(
+                'sticker_stream_push',
+              )
+              .asFunction<StickerStreamPushNativeDart>();
+
+      final stickerStreamDestroy = _lib!
+          .lookup<ffi.NativeFunction<StickerStreamDestroyNativeC>>(
+            'sticker_stream_destroy',
+          );
+      _stickerStreamDestroy =
+          stickerStreamDestroy.asFunction<StickerStreamDestroyNativeDart>();
+      _stickerStreamFinalizer = ffi.NativeFinalizer(
+        stickerStreamDestroy.cast(),
+      );
+
+      _resizeRgbaToNchw =
+          _lib!
+              .lookup<ffi.NativeFunction<ResizeRgbaToNchwNativeC>>(
+                'resize_rgba_to_nchw',
+              )
+              .asFunction<ResizeRgbaToNchwNativeDart>();
+
+      _upsampleMaskTensor =
+          _lib!
+              .lookup<ffi.NativeFunction<UpsampleMaskTensorNativeC>>(
+                'upsample_mask_tensor',
+              )
+              .asFunction<UpsampleMaskTensorNativeDart>();
+
+      _contentHash =
+          _lib!
+              .lookup<ffi.NativeFunction<ContentHashNativeC>>(
+                'mask_content_hash',
+              )
+              .asFunction<ContentHashNativeDart>();
+
+      _maskCacheOpen =
+          _lib!
+              .lookup<ffi.NativeFunction<MaskCacheOpenNativeC>>(
+                'mask_cache_open',
+              )
+              .asFunction<MaskCacheOpenNativeDart>();
+
+      _maskCacheGet =
+          _lib!
+              .lookup<ffi.NativeFunction<MaskCacheGetNativeC>>(
+                'mask_cache_get',
+              )
+              .asFunction<MaskCacheGetNativeDart>();
+
+      _maskCachePut =
+          _lib!
+              .lookup<ffi.NativeFunction<MaskCachePutNativeC>>(
+                'mask_cache_put',
+              )
+              .asFunction<MaskCachePutNativeDart>();
+
+      _maskCacheUsage =
+          _lib!
+              .lookup<ffi.NativeFunction<MaskCacheUsageNativeC>>(
+                'mask_cache_usage',
+              )
+              .asFunction<MaskCacheUsageNativeDart>();
+
+      final maskCacheClose = _lib!
+          .lookup<ffi.NativeFunction<MaskCacheCloseNativeC>>(
+            'mask_cache_close',
+          );
+      _maskCacheClose = maskCacheClose.asFunction<MaskCacheCloseNativeDart>();
+      _maskCacheFinalizer = ffi.NativeFinalizer(maskCacheClose.cast());
+
+      _stickerSessionCreate =
+          _lib!
+              .lookup<ffi.NativeFunction<StickerSessionCreateNativeC>>(
+                'sticker_session_create',
+              )
+              .asFunction<StickerSessionCreateNativeDart>();
+
+      _stickerSessionPixels =
+          _lib!
+              .lookup<ffi.NativeFunction<StickerSessionPixelsNativeC>>(
+                'sticker_session_pixels',
+              )
+              .asFunction<StickerSessionPixelsNativeDart>();
+
+      _stickerSessionSetBorderColor =
+          _lib!
+              .lookup<ffi.NativeFunction<StickerSessionSetBorderColorNativeC>>(
+                'sticker_session_set_border_color',
+              )
+              .asFunction<StickerSessionSetBorderColorNativeDart>();
+
+      _stickerSessionSetBorderWidth =
+          _lib!
+              .lookup<ffi.NativeFunction<StickerSessionSetBorderWidthNativeC>>(
+                'sticker_session_set_border_width',
+              )
+              .asFunction<StickerSessionSetBorderWidthNativeDart>();
+
+      _stickerSessionSetAddBorder =
+          _lib!
+              .lookup<ffi.NativeFunction<StickerSessionSetAddBorderNativeC>>(
+                'sticker_session_set_add_border',
+              )
+              .asFunction<StickerSessionSetAddBorderNativeDart>();
+
+      final stickerSessionDestroy = _lib!
+          .lookup<ffi.NativeFunction<StickerSessionDestroyNativeC>>(
+            'sticker_session_destroy',
+          );
+      _stickerSessionDestroy =
+          stickerSessionDestroy.asFunction<StickerSessionDestroyNativeDart>();
+      _stickerSessionFinalizer = ffi.NativeFinalizer(
+        stickerSessionDestroy.cast(),
+      );
+
+      _contextCreate =
+          _lib!
+              .lookup<ffi.NativeFunction<MaskProcessorContextCreateNativeC>>(
+                'mask_processor_context_create',
+              )
+              .asFunction<MaskProcessorContextCreateNativeDart>();
+
+      _contextTrim =
+          _lib!
+              .lookup<ffi.NativeFunction<MaskProcessorContextReleaseNativeC>>(
+                'mask_processor_context_trim',
+              )
+              .asFunction<MaskProcessorContextReleaseNativeDart>();
+
+      _contextHeapAllocations =
+          _lib!
+              .lookup<
+                ffi.NativeFunction<MaskProcessorContextHeapAllocationsNativeC>
+              >('mask_processor_context_heap_allocations')
+              .asFunction<MaskProcessorContextHeapAllocationsNativeDart>();
+
+      _contextReservedBytes =
+          _lib!
+              .lookup<
+                ffi.NativeFunction<MaskProcessorContextReservedBytesNativeC>
+              >('mask_processor_context_reserved_bytes')
+              .asFunction<MaskProcessorContextReservedBytesNativeDart>();
+
+      _contextStaging =
+          _lib!
+              .lookup<ffi.NativeFunction<MaskProcessorContextStagingNativeC>>(
+                'mask_processor_context_staging',
+              )
+              .asFunction<MaskProcessorContextStagingNativeDart>();
+
+      final contextDestroy = _lib!
+          .lookup<ffi.NativeFunction<MaskProcessorContextReleaseNativeC>>(
+            'mask_processor_context_destroy',
+          );
+      _contextDestroy =
+          contextDestroy.asFunction<MaskProcessorContextReleaseNativeDart>();
+      _contextFinalizer = ffi.NativeFinalizer(contextDestroy.cast());
+
+      _smoothMaskCtx =
+          _lib!
+              .lookup<ffi.NativeFunction<FilterMaskCtxNativeC>>(
+                'smooth_mask_ctx',
+              )
+              .asFunction<FilterMaskCtxNativeDart>();
+
+      _expandMaskCtx =
+          _lib!
+              .lookup<ffi.NativeFunction<FilterMaskCtxNativeC>>(
+                'expand_mask_ctx',
+              )
+              .asFunction<FilterMaskCtxNativeDart>();
+
+      _computeMaskSdfCtx =
+          _lib!
+              .lookup<ffi.NativeFunction<ComputeMaskSdfCtxNativeC>>(
+                'compute_mask_sdf_ctx',
+              )
+              .asFunction<ComputeMaskSdfCtxNativeDart>();
+
+      _makeStickerMaskFusedCtx =
+          _lib!
+              .lookup<ffi.NativeFunction<MakeStickerMaskFusedCtxNativeC>>(
+                'make_sticker_mask_fused_ctx',
+              )
+              .asFunction<MakeStickerMaskFusedCtxNativeDart>();
+
+      _resizeRgbaToNchwCtx =
+          _lib!
+              .lookup<ffi.NativeFunction<ResizeRgbaToNchwCtxNativeC>>(
+                'resize_rgba_to_nchw_ctx',
+              )
+              .asFunction<ResizeRgbaToNchwCtxNativeDart>();
+
+      _upsampleMaskTensorCtx =
+          _lib!
+              .lookup<ffi.NativeFunction<UpsampleMaskTensorCtxNativeC>>(
+                'upsample_mask_tensor_ctx',
+              )
+              .asFunction<UpsampleMaskTensorCtxNativeDart>();
+
+      _makeStickersBatch =
+          _lib!
+              .lookup<ffi.NativeFunction<MakeStickersBatchNativeC>>(
+                'make_stickers_batch',
+              )
+              .asFunction<MakeStickersBatchNativeDart>();
+
+      _makeStickersBatchCtx =
+          _lib!
+              .lookup<ffi.NativeFunction<MakeStickersBatchCtxNativeC>>(
+                'make_stickers_batch_ctx',
+              )
+              .asFunction<MakeStickersBatchCtxNativeDart>();
+
+      // Jobs post their completion through the VM's Dart_PostCObject
+      _maskJobsInit =
+          _lib!
+              .lookup<ffi.NativeFunction<MaskJobsInitNativeC>>(
+                'mask_jobs_init',
+              )
+              .asFunction<MaskJobsInitNativeDart>();
+      _maskJobsInit!(ffi.NativeApi.postCObject.cast());
+
+      _maskJobCancel =
+          _lib!
+              .lookup<ffi.NativeFunction<MaskJobCancelNativeC>>(
+                'mask_job_cancel',
+              )
+              .asFunction<MaskJobCancelNativeDart>();
+
+      _makeStickerMaskFusedAsync =
+          _lib!
+              .lookup<ffi.NativeFunction<MakeStickerMaskFusedAsyncNativeC>>(
+                'make_sticker_mask_fused_async',
+              )
+              .asFunction<MakeStickerMaskFusedAsyncNativeDart>();
+
+      _smoothMaskAsync =
+          _lib!
+              .lookup<ffi.NativeFunction<FilterMaskAsyncNativeC>>(
+                'smooth_mask_async',
+              )
+              .asFunction<FilterMaskAsyncNativeDart>();
+
+      _expandMaskAsync =
+          _lib!
+              .lookup<ffi.NativeFunction<FilterMaskAsyncNativeC>>(
+                'expand_mask_async',
+              )
+              .asFunction<FilterMaskAsyncNativeDart>();
+
+      _computeMaskSdfAsync =
+          _lib!
+              .lookup<ffi.NativeFunction<ComputeMaskSdfAsyncNativeC>>(
+                'compute_mask_sdf_async',
+              )
+              .asFunction<ComputeMaskSdfAsyncNativeDart>();
+
+      _applyStickerMaskSdfAsync =
+          _lib!
+              .lookup<ffi.NativeFunction<ApplyStickerMaskSdfAsyncNativeC>>(
+                'apply_sticker_mask_sdf_async',
+              )
+              .asFunction<ApplyStickerMaskSdfAsyncNativeDart>();
+
+      _resizeRgbaToNchwAsync =
+          _lib!
+              .lookup<ffi.NativeFunction<ResizeRgbaToNchwAsyncNativeC>>(
+                'resize_rgba_to_nchw_async',
+              )
+              .asFunction<ResizeRgbaToNchwAsyncNativeDart>();
+
+      _upsampleMaskTensorAsync =
+          _lib!
+              .lookup<ffi.NativeFunction<UpsampleMaskTensorAsyncNativeC>>(
+                'upsample_mask_tensor_async',
+              )
+              .asFunction<UpsampleMaskTensorAsyncNativeDart>();
+
+      _stickerSessionCreateAsync =
+          _lib!
+              .lookup<ffi.NativeFunction<StickerSessionCreateAsyncNativeC>>(
+                'sticker_session_create_async',
+              )
+              .asFunction<StickerSessionCreateAsyncNativeDart>();
+
+      _maskCachePutAsync =
+          _lib!
+              .lookup<ffi.NativeFunction<MaskCachePutAsyncNativeC>>(
+                'mask_cache_put_async',
+              )
+              .asFunction<MaskCachePutAsyncNativeDart>();
+
+      _available = true;
+    } catch (e) {
+      _available = false;
+    }
+
+    _initialized = true;
+    return _available;
+  }
+
+  /// Check if native processing is available
+  static bool get isAvailable => _available;
+
+  /// Instruction set the native kernels dispatch to (see [MaskProcessorIsa])
+  static int get activeIsa {
+    if (!_available || _getActiveIsa == null) {
+      return MaskProcessorIsa.scalar;
+    }
+    return _getActiveIsa!();
+  }
+
+  /// Number of threads the native kernels split their work across
+  static int get threadCount {
+    if (!_available || _getThreadCount == null) {
+      return 1;
+    }
+    return _getThreadCount!();
+  }
+
+  /// Set the native thread count; 0 uses one thread per online CPU.
+  ///
+  /// Output is identical for every thread count.
+  static int setThreadCount(int threadCount) {
+    if (!_available || _setThreadCount == null) {
+      return MaskProcessorResult.errorProcessing;
+    }
+    return _setThreadCount!(threadCount);
+  }
+
+  /// Turn cache-blocked tiling in the native kernels on or off.
+  ///
+  /// Tiling is on by default and does not change the output.
+  @visibleForTesting
+  static void setTiling(bool enabled) {
+    if (!_available || _setTiling == null) return;
+    _setTiling!(enabled ? 1 : 0);
+  }
+
+  /// Cache size in bytes the native tiles are sized for
+  static int get cacheSize {
+    if (!_available || _getCacheSize == null) return 0;
+    return _getCacheSize!();
+  }
+
+  /// Size native tiles for [bytes] of cache; 0 uses the detected L2 size.
+  @visibleForTesting
+  static void setCacheSize(int bytes) {
+    if (!_available || _setCacheSize == null) return;
+    _setCacheSize!(bytes);
+  }
+
+  /// Start perf event counters on the calling thread (Linux and Android).
+  ///
+  /// Only the calling thread is counted, so benchmarks should run with
+  /// [setThreadCount] 1. Returns false if no counter could be opened.
+  @visibleForTesting
+  static bool startPerfCounters() {
+    if (!_available || _perfCountersStart == null) return false;
+    return _perfCountersStart!() == MaskProcessorResult.success;
+  }
+
+  /// Stop the counters from [startPerfCounters] and read them.
+  ///
+  /// Counters the device does not provide are -1.
+  @visibleForTesting
+  static Map<String, int>? stopPerfCounters() {
+    if (!_available || _perfCountersStop == null) return null;
+
+    return using((arena) {
+      final counters = arena.allocate<MaskPerfCounters>(
+        ffi.sizeOf<MaskPerfCounters>(),
+      );
+      if (_perfCountersStop!(counters) != MaskProcessorResult.success) {
+        return null;
+      }
+      return {
+        'taskClockNs': counters.ref.taskClockNs,
+        'cycles': counters.ref.cycles,
+        'instructions': counters.ref.instructions,
+        'cacheReferences': counters.ref.cacheReferences,
+        'cacheMisses': counters.ref.cacheMisses,
+        'l1dReadMisses': counters.ref.l1dReadMisses,
+      };
+    });
+  }
+
+  /// Statistics of every [MaskStage] since start or [resetStats], indexed
+  /// by stage; null without native support.
+  ///
+  /// Every native kernel records its calls, timed at the outermost one on
+  /// its thread so stages never overlap. [recordStage] adds the stages that
+  /// run in Dart, such as inference and encoding.
+  static List<NativeStageStats>? getStats() {
+    if (!_available || _getStats == null) return null;
+
+    return using((arena) {
+      final stats = arena.allocate<MaskProcessorStats>(
+        ffi.sizeOf<MaskProcessorStats>(),
+      );
+      if (_getStats!(stats) != MaskProcessorResult.success) {
+        return null;
+      }
+      return List.generate(
+        MaskStage.count,
+        (stage) => NativeStageStats._(stage, stats.ref.stages[stage]),
+      );
+    });
+  }
+
+  /// Clear the statistics of every stage
+  static void resetStats() {
+    if (!_available || _resetStats == null) return;
+    _resetStats!();
+  }
+
+  /// Record a call to [stage] that took [elapsed] and moved [bytes]
+  static void recordStage(int stage, Duration elapsed, {int bytes = 0}) {
+    if (!_available || _recordStage == null) return;
+    _recordStage!(stage, elapsed.inMicroseconds * 1000, bytes);
+  }
+
+  /// Allocate a byte buffer in native memory.
+  ///
+  /// Buffers from the allocate methods are passed to the native kernels
+  /// without copying. The memory is freed when the list is garbage collected.
+  static Uint8List allocateUint8(int length) {
+    if (length <= 0) return Uint8List(0);
+    final pointer = malloc.allocate<ffi.Uint8>(length);
+    final list = pointer.asTypedList(length, finalizer: malloc.nativeFree);
+    _nativeBuffers[list] = pointer.cast();
+    return list;
+  }
+
+  /// Allocate a double buffer in native memory (see [allocateUint8])
+  static Float64List allocateFloat64(int length) {
+    if (length <= 0) return Float64List(0);
+    final pointer = malloc.allocate<ffi.Double>(
+      length * ffi.sizeOf<ffi.Double>(),
+    );
+    final list = pointer.asTypedList(length, finalizer: malloc.nativeFree);
+    _nativeBuffers[list] = pointer.cast();
+    return list;
+  }
+
+  /// Allocate a float buffer in native memory (see [allocateUint8])
+  static Float32List allocateFloat32(int length) {
+    if (length <= 0) return Float32List(0);
+    final pointer = malloc.allocate<ffi.Float>(
+      length * ffi.sizeOf<ffi.Float>(),
+    );
+    final list = pointer.asTypedList(length, finalizer: malloc.nativeFree);
+    _nativeBuffers[list] = pointer.cast();
+    return list;
+  }
+
+  /// Pointer for [data]: its own memory when it came from [allocateUint8],
+  /// otherwise a copy staged in [arena] ([copyIn] false skips the copy for
+  /// output-only buffers).
+  static ffi.Pointer<ffi.Uint8> _stageUint8(
+    Uint8List data,
+    ffi.Allocator arena, {
+    bool copyIn = true,
+  }) {
+    final address = _nativeBuffers[data];
+    if (address != null) return address.cast();
+
+    final staged = arena.allocate<ffi.Uint8>(data.length);
+    if (copyIn) staged.asTypedList(data.length).setAll(0, data);
+    return staged;
+  }
+
+  static ffi.Pointer<ffi.Double> _stageFloat64(
+    List<double> data,
+    ffi.Allocator arena, {
+    bool copyIn = true,
+  }) {
+    final address = data is Float64List ? _nativeBuffers[data] : null;
+    if (address != null) return address.cast();
+
+    final staged = arena.allocate<ffi.Double>(
+      data.length * ffi.sizeOf<ffi.Double>(),
+    );
+    if (copyIn) staged.asTypedList(data.length).setAll(0, data);
+    return staged;
+  }
+
+  static ffi.Pointer<ffi.Float> _stageFloat32(
+    Float32List data,
+    ffi.Allocator arena, {
+    bool copyIn = true,
+  }) {
+    final address = _nativeBuffers[data];
+    if (address != null) return address.cast();
+
+    final staged = arena.allocate<ffi.Float>(
+      data.length * ffi.sizeOf<ffi.Float>(),
+    );
+    if (copyIn) staged.asTypedList(data.length).setAll(0, data);
+    return staged;
+  }
+
+  /// Copy a staged output back into [data]; no-op for native buffers
+  static void _unstageUint8(Uint8List data, ffi.Pointer<ffi.Uint8> staged) {
+    if (staged != _nativeBuffers[data]) {
+      data.setAll(0, staged.asTypedList(data.length));
+    }
+  }
+
+  static void _unstageFloat64(
+    List<double> data,
+    ffi.Pointer<ffi.Double> staged,
+  ) {
+    if (data is! Float64List || staged != _nativeBuffers[data]) {
+      data.setAll(0, staged.asTypedList(data.length));
+    }
+  }
+
+  static void _unstageFloat32(Float32List data, ffi.Pointer<ffi.Float> staged) {
+    if (staged != _nativeBuffers[data]) {
+      data.setAll(0, staged.asTypedList(data.length));
+    }
+  }
+
+  /// [using], or the staging memory of [context] when given
+  static R _withStaging<R>(
+    NativeMaskProcessorContext? context,
+    R Function(ffi.Allocator arena) body,
+  ) {
+    if (context == null) return using(body);
+    return context._staging.run(body);
+  }
+
+  static RGBColor _borderColor(List<int> borderColorRgb, ffi.Allocator arena) {
+    final color = arena.allocate<RGBColor>(ffi.sizeOf<RGBColor>());
+    color.ref.r = borderColorRgb[0];
+    color.ref.g = borderColorRgb[1];
+    color.ref.b = borderColorRgb[2];
+    return color.ref;
+  }
+
+  /// Queue a native job and complete with its result code.
+  ///
+  /// [submit] stages the arguments in the job's arena and passes them, with
+  /// the job's port, id and state, to one of the *_async functions. Staged
+  /// outputs are copied back by [_NativeJob.onSuccess] when the job
+  /// succeeds, and the arena is freed once it is done.
+  static Future<int> _runJob(
+    String name,
+    NativeMaskProcessorContext? context,
+    NativeJobControl? control,
+    List<Object?> buffers,
+    int Function(_NativeJob job) submit,
+  ) {
+    if (control != null && control.isCancelled) {
+      return Future.value(MaskProcessorResult.errorCancelled);
+    }
+
+    final port = _jobPort ??= RawReceivePort(_completeJob, 'NativeMaskJobs');
+    final job = _NativeJob(
+      _nextJobId++,
+      port.sendPort.nativePort,
+      context,
+      control,
+      buffers,
+    );
+
+    int queued;
+    try {
+      queued = submit(job);
+    } catch (e) {
+      if (kDebugMode) {
+        debugPrint('Error in $name: $e');
+      }
+      queued = MaskProcessorResult.errorProcessing;
+    }
+    if (queued != MaskProcessorResult.success) {
+      job.arena.releaseAll();
+      _closeIdleJobPort();
+      return Future.value(queued);
+    }
+
+    // Completions are delivered by the event loop, never before this returns
+    _jobs[job.id] = job;
+    context?._jobStarted();
+    control?._jobStarted(job);
+    return job.completer.future;
+  }
+
+  static void _completeJob(Object? message) {
+    final job = _jobs.remove(message);
+    if (job == null) return;
+
+    var result = job.state.ref.result;
+    job.control?._jobEnded(job);
+    if (result == MaskProcessorResult.success && job.onSuccess != null) {
+      try {
+        job.onSuccess!();
+      } catch (e) {
+        if (kDebugMode) {
+          debugPrint('Error completing native job: $e');
+        }
+        result = MaskProcessorResult.errorProcessing;
+      }
+    }
+    job.arena.releaseAll();
+    job.context?._jobEnded();
+    _closeIdleJobPort();
+    job.completer.complete(result);
+  }
+
+  static void _cancelJob(_NativeJob job) {
+    _maskJobCancel?.call(job.state);
+  }
+
+  // The port would otherwise keep the isolate alive
+  static void _closeIdleJobPort() {
+    if (_jobs.isNotEmpty) return;
+    _jobPort?.close();
+    _jobPort = null;
+  }
+
+  /// Apply sticker mask effects using native code.
+  ///
+  /// With [source], pixels are read from [source] and the result is written
+  /// to [pixels], so the caller does not have to copy them first.
+  static int applyStickerMask(
+    Uint8List pixels,
+    List<double> mask,
+    int width,
+    int height,
+    bool addBorder,
+    List<int> borderColorRgb,
+    int borderWidth,
+    List<double>? expandedMask, {
+    Uint8List? source,
+  }) {
+    return _applyStickerMaskWith(
+      _applyStickerMaskOptimized,
+      pixels,
+      mask,
+      width,
+      height,
+      addBorder,
+      borderColorRgb,
+      borderWidth,
+      expandedMask,
+      source,
+    );
+  }
+
+  /// Apply sticker mask effects using the scalar reference kernel.
+  ///
+  /// Used by benchmarks to compare the SIMD path against the plain C loop.
+  @visibleForTesting
+  static int applyStickerMaskScalar(
+    Uint8List pixels,
+    List<double> mask,
+    int width,
+    int height,
+    bool addBorder,
+    List<int> borderColorRgb,
+    int borderWidth,
+    List<double>? expandedMask,
+  ) {
+    return _applyStickerMaskWith(
+      _applyStickerMaskNative,
+      pixels,
+      mask,
+      width,
+      height,
+      addBorder,
+      borderColorRgb,
+      borderWidth,
+      expandedMask,
+      null,
+    );
+  }
+
+  static int _applyStickerMaskWith(
+    ApplyStickerMaskNativeDart? applyStickerMask,
+    Uint8List pixels,
+    List<double> mask,
+    int width,
+    int height,
+    bool addBorder,
+    List<int> borderColorRgb,
+    int borderWidth,
+    List<double>? expandedMask,
+    Uint8List? source,
+  ) {
+    if (!_available ||
+        applyStickerMask == null ||
+        (source != null && _applyStickerMaskToOptimized == null)) {
+      return MaskProcessorResult.errorProcessing;
+    }
+
+    // Validate input parameters
+    if (pixels.isEmpty || mask.isEmpty || width <= 0 || height <= 0) {
+      return MaskProcessorResult.errorInvalidParams;
+    }
+
+    // Validate array sizes
+    final expectedPixelCount = width * height * 4; // RGBA
+    final expectedMaskCount = width * height;
+
+    if (pixels.length != expectedPixelCount ||
+        mask.length != expectedMaskCount ||
+        (source != null && source.length != expectedPixelCount) ||
+        (expandedMask != null &&
+            expandedMask.isNotEmpty &&
+            expandedMask.length != expectedMaskCount)) {
+      return MaskProcessorResult.errorInvalidParams;
+    }
+
+    try {
+      return using((arena) {
+        final maskPtr = _stageFloat64(mask, arena);
+        final expandedMaskPtr =
+            expandedMask != null && expandedMask.isNotEmpty
+                ? _stageFloat64(expandedMask, arena)
+                : ffi.nullptr.cast<ffi.Double>();
+        final borderColor = _borderColor(borderColorRgb, arena);
+
+        final int result;
+        final ffi.Pointer<ffi.Uint8> pixelsPtr;
+        if (source != null) {
+          // Out-of-place: pixels is output only
+          pixelsPtr = _stageUint8(pixels, arena, copyIn: false);
+          result = _applyStickerMaskToOptimized!(
+            _stageUint8(source, arena),
+            pixelsPtr,
+            maskPtr,
+            width,
+            height,
+            addBorder ? 1 : 0,
+            borderColor,
+            borderWidth,
+            expandedMaskPtr,
+          );
+        } else {
+          pixelsPtr = _stageUint8(pixels, arena);
+          result = applyStickerMask(
+            pixelsPtr,
+            maskPtr,
+            width,
+            height,
+            addBorder ? 1 : 0,
+            borderColor,
+            borderWidth,
+            expandedMaskPtr,
+          );
+        }
+
+        if (result == MaskProcessorResult.success) {
+          _unstageUint8(pixels, pixelsPtr);
+        }
+        return result;
+      });
+    } catch (e) {
+      if (kDebugMode) {
+        debugPrint('Error in applyStickerMask: $e');
+      }
+      return MaskProcessorResult.errorProcessing;
+    }
+  }
+
+  /// Smooth mask using native code
+  ///
+  /// With [context], scratch memory comes from the context (see
+  /// [NativeMaskProcessorContext]); the same holds for the other methods
+  /// that take one.
+  static int smoothMask(
+    List<double> mask,
+    List<double> output,
+    int width,
+    int height,
+    int kernelSize, {
+    NativeMaskProcessorContext? context,
+  }) {
+    return _filterMask(
+      _smoothMaskOptimized,
+      _smoothMaskCtx,
+      'smoothMask',
+      mask,
+      output,
+      width,
+      height,
+      kernelSize,
+      context,
+    );
+  }
+
+  /// Expand mask using native code
+  static int expandMask(
+    List<double> mask,
+    List<double> output,
+    int width,
+    int height,
+    int borderWidth, {
+    NativeMaskProcessorContext? context,
+  }) {
+    return _filterMask(
+      _expandMaskOptimized,
+      _expandMaskCtx,
+      'expandMask',
+      mask,
+      output,
+      width,
+      height,
+      borderWidth,
+      context,
+    );
+  }
+
+  /// Shared by smooth_mask_optimized and expand_mask_optimized, which have
+  /// the same signature, and by their context variants
+  static int _filterMask(
+    SmoothMaskNativeDart? filter,
+    FilterMaskCtxNativeDart? contextFilter,
+    String name,
+    List<double> mask,
+    List<double> output,
+    int width,
+    int height,
+    int size,
+    NativeMaskProcessorContext? context,
+  ) {
+    if (!_available || filter == null) {
+      return MaskProcessorResult.errorProcessing;
+    }
+
+    // Validate input parameters
+    if (mask.isEmpty || output.isEmpty || width <= 0 || height <= 0) {
+      return MaskProcessorResult.errorInvalidParams;
+    }
+
+    // Validate array sizes
+    final expectedSize = width * height;
+    if (mask.length != expectedSize || output.length != expectedSize) {
+      return MaskProcessorResult.errorInvalidParams;
+    }
+
+    try {
+      return _withStaging(context, (arena) {
+        final maskPtr = _stageFloat64(mask, arena);
+        final outputPtr = _stageFloat64(output, arena, copyIn: false);
+
+        final result = context != null
+            ? contextFilter!(
+                context._pointer,
+                maskPtr,
+                outputPtr,
+                width,
+                height,
+                size,
+              )
+            : filter(maskPtr, outputPtr, width, height, size);
+
+        if (result == MaskProcessorResult.success) {
+          _unstageFloat64(output, outputPtr);
+        }
+        return result;
+      });
+    } catch (e) {
+      if (kDebugMode) {
+        debugPrint('Error in $name: $e');
+      }
+      return MaskProcessorResult.errorProcessing;
+    }
+  }
+
+  /// [smoothMask] run off the calling thread.
+  ///
+  /// A native job thread does the work and the future completes with the
+  /// result code, so the calling isolate keeps running meanwhile. Lists
+  /// from the allocate methods are used in place and must not be touched
+  /// until then; other lists are copied in now and out on completion. A
+  /// [control] can cancel the job or follow its progress. The same holds
+  /// for the other async methods. Jobs run one after another in submission
+  /// order, each on the full thread pool.
+  static Future<int> smoothMaskAsync(
+    List<double> mask,
+    List<double> output,
+    int width,
+    int height,
+    int kernelSize, {
+    NativeMaskProcessorContext? context,
+    NativeJobControl? control,
+  }) {
+    return _filterMaskAsync(
+      _smoothMaskAsync,
+      'smoothMaskAsync',
+      mask,
+      output,
+      width,
+      height,
+      kernelSize,
+      context,
+      control,
+    );
+  }
+
+  /// [expandMask] run off the calling thread (see [smoothMaskAsync])
+  static Future<int> expandMaskAsync(
+    List<double> mask,
+    List<double> output,
+    int width,
+    int height,
+    int borderWidth, {
+    NativeMaskProcessorContext? context,
+    NativeJobControl? control,
+  }) {
+    return _filterMaskAsync(
+      _expandMaskAsync,
+      'expandMaskAsync',
+      mask,
+      output,
+      width,
+      height,
+      borderWidth,
+      context,
+      control,
+    );
+  }
+
+  static Future<int> _filterMaskAsync(
+    FilterMaskAsyncNativeDart? filter,
+    String name,
+    List<double> mask,
+    List<double> output,
+    int width,
+    int height,
+    int size,
+    NativeMaskProcessorContext? context,
+    NativeJobControl? control,
+  ) {
+    if (!_available || filter == null) {
+      return Future.value(MaskProcessorResult.errorProcessing);
+    }
+
+    // Validate input parameters
+    if (mask.isEmpty || output.isEmpty || width <= 0 || height <= 0) {
+      return Future.value(MaskProcessorResult.errorInvalidParams);
+    }
+
+    // Validate array sizes
+    final expectedSize = width * height;
+    if (mask.length != expectedSize || output.length != expectedSize) {
+      return Future.value(MaskProcessorResult.errorInvalidParams);
+    }
+
+    return _runJob(name, context, control, [mask, output], (job) {
+      final maskPtr = _stageFloat64(mask, job.arena);
+      final outputPtr = _stageFloat64(output, job.arena, copyIn: false);
+      job.onSuccess = () => _unstageFloat64(output, outputPtr);
+
+      return filter(
+        job.port,
+        job.id,
+        job.state,
+        context?._pointer ?? ffi.nullptr,
+        maskPtr,
+        outputPtr,
+        width,
+        height,
+        size,
+      );
+    });
+  }
+
+  /// Compute the signed distance field of a mask using native code.
+  ///
+  /// Values are positive outside the mask and negative inside, and
+  /// infinite when the mask has no foreground (or no background) pixel.
+  /// Any border width can then be applied with [applyStickerMaskSdf]
+  /// without re-expanding the mask.
+  static int computeMaskSdf(
+    List<double> mask,
+    Float32List sdf,
+    int width,
+    int height, {
+    NativeMaskProcessorContext? context,
+  }) {
+    if (!_available || _computeMaskSdf == null) {
+      return MaskProcessorResult.errorProcessing;
+    }
+
+    // Validate input parameters
+    if (mask.isEmpty || sdf.isEmpty || width <= 0 || height <= 0) {
+      return MaskProcessorResult.errorInvalidParams;
+    }
+
+    // Validate array sizes
+    final expectedSize = width * height;
+    if (mask.length != expectedSize || sdf.length != expectedSize) {
+      return MaskProcessorResult.errorInvalidParams;
+    }
+
+    try {
+      return _withStaging(context, (arena) {
+        final maskPtr = _stageFloat64(mask, arena);
+        final sdfPtr = _stageFloat32(sdf, arena, copyIn: false);
+
+        final result = context != null
+            ? _computeMaskSdfCtx!(
+                context._pointer,
+                maskPtr,
+                sdfPtr,
+                width,
+                height,
+              )
+            : _computeMaskSdf!(maskPtr, sdfPtr, width, height);
+
+        if (result == MaskProcessorResult.success) {
+          _unstageFloat32(sdf, sdfPtr);
+        }
+        return result;
+      });
+    } catch (e) {
+      if (kDebugMode) {
+        debugPrint('Error in computeMaskSdf: $e');
+      }
+      return MaskProcessorResult.errorProcessing;
+    }
+  }
+
+  /// [computeMaskSdf] run off the calling thread (see [smoothMaskAsync])
+  static Future<int> computeMaskSdfAsync(
+    List<double> mask,
+    Float32List sdf,
+    int width,
+    int height, {
+    NativeMaskProcessorContext? context,
+    NativeJobControl? control,
+  }) {
+    if (!_available || _computeMaskSdfAsync == null) {
+      return Future.value(MaskProcessorResult.errorProcessing);
+    }
+
+    // Validate input parameters
+    if (mask.isEmpty || sdf.isEmpty || width <= 0 || height <= 0) {
+      return Future.value(MaskProcessorResult.errorInvalidParams);
+    }
+
+    // Validate array sizes
+    final expectedSize = width * height;
+    if (mask.length != expectedSize || sdf.length != expectedSize) {
+      return Future.value(MaskProcessorResult.errorInvalidParams);
+    }
+
+    return _runJob('computeMaskSdfAsync', context, control, [mask, sdf], (job) {
+      final maskPtr = _stageFloat64(mask, job.arena);
+      final sdfPtr = _stageFloat32(sdf, job.arena, copyIn: false);
+      job.onSuccess = () => _unstageFloat32(sdf, sdfPtr);
+
+      return _computeMaskSdfAsync!(
+        job.port,
+        job.id,
+        job.state,
+        context?._pointer ?? ffi.nullptr,
+        maskPtr,
+        sdfPtr,
+        width,
+        height,
+      );
+    });
+  }
+
+  /// Apply sticker mask effects with the border taken from a signed distance
+  /// field produced by [computeMaskSdf].
+  ///
+  /// The border covers the background within [borderWidth] of the mask, the
+  /// same disc as [makeStickerMaskFused] paints at an integer width.
+  ///
+  /// With [source], pixels are read from [source] and written to [pixels].
+  static int applyStickerMaskSdf(
+    Uint8List pixels,
+    List<double> mask,
+    Float32List sdf,
+    int width,
+    int height,
+    bool addBorder,
+    List<int> borderColorRgb,
+    double borderWidth, {
+    Uint8List? source,
+  }) {
+    if (!_available ||
+        _applyStickerMaskSdf == null ||
+        (source != null && _applyStickerMaskSdfTo == null)) {
+      return MaskProcessorResult.errorProcessing;
+    }
+
+    // Validate input parameters
+    if (pixels.isEmpty || mask.isEmpty || width <= 0 || height <= 0) {
+      return MaskProcessorResult.errorInvalidParams;
+    }
+
+    // Validate array sizes
+    final expectedMaskCount = width * height;
+    if (pixels.length != expectedMaskCount * 4 ||
+        mask.length != expectedMaskCount ||
+        sdf.length != expectedMaskCount ||
+        (source != null && source.length != pixels.length)) {
+      return MaskProcessorResult.errorInvalidParams;
+    }
+
+    try {
+      return using((arena) {
+        final maskPtr = _stageFloat64(mask, arena);
+        final sdfPtr = _stageFloat32(sdf, arena);
+        final borderColor = _borderColor(borderColorRgb, arena);
+
+        final int result;
+        final ffi.Pointer<ffi.Uint8> pixelsPtr;
+        if (source != null) {
+          pixelsPtr = _stageUint8(pixels, arena, copyIn: false);
+          result = _applyStickerMaskSdfTo!(
+            _stageUint8(source, arena),
+            pixelsPtr,
+            maskPtr,
+            sdfPtr,
+            width,
+            height,
+            addBorder ? 1 : 0,
+            borderColor,
+            borderWidth,
+          );
+        } else {
+          pixelsPtr = _stageUint8(pixels, arena);
+          result = _applyStickerMaskSdf!(
+            pixelsPtr,
+            maskPtr,
+            sdfPtr,
+            width,
+            height,
+            addBorder ? 1 : 0,
+            borderColor,
+            borderWidth,
+          );
+        }
+
+        if (result == MaskProcessorResult.success) {
+          _unstageUint8(pixels, pixelsPtr);
+        }
+        return result;
+      });
+    } catch (e) {
+      if (kDebugMode) {
+        debugPrint('Error in applyStickerMaskSdf: $e');
+      }
+      return MaskProcessorResult.errorProcessing;
+    }
+  }
+
+  /// [applyStickerMaskSdf] run off the calling thread (see
+  /// [smoothMaskAsync])
+  static Future<int> applyStickerMaskSdfAsync(
+    Uint8List pixels,
+    List<double> mask,
+    Float32List sdf,
+    int width,
+    int height,
+    bool addBorder,
+    List<int> borderColorRgb,
+    double borderWidth, {
+    Uint8List? source,
+    NativeJobControl? control,
+  }) {
+    if (!_available || _applyStickerMaskSdfAsync == null) {
+      return Future.value(MaskProcessorResult.errorProcessing);
+    }
+
+    // Validate input parameters
+    if (pixels.isEmpty || mask.isEmpty || width <= 0 || height <= 0) {
+      return Future.value(MaskProcessorResult.errorInvalidParams);
+    }
+
+    // Validate array sizes
+    final expectedMaskCount = width * height;
+    if (pixels.length != expectedMaskCount * 4 ||
+        mask.length != expectedMaskCount ||
+        sdf.length != expectedMaskCount ||
+        (source != null && source.length != pixels.length)) {
+      return Future.value(MaskProcessorResult.errorInvalidParams);
+    }
+
+    final buffers = [pixels, mask, sdf, source];
+    return _runJob('applyStickerMaskSdfAsync', null, control, buffers, (job) {
+      final maskPtr = _stageFloat64(mask, job.arena);
+      final sdfPtr = _stageFloat32(sdf, job.arena);
+      final pixelsPtr = _stageUint8(
+        pixels,
+        job.arena,
+        copyIn: source == null,
+      );
+      final sourcePtr =
+          source != null ? _stageUint8(source, job.arena) : pixelsPtr;
+      job.onSuccess = () => _unstageUint8(pixels, pixelsPtr);
+
+      return _applyStickerMaskSdfAsync!(
+        job.port,
+        job.id,
+        job.state,
+        sourcePtr,
+        pixelsPtr,
+        maskPtr,
+        sdfPtr,
+        width,
+        height,
+        addBorder ? 1 : 0,
+        _borderColor(borderColorRgb, job.arena),
+        borderWidth,
+      );
+    });
+  }
+
+  /// Apply sticker mask effects with the border expanded into a packed
+  /// 1-bit mask that never leaves native memory.
+  ///
+  /// Same output as [expandMask] followed by [applyStickerMask]. With
+  /// [source], pixels are read from [source] and written to [pixels].
+  static int applyStickerMaskPacked(
+    Uint8List pixels,
+    List<double> mask,
+    int width,
+    int height,
+    bool addBorder,
+    List<int> borderColorRgb,
+    int borderWidth, {
+    Uint8List? source,
+  }) {
+    if (!_available ||
+        _bitMaskCreate == null ||
+        _bitMaskDestroy == null ||
+        _expandMaskPacked == null ||
+        _applyStickerMaskPacked == null ||
+        (source != null && _applyStickerMaskPackedTo == null)) {
+      return MaskProcessorResult.errorProcessing;
+    }
+
+    // Validate input parameters
+    if (pixels.isEmpty ||
+        mask.isEmpty ||
+        width <= 0 ||
+        height <= 0 ||
+        borderWidth < 0) {
+      return MaskProcessorResult.errorInvalidParams;
+    }
+
+    // Validate array sizes
+    final expectedMaskCount = width * height;
+    if (pixels.length != expectedMaskCount * 4 ||
+        mask.length != expectedMaskCount ||
+        (source != null && source.length != pixels.length)) {
+      return MaskProcessorResult.errorInvalidParams;
+    }
+
+    try {
+      return using((arena) {
+        final maskPtr = _stageFloat64(mask, arena);
+        final borderColor = _borderColor(borderColorRgb, arena);
+
+        ffi.Pointer<BitMask> expandedPtr = ffi.nullptr;
+        bool expandedCreated = false;
+        if (addBorder && borderWidth > 0) {
+          expandedPtr = arena.allocate<BitMask>(ffi.sizeOf<BitMask>());
+          int result = _bitMaskCreate!(expandedPtr, width, height);
+          if (result != MaskProcessorResult.success) {
+            return result;
+          }
+          expandedCreated = true;
+          // Runs before the arena frees the struct itself
+          arena.onReleaseAll(() => _bitMaskDestroy!(expandedPtr));
+
+          result = _expandMaskPacked!(maskPtr, expandedPtr, borderWidth);
+          if (result != MaskProcessorResult.success) {
+            return result;
+          }
+        }
+
+        final int result;
+        final ffi.Pointer<ffi.Uint8> pixelsPtr;
+        if (source != null) {
+          pixelsPtr = _stageUint8(pixels, arena, copyIn: false);
+          result = _applyStickerMaskPackedTo!(
+            _stageUint8(source, arena),
+            pixelsPtr,
+            maskPtr,
+            width,
+            height,
+            addBorder ? 1 : 0,
+            borderColor,
+            expandedCreated ? expandedPtr : ffi.nullptr,
+          );
+        } else {
+          pixelsPtr = _stageUint8(pixels, arena);
+          result = _applyStickerMaskPacked!(
+            pixelsPtr,
+            maskPtr,
+            width,
+            height,
+            addBorder ? 1 : 0,
+            borderColor,
+            expandedCreated ? expandedPtr : ffi.nullptr,
+          );
+        }
+
+        if (result == MaskProcessorResult.success) {
+          _unstageUint8(pixels, pixelsPtr);
+        }
+        return result;
+      });
+    } catch (e) {
+      if (kDebugMode) {
+        debugPrint('Error in applyStickerMaskPacked: $e');
+      }
+      return MaskProcessorResult.errorProcessing;
+    }
+  }
+
+  /// Smooth [mask], expand the border and apply both to [pixels] in one
+  /// native pass.
+  ///
+  /// Takes the raw mask: the blur, dilation and compositing stream through
+  /// row bands without full-size intermediate masks. Same output as
+  /// [smoothMask], [expandMask] and [applyStickerMask] up to the rounding of
+  /// the blur. With [source], pixels are read from [source] and written to
+  /// [pixels].
+  static int makeStickerMaskFused(
+    Uint8List pixels,
+    List<double> mask,
+    int width,
+    int height,
+    int kernelSize,
+    bool addBorder,
+    List<int> borderColorRgb,
+    int borderWidth, {
+    Uint8List? source,
+    NativeMaskProcessorContext? context,
+  }) {
+    if (!_available || _makeStickerMaskFused == null) {
+      return MaskProcessorResult.errorProcessing;
+    }
+
+    // Validate input parameters
+    if (pixels.isEmpty ||
+        mask.isEmpty ||
+        width <= 0 ||
+        height <= 0 ||
+        kernelSize <= 0 ||
+        borderWidth < 0) {
+      return MaskProcessorResult.errorInvalidParams;
+    }
+
+    // Validate array sizes
+    final expectedMaskCount = width * height;
+    if (pixels.length != expectedMaskCount * 4 ||
+        mask.length != expectedMaskCount ||
+        (source != null && source.length != pixels.length)) {
+      return MaskProcessorResult.errorInvalidParams;
+    }
+
+    try {
+      return _withStaging(context, (arena) {
+        final maskPtr = _stageFloat64(mask, arena);
+        final borderColor = _borderColor(borderColorRgb, arena);
+        final pixelsPtr = _stageUint8(pixels, arena, copyIn: source == null);
+        final sourcePtr = source != null
+            ? _stageUint8(source, arena)
+            : pixelsPtr;
+
+        final result = context != null
+            ? _makeStickerMaskFusedCtx!(
+                context._pointer,
+                sourcePtr,
+                pixelsPtr,
+                maskPtr,
+                width,
+                height,
+                kernelSize,
+                addBorder ? 1 : 0,
+                borderColor,
+                borderWidth,
+              )
+            : _makeStickerMaskFused!(
+                sourcePtr,
+                pixelsPtr,
+                maskPtr,
+                width,
+                height,
+                kernelSize,
+                addBorder ? 1 : 0,
+                borderColor,
+                borderWidth,
+              );
+
+        if (result == MaskProcessorResult.success) {
+          _unstageUint8(pixels, pixelsPtr);
+        }
+        return result;
+      });
+    } catch (e) {
+      if (kDebugMode) {
+        debugPrint('Error in makeStickerMaskFused: $e');
+      }
+      return MaskProcessorResult.errorProcessing;
+    }
+  }
+
+  /// [makeStickerMaskFused] on each of [items] in one native call.
+  ///
+  /// The native side spreads the images over the thread pool: small ones
+  /// whole, one per thread, and large ones split across all threads. All
+  /// images share the kernel and border settings. Returns the result code
+  /// of each image, in order; an image that fails does not stop the
+  /// others, and its pixels are left unspecified.
+  static List<int> makeStickersBatch(
+    List<NativeStickerBatchItem> items,
+    int kernelSize,
+    bool addBorder,
+    List<int> borderColorRgb,
+    int borderWidth, {
+    NativeMaskProcessorContext? context,
+  }) {
+    if (!_available || _makeStickersBatch == null) {
+      return List.filled(items.length, MaskProcessorResult.errorProcessing);
+    }
+
+    // Validate input parameters
+    if (kernelSize <= 0 || borderWidth < 0) {
+      return List.filled(items.length, MaskProcessorResult.errorInvalidParams);
+    }
+    if (items.isEmpty) return const [];
+
+    try {
+      return _withStaging(context, (arena) {
+        final count = items.length;
+        final itemsPtr = arena<StickerBatchItem>(count);
+        final resultsPtr = arena<ffi.Int32>(count);
+        final pixelsPtrs = List<ffi.Pointer<ffi.Uint8>?>.filled(count, null);
+
+        for (var i = 0; i < count; i++) {
+          final item = items[i];
+          final native = itemsPtr[i];
+          native.width = item.width;
+          native.height = item.height;
+
+          // Invalid images are passed without buffers, which the native
+          // side reports as invalid
+          if (!item._isValid) {
+            native.src = ffi.nullptr;
+            native.dst = ffi.nullptr;
+            native.mask = ffi.nullptr;
+            continue;
+          }
+
+          final source = item.source;
+          final pixelsPtr = _stageUint8(
+            item.pixels,
+            arena,
+            copyIn: source == null,
+          );
+          native.mask = _stageFloat64(item.mask, arena);
+          native.dst = pixelsPtr;
+          native.src = source != null ? _stageUint8(source, arena) : pixelsPtr;
+          pixelsPtrs[i] = pixelsPtr;
+        }
+
+        final borderColor = _borderColor(borderColorRgb, arena);
+        final result = context != null
+            ? _makeStickersBatchCtx!(
+                context._pointer,
+                itemsPtr,
+                count,
+                resultsPtr,
+                kernelSize,
+                addBorder ? 1 : 0,
+                borderColor,
+                borderWidth,
+              )
+            : _makeStickersBatch!(
+                itemsPtr,
+                count,
+                resultsPtr,
+                kernelSize,
+                addBorder ? 1 : 0,
+                borderColor,
+                borderWidth,
+              );
+        if (result != MaskProcessorResult.success) {
+          return List.filled(count, result);
+        }
+
+        final results = List<int>.generate(count, (i) => resultsPtr[i]);
+        for (var i = 0; i < count; i++) {
+          if (results[i] == MaskProcessorResult.success) {
+            _unstageUint8(items[i].pixels, pixelsPtrs[i]!);
+          }
+        }
+        return results;
+      });
+    } catch (e) {
+      if (kDebugMode) {
+        debugPrint('Error in makeStickersBatch: $e');
+      }
+      return List.filled(items.length, MaskProcessorResult.errorProcessing);
+    }
+  }
+
+  /// [makeStickerMaskFused] run off the calling thread (see
+  /// [smoothMaskAsync])
+  static Future<int> makeStickerMaskFusedAsync(
+    Uint8List pixels,
+    List<double> mask,
+    int width,
+    int height,
+    int kernelSize,
+    bool addBorder,
+    List<int> borderColorRgb,
+    int borderWidth, {
+    Uint8List? source,
+    NativeMaskProcessorContext? context,
+    NativeJobControl? control,
+  }) {
+    if (!_available || _makeStickerMaskFusedAsync == null) {
+      return Future.value(MaskProcessorResult.errorProcessing);
+    }
+
+    // Validate input parameters
+    if (pixels.isEmpty ||
+        mask.isEmpty ||
+        width <= 0 ||
+        height <= 0 ||
+        kernelSize <= 0 ||
+        borderWidth < 0) {
+      return Future.value(MaskProcessorResult.errorInvalidParams);
+    }
+
+    // Validate array sizes
+    final expectedMaskCount = width * height;
+    if (pixels.length != expectedMaskCount * 4 ||
+        mask.length != expectedMaskCount ||
+        (source != null && source.length != pixels.length)) {
+      return Future.value(MaskProcessorResult.errorInvalidParams);
+    }
+
+    final buffers = [pixels, mask, source];
+    return _runJob(
+      'makeStickerMaskFusedAsync',
+      context,
+      control,
+      buffers,
+      (job) {
+        final maskPtr = _stageFloat64(mask, job.arena);
+        final pixelsPtr = _stageUint8(
+          pixels,
+          job.arena,
+          copyIn: source == null,
+        );
+        final sourcePtr =
+            source != null ? _stageUint8(source, job.arena) : pixelsPtr;
+        job.onSuccess = () => _unstageUint8(pixels, pixelsPtr);
+
+        return _makeStickerMaskFusedAsync!(
+          job.port,
+          job.id,
+          job.state,
+          context?._pointer ?? ffi.nullptr,
+          sourcePtr,
+          pixelsPtr,
+          maskPtr,
+          width,
+          height,
+          kernelSize,
+          addBorder ? 1 : 0,
+          _borderColor(borderColorRgb, job.arena),
+          borderWidth,
+        );
+      },
+    );
+  }
+
+  /// Area-resample [pixels] (RGBA, [width] x [height]) into [output], a
+  /// normalized float tensor of three [outputWidth] x [outputHeight] planes
+  /// (NCHW, batch 1), computing (value / 255 - mean) * invStd per channel.
+  static int resizeRgbaToNchw(
+    Uint8List pixels,
+    int width,
+    int height,
+    Float32List output,
+    int outputWidth,
+    int outputHeight,
+    List<double> mean,
+    List<double> invStd, {
+    NativeMaskProcessorContext? context,
+  }) {
+    if (!_available || _resizeRgbaToNchw == null) {
+      return MaskProcessorResult.errorProcessing;
+    }
+
+    // Validate input parameters
+    if (width <= 0 ||
+        height <= 0 ||
+        outputWidth <= 0 ||
+        outputHeight <= 0 ||
+        mean.length != 3 ||
+        invStd.length != 3) {
+      return MaskProcessorResult.errorInvalidParams;
+    }
+
+    // Validate array sizes
+    if (pixels.length != width * height * 4 ||
+        output.length != outputWidth * outputHeight * 3) {
+      return MaskProcessorResult.errorInvalidParams;
+    }
+
+    try {
+      return _withStaging(context, (arena) {
+        final pixelsPtr = _stageUint8(pixels, arena);
+        final outputPtr = _stageFloat32(output, arena, copyIn: false);
+        final meanPtr = arena<ffi.Float>(3);
+        final invStdPtr = arena<ffi.Float>(3);
+        meanPtr.asTypedList(3).setAll(0, mean);
+        invStdPtr.asTypedList(3).setAll(0, invStd);
+
+        final result = context != null
+            ? _resizeRgbaToNchwCtx!(
+                context._pointer,
+                pixelsPtr,
+                width,
+                height,
+                outputPtr,
+                outputWidth,
+                outputHeight,
+                meanPtr,
+                invStdPtr,
+              )
+            : _resizeRgbaToNchw!(
+                pixelsPtr,
+                width,
+                height,
+                outputPtr,
+                outputWidth,
+                outputHeight,
+                meanPtr,
+                invStdPtr,
+              );
+
+        if (result == MaskProcessorResult.success) {
+          _unstageFloat32(output, outputPtr);
+        }
+        return result;
+      });
+    } catch (e) {
+      if (kDebugMode) {
+        debugPrint('Error in resizeRgbaToNchw: $e');
+      }
+      return MaskProcessorResult.errorProcessing;
+    }
+  }
+
+  /// [resizeRgbaToNchw] run off the calling thread (see [smoothMaskAsync])
+  static Future<int> resizeRgbaToNchwAsync(
+    Uint8List pixels,
+    int width,
+    int height,
+    Float32List output,
+    int outputWidth,
+    int outputHeight,
+    List<double> mean,
+    List<double> invStd, {
+    NativeMaskProcessorContext? context,
+    NativeJobControl? control,
+  }) {
+    if (!_available || _resizeRgbaToNchwAsync == null) {
+      return Future.value(MaskProcessorResult.errorProcessing);
+    }
+
+    // Validate input parameters
+    if (width <= 0 ||
+        height <= 0 ||
+        outputWidth <= 0 ||
+        outputHeight <= 0 ||
+        mean.length != 3 ||
+        invStd.length != 3) {
+      return Future.value(MaskProcessorResult.errorInvalidParams);
+    }
+
+    // Validate array sizes
+    if (pixels.length != width * height * 4 ||
+        output.length != outputWidth * outputHeight * 3) {
+      return Future.value(MaskProcessorResult.errorInvalidParams);
+    }
+
+    return _runJob(
+      'resizeRgbaToNchwAsync',
+      context,
+      control,
+      [pixels, output],
+      (job) {
+        final pixelsPtr = _stageUint8(pixels, job.arena);
+        final outputPtr = _stageFloat32(output, job.arena, copyIn: false);
+        final meanPtr = job.arena<ffi.Float>(3);
+        final invStdPtr = job.arena<ffi.Float>(3);
+        meanPtr.asTypedList(3).setAll(0, mean);
+        invStdPtr.asTypedList(3).setAll(0, invStd);
+        job.onSuccess = () => _unstageFloat32(output, outputPtr);
+
+        return _resizeRgbaToNchwAsync!(
+          job.port,
+          job.id,
+          job.state,
+          context?._pointer ?? ffi.nullptr,
+          pixelsPtr,
+          width,
+          height,
+          outputPtr,
+          outputWidth,
+          outputHeight,
+          meanPtr,
+          invStdPtr,
+        );
+      },
+    );
+  }
+
+  /// Bilinearly upsample a model output [tensor] ([tensorWidth] x
+  /// [tensorHeight]) into [output] at [width] x [height].
+  ///
+  /// [output] is a [Float64List], [Float32List] or [Uint8List] (values
+  /// scaled to 0-255). With [applySigmoid] the tensor holds logits; with a
+  /// non-negative [threshold] the output is binarized. A [Float64List] from
+  /// [allocateFloat64] can go straight to [makeStickerMaskFused].
+  static int upsampleMask(
+    Float32List tensor,
+    int tensorWidth,
+    int tensorHeight,
+    TypedData output,
+    int width,
+    int height, {
+    bool applySigmoid = false,
+    double threshold = -1.0,
+    NativeMaskProcessorContext? context,
+  }) {
+    if (!_available || _upsampleMaskTensor == null) {
+      return MaskProcessorResult.errorProcessing;
+    }
+
+    // Validate input parameters
+    if (tensorWidth <= 0 || tensorHeight <= 0 || width <= 0 || height <= 0) {
+      return MaskProcessorResult.errorInvalidParams;
+    }
+
+    // Validate array sizes
+    final outputLength = width * height;
+    if (tensor.length != tensorWidth * tensorHeight ||
+        output.lengthInBytes != outputLength * output.elementSizeInBytes) {
+      return MaskProcessorResult.errorInvalidParams;
+    }
+
+    try {
+      return _withStaging(context, (arena) {
+        final int format;
+        final ffi.Pointer<ffi.Void> outputPtr;
+        if (output is Float64List) {
+          format = MaskOutputFormat.float64;
+          outputPtr = _stageFloat64(output, arena, copyIn: false).cast();
+        } else if (output is Float32List) {
+          format = MaskOutputFormat.float32;
+          outputPtr = _stageFloat32(output, arena, copyIn: false).cast();
+        } else if (output is Uint8List) {
+          format = MaskOutputFormat.uint8;
+          outputPtr = _stageUint8(output, arena, copyIn: false).cast();
+        } else {
+          return MaskProcessorResult.errorInvalidParams;
+        }
+
+        final tensorPtr = _stageFloat32(tensor, arena);
+        final result = context != null
+            ? _upsampleMaskTensorCtx!(
+                context._pointer,
+                tensorPtr,
+                tensorWidth,
+                tensorHeight,
+                outputPtr,
+                format,
+                width,
+                height,
+                applySigmoid ? 1 : 0,
+                threshold,
+              )
+            : _upsampleMaskTensor!(
+                tensorPtr,
+                tensorWidth,
+                tensorHeight,
+                outputPtr,
+                format,
+                width,
+                height,
+                applySigmoid ? 1 : 0,
+                threshold,
+              );
+
+        if (result == MaskProcessorResult.success) {
+          if (output is Float64List) {
+            _unstageFloat64(output, outputPtr.cast());
+          } else if (output is Float32List) {
+            _unstageFloat32(output, outputPtr.cast());
+          } else if (output is Uint8List) {
+            _unstageUint8(output, outputPtr.cast());
+          }
+        }
+        return result;
+      });
+    } catch (e) {
+      if (kDebugMode) {
+        debugPrint('Error in upsampleMask: $e');
+      }
+      return MaskProcessorResult.errorProcessing;
+    }
+  }
+
+  /// [upsampleMask] run off the calling thread (see [smoothMaskAsync])
+  static Future<int> upsampleMaskAsync(
+    Float32List tensor,
+    int tensorWidth,
+    int tensorHeight,
+    TypedData output,
+    int width,
+    int height, {
+    bool applySigmoid = false,
+    double threshold = -1.0,
+    NativeMaskProcessorContext? context,
+    NativeJobControl? control,
+  }) {
+    if (!_available || _upsampleMaskTensorAsync == null) {
+      return Future.value(MaskProcessorResult.errorProcessing);
+    }
+
+    // Validate input parameters
+    if (tensorWidth <= 0 || tensorHeight <= 0 || width <= 0 || height <= 0) {
+      return Future.value(MaskProcessorResult.errorInvalidParams);
+    }
+
+    // Validate array sizes
+    final outputLength = width * height;
+    if (tensor.length != tensorWidth * tensorHeight ||
+        output.lengthInBytes != outputLength * output.elementSizeInBytes) {
+      return Future.value(MaskProcessorResult.errorInvalidParams);
+    }
+
+    final int format;
+    if (output is Float64List) {
+      format = MaskOutputFormat.float64;
+    } else if (output is Float32List) {
+      format = MaskOutputFormat.float32;
+    } else if (output is Uint8List) {
+      format = MaskOutputFormat.uint8;
+    } else {
+      return Future.value(MaskProcessorResult.errorInvalidParams);
+    }
+
+    return _runJob(
+      'upsampleMaskAsync',
+      context,
+      control,
+      [tensor, output],
+      (job) {
+        final ffi.Pointer<ffi.Void> outputPtr;
+        if (output is Float64List) {
+          final staged = _stageFloat64(output, job.arena, copyIn: false);
+          job.onSuccess = () => _unstageFloat64(output, staged);
+          outputPtr = staged.cast();
+        } else if (output is Float32List) {
+          final staged = _stageFloat32(output, job.arena, copyIn: false);
+          job.onSuccess = () => _unstageFloat32(output, staged);
+          outputPtr = staged.cast();
+        } else {
+          final staged = _stageUint8(
+            output as Uint8List,
+            job.arena,
+            copyIn: false,
+          );
+          job.onSuccess = () => _unstageUint8(output, staged);
+          outputPtr = staged.cast();
+        }
+
+        return _upsampleMaskTensorAsync!(
+          job.port,
+          job.id,
+          job.state,
+          context?._pointer ?? ffi.nullptr,
+          _stageFloat32(tensor, job.arena),
+          tensorWidth,
+          tensorHeight,
+          outputPtr,
+          format,
+          width,
+          height,
+          applySigmoid ? 1 : 0,
+          threshold,
+        );
+      },
+    );
+  }
+
+  /// 128-bit hash of every byte of [data] as 32 hex digits, or null when
+  /// native processing is unavailable. Deterministic across runs and
+  /// platforms, for cache keys.
+  static String? contentHash(Uint8List data, {int seed = 0}) {
+    final hash = contentHash128(data, seed: seed);
+    return hash == null ? null : formatHash128(hash);
+  }
+
+  /// A [contentHash128] result as the 32 hex digits of [contentHash]
+  static String formatHash128(({int low, int high}) hash) {
+    return _hex64(hash.high) + _hex64(hash.low);
+  }
+
+  /// The hash behind [contentHash] as two 64-bit halves, the key form
+  /// [NativeMaskCache] takes
+  static ({int low, int high})? contentHash128(
+    Uint8List data, {
+    int seed = 0,
+  }) {
+    if (!_available || _contentHash == null) {
+      return null;
+    }
+
+    try {
+      return using((arena) {
+        final hash = arena<MaskHash128>();
+        final result = _contentHash!(
+          data.isEmpty ? ffi.nullptr : _stageUint8(data, arena),
+          data.length,
+          seed,
+          hash,
+        );
+        if (result != MaskProcessorResult.success) {
+          return null;
+        }
+        return (low: hash.ref.low, high: hash.ref.high);
+      });
+    } catch (e) {
+      if (kDebugMode) {
+        debugPrint('Error in contentHash: $e');
+      }
+      return null;
+    }
+  }
+
+  // 64-bit value (possibly negative as a Dart int) as 16 hex digits
+  static String _hex64(int value) {
+    return ((value >> 32) & 0xFFFFFFFF).toRadixString(16).padLeft(8, '0') +
+        (value & 0xFFFFFFFF).toRadixString(16).padLeft(8, '0');
+  }
+
+  /// Apply sticker mask effects using 8-bit masks (q = round(mask * 255)).
+  ///
+  /// See mask_processor.h for the error bounds against [applyStickerMask].
+  static int applyStickerMaskU8(
+    Uint8List pixels,
+    Uint8List mask,
+    int width,
+    int height,
+    bool addBorder,
+    List<int> borderColorRgb,
+    Uint8List? expandedMask,
+  ) {
+    if (!_available || _applyStickerMaskU8 == null) {
+      return MaskProcessorResult.errorProcessing;
+    }
+
+    // Validate input parameters
+    if (pixels.isEmpty || mask.isEmpty || width <= 0 || height <= 0) {
+      return MaskProcessorResult.errorInvalidParams;
+    }
+
+    // Validate array sizes
+    final expectedMaskCount = width * height;
+    if (pixels.length != expectedMaskCount * 4 ||
+        mask.length != expectedMaskCount ||
+        (expandedMask != null && expandedMask.length != expectedMaskCount)) {
+      return MaskProcessorResult.errorInvalidParams;
+    }
+
+    try {
+      return using((arena) {
+        final pixelsPtr = _stageUint8(pixels, arena);
+        final maskPtr = _stageUint8(mask, arena);
+        final expandedMaskPtr =
+            expandedMask != null
+                ? _stageUint8(expandedMask, arena)
+                : ffi.nullptr.cast<ffi.Uint8>();
+
+        final result = _applyStickerMaskU8!(
+          pixelsPtr,
+          maskPtr,
+          width,
+          height,
+          addBorder ? 1 : 0,
+          _borderColor(borderColorRgb, arena),
+          expandedMaskPtr,
+        );
+
+        if (result == MaskProcessorResult.success) {
+          _unstageUint8(pixels, pixelsPtr);
+        }
+        return result;
+      });
+    } catch (e) {
+      if (kDebugMode) {
+        debugPrint('Error in applyStickerMaskU8: $e');
+      }
+      return MaskProcessorResult.errorProcessing;
+    }
+  }
+
+  /// Smooth an 8-bit mask using native code
+  static int smoothMaskU8(
+    Uint8List mask,
+    Uint8List output,
+    int width,
+    int height,
+    int kernelSize,
+  ) {
+    return _filterMaskU8(
+      _smoothMaskU8,
+      'smoothMaskU8',
+      mask,
+      output,
+      width,
+      height,
+      kernelSize,
+    );
+  }
+
+  /// Expand an 8-bit mask using native code (output is 0 or 255)
+  static int expandMaskU8(
+    Uint8List mask,
+    Uint8List output,
+    int width,
+    int height,
+    int borderWidth,
+  ) {
+    return _filterMaskU8(
+      _expandMaskU8,
+      'expandMaskU8',
+      mask,
+      output,
+      width,
+      height,
+      borderWidth,
+    );
+  }
+
+  static int _filterMaskU8(
+    FilterMaskU8NativeDart? filter,
+    String name,
+    Uint8List mask,
+    Uint8List output,
+    int width,
+    int height,
+    int size,
+  ) {
+    if (!_available || filter == null) {
+      return MaskProcessorResult.errorProcessing;
+    }
+
+    // Validate input parameters
+    if (mask.isEmpty || output.isEmpty || width <= 0 || height <= 0) {
+      return MaskProcessorResult.errorInvalidParams;
+    }
+
+    // Validate array sizes
+    final expectedSize = width * height;
+    if (mask.length != expectedSize || output.length != expectedSize) {
+      return MaskProcessorResult.errorInvalidParams;
+    }
+
+    try {
+      return using((arena) {
+        final maskPtr = _stageUint8(mask, arena);
+        final outputPtr = _stageUint8(output, arena, copyIn: false);
+
+        final result = filter(maskPtr, outputPtr, width, height, size);
+
+        if (result == MaskProcessorResult.success) {
+          _unstageUint8(output, outputPtr);
+        }
+        return result;
+      });
+    } catch (e) {
+      if (kDebugMode) {
+        debugPrint('Error in $name: $e');
+      }
+      return MaskProcessorResult.errorProcessing;
+    }
+  }
+}
+
+/// Statistics of one [MaskStage] from [NativeMaskProcessor.getStats].
+///
+/// [histogram] bucket i counts calls that took from 2^i up to 2^(i+1)
+/// microseconds; bucket 0 also counts shorter calls and the last bucket
+/// longer ones.
+class NativeStageStats {
+  NativeStageStats._(this.stage, MaskStageStats stats)
+    : calls = stats.calls,
+      errors = stats.errors,
+      totalTime = Duration(microseconds: stats.totalNs ~/ 1000),
+      maxTime = Duration(microseconds: stats.maxNs ~/ 1000),
+      bytes = stats.bytes,
+      histogram = List.unmodifiable(
+        List.generate(MaskStage.histogramBuckets, (i) => stats.histogram[i]),
+      );
+
+  final int stage;
+  final int calls;
+
+  /// Calls that returned an error, included in [calls]
+  final int errors;
+  final Duration totalTime;
+  final Duration maxTime;
+
+  /// Bytes read and written by the calls that succeeded
+  final int bytes;
+  final List<int> histogram;
+
+  String get name => MaskStage.name(stage);
+
+  Duration get meanTime => calls > 0
+      ? Duration(microseconds: totalTime.inMicroseconds ~/ calls)
+      : Duration.zero;
+
+  /// Upper bound of the [fraction] quantile (0.5 for the median), from
+  /// [histogram]; within a factor of two of the true value
+  Duration percentile(double fraction) {
+    if (calls == 0) return Duration.zero;
+    final rank = (fraction * calls).ceil().clamp(1, calls);
+    var seen = 0;
+    for (var i = 0; i < histogram.length - 1; i++) {
+      seen += histogram[i];
+      if (seen >= rank) return Duration(microseconds: 2 << i);
+    }
+    return maxTime;
+  }
+}
+
+/// Fused sticker pipeline fed a band of rows at a time.
+///
+/// For images too large to hold as a whole mask: [push] takes the next
+/// source rows with their mask rows and returns the RGBA rows they
+/// complete, trailing the input by [lag] rows. The push that supplies the
+/// last row returns everything left. Native memory stays proportional to
+/// the width times the kernel size plus border width. Same pixels as
+/// [NativeMaskProcessor.makeStickerMaskFused].
+class NativeStickerStream implements ffi.Finalizable {
+  NativeStickerStream._(this._stream, this.width, this.height, this.lag);
+
+  final ffi.Pointer<StickerStream> _stream;
+  final int width;
+  final int height;
+
+  /// Input rows held back before their output is ready
+  final int lag;
+
+  int _pushed = 0;
+  bool _disposed = false;
+
+  /// Rows pushed so far
+  int get pushedRows => _pushed;
+
+  /// Whether every row has been pushed
+  bool get isComplete => _pushed == height;
+
+  /// Create a stream, or null when native processing is unavailable or the
+  /// parameters are invalid
+  static NativeStickerStream? create(
+    int width,
+    int height,
+    int kernelSize,
+    bool addBorder,
+    List<int> borderColorRgb,
+    int borderWidth,
+  ) {
+    if (!NativeMaskProcessor._available ||
+        NativeMaskProcessor._stickerStreamCreate == null) {
+      return null;
+    }
+    if (width <= 0 || height <= 0 || kernelSize <= 0 || borderWidth < 0) {
+      return null;
+    }
+
+    try {
+      return using((arena) {
+        final streamPtr = arena<ffi.Pointer<StickerStream>>();
+        final result = NativeMaskProcessor._stickerStreamCreate!(
+          streamPtr,
+          width,
+          height,
+          kernelSize,
+          addBorder ? 1 : 0,
+          NativeMaskProcessor._borderColor(borderColorRgb, arena),
+          borderWidth,
+        );
+        if (result != MaskProcessorResult.success) {
+          return null;
+        }
+
+        final stream = NativeStickerStream._(
+          streamPtr.value,
+          width,
+          height,
+          NativeMaskProcessor._stickerStreamLag!(streamPtr.value),
+        );
+        NativeMaskProcessor._stickerStreamFinalizer!.attach(
+          stream,
+          streamPtr.value.cast(),
+          detach: stream,
+        );
+        return stream;
+      });
     } catch (e) {
       if (kDebugMode) {
-        debugPrint('Error in applyStickerMask: $e');
+        debugPrint('Error in NativeStickerStream.create: $e');
       }
-      return MaskProcessorResult.errorProcessing;
-    } finally {
-      // Clean up allocated memory
-      if (pixelsPtr != ffi.nullptr) {
-        malloc.free(pixelsPtr);
-      }
-      if (maskPtr != ffi.nullptr) {
-        malloc.free(maskPtr);
+      return null;
+    }
+  }
+
+  /// Push the next rows of [pixels] (RGBA) and [mask] and return the
+  /// finished RGBA rows, possibly none. Returns null on error.
+  Uint8List? push(Uint8List pixels, List<double> mask) {
+    if (_disposed || pixels.isEmpty || pixels.length % (width * 4) != 0) {
+      return null;
+    }
+    final rows = pixels.length ~/ (width * 4);
+    if (mask.length != rows * width || rows > height - _pushed) {
+      return null;
+    }
+
+    try {
+      return using((arena) {
+        final outputPtr = arena<ffi.Uint8>((rows + lag) * width * 4);
+        final outputRows = arena<ffi.Int32>();
+
+        final result = NativeMaskProcessor._stickerStreamPush!(
+          _stream,
+          NativeMaskProcessor._stageUint8(pixels, arena),
+          NativeMaskProcessor._stageFloat64(mask, arena),
+          rows,
+          outputPtr,
+          outputRows,
+        );
+        if (result != MaskProcessorResult.success) {
+          return null;
+        }
+
+        _pushed += rows;
+        return Uint8List.fromList(
+          outputPtr.asTypedList(outputRows.value * width * 4),
+        );
+      });
+    } catch (e) {
+      if (kDebugMode) {
+        debugPrint('Error in NativeStickerStream.push: $e');
       }
-      if (expandedMaskPtr != ffi.nullptr) {
-        malloc.free(expandedMaskPtr);
+      return null;
+    }
+  }
+
+  /// Free the native state now rather than when the stream is collected
+  void dispose() {
+    if (_disposed) return;
+    _disposed = true;
+    NativeMaskProcessor._stickerStreamFinalizer!.detach(this);
+    NativeMaskProcessor._stickerStreamDestroy!(_stream);
+  }
+}
+
+/// Persistent on-disk cache of inference masks keyed by
+/// [NativeMaskProcessor.contentHash128].
+///
+/// Masks are stored as 8-bit values, so a hit returns the mask rounded to
+/// the nearest 1/255. Writes are crash-safe and least recently used masks
+/// are evicted beyond [maxBytes]. See mask_cache.h.
+class NativeMaskCache implements ffi.Finalizable {
+  NativeMaskCache._(this._cache, this.directory, this.maxBytes);
+
+  final ffi.Pointer<MaskCache> _cache;
+  final String directory;
+  final int maxBytes;
+
+  bool _closed = false;
+
+  // Puts queued by [putAsync] and not yet done; the native cache is closed
+  // after the last one
+  int _pendingPuts = 0;
+
+  /// Open or create the cache in [directory], or null when native
+  /// processing is unavailable or the directory cannot be used
+  static NativeMaskCache? open(String directory, {required int maxBytes}) {
+    if (!NativeMaskProcessor._available ||
+        NativeMaskProcessor._maskCacheOpen == null) {
+      return null;
+    }
+    if (directory.isEmpty || maxBytes <= 0) {
+      return null;
+    }
+
+    try {
+      return using((arena) {
+        final cachePtr = arena<ffi.Pointer<MaskCache>>();
+        final result = NativeMaskProcessor._maskCacheOpen!(
+          cachePtr,
+          directory.toNativeUtf8(allocator: arena),
+          maxBytes,
+        );
+        if (result != MaskProcessorResult.success) {
+          return null;
+        }
+
+        final cache = NativeMaskCache._(cachePtr.value, directory, maxBytes);
+        NativeMaskProcessor._maskCacheFinalizer!.attach(
+          cache,
+          cachePtr.value.cast(),
+          detach: cache,
+        );
+        return cache;
+      });
+    } catch (e) {
+      if (kDebugMode) {
+        debugPrint('Error in NativeMaskCache.open: $e');
       }
-      if (borderColor != ffi.nullptr) {
-        malloc.free(borderColor);
+      return null;
+    }
+  }
+
+  /// The cached mask for [key] at this size, or null on a miss
+  Float64List? get(({int low, int high}) key, int width, int height) {
+    if (_closed || width <= 0 || height <= 0) {
+      return null;
+    }
+
+    try {
+      final output = NativeMaskProcessor.allocateFloat64(width * height);
+      final found = using((arena) {
+        final foundPtr = arena<ffi.Int32>();
+        final result = NativeMaskProcessor._maskCacheGet!(
+          _cache,
+          _key(key, arena),
+          NativeMaskProcessor._stageFloat64(output, arena, copyIn: false),
+          width,
+          height,
+          foundPtr,
+        );
+        return result == MaskProcessorResult.success && foundPtr.value != 0;
+      });
+      return found ? output : null;
+    } catch (e) {
+      if (kDebugMode) {
+        debugPrint('Error in NativeMaskCache.get: $e');
       }
+      return null;
     }
   }
 
-  /// Smooth mask using native code
-  static int smoothMask(
+  /// Store [mask] (width * height values, 0.0-1.0) under [key]
+  int put(
+    ({int low, int high}) key,
     List<double> mask,
-    List<double> output,
     int width,
     int height,
-    int kernelSize,
   ) {
-    if (!_available || _smoothMaskOptimized == null) {
-      return MaskProcessorResult.errorProcessing;
+    if (_closed ||
+        width <= 0 ||
+        height <= 0 ||
+        mask.length != width * height) {
+      return MaskProcessorResult.errorInvalidParams;
     }
 
-    // Validate input parameters
-    if (mask.isEmpty || output.isEmpty || width <= 0 || height <= 0) {
-      return MaskProcessorResult.errorInvalidParams;
+    try {
+      return using((arena) {
+        return NativeMaskProcessor._maskCachePut!(
+          _cache,
+          _key(key, arena),
+          NativeMaskProcessor._stageFloat64(mask, arena),
+          width,
+          height,
+        );
+      });
+    } catch (e) {
+      if (kDebugMode) {
+        debugPrint('Error in NativeMaskCache.put: $e');
+      }
+      return MaskProcessorResult.errorProcessing;
     }
+  }
 
-    // Validate array sizes
-    final expectedSize = width * height;
-    if (mask.length != expectedSize || output.length != expectedSize) {
+  /// [put] run off the calling thread.
+  ///
+  /// The mask is quantized, run-length coded and synced to disk on a
+  /// native thread of its own, so neither the calling isolate nor the
+  /// kernel jobs wait for it. The future completes with the result code.
+  /// A [mask] from [NativeMaskProcessor.allocateFloat64] is read in place
+  /// and must not be written until then. [close] waits for queued puts
+  /// before closing the files.
+  Future<int> putAsync(
+    ({int low, int high}) key,
+    List<double> mask,
+    int width,
+    int height,
+  ) async {
+    if (_closed ||
+        NativeMaskProcessor._maskCachePutAsync == null ||
+        width <= 0 ||
+        height <= 0 ||
+        mask.length != width * height) {
       return MaskProcessorResult.errorInvalidParams;
     }
 
-    ffi.Pointer<ffi.Double> maskPtr = ffi.nullptr;
-    ffi.Pointer<ffi.Double> outputPtr = ffi.nullptr;
-
+    _pendingPuts++;
     try {
-      // Allocate memory with proper size calculation
-      maskPtr = malloc.allocate<ffi.Double>(
-        mask.length * ffi.sizeOf<ffi.Double>(),
-      );
-      outputPtr = malloc.allocate<ffi.Double>(
-        output.length * ffi.sizeOf<ffi.Double>(),
+      // The cache is passed as a buffer, so the finalizer cannot close it
+      // under the job
+      return await NativeMaskProcessor._runJob(
+        'NativeMaskCache.putAsync',
+        null,
+        null,
+        [this, mask],
+        (job) => NativeMaskProcessor._maskCachePutAsync!(
+          job.port,
+          job.id,
+          job.state,
+          _cache,
+          _key(key, job.arena),
+          NativeMaskProcessor._stageFloat64(mask, job.arena),
+          width,
+          height,
+        ),
       );
-
-      // Verify pointers are valid
-      if (maskPtr == ffi.nullptr || outputPtr == ffi.nullptr) {
-        return MaskProcessorResult.errorMemory;
+    } finally {
+      if (--_pendingPuts == 0 && _closed) {
+        NativeMaskProcessor._maskCacheClose!(_cache);
       }
+    }
+  }
 
-      // Copy data to native memory safely
-      for (int i = 0; i < mask.length; i++) {
-        maskPtr[i] = mask[i];
-      }
+  /// Stored mask bytes and number of masks
+  ({int bytes, int entries}) get usage {
+    if (_closed) {
+      return (bytes: 0, entries: 0);
+    }
+    return using((arena) {
+      final bytes = arena<ffi.Uint64>();
+      final entries = arena<ffi.Int32>();
+      NativeMaskProcessor._maskCacheUsage!(_cache, bytes, entries);
+      return (bytes: bytes.value, entries: entries.value);
+    });
+  }
 
-      // Call native function
-      final result = _smoothMaskOptimized!(
-        maskPtr,
-        outputPtr,
-        width,
-        height,
-        kernelSize,
-      );
+  /// Close the files now rather than when the cache is collected, or once
+  /// the puts queued by [putAsync] are done
+  void close() {
+    if (_closed) return;
+    _closed = true;
+    NativeMaskProcessor._maskCacheFinalizer!.detach(this);
+    if (_pendingPuts == 0) {
+      NativeMaskProcessor._maskCacheClose!(_cache);
+    }
+  }
 
-      // Copy result back safely
-      if (result == MaskProcessorResult.success) {
-        for (int i = 0; i < output.length; i++) {
-          output[i] = outputPtr[i];
-        }
-      }
+  static ffi.Pointer<MaskHash128> _key(
+    ({int low, int high}) key,
+    Arena arena,
+  ) {
+    final pointer = arena<MaskHash128>();
+    pointer.ref.low = key.low;
+    pointer.ref.high = key.high;
+    return pointer;
+  }
+}
+
+/// One image for [NativeMaskProcessor.makeStickersBatch].
+///
+/// Takes the same buffers as [NativeMaskProcessor.makeStickerMaskFused]:
+/// [pixels] receives the sticker, read from [source] when given.
+class NativeStickerBatchItem {
+  const NativeStickerBatchItem({
+    required this.pixels,
+    required this.mask,
+    required this.width,
+    required this.height,
+    this.source,
+  });
+
+  final Uint8List pixels;
+  final List<double> mask;
+  final int width;
+  final int height;
+  final Uint8List? source;
+
+  bool get _isValid {
+    if (pixels.isEmpty || mask.isEmpty || width <= 0 || height <= 0) {
+      return false;
+    }
+    final expectedMaskCount = width * height;
+    return pixels.length == expectedMaskCount * 4 &&
+        mask.length == expectedMaskCount &&
+        (source == null || source!.length == pixels.length);
+  }
+}
+
+/// Sticker whose border style can be changed without recompositing.
+///
+/// [create] smooths the mask, computes its distance field and composites
+/// once. [setBorderColor], [setBorderWidth] and [setAddBorder] then rewrite
+/// only the background pixels the change affects, typically well under a
+/// millisecond, for live style pickers. [pixels] always equals
+/// [NativeMaskProcessor.applyStickerMaskSdf] on the smoothed mask with the
+/// current style. See sticker_session.h.
+class NativeStickerSession implements ffi.Finalizable {
+  NativeStickerSession._(
+    this._session,
+    this.width,
+    this.height,
+    this._addBorder,
+    this._borderColor,
+    this._borderWidth,
+  );
+
+  final ffi.Pointer<StickerSession> _session;
+  final int width;
+  final int height;
+
+  bool _addBorder;
+  List<int> _borderColor;
+  double _borderWidth;
+  bool _disposed = false;
+
+  bool get addBorder => _addBorder;
+  List<int> get borderColor => List.unmodifiable(_borderColor);
+  double get borderWidth => _borderWidth;
+
+  /// Create a session, or null when native processing is unavailable or
+  /// the parameters are invalid
+  static NativeStickerSession? create(
+    Uint8List pixels,
+    List<double> mask,
+    int width,
+    int height,
+    int kernelSize,
+    bool addBorder,
+    List<int> borderColorRgb,
+    double borderWidth,
+  ) {
+    if (!NativeMaskProcessor._available ||
+        NativeMaskProcessor._stickerSessionCreate == null) {
+      return null;
+    }
+    if (width <= 0 ||
+        height <= 0 ||
+        kernelSize <= 0 ||
+        borderWidth < 0 ||
+        pixels.length != width * height * 4 ||
+        mask.length != width * height) {
+      return null;
+    }
 
-      return result;
+    try {
+      return using((arena) {
+        final sessionPtr = arena<ffi.Pointer<StickerSession>>();
+        final result = NativeMaskProcessor._stickerSessionCreate!(
+          sessionPtr,
+          NativeMaskProcessor._stageUint8(pixels, arena),
+          NativeMaskProcessor._stageFloat64(mask, arena),
+          width,
+          height,
+          kernelSize,
+          addBorder ? 1 : 0,
+          NativeMaskProcessor._borderColor(borderColorRgb, arena),
+          borderWidth,
+        );
+        if (result != MaskProcessorResult.success) {
+          return null;
+        }
+        return NativeStickerSession._adopt(
+          sessionPtr.value,
+          width,
+          height,
+          addBorder,
+          borderColorRgb,
+          borderWidth,
+        );
+      });
     } catch (e) {
       if (kDebugMode) {
-        debugPrint('Error in smoothMask: $e');
-      }
-      return MaskProcessorResult.errorProcessing;
-    } finally {
-      // Clean up allocated memory
-      if (maskPtr != ffi.nullptr) {
-        malloc.free(maskPtr);
-      }
-      if (outputPtr != ffi.nullptr) {
-        malloc.free(outputPtr);
+        debugPrint('Error in NativeStickerSession.create: $e');
       }
+      return null;
     }
   }
 
-  /// Expand mask using native code
-  static int expandMask(
+  /// [create] run off the calling thread (see
+  /// [NativeMaskProcessor.smoothMaskAsync])
+  static Future<NativeStickerSession?> createAsync(
+    Uint8List pixels,
     List<double> mask,
-    List<double> output,
     int width,
     int height,
-    int borderWidth,
+    int kernelSize,
+    bool addBorder,
+    List<int> borderColorRgb,
+    double borderWidth, {
+    NativeJobControl? control,
+  }) async {
+    if (!NativeMaskProcessor._available ||
+        NativeMaskProcessor._stickerSessionCreateAsync == null) {
+      return null;
+    }
+    if (width <= 0 ||
+        height <= 0 ||
+        kernelSize <= 0 ||
+        borderWidth < 0 ||
+        pixels.length != width * height * 4 ||
+        mask.length != width * height) {
+      return null;
+    }
+
+    ffi.Pointer<StickerSession> created = ffi.nullptr;
+    final result = await NativeMaskProcessor._runJob(
+      'NativeStickerSession.createAsync',
+      null,
+      control,
+      [pixels, mask],
+      (job) {
+        final sessionPtr = job.arena<ffi.Pointer<StickerSession>>();
+        job.onSuccess = () => created = sessionPtr.value;
+
+        return NativeMaskProcessor._stickerSessionCreateAsync!(
+          job.port,
+          job.id,
+          job.state,
+          sessionPtr,
+          NativeMaskProcessor._stageUint8(pixels, job.arena),
+          NativeMaskProcessor._stageFloat64(mask, job.arena),
+          width,
+          height,
+          kernelSize,
+          addBorder ? 1 : 0,
+          NativeMaskProcessor._borderColor(borderColorRgb, job.arena),
+          borderWidth,
+        );
+      },
+    );
+    if (result != MaskProcessorResult.success || created == ffi.nullptr) {
+      return null;
+    }
+    return _adopt(
+      created,
+      width,
+      height,
+      addBorder,
+      borderColorRgb,
+      borderWidth,
+    );
+  }
+
+  // Wrap a native session, freed by the finalizer unless disposed
+  static NativeStickerSession _adopt(
+    ffi.Pointer<StickerSession> pointer,
+    int width,
+    int height,
+    bool addBorder,
+    List<int> borderColorRgb,
+    double borderWidth,
   ) {
-    if (!_available || _expandMaskNative == null) {
-      return MaskProcessorResult.errorProcessing;
+    final session = NativeStickerSession._(
+      pointer,
+      width,
+      height,
+      addBorder,
+      List.of(borderColorRgb),
+      borderWidth,
+    );
+    NativeMaskProcessor._stickerSessionFinalizer!.attach(
+      session,
+      pointer.cast(),
+      detach: session,
+    );
+    return session;
+  }
+
+  /// The composited RGBA sticker, a view of native memory that follows
+  /// the setters. Must not be used after [dispose].
+  Uint8List get pixels {
+    if (_disposed) return Uint8List(0);
+    return NativeMaskProcessor._stickerSessionPixels!(
+      _session,
+    ).asTypedList(width * height * 4);
+  }
+
+  /// Change the border color; rewrites only the border pixels
+  int setBorderColor(List<int> borderColorRgb) {
+    if (_disposed) return MaskProcessorResult.errorInvalidParams;
+    if (listEquals(borderColorRgb, _borderColor)) {
+      return MaskProcessorResult.success;
     }
 
-    // Validate input parameters
-    if (mask.isEmpty || output.isEmpty || width <= 0 || height <= 0) {
-      return MaskProcessorResult.errorInvalidParams;
+    final result = using((arena) {
+      return NativeMaskProcessor._stickerSessionSetBorderColor!(
+        _session,
+        NativeMaskProcessor._borderColor(borderColorRgb, arena),
+      );
+    });
+    if (result == MaskProcessorResult.success) {
+      _borderColor = List.of(borderColorRgb);
     }
+    return result;
+  }
 
-    // Validate array sizes
-    final expectedSize = width * height;
-    if (mask.length != expectedSize || output.length != expectedSize) {
+  /// Change the border width; rewrites only the pixels between the old
+  /// and new border contours
+  int setBorderWidth(double borderWidth) {
+    if (_disposed || borderWidth < 0) {
       return MaskProcessorResult.errorInvalidParams;
     }
+    if (borderWidth == _borderWidth) return MaskProcessorResult.success;
 
-    ffi.Pointer<ffi.Double> maskPtr = ffi.nullptr;
-    ffi.Pointer<ffi.Double> outputPtr = ffi.nullptr;
+    final result = NativeMaskProcessor._stickerSessionSetBorderWidth!(
+      _session,
+      borderWidth,
+    );
+    if (result == MaskProcessorResult.success) {
+      _borderWidth = borderWidth;
+    }
+    return result;
+  }
 
-    try {
-      // Allocate memory with proper size calculation
-      maskPtr = malloc.allocate<ffi.Double>(
-        mask.length * ffi.sizeOf<ffi.Double>(),
-      );
-      outputPtr = malloc.allocate<ffi.Double>(
-        output.length * ffi.sizeOf<ffi.Double>(),
-      );
+  /// Show or hide the border; rewrites only the border pixels
+  int setAddBorder(bool addBorder) {
+    if (_disposed) return MaskProcessorResult.errorInvalidParams;
+    if (addBorder == _addBorder) return MaskProcessorResult.success;
 
-      // Verify pointers are valid
-      if (maskPtr == ffi.nullptr || outputPtr == ffi.nullptr) {
-        return MaskProcessorResult.errorMemory;
-      }
+    final result = NativeMaskProcessor._stickerSessionSetAddBorder!(
+      _session,
+      addBorder ? 1 : 0,
+    );
+    if (result == MaskProcessorResult.success) {
+      _addBorder = addBorder;
+    }
+    return result;
+  }
 
-      // Copy data to native memory safely
-      for (int i = 0; i < mask.length; i++) {
-        maskPtr[i] = mask[i];
-      }
+  /// Free the native state now rather than when the session is collected
+  void dispose() {
+    if (_disposed) return;
+    _disposed = true;
+    NativeMaskProcessor._stickerSessionFinalizer!.detach(this);
+    NativeMaskProcessor._stickerSessionDestroy!(_session);
+  }
+}
 
-      // Call native function
-      final result = _expandMaskNative!(
-        maskPtr,
-        outputPtr,
-        width,
-        height,
-        borderWidth,
-      );
+/// Native scratch memory reused across calls (see processor_context.h).
+///
+/// Passed to [NativeMaskProcessor.smoothMask],
+/// [NativeMaskProcessor.expandMask], [NativeMaskProcessor.computeMaskSdf],
+/// [NativeMaskProcessor.makeStickerMaskFused],
+/// [NativeMaskProcessor.resizeRgbaToNchw] or
+/// [NativeMaskProcessor.upsampleMask], a context supplies both the native
+/// temporaries and the staging copies of Dart lists from memory it keeps
+/// between calls. Once a size has been processed, repeated calls make no
+/// heap allocations; [heapAllocations] counts the ones made so far.
+///
+/// A context serves one call at a time. The async methods queue their jobs
+/// on one native thread, so the jobs of a context never overlap; [trim] and
+/// [dispose] wait for the ones in flight to finish.
+class NativeMaskProcessorContext implements ffi.Finalizable {
+  NativeMaskProcessorContext._(this._context) {
+    _staging = _ContextStaging(this);
+  }
+
+  final ffi.Pointer<MaskProcessorContext> _context;
+  late final _ContextStaging _staging;
+  bool _disposed = false;
+  int _activeJobs = 0;
+  bool _trimPending = false;
+
+  /// Create a context, or null when native processing is unavailable.
+  ///
+  /// A non-zero [threadCount] resizes the library thread pool, which all
+  /// contexts share (see [NativeMaskProcessor.setThreadCount]).
+  static NativeMaskProcessorContext? create({int threadCount = 0}) {
+    if (!NativeMaskProcessor._available ||
+        NativeMaskProcessor._contextCreate == null) {
+      return null;
+    }
+    if (threadCount < 0) return null;
 
-      // Copy result back safely
-      if (result == MaskProcessorResult.success) {
-        for (int i = 0; i < output.length; i++) {
-          output[i] = outputPtr[i];
+    try {
+      return using((arena) {
+        final contextPtr = arena<ffi.Pointer<MaskProcessorContext>>();
+        final result = NativeMaskProcessor._contextCreate!(
+          contextPtr,
+          threadCount,
+        );
+        if (result != MaskProcessorResult.success) {
+          return null;
         }
-      }
 
-      return result;
+        final context = NativeMaskProcessorContext._(contextPtr.value);
+        NativeMaskProcessor._contextFinalizer!.attach(
+          context,
+          contextPtr.value.cast(),
+          detach: context,
+        );
+        return context;
+      });
     } catch (e) {
       if (kDebugMode) {
-        debugPrint('Error in expandMask: $e');
+        debugPrint('Error in NativeMaskProcessorContext.create: $e');
       }
-      return MaskProcessorResult.errorProcessing;
+      return null;
+    }
+  }
+
+  ffi.Pointer<MaskProcessorContext> get _pointer {
+    if (_disposed) {
+      throw StateError('NativeMaskProcessorContext used after dispose');
+    }
+    return _context;
+  }
+
+  /// Heap blocks allocated for scratch and staging memory since creation
+  int get heapAllocations {
+    if (_disposed) return 0;
+    return NativeMaskProcessor._contextHeapAllocations!(_context) +
+        _staging.overflowAllocations;
+  }
+
+  /// Bytes of native memory held between calls
+  int get reservedBytes {
+    if (_disposed) return 0;
+    return NativeMaskProcessor._contextReservedBytes!(_context);
+  }
+
+  /// Free the memory held between calls, e.g. after an unusually large
+  /// image; later calls grow it again
+  void trim() {
+    if (_disposed) return;
+    if (_activeJobs > 0) {
+      _trimPending = true;
+      return;
+    }
+    NativeMaskProcessor._contextTrim!(_context);
+    _staging.release();
+  }
+
+  /// Free the native state now rather than when the context is collected
+  void dispose() {
+    if (_disposed) return;
+    _disposed = true;
+    NativeMaskProcessor._contextFinalizer!.detach(this);
+    if (_activeJobs == 0) {
+      NativeMaskProcessor._contextDestroy!(_context);
+    }
+  }
+
+  void _jobStarted() => _activeJobs++;
+
+  // Run the trim or dispose deferred while jobs were in flight
+  void _jobEnded() {
+    if (--_activeJobs > 0) return;
+    if (_disposed) {
+      NativeMaskProcessor._contextDestroy!(_context);
+    } else if (_trimPending) {
+      _trimPending = false;
+      trim();
+    }
+  }
+}
+
+/// Bump allocator over the staging buffer of a context.
+///
+/// Requests past the end of the buffer are served by malloc for the
+/// current call only; the buffer is then grown to the total the call
+/// needed, so the next call of that size fits.
+class _ContextStaging implements ffi.Allocator {
+  _ContextStaging(this._owner);
+
+  static const _alignment = 16;
+
+  final NativeMaskProcessorContext _owner;
+  final List<ffi.Pointer<ffi.Uint8>> _overflow = [];
+  ffi.Pointer<ffi.Uint8> _buffer = ffi.nullptr;
+  int _capacity = 0;
+  int _used = 0;
+  int _needed = 0;
+  int overflowAllocations = 0;
+
+  @override
+  ffi.Pointer<T> allocate<T extends ffi.NativeType>(
+    int byteCount, {
+    int? alignment,
+  }) {
+    final bytes = (byteCount + _alignment - 1) & ~(_alignment - 1);
+    _needed += bytes;
+    if (_used + bytes <= _capacity) {
+      final pointer = ffi.Pointer<ffi.Uint8>.fromAddress(
+        _buffer.address + _used,
+      );
+      _used += bytes;
+      return pointer.cast();
+    }
+
+    final pointer = malloc.allocate<ffi.Uint8>(byteCount);
+    _overflow.add(pointer);
+    overflowAllocations++;
+    return pointer.cast();
+  }
+
+  /// No-op: everything is released when the call ends
+  @override
+  void free(ffi.Pointer<ffi.NativeType> pointer) {}
+
+  R run<R>(R Function(ffi.Allocator arena) body) {
+    final context = _owner._pointer;
+    try {
+      return body(this);
     } finally {
-      // Clean up allocated memory
-      if (maskPtr != ffi.nullptr) {
-        malloc.free(maskPtr);
+      for (final pointer in _overflow) {
+        malloc.free(pointer);
       }
-      if (outputPtr != ffi.nullptr) {
-        malloc.free(outputPtr);
+      _overflow.clear();
+      if (_needed > _capacity) {
+        _buffer = NativeMaskProcessor._contextStaging!(context, _needed).cast();
+        _capacity = _buffer == ffi.nullptr ? 0 : _needed;
       }
+      _used = 0;
+      _needed = 0;
+    }
+  }
+
+  /// Forget the buffer after the context freed it
+  void release() {
+    _buffer = ffi.nullptr;
+    _capacity = 0;
+  }
+}
+
+/// Cancels, and reports the progress of, the async jobs it is passed to.
+///
+/// One control can follow several jobs in turn, such as the steps of one
+/// sticker. [cancel] stops its running job at the next band boundary,
+/// within milliseconds, and drops its queued ones; they complete with
+/// [MaskProcessorResult.errorCancelled] and leave their outputs
+/// unspecified. Jobs passed a cancelled control complete the same way
+/// without running. A job that finishes before the cancel lands keeps its
+/// result.
+class NativeJobControl {
+  final Set<_NativeJob> _jobs = {};
+  _NativeJob? _latest;
+  double _latestProgress = 0;
+  bool _cancelled = false;
+
+  /// Whether [cancel] has been called
+  bool get isCancelled => _cancelled;
+
+  /// Fraction of the most recently submitted job done, from 0 to 1.
+  ///
+  /// An estimate spread over the passes the job makes; it only goes up and
+  /// reaches 1 only when the job succeeds.
+  double get progress {
+    final job = _latest;
+    return job != null ? job.state.ref.progress : _latestProgress;
+  }
+
+  /// Stop the jobs in flight and refuse new ones
+  void cancel() {
+    if (_cancelled) return;
+    _cancelled = true;
+    _jobs.forEach(NativeMaskProcessor._cancelJob);
+  }
+
+  void _jobStarted(_NativeJob job) {
+    _jobs.add(job);
+    _latest = job;
+    _latestProgress = 0;
+  }
+
+  // Called before the job's state is freed
+  void _jobEnded(_NativeJob job) {
+    _jobs.remove(job);
+    if (identical(_latest, job)) {
+      _latestProgress = job.state.ref.progress;
+      _latest = null;
     }
   }
 }
+
+/// An async native job in flight
+class _NativeJob {
+  _NativeJob(this.id, this.port, this.context, this.control, this.buffers);
+
+  final int id;
+  final int port;
+  final NativeMaskProcessorContext? context;
+  final NativeJobControl? control;
+
+  /// Lists the job may use in place, kept reachable until it is done
+  final List<Object?> buffers;
+
+  /// Staging memory and the shared state, freed when the job is done
+  final Arena arena = Arena(malloc);
+  late final ffi.Pointer<MaskJobState> state = arena<MaskJobState>()
+    ..ref.result = MaskProcessorResult.success
+    ..ref.cancelled = 0
+    ..ref.progress = 0;
+  final Completer<int> completer = Completer<int>();
+
+  /// Copies staged outputs back once the job has succeeded
+  void Function()? onSuccess;
+}
@@ -1,6 +1,8 @@
 import 'dart:math' as math;
 import 'dart:async';
 import 'package:flutter/foundation.dart';
+import 'package:flutter/widgets.dart'
+    show WidgetsBinding, WidgetsBindingObserver;
 import 'package:flutter_onnxruntime/flutter_onnxruntime.dart';
 import 'package:flutter_sticker_maker/src/constants.dart';
 import 'package:flutter_sticker_maker/src/native_mask_processor.dart';
@@ -19,7 +21,10 @@ class _MemoryPool {
     if (pool != null && pool.isNotEmpty) {
       return pool.removeLast();
     }
-    return Uint8List(size);
+    // Native-owned buffers reach the native kernels without copying
+    return NativeMaskProcessor.isAvailable
+        ? NativeMaskProcessor.allocateUint8(size)
+        : Uint8List(size);
   }
 
   static void returnBuffer(Uint8List buffer) {
@@ -27,9 +32,7 @@ class _MemoryPool {
     final pool = _pools.putIfAbsent(size, () => <Uint8List>[]);
     if (pool.length < _maxPoolSize) {
       // Properly clear buffer contents
-      for (int i = 0; i < buffer.length; i++) {
-        buffer[i] = 0;
-      }
+      buffer.fillRange(0, buffer.length, 0);
       pool.add(buffer);
     }
   }
@@ -45,35 +48,36 @@ class _ProcessingCache {
   static final Map<String, ui.Image> _imageCache = {};
   static const int _maxCacheSize = 10;
 
-  static String _generateKey(Uint8List data, int width, int height) {
-    // Create a more robust hash that's truly unique per image
-
-    // Use a more comprehensive sampling strategy
-    final step = math.max(1, data.length ~/ 2048); // Sample more pixels
-
-    // Create multiple hash components
-    int hash1 = 0, hash2 = 0, hash3 = 0;
-
-    for (int i = 0; i < data.length; i += step) {
-      final pixel = data[i];
-      hash1 = (hash1 * 31 + pixel) & 0x7FFFFFFF;
-    }
+  /// Key from the full image content and its dimensions, so the same
+  /// photo submitted again (for example with new border settings) hits.
+  /// [hash] passes a native hash the caller already has.
+  static String _generateKey(
+    Uint8List data,
+    int width,
+    int height, {
+    ({int low, int high})? hash,
+  }) {
+    hash ??= NativeMaskProcessor.contentHash128(data);
+    final digest =
+        hash == null
+            ? _dartContentHash(data)
+            : NativeMaskProcessor.formatHash128(hash);
+    return '${width}x${height}_$digest';
+  }
 
-    // Sample from different regions for better uniqueness
-    for (int i = step ~/ 2; i < data.length; i += step * 2) {
-      final pixel = data[i];
-      hash2 = (hash2 * 37 + pixel) & 0x7FFFFFFF;
+  // Full-content hash for when the native library is unavailable: two
+  // independent 32-bit multiplicative hashes over every byte
+  static String _dartContentHash(Uint8List data) {
+    int hash1 = 0x811C9DC5;
+    int hash2 = data.length;
+    for (int i = 0; i < data.length; i++) {
+      final byte = data[i];
+      hash1 = ((hash1 ^ byte) * 0x01000193) & 0xFFFFFFFF;
+      hash2 = ((hash2 + byte) * 0x5BD1E995) & 0xFFFFFFFF;
+      hash2 ^= hash2 >> 15;
     }
-
-    // Include data length and additional variance
-    hash3 = data.length.hashCode;
-
-    // Combine all hash components
-
-    // Add timestamp component to ensure uniqueness across sessions
-    final timestamp = DateTime.now().microsecondsSinceEpoch;
-
-    return '${width}x${height}_${hash1}_${hash2}_${hash3}_$timestamp';
+    return '${hash1.toRadixString(16).padLeft(8, '0')}'
+        '${hash2.toRadixString(16).padLeft(8, '0')}';
   }
 
   static List<double>? getMask(String key) => _maskCache[key];
@@ -103,6 +107,79 @@ class _ProcessingCache {
   }
 }
 
+/// Mask derivatives that do not depend on border style
+class _PreparedMask {
+  final List<double> source;
+  final int width;
+  final int height;
+  final List<double> smoothedMask;
+
+  /// Signed distance field of [smoothedMask], or null without native support
+  final Float32List? sdf;
+
+  _PreparedMask({
+    required this.source,
+    required this.width,
+    required this.height,
+    required this.smoothedMask,
+    required this.sdf,
+  });
+}
+
+/// Native sticker session kept for border edits of the same image
+class _StickerSessionEntry {
+  final List<double> source;
+  final WeakReference<Uint8List> pixels;
+
+  /// Content hash of the pixels, to recognize the same image in a new list
+  final ({int low, int high})? pixelsHash;
+  final NativeStickerSession session;
+
+  _StickerSessionEntry({
+    required this.source,
+    required this.pixels,
+    required this.pixelsHash,
+    required this.session,
+  });
+
+  bool matches(Uint8List pixels, List<double> mask, int width, int height) {
+    if (!identical(source, mask) ||
+        session.width != width ||
+        session.height != height) {
+      return false;
+    }
+    if (identical(this.pixels.target, pixels)) return true;
+    return pixelsHash != null &&
+        NativeMaskProcessor.contentHash128(pixels) == pixelsHash;
+  }
+}
+
+/// Forwards the platform's low-memory signal to [OnnxStickerProcessor]
+class _MemoryPressureObserver with WidgetsBindingObserver {
+  /// The registered observer, or null when no binding is running, as in
+  /// plain Dart tests
+  static _MemoryPressureObserver? register() {
+    try {
+      final observer = _MemoryPressureObserver();
+      WidgetsBinding.instance.addObserver(observer);
+      return observer;
+    } catch (_) {
+      return null;
+    }
+  }
+
+  void unregister() {
+    try {
+      WidgetsBinding.instance.removeObserver(this);
+    } catch (_) {}
+  }
+
+  @override
+  void didHaveMemoryPressure() {
+    OnnxStickerProcessor._didHaveMemoryPressure();
+  }
+}
+
 /// ONNX-based implementation for background removal and sticker creation
 class OnnxStickerProcessor {
   static OrtSession? _session;
@@ -111,6 +188,28 @@ class OnnxStickerProcessor {
   // Clear the float buffer pool completely for each new image
   static final Map<int, Float32List> _floatBufferPool = {};
 
+  // Smoothed mask and SDF for the most recent mask
+  static _PreparedMask? _preparedMask;
+  // Last mask rendered by the fused pipeline
+  static List<double>? _fusedMask;
+  // Session restyled in place when only the border style changes
+  static _StickerSessionEntry? _stickerSession;
+  // Calls using the session, which is only freed once there are none
+  static int _stickerSessionUses = 0;
+  // Frees the session after StickerDefaults.stickerSessionIdleSeconds unused
+  static Timer? _stickerSessionTimer;
+  // Frees the session as soon as it is unused, after memory pressure
+  static bool _stickerSessionReleasePending = false;
+  static _MemoryPressureObserver? _memoryPressureObserver;
+  // Persistent mask cache, when enabled
+  static NativeMaskCache? _diskCache;
+  // Scratch memory reused by the native preprocessing, upsampling and
+  // compositing calls
+  static NativeMaskProcessorContext? _nativeContext;
+
+  static NativeMaskProcessorContext? get _context =>
+      _nativeContext ??= NativeMaskProcessorContext.create();
+
   // Pre-computed constants for better performance
   static const mean = [0.485, 0.456, 0.406];
   static const invStd = [1.0 / 0.229, 1.0 / 0.224, 1.0 / 0.225];
@@ -128,7 +227,9 @@ class OnnxStickerProcessor {
       final nativeAvailable = NativeMaskProcessor.initialize();
       if (kDebugMode) {
         dev.log(
-          'Native mask processor available: $nativeAvailable',
+          'Native mask processor available: $nativeAvailable '
+          '(isa: ${MaskProcessorIsa.name(NativeMaskProcessor.activeIsa)}, '
+          'threads: ${NativeMaskProcessor.threadCount})',
           name: "FlutterStickerMaker",
         );
       }
@@ -197,6 +298,26 @@ class OnnxStickerProcessor {
     }
   }
 
+  /// Keep inference masks in [directory] across app launches, so
+  /// reopening a photo skips the model. Returns false when native
+  /// processing is unavailable or the directory cannot be used.
+  static bool enableDiskCache(
+    String directory, {
+    int maxBytes = StickerDefaults.diskCacheMaxBytes,
+  }) {
+    if (!NativeMaskProcessor.initialize()) return false;
+
+    _diskCache?.close();
+    _diskCache = NativeMaskCache.open(directory, maxBytes: maxBytes);
+    return _diskCache != null;
+  }
+
+  /// Stop using the persistent mask cache; its files stay on disk
+  static void disableDiskCache() {
+    _diskCache?.close();
+    _diskCache = null;
+  }
+
   static Future<PixelImage?> getPixelsFromImage(Uint8List imageBytes) async {
     // Decode the input image
     final codec = await ui.instantiateImageCodec(imageBytes);
@@ -215,12 +336,16 @@ class OnnxStickerProcessor {
     return PixelImage(width: width, height: height, pixels: pixels);
   }
 
-  /// Create a sticker using ONNX-based background removal
+  /// Create a sticker using ONNX-based background removal.
+  ///
+  /// Cancelling [control] stops the native work in flight and makes this
+  /// throw.
   static Future<Uint8List?> makeSticker(
     Uint8List imageBytes, {
     bool addBorder = true,
     String borderColor = '#FFFFFF',
     double borderWidth = 12.0,
+    NativeJobControl? control,
   }) async {
     // Clear float buffer pool at start of each processing to prevent reuse
     _floatBufferPool.clear();
@@ -241,6 +366,7 @@ class OnnxStickerProcessor {
         pixelImage.pixels,
         pixelImage.width,
         pixelImage.height,
+        control: control,
       );
 
       // Apply the mask and create the sticker with async processing
@@ -252,6 +378,7 @@ class OnnxStickerProcessor {
         addBorder: addBorder,
         borderColor: borderColor,
         borderWidth: borderWidth,
+        control: control,
       );
 
       return stickerBytes;
@@ -260,8 +387,11 @@ class OnnxStickerProcessor {
     }
   }
 
-  /// Generate mask from image bytes
-  static Future<List<double>?> generateMask(PixelImage pixelImage) async {
+  /// Generate mask from image bytes (see [makeSticker] for [control])
+  static Future<List<double>?> generateMask(
+    PixelImage pixelImage, {
+    NativeJobControl? control,
+  }) async {
     // Clear float buffer pool at start of each processing to prevent reuse
     _floatBufferPool.clear();
 
@@ -275,19 +405,22 @@ class OnnxStickerProcessor {
         pixelImage.pixels,
         pixelImage.width,
         pixelImage.height,
+        control: control,
       );
     } catch (e) {
       throw Exception('Failed to generate mask: $e');
     }
   }
 
-  /// Apply sticker effect using existing mask
+  /// Apply sticker effect using existing mask (see [makeSticker] for
+  /// [control])
   static Future<Uint8List?> applyStickerEffect(
     PixelImage pixelImage,
     List<double> mask, {
     bool addBorder = true,
     String borderColor = '#FFFFFF',
     double borderWidth = 12.0,
+    NativeJobControl? control,
   }) async {
     // Clear float buffer pool at start of each processing to prevent reuse
     _floatBufferPool.clear();
@@ -307,6 +440,7 @@ class OnnxStickerProcessor {
         addBorder: addBorder,
         borderColor: borderColor,
         borderWidth: borderWidth,
+        control: control,
       );
 
       return stickerBytes;
@@ -318,10 +452,17 @@ class OnnxStickerProcessor {
   static Future<List<double>> _getMaskFromPixels(
     Uint8List pixels,
     int width,
-    int height,
-  ) async {
+    int height, {
+    NativeJobControl? control,
+  }) async {
     // Generate unique cache key for this specific image
-    final cacheKey = _ProcessingCache._generateKey(pixels, width, height);
+    final hash = NativeMaskProcessor.contentHash128(pixels);
+    final cacheKey = _ProcessingCache._generateKey(
+      pixels,
+      width,
+      height,
+      hash: hash,
+    );
     List<double>? mask = _ProcessingCache.getMask(cacheKey);
 
     if (mask != null) {
@@ -332,10 +473,38 @@ class OnnxStickerProcessor {
         );
       }
       return mask;
+    }
+
+    final diskCache = hash == null ? null : _diskCache;
+    mask = diskCache?.get(hash!, width, height);
+    if (mask != null) {
+      if (kDebugMode) {
+        dev.log(
+          'Using disk cached mask for key: $cacheKey',
+          name: "FlutterStickerMaker",
+        );
+      }
     } else {
-      mask = await _runOnnxInference(pixels, width, height);
-      _ProcessingCache.putMask(cacheKey, mask);
-      return mask;
+      mask = await _runOnnxInference(
+        pixels,
+        width,
+        height,
+        control: control,
+      );
+      // Not awaited: the sticker does not need the stored copy
+      if (diskCache != null) {
+        unawaited(diskCache.putAsync(hash!, mask, width, height));
+      }
+    }
+    _ProcessingCache.putMask(cacheKey, mask);
+    return mask;
+  }
+
+  // A cancelled native job ends the call instead of falling back to the
+  // slower paths
+  static void _throwIfCancelled(NativeJobControl? control) {
+    if (control != null && control.isCancelled) {
+      throw Exception('Processing was cancelled');
     }
   }
 
@@ -343,8 +512,9 @@ class OnnxStickerProcessor {
   static Future<List<double>> _runOnnxInference(
     Uint8List pixels,
     int width,
-    int height,
-  ) async {
+    int height, {
+    NativeJobControl? control,
+  }) async {
     if (_session == null) {
       throw Exception('ONNX session not initialized');
     }
@@ -355,11 +525,15 @@ class OnnxStickerProcessor {
         pixels,
         width,
         height,
+        control: control,
       );
 
       // Run inference with correct input name
       final inputs = {'input.1': inputTensor};
+      final inference = Stopwatch()..start();
       final mapOutputs = await _session!.run(inputs);
+      NativeMaskProcessor.recordStage(MaskStage.inference, inference.elapsed);
+      _throwIfCancelled(control);
 
       final outputs = mapOutputs.values.toList();
 
@@ -368,6 +542,7 @@ class OnnxStickerProcessor {
         outputs,
         width,
         height,
+        control: control,
       );
 
       // Clean up tensors
@@ -386,9 +561,42 @@ class OnnxStickerProcessor {
   static Future<OrtValue> _preprocessImageForOnnxOptimized(
     Uint8List pixels,
     int originalWidth,
-    int originalHeight,
-  ) async {
+    int originalHeight, {
+    NativeJobControl? control,
+  }) async {
     const modelInputSize = 320;
+    final inputShape = [1, 3, modelInputSize, modelInputSize];
+
+    // Native area resampling writes the normalized tensor directly, without
+    // a ui.Image round trip
+    if (NativeMaskProcessor.isAvailable) {
+      final normalizedData = NativeMaskProcessor.allocateFloat32(
+        3 * modelInputSize * modelInputSize,
+      );
+      final result = await NativeMaskProcessor.resizeRgbaToNchwAsync(
+        pixels,
+        originalWidth,
+        originalHeight,
+        normalizedData,
+        modelInputSize,
+        modelInputSize,
+        mean,
+        invStd,
+        context: _context,
+        control: control,
+      );
+      _throwIfCancelled(control);
+      if (result == MaskProcessorResult.success) {
+        return OrtValue.fromList(normalizedData, inputShape);
+      }
+      if (kDebugMode) {
+        dev.log(
+          'Native preprocessing failed ($result), using ui.Image resize',
+          name: "FlutterStickerMaker",
+        );
+      }
+    }
+
     final cacheKey = _ProcessingCache._generateKey(
       pixels,
       originalWidth,
@@ -427,7 +635,6 @@ class OnnxStickerProcessor {
     );
 
     // Create tensor with shape [1, 3, 320, 320] (NCHW format)
-    final inputShape = [1, 3, modelInputSize, modelInputSize];
     OrtValue inputTensor = await OrtValue.fromList(normalizedData, inputShape);
 
     return inputTensor;
@@ -504,12 +711,25 @@ class OnnxStickerProcessor {
   static Future<List<double>> _postprocessOnnxOutputOptimized(
     List<OrtValue> outputs,
     int targetWidth,
-    int targetHeight,
-  ) async {
+    int targetHeight, {
+    NativeJobControl? control,
+  }) async {
     if (outputs.isEmpty) {
       throw Exception('No output from ONNX model');
     }
 
+    // Native path: the flat float tensor goes straight to the upsampler,
+    // which writes the full-resolution mask into native memory
+    if (NativeMaskProcessor.isAvailable) {
+      final mask = await _upsampleOnnxOutputNative(
+        outputs.last,
+        targetWidth,
+        targetHeight,
+        control: control,
+      );
+      if (mask != null) return mask;
+    }
+
     final outputTensor = await outputs.last.asList();
 
     // More efficient data extraction
@@ -528,6 +748,56 @@ class OnnxStickerProcessor {
     );
   }
 
+  /// Upsample the [1, 1, H, W] model output natively; null when the
+  /// tensor has an unexpected layout or the native call fails
+  static Future<Float64List?> _upsampleOnnxOutputNative(
+    OrtValue output,
+    int targetWidth,
+    int targetHeight, {
+    NativeJobControl? control,
+  }) async {
+    final shape = output.shape;
+    if (shape.length < 2) return null;
+    final tensorHeight = shape[shape.length - 2];
+    final tensorWidth = shape[shape.length - 1];
+
+    final flat = await output.asFlattenedList();
+    if (flat.length != tensorWidth * tensorHeight) return null;
+
+    final tensor =
+        flat is Float32List
+            ? flat
+            : NativeMaskProcessor.allocateFloat32(flat.length);
+    if (!identical(tensor, flat)) {
+      for (var i = 0; i < flat.length; i++) {
+        tensor[i] = (flat[i] as num).toDouble();
+      }
+    }
+
+    final mask = NativeMaskProcessor.allocateFloat64(targetWidth * targetHeight);
+    final result = await NativeMaskProcessor.upsampleMaskAsync(
+      tensor,
+      tensorWidth,
+      tensorHeight,
+      mask,
+      targetWidth,
+      targetHeight,
+      context: _context,
+      control: control,
+    );
+    _throwIfCancelled(control);
+    if (result != MaskProcessorResult.success) {
+      if (kDebugMode) {
+        dev.log(
+          'Native mask upsampling failed ($result), using Dart fallback',
+          name: "FlutterStickerMaker",
+        );
+      }
+      return null;
+    }
+    return mask;
+  }
+
   /// Optimized mask data extraction
   static void _extractMaskDataOptimized(
     dynamic outputTensor,
@@ -610,15 +880,146 @@ class OnnxStickerProcessor {
     required bool addBorder,
     required String borderColor,
     required double borderWidth,
+    NativeJobControl? control,
   }) async {
     // Use memory pool for result buffer
     final result = _MemoryPool.getBuffer(width * height * 4);
     final borderColorRgb = _parseBorderColorOptimized(borderColor);
+    // Every path below paints the same disc border at this width, so a
+    // setting gives the same sticker whichever path the caches pick
     final borderWidthInt = borderWidth.round();
 
     try {
-      // Apply smoothing to the mask for better edges
-      final smoothedMask = await _smoothMaskAsync(mask, width, height, 3);
+      // A new mask goes through the fused pipeline, which never builds the
+      // smoothed or expanded mask. When the same mask comes back (border
+      // edits), smoothing once and keeping the SDF is cheaper.
+      final cached = _preparedMask;
+      final isPrepared =
+          cached != null &&
+          identical(cached.source, mask) &&
+          cached.width == width &&
+          cached.height == height;
+      if (NativeMaskProcessor.isAvailable &&
+          !isPrepared &&
+          !identical(_fusedMask, mask)) {
+        final nativeResult =
+            await NativeMaskProcessor.makeStickerMaskFusedAsync(
+              result,
+              mask,
+              width,
+              height,
+              StickerDefaults.maskSmoothingKernelSize,
+              addBorder,
+              borderColorRgb,
+              borderWidthInt,
+              source: pixels,
+              context: _context,
+              control: control,
+            );
+        _throwIfCancelled(control);
+
+        if (nativeResult == MaskProcessorResult.success) {
+          _fusedMask = mask;
+          if (kDebugMode) {
+            dev.log(
+              'Used native fused mask processing',
+              name: "FlutterStickerMaker",
+            );
+          }
+          return await _encodeToPng(result, width, height);
+        }
+      }
+
+      // The same image again with another border style: restyle the kept
+      // session, which rewrites only the pixels around the border
+      _stickerSessionUses++;
+      _stickerSessionTimer?.cancel();
+      try {
+        final session = await _restyleSession(
+          pixels,
+          mask,
+          width,
+          height,
+          addBorder,
+          borderColorRgb,
+          borderWidthInt.toDouble(),
+          control: control,
+        );
+        if (session != null) {
+          if (kDebugMode) {
+            dev.log(
+              'Used native sticker session restyle',
+              name: "FlutterStickerMaker",
+            );
+          }
+          return await _encodeToPng(session.pixels, width, height);
+        }
+      } finally {
+        _stickerSessionUses--;
+        _scheduleStickerSessionRelease();
+      }
+
+      // Smoothed mask and SDF are reused while the same mask comes back
+      final prepared = await _prepareMask(
+        mask,
+        width,
+        height,
+        control: control,
+      );
+      final smoothedMask = prepared.smoothedMask;
+
+      // Any border width is a threshold on the signed distance field, so
+      // border-only changes skip expansion entirely
+      final sdf = prepared.sdf;
+      if (sdf != null) {
+        final nativeResult = await NativeMaskProcessor.applyStickerMaskSdfAsync(
+          result,
+          smoothedMask,
+          sdf,
+          width,
+          height,
+          addBorder,
+          borderColorRgb,
+          borderWidthInt.toDouble(),
+          source: pixels,
+          control: control,
+        );
+        _throwIfCancelled(control);
+
+        if (nativeResult == MaskProcessorResult.success) {
+          if (kDebugMode) {
+            dev.log(
+              'Used native SDF mask processing',
+              name: "FlutterStickerMaker",
+            );
+          }
+          return await _encodeToPng(result, width, height);
+        }
+      }
+
+      // Packed expansion keeps the 1-bit border mask in native memory
+      if (NativeMaskProcessor.isAvailable) {
+        final nativeResult = NativeMaskProcessor.applyStickerMaskPacked(
+          result,
+          smoothedMask,
+          width,
+          height,
+          addBorder,
+          borderColorRgb,
+          borderWidthInt,
+          source: pixels,
+        );
+
+        if (nativeResult == MaskProcessorResult.success) {
+          if (kDebugMode) {
+            dev.log(
+              'Used native packed mask processing',
+              name: "FlutterStickerMaker",
+            );
+          }
+          return await _encodeToPng(result, width, height);
+        }
+      }
 
       // Create expanded mask for border if needed
       List<double>? expandedMask;
@@ -628,12 +1029,10 @@ class OnnxStickerProcessor {
           width,
           height,
           borderWidthInt,
+          control: control,
         );
       }
 
-      // Copy pixels to result buffer first
-      result.setAll(0, pixels);
-
       // Try native implementation first
       if (NativeMaskProcessor.isAvailable) {
         final nativeResult = NativeMaskProcessor.applyStickerMask(
@@ -645,6 +1044,7 @@ class OnnxStickerProcessor {
           borderColorRgb,
           borderWidthInt,
           expandedMask,
+          source: pixels,
         );
 
         if (nativeResult == MaskProcessorResult.success) {
@@ -693,6 +1093,144 @@ class OnnxStickerProcessor {
     }
   }
 
+  /// The session for this image with the given border style, restyling
+  /// the kept one when it matches and creating it otherwise. Null without
+  /// native support or above StickerDefaults.maxStickerSessionPixels.
+  static Future<NativeStickerSession?> _restyleSession(
+    Uint8List pixels,
+    List<double> mask,
+    int width,
+    int height,
+    bool addBorder,
+    List<int> borderColorRgb,
+    double borderWidth, {
+    NativeJobControl? control,
+  }) async {
+    if (!NativeMaskProcessor.isAvailable) return null;
+
+    final cached = _stickerSession;
+    if (width * height > StickerDefaults.maxStickerSessionPixels) {
+      cached?.session.dispose();
+      _stickerSession = null;
+      return null;
+    }
+    if (cached != null && cached.matches(pixels, mask, width, height)) {
+      final session = cached.session;
+      if (session.setAddBorder(addBorder) == MaskProcessorResult.success &&
+          session.setBorderColor(borderColorRgb) ==
+              MaskProcessorResult.success &&
+          session.setBorderWidth(borderWidth) == MaskProcessorResult.success) {
+        return session;
+      }
+    }
+
+    cached?.session.dispose();
+    _stickerSession = null;
+
+    final session = await NativeStickerSession.createAsync(
+      pixels,
+      mask,
+      width,
+      height,
+      StickerDefaults.maskSmoothingKernelSize,
+      addBorder,
+      borderColorRgb,
+      borderWidth,
+      control: control,
+    );
+    _throwIfCancelled(control);
+    if (session == null) return null;
+
+    _stickerSession = _StickerSessionEntry(
+      source: mask,
+      pixels: WeakReference(pixels),
+      pixelsHash: NativeMaskProcessor.contentHash128(pixels),
+      session: session,
+    );
+    _memoryPressureObserver ??= _MemoryPressureObserver.register();
+    return session;
+  }
+
+  // Free the session once no call uses it: now after memory pressure,
+  // otherwise when it has sat unused for the idle timeout
+  static void _scheduleStickerSessionRelease() {
+    _stickerSessionTimer?.cancel();
+    _stickerSessionTimer = null;
+    if (_stickerSession == null || _stickerSessionUses > 0) return;
+
+    if (_stickerSessionReleasePending) {
+      _releaseStickerSession();
+    } else {
+      _stickerSessionTimer = Timer(
+        const Duration(seconds: StickerDefaults.stickerSessionIdleSeconds),
+        _releaseStickerSession,
+      );
+    }
+  }
+
+  static void _releaseStickerSession() {
+    _stickerSessionTimer?.cancel();
+    _stickerSessionTimer = null;
+    _stickerSessionReleasePending = false;
+    _stickerSession?.session.dispose();
+    _stickerSession = null;
+  }
+
+  static void _didHaveMemoryPressure() {
+    _stickerSessionReleasePending = true;
+    _scheduleStickerSessionRelease();
+  }
+
+  /// Smooth [mask] and compute its signed distance field, reusing the result
+  /// of the previous call when the same mask instance is passed again.
+  static Future<_PreparedMask> _prepareMask(
+    List<double> mask,
+    int width,
+    int height, {
+    NativeJobControl? control,
+  }) async {
+    final cached = _preparedMask;
+    if (cached != null &&
+        identical(cached.source, mask) &&
+        cached.width == width &&
+        cached.height == height) {
+      return cached;
+    }
+
+    final smoothedMask = await _smoothMaskAsync(
+      mask,
+      width,
+      height,
+      StickerDefaults.maskSmoothingKernelSize,
+      control: control,
+    );
+
+    Float32List? sdf;
+    if (NativeMaskProcessor.isAvailable) {
+      sdf = NativeMaskProcessor.allocateFloat32(width * height);
+      final nativeResult = await NativeMaskProcessor.computeMaskSdfAsync(
+        smoothedMask,
+        sdf,
+        width,
+        height,
+        context: _context,
+        control: control,
+      );
+      _throwIfCancelled(control);
+      if (nativeResult != MaskProcessorResult.success) {
+        sdf = null;
+      }
+    }
+
+    return _preparedMask = _PreparedMask(
+      source: mask,
+      width: width,
+      height: height,
+      smoothedMask: smoothedMask,
+      sdf: sdf,
+    );
+  }
+
   /// Dart fallback implementation for sticker effects
   static Future<void> _applyStickerEffectsDart(
     Uint8List result,
@@ -709,6 +1247,10 @@ class OnnxStickerProcessor {
     const thresholdLow = threshold - 0.05;
     const thresholdRange = 0.1;
 
+    // Background pixels keep the source RGB; a failed native attempt may
+    // also have left partial output behind
+    result.setAll(0, pixels);
+
     // Process in chunks to avoid blocking the main thread
     const chunkSize = 10000; // Process 10k pixels at a time
     final totalPixels = width * height;
@@ -736,7 +1278,7 @@ class OnnxStickerProcessor {
             result[pixelIndex + 2] = borderColorRgb[2];
             result[pixelIndex + 3] = 255;
           } else {
-            // Background pixel - transparent (already zeroed by pool)
+            // Background pixel - transparent
             result[pixelIndex + 3] = 0;
           }
         } else {
@@ -764,21 +1306,24 @@ class OnnxStickerProcessor {
     List<double> mask,
     int width,
     int height,
-    int kernelSize,
-  ) async {
+    int kernelSize, {
+    NativeJobControl? control,
+  }) async {
     if (kernelSize <= 1) return mask;
 
-    final smoothed = Float64List(width * height);
-
     // Try native implementation first
     if (NativeMaskProcessor.isAvailable) {
-      final nativeResult = NativeMaskProcessor.smoothMask(
+      final smoothed = NativeMaskProcessor.allocateFloat64(width * height);
+      final nativeResult = await NativeMaskProcessor.smoothMaskAsync(
         mask,
         smoothed,
         width,
         height,
         kernelSize,
+        context: _context,
+        control: control,
       );
+      _throwIfCancelled(control);
 
       if (nativeResult == MaskProcessorResult.success) {
         if (kDebugMode) {
@@ -863,19 +1408,22 @@ class OnnxStickerProcessor {
     List<double> mask,
     int width,
     int height,
-    int borderWidth,
-  ) async {
-    final expanded = Float64List(width * height);
-
+    int borderWidth, {
+    NativeJobControl? control,
+  }) async {
     // Try native implementation first
     if (NativeMaskProcessor.isAvailable) {
-      final nativeResult = NativeMaskProcessor.expandMask(
+      final expanded = NativeMaskProcessor.allocateFloat64(width * height);
+      final nativeResult = await NativeMaskProcessor.expandMaskAsync(
         mask,
         expanded,
         width,
         height,
         borderWidth,
+        context: _context,
+        control: control,
       );
+      _throwIfCancelled(control);
 
       if (nativeResult == MaskProcessorResult.success) {
         if (kDebugMode) {
@@ -966,6 +1514,7 @@ class OnnxStickerProcessor {
     int width,
     int height,
   ) async {
+    final encode = Stopwatch()..start();
     final completer = Completer<ui.Image>();
     ui.decodeImageFromPixels(
       rgbaBytes,
@@ -977,7 +1526,13 @@ class OnnxStickerProcessor {
 
     final image = await completer.future;
     final byteData = await image.toByteData(format: ui.ImageByteFormat.png);
-    return byteData!.buffer.asUint8List();
+    final png = byteData!.buffer.asUint8List();
+    NativeMaskProcessor.recordStage(
+      MaskStage.encode,
+      encode.elapsed,
+      bytes: rgbaBytes.length + png.length,
+    );
+    return png;
   }
 
   /// Clean up resources
@@ -993,6 +1548,13 @@ class OnnxStickerProcessor {
       _MemoryPool.clear();
       _floatBufferPool.clear();
       _colorCache.clear();
+      _preparedMask = null;
+      _fusedMask = null;
+      _releaseStickerSession();
+      _memoryPressureObserver?.unregister();
+      _memoryPressureObserver = null;
+      _nativeContext?.dispose();
+      _nativeContext = null;
     } catch (e) {
       // Log error but don't throw to prevent app crashes during disposal
       if (kDebugMode) {